@@ -30,6 +30,11 @@ LOCAL_SRC_FILES := \
     main.c \
     config.c \
     inotify_handler.c \
+    collector.c \
+    reactor.c \
+    notifier.c \
+    reaper.c \
+    quota.c \
     startupreason.c \
     crashutils.c \
     usercrash.c \
@@ -47,7 +52,7 @@ LOCAL_SRC_FILES := \
     getbulkprops.c \
     ingredients.c
 
-LOCAL_SHARED_LIBRARIES := libcutils libcrypto
+LOCAL_SHARED_LIBRARIES := libcutils libcrypto libz
 
 LOCAL_LDLIBS := -lm -llog
 LOCAL_CFLAGS += -D__LINUX__
@@ -84,6 +89,18 @@ ifeq ($(CRASHLOGD_MODULE_EARLYLOGS),true)
 LOCAL_CFLAGS += -DCONFIG_EARLY_LOGS
 endif
 
+ifeq ($(CRASHLOGD_COMPRESS_LOGS),true)
+LOCAL_CFLAGS += -DCONFIG_COMPRESS_LOGS
+endif
+
+ifeq ($(CRASHLOGD_FAST_EVENT_ID),true)
+LOCAL_CFLAGS += -DCONFIG_FAST_EVENT_ID
+endif
+
+ifeq ($(CRASHLOGD_CRASHFILE_FSYNC),true)
+LOCAL_CFLAGS += -DCONFIG_CRASHFILE_FSYNC
+endif
+
 LOCAL_PROPRIETARY_MODULE := true
 include $(BUILD_EXECUTABLE)
 
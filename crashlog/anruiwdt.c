@@ -43,32 +43,13 @@
 #include "dropbox.h"
 #include "fsutils.h"
 #include "utils.h"
-
-#define PATH_LENGTH			256
-void do_copy_pvr(char * src, char * dest) {
-   char buf[PATH_LENGTH] = {0, };
-   FILE * fs = NULL;
-   FILE * fd = NULL;
-   fs = fopen(src,"r");
-   fd = fopen(dest,"w");
-   if (fs && fd) {
-		while(fgets(buf, PATH_LENGTH, fs)) {
-		    fputs(buf ,fd);
-		 }
-   }
-   if (fs)
-      fclose(fs);
-   if (fd)
-      fclose(fd);
-
-   return;
-}
+#include "notifier.h"
 
 #ifdef CONFIG_BTDUMP
 
 struct bt_dump_arg {
     int eventtype;
-    char *key;
+    char key[EVENT_ID_SIZE];
     char *destion;
     char *eventname;
 };
@@ -154,18 +135,9 @@ void *dump_bt_all(void *param) {
 #endif
         ) {
         /*done */
-        snprintf(cmd, sizeof(cmd) - 1, "am broadcast -n com.intel.crashreport"
-                 "/.specific.NotificationReceiver -a com.intel.crashreport.intent.CRASH_LOGS_COPY_FINISHED "
-                 "-c android.intent.category.ALTERNATIVE --es com.intel.crashreport.extra.EVENT_ID %s",
-                 args->key);
-
-        int status = run_command(cmd, 30);
-        if (status != 0)
-            LOGI("%s: Notify crashreport status(%d) for command \"%s\".\n",
-                 __FUNCTION__, status, cmd);
+        notifier_logs_copy_finished(args->key);
     }
 
-    free(args->key);
     free(args->eventname);
     free(args->destion);
     free(param);
@@ -182,7 +154,7 @@ int process_anruiwdt_event(struct watch_entry *entry, struct inotify_event *even
     char path[PATHMAX];
     char destion[PATHMAX];
     const char *dateshort = get_current_time_short(1);
-    char *key = NULL;
+    char key[EVENT_ID_SIZE];
     char *dir;
 #ifdef CONFIG_BTDUMP
     struct bt_dump_arg *btd_param;
@@ -193,14 +165,14 @@ int process_anruiwdt_event(struct watch_entry *entry, struct inotify_event *even
     if ( manage_duplicate_dropbox_events(event) )
         return 1;
 
-    key = generate_event_id(CRASHEVENT, entry->eventname);
+    compute_event_id(key, CRASHEVENT, entry->eventname);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (dir != NULL) {
         snprintf(destion,sizeof(destion),"%s/%s", dir, "pvr_debug_dump.txt");
-        do_copy_pvr("/d/pvr/debug_dump", destion);
+        do_copy_eof("/d/pvr/debug_dump", destion);
         do_chown(destion, PERM_USER, PERM_GROUP);
         snprintf(destion,sizeof(destion),"%s/%s", dir, "fence_sync.txt");
-        do_copy_pvr("/d/sync", destion);
+        do_copy_eof("/d/sync", destion);
         do_chown(destion, PERM_USER, PERM_GROUP);
     }
     snprintf(path, sizeof(path),"%s/%s", entry->eventpath, event->name);
@@ -213,7 +185,6 @@ int process_anruiwdt_event(struct watch_entry *entry, struct inotify_event *even
         }
         raise_event(key, CRASHEVENT, entry->eventname, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), entry->eventname);
-        free(key);
         return -1;
     }
 
@@ -225,13 +196,13 @@ int process_anruiwdt_event(struct watch_entry *entry, struct inotify_event *even
 #ifdef CONFIG_DUMP_BINDER
     /*add binder transactions*/
     snprintf(destion,sizeof(destion),"%s/%s", dir, "binder_transactions.txt");
-    do_copy_pvr(BINDER_TRANSACTIONS, destion);
+    do_copy_eof(BINDER_TRANSACTIONS, destion);
     do_chown(destion, PERM_USER, PERM_GROUP);
     snprintf(destion,sizeof(destion),"%s/%s", dir, "binder_transaction_log.txt");
-    do_copy_pvr(BINDER_TRANSACTION_LOG, destion);
+    do_copy_eof(BINDER_TRANSACTION_LOG, destion);
     do_chown(destion, PERM_USER, PERM_GROUP);
     snprintf(destion,sizeof(destion),"%s/%s", dir, "binder_failed_transaction_log.txt");
-    do_copy_pvr(BINDER_FAILED_TRANSACTION_LOG, destion);
+    do_copy_eof(BINDER_FAILED_TRANSACTION_LOG, destion);
     do_chown(destion, PERM_USER, PERM_GROUP);
 #endif
 
@@ -240,7 +211,7 @@ int process_anruiwdt_event(struct watch_entry *entry, struct inotify_event *even
     if (!strcmp(bt_dis_prop, "0")) {
         /*alloc arguments */
         btd_param = malloc(sizeof(struct bt_dump_arg));
-        btd_param->key = key;
+        strcpy(btd_param->key, key);
         btd_param->destion = dir;
         btd_param->eventname = strdup(entry->eventname);
         btd_param->eventtype = entry->eventtype;
@@ -261,7 +232,6 @@ int process_anruiwdt_event(struct watch_entry *entry, struct inotify_event *even
 #ifdef FULL_REPORT
     start_dumpstate_srv(dir, key);
 #endif
-    free(key);
     free(dir);
     return 1;
 }
@@ -0,0 +1,342 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file collector.c
+ * @brief File containing functions to run the inotify event callbacks
+ * asynchronously.
+ *
+ * The jobs are kept in a list in the order they were submitted, the ones
+ * waiting for a worker in a second list. A worker takes the oldest queued job
+ * whose event type has not reached its concurrency limit. At most
+ * COLLECTOR_QUEUE_SIZE jobs are queued or running: a done job no longer counts,
+ * it is only parked until all the previous ones are done. Their deferred
+ * history lines are then committed in the submission order, so a slow job
+ * does not hold the submissions back.
+ */
+
+#include "collector.h"
+#include "privconfig.h"
+#include "crashutils.h"
+#include "history.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <cutils/properties.h>
+
+#define LOG_PREFIX "collector: "
+
+enum job_state {
+    JOB_QUEUED = 0,
+    JOB_RUNNING,
+    JOB_DONE,
+};
+
+struct collector_job {
+    enum job_state state;
+    struct watch_entry *entry;
+    struct inotify_event *event;    /* copy of the event, including its name */
+    char *lines;                    /* deferred history lines, '\0' separated */
+    size_t lines_len;
+    int notify;                     /* deferred crashreport notification */
+    struct collector_job *next;     /* next uncommitted job */
+    struct collector_job *next_queued;  /* next job waiting for a worker */
+};
+
+/* Number of jobs of each event type allowed to run at the same time.
+ * A 0 limit means the callback runs inline from the monitor loop:
+ * BUILDID exits the daemon and UPTIME rewrites the history first line. */
+static const unsigned int type_limits[EVENT_TYPE_NUMBER] = {
+    [ LOST_TYPE ... CMDTRIG_TYPE ] = 1,
+    [ BUILDID_TYPE ... UPTIME_TYPE ] = 0,
+};
+
+/* the uncommitted jobs and the queued ones, in the submission order */
+static struct collector_job *jobs = NULL;
+static struct collector_job **jobs_tail = &jobs;
+static struct collector_job *queued = NULL;
+static struct collector_job **queued_tail = &queued;
+/* jobs queued or running, at most COLLECTOR_QUEUE_SIZE */
+static unsigned int active = 0;
+static unsigned int type_running[EVENT_TYPE_NUMBER];
+static struct collector_stats stats;
+static int nbworkers = 0;
+static int key_created = 0;
+static pthread_key_t job_key;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t space_cond = PTHREAD_COND_INITIALIZER;
+/* PROP_PROC_ONGOING is set while the monitor loop or a job is busy */
+static int main_busy = 0;
+static int ongoing = -1;
+/* set while a thread commits the done jobs */
+static int committing = 0;
+
+/* Called with lock held */
+static void update_ongoing() {
+    int busy = (main_busy || committing || jobs != NULL);
+
+    if (busy == ongoing)
+        return;
+    property_set(PROP_PROC_ONGOING, busy ? "1" : "0");
+    ongoing = busy;
+}
+
+/* Called with lock held: takes the oldest queued job allowed to run */
+static struct collector_job *next_job() {
+    struct collector_job *job, **pjob;
+
+    for (pjob = &queued ; (job = *pjob) != NULL ; pjob = &job->next_queued) {
+        if (type_running[job->entry->eventtype] < type_limits[job->entry->eventtype]) {
+            *pjob = job->next_queued;
+            if (queued_tail == &job->next_queued)
+                queued_tail = pjob;
+            job->next_queued = NULL;
+            return job;
+        }
+    }
+    return NULL;
+}
+
+/* Called with lock held: commits the done jobs from the oldest one.
+ * The history lines and the notifications are committed with the lock
+ * released, a single thread committing at a time to keep their order. */
+static void commit_jobs() {
+    struct collector_job *job;
+    char *line;
+
+    if (committing)
+        return;
+
+    committing = 1;
+    while (jobs && jobs->state == JOB_DONE) {
+        job = jobs;
+        jobs = job->next;
+        if (!jobs)
+            jobs_tail = &jobs;
+        stats.depth--;
+        pthread_mutex_unlock(&lock);
+
+        for (line = job->lines ; line && line < job->lines + job->lines_len ;
+                line += strlen(line) + 1)
+            history_commit_line(line);
+        if (job->notify)
+            notify_crashreport();
+        free(job->lines);
+        free(job);
+
+        pthread_mutex_lock(&lock);
+        stats.completed++;
+    }
+    committing = 0;
+    update_ongoing();
+}
+
+static void *collector_worker(void __attribute__((unused)) *arg) {
+    struct collector_job *job;
+    int type, res;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        job = next_job();
+        if (!job) {
+            pthread_cond_wait(&work_cond, &lock);
+            continue;
+        }
+        type = job->entry->eventtype;
+        job->state = JOB_RUNNING;
+        type_running[type]++;
+        stats.running++;
+        pthread_mutex_unlock(&lock);
+
+        pthread_setspecific(job_key, job);
+        res = job->entry->pcallback(job->entry, job->event);
+        pthread_setspecific(job_key, NULL);
+        if (res < 0)
+            LOGE(LOG_PREFIX "%s: Can't handle the event %s...\n", __FUNCTION__,
+                job->event->len ? job->event->name : "");
+
+        pthread_mutex_lock(&lock);
+        type_running[type]--;
+        stats.running--;
+        /* parked until the previous jobs are done, the slot is free */
+        job->state = JOB_DONE;
+        active--;
+        pthread_cond_signal(&space_cond);
+        commit_jobs();
+        /* a job of this type may be waiting for the slot just released */
+        pthread_cond_broadcast(&work_cond);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the collection workers
+ *
+ * When no worker can be started, the callbacks are run inline by
+ * collector_submit.
+ *
+ * @return number of workers started, -1 on error.
+ */
+int collector_init() {
+    pthread_t thread;
+    int idx;
+
+    if (key_created)
+        return nbworkers;
+
+    if (pthread_key_create(&job_key, NULL)) {
+        LOGE(LOG_PREFIX "%s: Cannot create the job key\n", __FUNCTION__);
+        return -1;
+    }
+    key_created = 1;
+
+    for (idx = 0 ; idx < COLLECTOR_WORKERS ; idx++) {
+        if (pthread_create(&thread, NULL, collector_worker, NULL)) {
+            LOGE(LOG_PREFIX "%s: Cannot create worker %d - %s\n",
+                __FUNCTION__, idx, strerror(errno));
+            break;
+        }
+        pthread_detach(thread);
+        nbworkers++;
+    }
+    LOGI(LOG_PREFIX "%d workers started\n", nbworkers);
+    return nbworkers;
+}
+
+/**
+ * @brief Queues the callback of a watch entry for an event
+ *
+ * The event is copied so the caller buffer can be reused. When
+ * COLLECTOR_QUEUE_SIZE jobs are already queued or running, the caller waits
+ * for one of them to be done.
+ *
+ * @return 1 if the job is queued, else the result of the callback run inline.
+ */
+int collector_submit(struct watch_entry *entry, struct inotify_event *event) {
+    struct collector_job *job;
+    size_t size;
+    char value[PROPERTY_VALUE_MAX];
+
+    if (!entry || !entry->pcallback || !event)
+        return -EINVAL;
+
+    if (!nbworkers || entry->eventtype < 0 || entry->eventtype >= EVENT_TYPE_NUMBER ||
+            !type_limits[entry->eventtype])
+        return entry->pcallback(entry, event);
+
+    /* the copy of the event follows the job */
+    size = sizeof(struct inotify_event) + event->len;
+    job = calloc(1, sizeof(*job) + size);
+    if (!job) {
+        LOGE(LOG_PREFIX "%s: Cannot queue the event %s, process it inline\n",
+            __FUNCTION__, event->len ? event->name : "");
+        return entry->pcallback(entry, event);
+    }
+    job->entry = entry;
+    job->event = (struct inotify_event *)(job + 1);
+    memcpy(job->event, event, size);
+    job->state = JOB_QUEUED;
+
+    pthread_mutex_lock(&lock);
+    while (active >= COLLECTOR_QUEUE_SIZE)
+        pthread_cond_wait(&space_cond, &lock);
+
+    active++;
+    *jobs_tail = job;
+    jobs_tail = &job->next;
+    *queued_tail = job;
+    queued_tail = &job->next_queued;
+
+    stats.submitted++;
+    stats.depth++;
+    if (stats.depth > stats.max_depth) {
+        stats.max_depth = stats.depth;
+        snprintf(value, sizeof(value), "%u", stats.max_depth);
+        property_set(PROP_QUEUE_MAXDEPTH, value);
+    }
+    update_ongoing();
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&lock);
+    return 1;
+}
+
+/**
+ * @brief Defers a history line raised by the current job
+ *
+ * @return 1 if the line will be committed with the job, 0 if the caller is
+ * not a collection job and shall commit the line itself.
+ */
+int collector_defer_history(const char *line) {
+    struct collector_job *job;
+    size_t len;
+    char *lines;
+
+    if (!key_created || !line || (job = pthread_getspecific(job_key)) == NULL)
+        return 0;
+
+    len = strlen(line) + 1;
+    lines = realloc(job->lines, job->lines_len + len);
+    if (!lines) {
+        LOGE(LOG_PREFIX "%s: Cannot defer the history line, commit it now\n",
+            __FUNCTION__);
+        return 0;
+    }
+    memcpy(lines + job->lines_len, line, len);
+    job->lines = lines;
+    job->lines_len += len;
+    return 1;
+}
+
+/**
+ * @brief Defers the crashreport notification raised by the current job
+ * after its history lines are committed
+ *
+ * @return 1 if deferred, 0 if the caller is not a collection job.
+ */
+int collector_defer_notify() {
+    struct collector_job *job;
+
+    if (!key_created || (job = pthread_getspecific(job_key)) == NULL)
+        return 0;
+
+    job->notify = 1;
+    return 1;
+}
+
+/**
+ * @brief Sets whether the monitor loop is busy, PROP_PROC_ONGOING being
+ * updated when neither the loop nor the jobs are busy anymore and back.
+ */
+void collector_set_ongoing(int busy) {
+    pthread_mutex_lock(&lock);
+    main_busy = busy;
+    update_ongoing();
+    pthread_mutex_unlock(&lock);
+}
+
+void collector_get_stats(struct collector_stats *out) {
+    if (!out)
+        return;
+
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
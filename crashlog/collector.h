@@ -0,0 +1,50 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file collector.h
+ * @brief File containing functions to run the inotify event callbacks
+ * asynchronously.
+ *
+ * The inotify events are queued as collection jobs to a bounded pool of
+ * worker threads so the monitor loop never blocks on the logs collection.
+ * Each event type has its own concurrency limit. The history lines and
+ * the crashreport notification raised by a job are deferred until every
+ * previous job is done, so the history_event order follows the order in
+ * which the events were received.
+ */
+
+#ifndef __COLLECTOR_H__
+#define __COLLECTOR_H__
+
+#include "inotify_handler.h"
+
+struct collector_stats {
+    unsigned int depth;         /* jobs submitted, not yet committed */
+    unsigned int max_depth;     /* highest depth reached */
+    unsigned int running;       /* jobs being processed by a worker */
+    unsigned long submitted;
+    unsigned long completed;
+};
+
+int collector_init();
+int collector_submit(struct watch_entry *entry, struct inotify_event *event);
+int collector_defer_history(const char *line);
+int collector_defer_notify();
+void collector_set_ongoing(int busy);
+void collector_get_stats(struct collector_stats *stats);
+
+#endif /* __COLLECTOR_H__ */
@@ -24,17 +24,221 @@
  * composed of a list of key-value couples.
  * A config is then used to configure crashlogd behavior.
  * One or several configs can be loaded.
+ *
+ * The sections, the key/value items and the section names and keys of a
+ * config are allocated in chunks owned by its index, the names and keys
+ * being interned. Once the file is loaded, the sections and the key/value
+ * items are indexed in open addressing hash tables; the first occurrence
+ * of a duplicated section or key is indexed, as a list walk would find it.
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <ctype.h>
 #include "config.h"
 #define LOG_TAG "CRASHCONFIG"
 #include "log.h"
 
 #define MAXLEN 127
+#define CONFIG_CHUNK_SIZE       4096
+#define CONFIG_MIN_SLOTS        16
+#define CONFIG_HASH_SEED        2166136261U
+#define CONFIG_HASH_PRIME       16777619U
+
+struct config_chunk {
+    struct config_chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+struct config_kv_slot {
+    psection section;
+    pkv kv;
+};
+
+struct config_index {
+    struct config_chunk *chunks;    /* sections, kv items and interned strings */
+    char **strings;                 /* interned strings */
+    unsigned int string_slots;
+    unsigned int nbstrings;
+    psection *sections;             /* sections by name */
+    unsigned int section_slots;
+    struct config_kv_slot *kvs;     /* kv items by section and key */
+    unsigned int kv_slots;
+    unsigned int nbsections;
+    unsigned int nbkvs;
+    pkv last_kv;                    /* last kv item of the section being loaded */
+};
+
+/* FNV-1a of the len first characters of s */
+static uint32_t config_hash(const char *s, size_t len, uint32_t hash) {
+    while (len--) {
+        hash ^= (unsigned char)*s++;
+        hash *= CONFIG_HASH_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t config_name_hash(const char *name) {
+    return config_hash(name, strlen(name), CONFIG_HASH_SEED);
+}
+
+/* The hash of a key extends the hash of its section name */
+static uint32_t config_kv_hash(uint32_t section_hash, const char *key) {
+    /* separates "ab"/"c" from "a"/"bc" */
+    uint32_t hash = config_hash("", 1, section_hash);
+
+    return config_hash(key, strlen(key), hash);
+}
+
+/* Returns the number of slots of a table holding count entries at most half full */
+static unsigned int config_slots(unsigned int count) {
+    unsigned int slots = CONFIG_MIN_SLOTS;
+
+    while (slots < 2 * count)
+        slots <<= 1;
+    return slots;
+}
+
+static void *config_alloc(struct config_index *index, size_t size) {
+    struct config_chunk *chunk = index->chunks;
+    void *ptr;
+
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    if (!chunk || chunk->used + size > chunk->size) {
+        size_t chunk_size = size > CONFIG_CHUNK_SIZE ? size : CONFIG_CHUNK_SIZE;
+
+        chunk = malloc(sizeof(*chunk) + chunk_size);
+        if (!chunk)
+            return NULL;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        chunk->next = index->chunks;
+        index->chunks = chunk;
+    }
+    ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+static int config_grow_strings(struct config_index *index) {
+    unsigned int slots = config_slots(index->nbstrings + 1), idx, pos;
+    char **strings;
+
+    if (slots <= index->string_slots)
+        return 0;
+    strings = calloc(slots, sizeof(*strings));
+    if (!strings)
+        return -1;
+    for (idx = 0 ; idx < index->string_slots ; idx++) {
+        if (!index->strings[idx])
+            continue;
+        pos = config_name_hash(index->strings[idx]);
+        for (pos &= slots - 1 ; strings[pos] ; pos = (pos + 1) & (slots - 1));
+        strings[pos] = index->strings[idx];
+    }
+    free(index->strings);
+    index->strings = strings;
+    index->string_slots = slots;
+    return 0;
+}
+
+/* Returns the interned copy of the len first characters of s */
+static char *config_intern(struct config_index *index, const char *s, size_t len) {
+    unsigned int pos;
+    char *copy;
+
+    if (config_grow_strings(index) < 0)
+        return NULL;
+    pos = config_hash(s, len, CONFIG_HASH_SEED) & (index->string_slots - 1);
+    for ( ; index->strings[pos] ; pos = (pos + 1) & (index->string_slots - 1)) {
+        if (!strncmp(index->strings[pos], s, len) && index->strings[pos][len] == '\0')
+            return index->strings[pos];
+    }
+    copy = config_alloc(index, len + 1);
+    if (!copy)
+        return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    index->strings[pos] = copy;
+    index->nbstrings++;
+    return copy;
+}
+
+static psection config_index_find_section(struct config_index *index, const char *name,
+        uint32_t hash) {
+    unsigned int pos = hash;
+
+    for (pos &= index->section_slots - 1 ; index->sections[pos] ;
+            pos = (pos + 1) & (index->section_slots - 1)) {
+        if (!strcmp(index->sections[pos]->name, name))
+            return index->sections[pos];
+    }
+    return NULL;
+}
+
+static pkv config_index_find_kv(struct config_index *index, psection section, const char *key,
+        uint32_t section_hash) {
+    unsigned int pos = config_kv_hash(section_hash, key);
+    struct config_kv_slot *slot;
+
+    for (pos &= index->kv_slots - 1 ; index->kvs[pos].kv ; pos = (pos + 1) & (index->kv_slots - 1)) {
+        slot = &index->kvs[pos];
+        if (slot->section == section && !strcmp(slot->kv->key, key))
+            return slot->kv;
+    }
+    return NULL;
+}
+
+/*
+* Name          : build_index
+* Description   : This function indexes the sections and kv items of a loaded
+*                 config. Without index, the lookups walk the lists.
+* Parameters    :
+*   pconfig_handle  conf_handle -> handle where is stored the configuration
+*/
+static void build_index(pconfig_handle conf_handle) {
+    struct config_index *index = conf_handle->index;
+    unsigned int pos;
+    uint32_t hash;
+    psection section;
+    pkv kv;
+
+    index->section_slots = config_slots(index->nbsections);
+    index->kv_slots = config_slots(index->nbkvs);
+    index->sections = calloc(index->section_slots, sizeof(*index->sections));
+    index->kvs = calloc(index->kv_slots, sizeof(*index->kvs));
+    if (!index->sections || !index->kvs) {
+        LOGE("%s: Cannot allocate the config index\n", __FUNCTION__);
+        free(index->sections);
+        free(index->kvs);
+        index->sections = NULL;
+        index->kvs = NULL;
+        return;
+    }
+
+    for (section = conf_handle->first ; section ; section = section->next) {
+        hash = config_name_hash(section->name);
+        if (!config_index_find_section(index, section->name, hash)) {
+            pos = hash;
+            for (pos &= index->section_slots - 1 ; index->sections[pos] ;
+                    pos = (pos + 1) & (index->section_slots - 1));
+            index->sections[pos] = section;
+        }
+        for (kv = section->kvlist ; kv ; kv = kv->next) {
+            if (config_index_find_kv(index, section, kv->key, hash))
+                continue;
+            pos = config_kv_hash(hash, kv->key);
+            for (pos &= index->kv_slots - 1 ; index->kvs[pos].kv ;
+                    pos = (pos + 1) & (index->kv_slots - 1));
+            index->kvs[pos].section = section;
+            index->kvs[pos].kv = kv;
+        }
+    }
+}
 
 /*
 * Name          : config_trim
@@ -85,11 +289,19 @@ static void config_trim(char *s)
 *   char *config        -> char *corresponds to the name of the new section
 */
 static void add_section(char *config, pconfig_handle  conf_handle) {
-    psection newsect = malloc(sizeof(struct section));
+    struct config_index *index = conf_handle->index;
+    psection newsect = config_alloc(index, sizeof(struct section));
     if(!newsect) {
         LOGE("%s:malloc failed\n", __FUNCTION__);
         return;
     }
+    newsect->name = config_intern(index, config+1, strlen(config)-2); /*+1 for removing [ char */
+    if(!newsect->name) {
+        LOGE("%s:malloc failed\n", __FUNCTION__);
+        return;
+    }
+    newsect->kvlist = NULL;
+    newsect->next   = NULL;
     if (conf_handle->first == NULL){
     // start the chain off
         conf_handle->first = newsect;
@@ -98,18 +310,8 @@ static void add_section(char *config, pconfig_handle  conf_handle) {
         conf_handle->current->next = newsect;
      }
     conf_handle->current = newsect;
-    newsect->name = malloc(strlen(config));
-    if(!newsect->name) {
-        if(newsect) {
-            free(newsect);
-        }
-        LOGE("%s:malloc failed\n", __FUNCTION__);
-        return;
-    }
-    strncpy(newsect->name,config+1,strlen(config)-1); /*+1 for removing [ char */
-    newsect->name[strlen(config)-2]= '\0';
-    newsect->kvlist = NULL;
-    newsect->next   = NULL;
+    index->last_kv = NULL;
+    index->nbsections++;
 }
 
 /*
@@ -122,7 +324,6 @@ static int add_kv_pair(char *config,pconfig_handle  conf_handle) {
     char *key= NULL;
     char *value = NULL;
     pkv   newkv = NULL;
-    pkv   lastkv;
     size_t valuelen;
     size_t p=0;
     int iFound=-1;
@@ -143,31 +344,21 @@ static int add_kv_pair(char *config,pconfig_handle  conf_handle) {
         return 0; /*  No = in key = value => line ignored */
     }
 
-    newkv = malloc(sizeof(struct kv));
+    newkv = config_alloc(conf_handle->index, sizeof(struct kv));
     if(!newkv) {
         LOGE("%s: newkv malloc failed\n", __FUNCTION__);
         return 0;
     }
-    key=malloc(p+1);
+    key = config_intern(conf_handle->index, config, p);
     if(!key) {
-        if (newkv){
-            free(newkv);
-        }
         LOGE("%s: key malloc failed\n", __FUNCTION__);
         return 0;
     }
-    strncpy(key,config,p);
-    key[p]='\0';
 
+    /* the owner of the config may replace the value */
     valuelen = strlen(config)-p-1;
     value= malloc(valuelen+1); /* add 1 for \0 */
     if(!value) {
-        if (newkv){
-            free(newkv);
-        }
-        if (key){
-            free(key);
-        }
         LOGE("%s: key value malloc failed\n", __FUNCTION__);
         return 0;
     }
@@ -183,13 +374,10 @@ static int add_kv_pair(char *config,pconfig_handle  conf_handle) {
         conf_handle->current->kvlist = newkv;
     }
     else {
-        lastkv= conf_handle->current->kvlist;
-        //iterate until the end
-        while ((lastkv->next ) != NULL){
-            lastkv=lastkv->next;
-        }
-        lastkv->next = newkv;
+        conf_handle->index->last_kv->next = newkv;
     }
+    conf_handle->index->last_kv = newkv;
+    conf_handle->index->nbkvs++;
     return 1;
 }
 
@@ -230,6 +418,11 @@ psection find_section(char *section_name, pconfig_handle  conf_handle) {
             return conf_handle->current;
         }
     }
+    if (conf_handle->index && conf_handle->index->sections) {
+        conf_handle->current = config_index_find_section(conf_handle->index, section_name,
+            config_name_hash(section_name));
+        return conf_handle->current;
+    }
     conf_handle->current = conf_handle->first;
     while (conf_handle->current) {
         if (strcmp(conf_handle->current->name,section_name)==0){
@@ -245,6 +438,18 @@ psection find_section(char *section_name, pconfig_handle  conf_handle) {
 char *get_value (char *section, char *name, pconfig_handle  conf_handle) {
     char *result = NULL;
     config_trim(section);
+    if (conf_handle->index && conf_handle->index->kvs) {
+        //the section name is hashed once for both lookups
+        uint32_t hash = config_name_hash(section);
+        pkv kv;
+
+        if (!conf_handle->current || strcmp(conf_handle->current->name, section))
+            conf_handle->current = config_index_find_section(conf_handle->index, section, hash);
+        if (!conf_handle->current)
+            return NULL;
+        kv = config_index_find_kv(conf_handle->index, conf_handle->current, name, hash);
+        return kv ? kv->value : NULL;
+    }
     conf_handle->current = find_section(section,conf_handle);
     if (!conf_handle->current){
         //section not found
@@ -293,6 +498,7 @@ int init_config_file(const char *filename, pconfig_handle conf_handle) {
         //file could not be found
         conf_handle->first = NULL;
         conf_handle->current = NULL;
+        conf_handle->index = NULL;
         return -1;
     }
     LOGD("file opened");
@@ -303,6 +509,13 @@ int init_config_file(const char *filename, pconfig_handle conf_handle) {
     }
     LOGD("before while");
     conf_handle->first = NULL;
+    conf_handle->current = NULL;
+    conf_handle->index = calloc(1, sizeof(struct config_index));
+    if (!conf_handle->index) {
+        LOGE("%s: index malloc failed\n", __FUNCTION__);
+        fclose(f);
+        return -1;
+    }
     while (!feof(f)) {
         if (fgets(buff,MAXLEN-2,f)==NULL){
             break;
@@ -311,6 +524,7 @@ int init_config_file(const char *filename, pconfig_handle conf_handle) {
         generate_section_kv(buff,conf_handle);
     }
     fclose(f);
+    build_index(conf_handle);
     return 0;
 }
 
@@ -391,29 +605,29 @@ int cmp_config(pconfig_handle h1, pconfig_handle h2) {
 
 void free_config_file(pconfig_handle  conf_handle)
 {
-    pkv   currentkv;
-    pkv      nextkv;
-    psection nextsection;
+    struct config_index *index = conf_handle->index;
+    struct config_chunk *chunk;
     psection local_current;
-    local_current = conf_handle->first;
-    while (local_current){
-        currentkv = local_current->kvlist;
-// Free up the list of kv pairs in current section
-        while (currentkv){
-            nextkv = currentkv->next;
+    pkv   currentkv;
+
+// The values are the only items allocated one by one
+    for (local_current = conf_handle->first ; local_current ; local_current = local_current->next) {
+        for (currentkv = local_current->kvlist ; currentkv ; currentkv = currentkv->next)
             free(currentkv->value);
-            free(currentkv->key);
-            free(currentkv);
-            currentkv = nextkv;
+    }
+    if (index) {
+        while ((chunk = index->chunks) != NULL) {
+            index->chunks = chunk->next;
+            free(chunk);
         }
-// Now free current section
-        nextsection = local_current->next;
-        free(local_current->name);
-        free(local_current);
-        local_current = nextsection;
+        free(index->strings);
+        free(index->sections);
+        free(index->kvs);
+        free(index);
     }
     conf_handle->first=NULL;
     conf_handle->current=NULL;
+    conf_handle->index=NULL;
 }
 
 /*
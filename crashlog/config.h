@@ -25,6 +25,8 @@
  * composed of a list of key-value couples.
  * A config is then used to configure crashlogd behavior.
  * One or several configs can be loaded.
+ * Once loaded, a config is indexed by section name and by key, the lists
+ * keep the order of the file.
  */
 
 typedef struct kv * pkv;
@@ -33,8 +35,8 @@ typedef struct config_handle * pconfig_handle;
 
 
 struct kv {
-    char *key;
-    char *value;
+    char *key;     /* interned, owned by the config */
+    char *value;   /* allocated, may be replaced by the owner of the config */
     pkv   next;
 };
 
@@ -47,6 +49,7 @@ struct section {
 struct config_handle {
     psection first;
     psection current;
+    struct config_index *index;  /* set by init_config_file */
 };
 
 /*
@@ -36,6 +36,8 @@
 #include <errno.h>
 #include <stdio.h>
 #include <time.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <openssl/sha.h>
 #include <sys/wait.h>
 #include <pthread.h>
@@ -55,6 +57,10 @@
 #include "ingredients.h"
 #include "utils.h"
 #include "fwcrash.h"
+#include "collector.h"
+#include "notifier.h"
+#include "reaper.h"
+#include "quota.h"
 
 #ifdef CONFIG_EFILINUX
 #include <libuefivar.h>
@@ -73,6 +79,8 @@ int gabortcleansd = 0;
  *
  * if refresh requested, returns current date/time.
  * if refresh not requested, returns previous computed time if available.
+ * The computed values are kept per thread: a collection job reads back the
+ * date it refreshed, whatever the other jobs running at the same time.
  *
  * @param[in] refresh : force date/time re-computing or not.
  * @param[in] format : specifies requested date/time format.
@@ -88,7 +96,7 @@ const char *  __attribute__( ( noinline ) ) get_current_system_time(int refresh,
             [ TIME_FORMAT_LONG ]  = { "%Y-%m-%d/%H:%M:%S  " },
     };
     /* Array containing the current date/time under different formats */
-    static struct { char value[TIME_FORMAT_LENGTH]; } crashlog_time_array[] = {
+    static __thread struct { char value[TIME_FORMAT_LENGTH]; } crashlog_time_array[] = {
             [ DATE_FORMAT_SHORT ] = { {0,} },
             [ TIME_FORMAT_SHORT ] = { {0,} },
             [ TIME_FORMAT_LONG ]  = { {0,} },
@@ -102,7 +110,8 @@ const char *  __attribute__( ( noinline ) ) get_current_system_time(int refresh,
     if (time(&t) == (time_t)-1 )
         LOGE("%s: Can't get current system time : use value previously got - error is %s", __FUNCTION__, strerror(errno));
     else {
-        struct tm * time_val = localtime((const time_t *)&t);
+        struct tm tm_val;
+        struct tm * time_val = localtime_r((const time_t *)&t, &tm_val);
         if (!time_val) {
             LOGE("%s: Could not retrieve the local time. Returning previously computed values.", __FUNCTION__);
         } else {
@@ -128,7 +137,8 @@ const char *get_current_time_long(int refresh) {
 
 unsigned long long get_uptime(int refresh, int *error)
 {
-    static long long time_ns = -1;
+    /* per thread, as the date/time above */
+    static __thread long long time_ns = -1;
 #ifndef __LINUX__
     struct timespec ts;
     int result = -1;
@@ -238,50 +248,98 @@ void do_last_fw_msg_copy(char *dir) {
 #endif
 }
 
-/* Compute key shall be checked only once at the first call to insure the
-  memory allocation succeeded */
-static int compute_key(char* key, char *event, char *type)
-{
-    static SHA_CTX *sha = NULL;
-    char buf[256] = { '\0', };
-    long long time_ns=0;
-    char *tmp_key = key;
-    unsigned char results[SHA_DIGEST_LENGTH];
-    int i;
+/* Distinguishes the keys computed within the same clock tick */
+static unsigned long event_id_seq = 0;
+
+#ifdef CONFIG_FAST_EVENT_ID
+/* splitmix64 finalizer, a bijection on 64 bits */
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
 
-    if (sha == NULL) {
-        sha = (SHA_CTX*)malloc(sizeof(SHA_CTX));
-        if (sha == NULL) {
-            LOGE("%s - Cannot create SHA_CTX memory... fails to compute the key!\n", __FUNCTION__);
-            return -1;
-        }
-        SHA1_Init(sha);
+static uint64_t fnv1a(uint64_t hash, const char *str) {
+    for ( ; *str ; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3ULL;
     }
+    return hash;
+}
 
-    if (!key || !event || !type) return -EINVAL;
-
-    time_ns = get_uptime(1, &i);
-    snprintf(buf, 256, "%s%s%s%s%lld", gbuildversion, guuid, event, type, time_ns);
-
-    SHA1_Update(sha, (unsigned char*) buf, strlen(buf));
-    SHA1_Final(results, sha);
-    for (i = 0; i < SHA_DIGEST_LENGTH/2; i++)
-    {
-        sprintf(tmp_key, "%02x", results[i]);
-        tmp_key+=2;
-    }
-    *tmp_key=0;
-    return 0;
+/* FNV-1a of the seeds, mixed with the time then with the sequence number:
+ * the keys of a same tick differ as mix64 is a bijection */
+static void hash_event_id(unsigned char digest[EVENT_ID_SIZE / 2], const char *event,
+        const char *type, long long time_ns, unsigned long seq) {
+    uint64_t hash = 0xcbf29ce484222325ULL, high;
+    unsigned int idx;
+
+    hash = fnv1a(hash, gbuildversion);
+    hash = fnv1a(hash, guuid);
+    hash = fnv1a(hash, event);
+    hash = fnv1a(hash, type);
+    hash = mix64(mix64(hash ^ (uint64_t)time_ns) ^ seq);
+    high = mix64(hash);
+    for (idx = 0 ; idx < 8 ; idx++)
+        digest[idx] = hash >> (idx * 8);
+    for ( ; idx < EVENT_ID_SIZE / 2 ; idx++)
+        digest[idx] = high >> ((idx - 8) * 8);
+}
+#else
+static void hash_event_id(unsigned char digest[EVENT_ID_SIZE / 2], const char *event,
+        const char *type, long long time_ns, unsigned long seq) {
+    unsigned char results[SHA_DIGEST_LENGTH];
+    SHA_CTX sha;
+
+    SHA1_Init(&sha);
+    SHA1_Update(&sha, gbuildversion, strlen(gbuildversion));
+    SHA1_Update(&sha, guuid, strlen(guuid));
+    SHA1_Update(&sha, event, strlen(event));
+    SHA1_Update(&sha, type, strlen(type));
+    SHA1_Update(&sha, &time_ns, sizeof(time_ns));
+    SHA1_Update(&sha, &seq, sizeof(seq));
+    SHA1_Final(results, &sha);
+    memcpy(digest, results, EVENT_ID_SIZE / 2);
 }
+#endif
 
-char *generate_event_id(char *seed1, char *seed2) {
-    char *key = (char *)malloc(SHA_DIGEST_LENGTH+1);
+/**
+ * @brief Computes a new event id
+ *
+ * The id is the hash of the build, the serial number, the seeds, the boot
+ * time and a sequence number, as 20 hexadecimal digits. The function is
+ * reentrant and does not allocate.
+ *
+ * @param key buffer of EVENT_ID_SIZE bytes receiving the id
+ * @param seed1 usually the event name, NULL for none
+ * @param seed2 usually the event type, NULL for none
+ * @return 0 on success, -EINVAL if key is NULL.
+ */
+int compute_event_id(char key[EVENT_ID_SIZE], const char *seed1, const char *seed2) {
+    static const char hex[] = "0123456789abcdef";
+    unsigned char digest[EVENT_ID_SIZE / 2];
+    struct timespec ts;
+    long long time_ns;
+    unsigned long seq;
+    unsigned int idx;
 
     if (!key)
-        return NULL;
+        return -EINVAL;
 
-    compute_key(key, seed1, seed2);
-    return key;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    time_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    seq = __sync_fetch_and_add(&event_id_seq, 1);
+    hash_event_id(digest, seed1 ? seed1 : "", seed2 ? seed2 : "", time_ns, seq);
+
+    for (idx = 0 ; idx < sizeof(digest) ; idx++) {
+        key[2 * idx] = hex[digest[idx] >> 4];
+        key[2 * idx + 1] = hex[digest[idx] & 0xf];
+    }
+    key[EVENT_ID_SIZE - 1] = '\0';
+    return 0;
 }
 
 char **commachain_to_fixedarray(char *chain,
@@ -347,112 +405,173 @@ char **commachain_to_fixedarray(char *chain,
     return array;
 }
 
-static const char *get_imei() {
-    static char imei[PROPERTY_VALUE_MAX] = { 0, };
-
-    if (imei[0] != 0) return imei;
+static char imei[PROPERTY_VALUE_MAX] = { 0, };
+static pthread_once_t imei_once = PTHREAD_ONCE_INIT;
 
+static void read_imei() {
     property_get(IMEI_FIELD, imei, "");
+}
+
+/* The collector workers write crashfiles at the same time: the IMEI is
+ * read once, the operator in a buffer of each thread as it may change */
+static const char *get_imei() {
+    pthread_once(&imei_once, read_imei);
     return imei;
 }
 
 static const char *get_operator() {
-    static char operator[PROPERTY_VALUE_MAX] = { 0, };
+    static __thread char operator[PROPERTY_VALUE_MAX];
+
     property_get(OPERATOR_FIELD, operator, "UNKNOWN");
     return operator;
 }
 
+/* Appends a formatted line to the crashfile buffer, truncated to its size */
+static void crashfile_printf(char *buf, size_t size, size_t *len, const char *fmt, ...) {
+    va_list args;
+    int res;
+
+    if (*len >= size - 1)
+        return;
+    va_start(args, fmt);
+    res = vsnprintf(buf + *len, size - *len, fmt, args);
+    va_end(args);
+    if (res > 0)
+        *len += MIN((size_t)res, size - *len - 1);
+}
+
+/* Appends the DATA fields of a modem panic, read from the first mpanic or
+ * crashdata file of the folder dirfd */
+static int crashfile_mpanic_data(int dirfd, const char *path, char *buf, size_t size, size_t *len) {
+    char value[PATHMAX];
+    struct dirent *de;
+    FILE *fp;
+    DIR *d;
+    int fd;
+
+    LOGI("Modem panic detected : generating DATA0\n");
+    /* the listing needs its own descriptor, dirfd is still used to publish */
+    fd = dup(dirfd);
+    if (fd < 0 || (d = fdopendir(fd)) == NULL) {
+        LOGE("%s: Can't open dir %s\n", __FUNCTION__, path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    while ((de = readdir(d))) {
+        const char *name = de->d_name;
+        int ismpanic, iscrashdata = 0;
+        ismpanic = (strstr(name, "mpanic") != NULL);
+        if (!ismpanic) iscrashdata = (strstr(name, "_crashdata") != NULL);
+        if (!ismpanic && !iscrashdata)
+            continue;
+
+        fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || (fp = fdopen(fd, "r")) == NULL) {
+            LOGE("%s: can not open file: %s/%s\n", __FUNCTION__, path, name);
+            if (fd >= 0)
+                close(fd);
+            break;
+        }
+        if (ismpanic) {
+            /* value holds PATHMAX bytes */
+            if (fscanf(fp, "%511s", value) == 1)
+                crashfile_printf(buf, size, len, "DATA0=%s\n", value);
+        }
+        else { // iscrashdata
+            while (fgets(value, sizeof(value), fp) && !strstr(value, "_END")) {
+                value[strcspn(value, "\n")] = '\0';
+                crashfile_printf(buf, size, len, "%s\n", value);
+            }
+        }
+        fclose(fp);
+        break;
+    }
+    closedir(d);
+    return 0;
+}
+
 //This function creates a minimal crashfile (DATA0, DATA1 and DATA2 fields)
 //Note: for Modem Panic case, DATA are set via file parsing adn parameters
 //  Data0,1,2 are ignored
+//The crashfile is rendered in memory, written to a temporary file and renamed
+//over CRASHFILE_NAME so the readers never see it partially written
 static int create_minimal_crashfile(char * event, const char* type, const char* path, char* key,
       const char* uptime, const char* date, int data_ready, char* data0, char* data1, char* data2)
 {
-    FILE *fp;
-    char fullpath[PATHMAX];
-    char mpanicpath[PATHMAX];
-
-    snprintf(fullpath, sizeof(fullpath)-1, "%s/%s", path, CRASHFILE_NAME);
-
-    //Create crashfile
-    errno = 0;
-    fp = fopen(fullpath,"w");
-    if (fp == NULL)
-    {
-        LOGE("%s: Cannot create %s - %s\n", __FUNCTION__, fullpath, strerror(errno));
-        return -errno;
-    }
-    fclose(fp);
-    do_chown(fullpath, PERM_USER, PERM_GROUP);
-
-    fp = fopen(fullpath,"w");
-    if (fp == NULL)
-    {
-        LOGE("%s: can not open file: %s\n", __FUNCTION__, fullpath);
+    char buf[CRASHFILE_MAXSIZE];
+    char tmppath[PATHMAX];
+    size_t len = 0, size = sizeof(buf) - sizeof("_END\n") + 1;
+    ssize_t written;
+    int dirfd, fd, res = 0;
+
+    dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        LOGE("%s: Cannot open %s - %s\n", __FUNCTION__, path, strerror(errno));
         return -errno;
     }
 
     //Fill crashfile
-    fprintf(fp,"EVENT=%s\n", event);
-    fprintf(fp,"ID=%s\n", key);
-    fprintf(fp,"SN=%s\n", guuid);
-    fprintf(fp,"DATE=%s\n", date);
-    fprintf(fp,"UPTIME=%s\n", uptime);
-    fprintf(fp,"BUILD=%s\n", get_build_footprint());
-    fprintf(fp,"BOARD=%s\n", gboardversion);
-    fprintf(fp,"IMEI=%s\n", get_imei());
-    fprintf(fp,"TYPE=%s\n", type);
-    fprintf(fp,"DATA_READY=%d\n", data_ready);
-    fprintf(fp,"OPERATOR=%s\n", get_operator());
+    crashfile_printf(buf, size, &len, "EVENT=%s\n", event);
+    crashfile_printf(buf, size, &len, "ID=%s\n", key);
+    crashfile_printf(buf, size, &len, "SN=%s\n", guuid);
+    crashfile_printf(buf, size, &len, "DATE=%s\n", date);
+    crashfile_printf(buf, size, &len, "UPTIME=%s\n", uptime);
+    crashfile_printf(buf, size, &len, "BUILD=%s\n", get_build_footprint());
+    crashfile_printf(buf, size, &len, "BOARD=%s\n", gboardversion);
+    crashfile_printf(buf, size, &len, "IMEI=%s\n", get_imei());
+    crashfile_printf(buf, size, &len, "TYPE=%s\n", type);
+    crashfile_printf(buf, size, &len, "DATA_READY=%d\n", data_ready);
+    crashfile_printf(buf, size, &len, "OPERATOR=%s\n", get_operator());
     //MPANIC crash : fill DATA field and preempt data012 mechanism
-    if (!strcmp(MDMCRASH_EVNAME, type)){
-        LOGI("Modem panic detected : generating DATA0\n");
-        FILE *fd_panic;
-        DIR *d;
-        struct dirent* de;
-        d = opendir(path);
-        if(!d) {
-            LOGE("%s: Can't open dir %s\n",__FUNCTION__, path);
-            fclose(fp);
+    if (!strcmp(MDMCRASH_EVNAME, type)) {
+        if (crashfile_mpanic_data(dirfd, path, buf, size, &len) < 0) {
+            close(dirfd);
             return -1;
         }
-        while ((de = readdir(d))) {
-            const char *name = de->d_name;
-            int ismpanic, iscrashdata = 0;
-            ismpanic = (strstr(name, "mpanic") != NULL);
-            if (!ismpanic) iscrashdata = (strstr(name, "_crashdata") != NULL);
-            if (ismpanic || iscrashdata) {
-                snprintf(mpanicpath, sizeof(mpanicpath)-1, "%s/%s", path, name);
-                fd_panic = fopen(mpanicpath, "r");
-                if (fd_panic == NULL){
-                    LOGE("%s: can not open file: %s\n", __FUNCTION__, mpanicpath);
-                    break;
-                }
-                char value[PATHMAX] = "";
-                if (ismpanic) {
-                    int ret = fscanf(fd_panic, "%s", value);
-                    if (ret != EOF)
-                        fprintf(fp,"DATA0=%s\n", value);
-                }
-                else { // iscrashdata
-                    while (fgets(value,sizeof(value),fd_panic) && !strstr(value,"_END"))
-                        fprintf(fp,"%s\n", value);
-                }
-                fclose(fd_panic);
-                break;
-            }
-        }
-        closedir(d);
     } else {
         if (data0)
-            fprintf(fp,"DATA0=%s\n", data0);
+            crashfile_printf(buf, size, &len, "DATA0=%s\n", data0);
         if (data1)
-            fprintf(fp,"DATA1=%s\n", data1);
+            crashfile_printf(buf, size, &len, "DATA1=%s\n", data1);
         if (data2)
-            fprintf(fp,"DATA2=%s\n", data2);
-    }
-    fprintf(fp,"_END\n");
-    fclose(fp);
+            crashfile_printf(buf, size, &len, "DATA2=%s\n", data2);
+    }
+    crashfile_printf(buf, sizeof(buf), &len, "_END\n");
+
+    snprintf(tmppath, sizeof(tmppath), "%s/%s", path, CRASHFILE_TMP_NAME);
+    fd = openat(dirfd, CRASHFILE_TMP_NAME, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    if (fd < 0) {
+        res = -errno;
+        LOGE("%s: Cannot create %s - %s\n", __FUNCTION__, tmppath, strerror(errno));
+        close(dirfd);
+        return res;
+    }
+    written = do_write(fd, buf, len);
+    if (written != (ssize_t)len)
+        res = written < 0 ? (int)written : -EIO;
+#ifdef CONFIG_CRASHFILE_FSYNC
+    if (!res && fsync(fd) < 0)
+        res = -errno;
+#endif
+    close(fd);
+    do_chown(tmppath, PERM_USER, PERM_GROUP);
+
+    if (!res && renameat(dirfd, CRASHFILE_TMP_NAME, dirfd, CRASHFILE_NAME) < 0)
+        res = -errno;
+    if (res) {
+        LOGE("%s: Cannot write %s/%s - %s\n", __FUNCTION__, path, CRASHFILE_NAME, strerror(-res));
+        unlinkat(dirfd, CRASHFILE_TMP_NAME, 0);
+        close(dirfd);
+        return res;
+    }
+#ifdef CONFIG_CRASHFILE_FSYNC
+    /* the rename itself is only durable once the folder is synced */
+    fsync(dirfd);
+#endif
+    close(dirfd);
+    /* only the folder of the path is accounted */
+    quota_account(tmppath, len);
     return 0;
 }
 
@@ -777,7 +896,7 @@ int process_info_and_error(char *filename, char *name) {
     char file_ext[20];
     char type[20] = { '\0', };
     char tmp_data_name[PATHMAX];
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     if (strstr(name, "_infoevent" )){
         snprintf(name_event,sizeof(name_event),"%s",INFOEVENT);
@@ -791,7 +910,7 @@ int process_info_and_error(char *filename, char *name) {
     }
     snprintf(tmp,sizeof(tmp),"%s",name);
 
-    key = generate_event_id(name_event, tmp);
+    compute_event_id(key, name_event, tmp);
     dir = generate_crashlog_dir(MODE_STATS, key);
     if (!dir) {
         LOGE("%s: Cannot get a valid new crash directory...\n", __FUNCTION__);
@@ -801,7 +920,6 @@ int process_info_and_error(char *filename, char *name) {
         }
         raise_event(key, name_event, tmp, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", name_event, key, get_current_time_long(0), tmp);
-        free(key);
         return -1;
     }
     /*copy data file*/
@@ -833,7 +951,6 @@ int process_info_and_error(char *filename, char *name) {
         snprintf(type,sizeof(type),"%s",name);
     raise_event(key, name_event, type, NULL, dir);
     LOGE("%-8s%-22s%-20s%s %s\n", name_event, key, get_current_time_long(0), type, dir);
-    free(key);
     free(dir);
     return 0;
 }
@@ -876,8 +993,11 @@ void create_infoevent(char* filename, char* data0, char* data1, char* data2)
     process_info_and_error(LOGS_DIR, filename);
 }
 
-const char *get_build_footprint() {
-    static char footprint[SIZE_FOOTPRINT_MAX+1] = {0,};
+static char footprint[SIZE_FOOTPRINT_MAX+1] = {0,};
+static pthread_once_t footprint_once = PTHREAD_ONCE_INIT;
+
+/* Built once, by the first of the collector workers asking for it */
+static void build_footprint() {
     char prop[PROPERTY_VALUE_MAX];
     char *modem_name;
 
@@ -892,8 +1012,6 @@ const char *get_build_footprint() {
      * scufwVersion
      * punitVersion
      * valhooksVersion */
-    if (footprint[0] != 0) return footprint;
-
     snprintf(footprint, SIZE_FOOTPRINT_MAX, "%s,", gbuildversion);
 
     property_get(FINGERPRINT_FIELD, prop, "");
@@ -934,6 +1052,10 @@ const char *get_build_footprint() {
 
     property_get(VALHOOKS_VERSION, prop, "");
     strncat(footprint, prop, PROPERTY_VALUE_MAX);
+}
+
+const char *get_build_footprint() {
+    pthread_once(&footprint_once, build_footprint);
     return footprint;
 }
 
@@ -942,86 +1064,28 @@ void start_daemon(const char *daemonname) {
     property_set("ctl.start", (char *)daemonname);
 }
 
-#define MAX_THREAD 3
-#define MIN_WAIT 60
-void notify_crashreport_thread() {
+void notify_crashreport() {
     char boot_state[PROPERTY_VALUE_MAX];
-    struct timespec ts;
-    static time_t last_notify = -MIN_WAIT;
-    static int thread_count = 0;
-    static int last_chance = 0;
-    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-
-    /* Does current crashlog mode allow notifs to crashreport ?*/
-    if ( !CRASHLOG_MODE_NOTIFS_ENABLED(g_crashlog_mode) ) {
-        LOGD("%s : Current crashlog mode is %s - crashreport notifs disabled.\n", __FUNCTION__, CRASHLOG_MODE_NAME(g_crashlog_mode) );
-        return;
-    }
-    property_get(PROP_BOOT_STATUS, boot_state, "-1");
-    if (strcmp(boot_state, "1"))
-        return;
 
-    pthread_mutex_lock(&lock);
-
-    if (thread_count >= MAX_THREAD) {
-        LOGE("Too many threads, can't notify crashreport : %d\n", thread_count);
-        pthread_mutex_unlock(&lock);
-        return;
-    }
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    if ((ts.tv_sec < last_notify + MIN_WAIT) && (last_chance != 0)) {
-        LOGI("Already notified, can't notify crashreport.\n");
-        pthread_mutex_unlock(&lock);
+    if (!is_crashreport_available()) {
+        LOGW("%s: Crashreport notification (CRASH_NOTIFY) skipped!\n", __FUNCTION__);
         return;
     }
 
-    // if we increment thread_count, it means system command will be executed sooner or later
-    thread_count++;
-
-    if (ts.tv_sec >= last_notify + MIN_WAIT) {
-        last_notify = ts.tv_sec;
-    } else {
-        last_chance = 1;
-        pthread_mutex_unlock(&lock);
-        //wait for the timeout
-        sleep(MIN_WAIT);
-        pthread_mutex_lock(&lock);
-        last_chance = 0;
-        LOGI("Performing last_chance notify crashreport.\n");
-    }
-
-    pthread_mutex_unlock(&lock);
-
-    int status = run_command("am broadcast -n com.intel.crashreport/.specific.NotificationReceiver -a com.intel.crashreport.intent.CRASH_NOTIFY -c android.intent.category.ALTERNATIVE", 30);
-
-    pthread_mutex_lock(&lock);
-    thread_count--;
-    pthread_mutex_unlock(&lock);
-
-    if (status == -1) {
-        LOGI("notify crash report failed: fork\n");
+    /* Notify once the history lines of the collection job are committed */
+    if (collector_defer_notify())
         return;
-    }
 
-    if (WIFEXITED(status) && WEXITSTATUS(status)) {
-        LOGI("notify crash report status: %d.\n", WEXITSTATUS(status));
+    /* Does current crashlog mode allow notifs to crashreport ?*/
+    if ( !CRASHLOG_MODE_NOTIFS_ENABLED(g_crashlog_mode) ) {
+        LOGD("%s : Current crashlog mode is %s - crashreport notifs disabled.\n", __FUNCTION__, CRASHLOG_MODE_NAME(g_crashlog_mode) );
         return;
     }
-}
-
-void notify_crashreport() {
-    int ret = 0;
-    pthread_t thread;
-
-    if (!is_crashreport_available()) {
-        LOGW("%s: Crashreport notification (CRASH_NOTIFY) skipped!\n", __FUNCTION__);
+    property_get(PROP_BOOT_STATUS, boot_state, "-1");
+    if (strcmp(boot_state, "1"))
         return;
-    }
 
-    ret = pthread_create(&thread, NULL, (void *)notify_crashreport_thread, NULL);
-    if (ret < 0) {
-        LOGE("%s: notify_crashreport thread error", __FUNCTION__);
-    }
+    notifier_crash_notify();
 }
 
 /**
@@ -1109,15 +1173,12 @@ void monitor_crashenv()
 }
 
 int raise_infoerror(char *type, char *subtype) {
-    char *key;
+    char key[EVENT_ID_SIZE];
 
-    key = generate_event_id(type, subtype);
-    if (raise_event(key, NULL, type, subtype, LOGINFO_DIR) == 0) {
-        free(key);
+    compute_event_id(key, type, subtype);
+    if (raise_event(key, NULL, type, subtype, LOGINFO_DIR) == 0)
         return -errno;
-    }
     LOGE("%-8s%-22s%-20s%s\n", type, key, get_current_time_long(0), subtype);
-    free(key);
     unlink(LOGRESERVED);
 #ifdef FULL_REPORT
     monitor_crashenv();
@@ -1219,7 +1280,7 @@ void clean_crashlog_in_sd(char *dir_to_search, int max) {
                 /* If current path is not written in the history file, it's a legacy folder to remove */
                 if (!history_has_event(path)) {
                     LOGD("%s : remove legacy crash folder %s", __FUNCTION__, path);
-                    if  (rmfr(path) < 0)
+                    if  (reaper_dispose(path) < 0)
                         LOGE("%s: failed to remove folder %s", __FUNCTION__, path);
                     i++;
                     if (i >= max)
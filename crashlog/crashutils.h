@@ -45,6 +45,8 @@ enum partition_error {
 };
 
 #define TIME_FORMAT_LENGTH  32
+/* event ids are 20 hexadecimal digits */
+#define EVENT_ID_SIZE       21
 #define DUPLICATE_TIME_FORMAT    "%Y-%m-%d/%H:%M:%S"
 
 #define PRINT_TIME(var_tmp, format_time, local_time) {              \
@@ -74,7 +76,7 @@ int raise_infoerror(char *type, char *subtype);
 int create_rebootfile(char* key, int data_ready);
 int reboot_reason_files_present();
 void get_data_from_boot_file(char *file, char* data, FILE* fp);
-char *generate_event_id(char *seed1, char *seed2);
+int compute_event_id(char key[EVENT_ID_SIZE], const char *seed1, const char *seed2);
 int raise_event(char *key, char *event, char *type, char *subtype, char *log);
 int raise_event_nouptime(char *key, char *event, char *type, char *subtype, char *log);
 int raise_event_wdt(char *key, char *event, char *type, char *subtype, char *log);
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <openssl/sha.h>
 
 #include "crashutils.h"
@@ -36,12 +37,28 @@
 #include "fsutils.h"
 #include "dropbox.h"
 #include "utils.h"
+#include "notifier.h"
 
 static char gcurrent_key[2][SHA_DIGEST_LENGTH+1] = {{0,},{0,}};
 static int  gfile_monitor_fd = -1;
 
-struct arg_cmd {
-    char key[SHA_DIGEST_LENGTH+1];
+static int process_dropbox_final_event(struct watch_entry *entry, struct inotify_event *event);
+
+/* The pending dumpstates are started and finalized from the collection jobs */
+static pthread_mutex_t dumpstate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* One watch per pending dumpstate, on its crash directory: the dropbox file
+ * written last by dumpstate finalizes the pending event */
+static char gdropbox_path[DIM(gcurrent_key)][PATHMAX];
+static struct watch_entry gdropbox_entries[DIM(gcurrent_key)] = {
+    [0 ... DIM(gcurrent_key) - 1] = {
+        .wd = -1,
+        .eventmask = IN_CLOSE_WRITE,
+        .eventtype = -1,
+        .eventpattern = "dropbox-",
+        .pcallback = process_dropbox_final_event,
+        .matchtype = MATCH_PREFIX,
+    },
 };
 
 void dropbox_set_file_monitor_fd(int file_monitor_fd) {
@@ -65,7 +82,9 @@ int start_dumpstate_srv(char* crash_dir, char *key) {
         if (fp == NULL) {
             LOGE("%s: Cannot create %s - %s\n", __FUNCTION__, path, strerror(errno));
         } else {
+            pthread_mutex_lock(&dumpstate_lock);
             fprintf(fp,"Previous event: %s\n", gcurrent_key[index_prod]);
+            pthread_mutex_unlock(&dumpstate_lock);
             fclose(fp);
             do_chown(path, PERM_USER, PERM_GROUP);
         }
@@ -84,68 +103,77 @@ int start_dumpstate_srv(char* crash_dir, char *key) {
 #else
     start_daemon("vendor.logsystemstate");
 #endif
-    if (inotify_add_watch(gfile_monitor_fd, crash_dir, IN_CLOSE_WRITE) < 0) {
-        LOGE("%s: Can't add watch for %s - %s.\n", __FUNCTION__,
-            crash_dir, strerror(errno));
+    pthread_mutex_lock(&dumpstate_lock);
+    index_prod = (index_prod + 1) % DIM(gcurrent_key);
+    /* the slot may still be watched if its dumpstate never completed */
+    inotify_remove_entry(gfile_monitor_fd, &gdropbox_entries[index_prod]);
+    strncpy(gdropbox_path[index_prod], crash_dir, PATHMAX - 1);
+    gdropbox_path[index_prod][PATHMAX - 1] = '\0';
+    gdropbox_entries[index_prod].eventpath = gdropbox_path[index_prod];
+    if (inotify_add_entry(gfile_monitor_fd, &gdropbox_entries[index_prod]) < 0) {
+        pthread_mutex_unlock(&dumpstate_lock);
         return -1;
     }
-    index_prod = (index_prod + 1) % DIM(gcurrent_key);
     strncpy(gcurrent_key[index_prod],key,SHA_DIGEST_LENGTH);
     gcurrent_key[index_prod][SHA_DIGEST_LENGTH] = '\0';
+    pthread_mutex_unlock(&dumpstate_lock);
     return 1;
 }
 
-void finalize_dropbox_system_thread(void *param) {
-    char cmd[512];
-    struct arg_cmd *args = (struct arg_cmd *)param;
-
-    snprintf(cmd,sizeof(cmd)-1,"am broadcast -n com.intel.crashreport"
-        "/.specific.NotificationReceiver -a com.intel.crashreport.intent.CRASH_LOGS_COPY_FINISHED "
-        "-c android.intent.category.ALTERNATIVE --es com.intel.crashreport.extra.EVENT_ID %s",
-        args->key);
-    free(args);
-    int status = run_command(cmd, 30);
-    if (status == -1) {
-        LOGI("%s: Notify crashreport failed for command \"%s\".\n", __FUNCTION__, cmd);
-    } else {
-        LOGI("%s: Notify crashreport status(%d) for command \"%s\".\n", __FUNCTION__, status, cmd);
-    }
-
+/* dumpstate is done so remove the watcher */
+static int process_dropbox_final_event(struct watch_entry *entry, struct inotify_event *event) {
+    LOGD("%s: Received a dropbox event(%s)...", __FUNCTION__, event->name);
+    finalize_dropbox_pending_event(entry, event);
+    return 0;
 }
 
-/* TODO, change the current key with a list of keys and compare with the
- * event to retreive the one */
-int finalize_dropbox_pending_event(const struct inotify_event __attribute__((unused)) *event) {
+/**
+ * @brief Finalizes the pending dumpstate whose crash directory is watched
+ * by entry: its watch is removed and the crashreport is notified with the
+ * key of its event.
+ *
+ * @return 0 on success, -1 if no dumpstate is pending on the entry.
+ */
+int finalize_dropbox_pending_event(struct watch_entry *entry, const struct inotify_event *event) {
     char boot_state[PROPERTY_VALUE_MAX];
-    static int index_cons = 0;
-    int ret = 0;
-    pthread_t thread;
+    char key[SHA_DIGEST_LENGTH+1];
+    int slot;
+
+    if (entry < gdropbox_entries || entry >= gdropbox_entries + DIM(gdropbox_entries))
+        return -1;
+    slot = entry - gdropbox_entries;
+
+    pthread_mutex_lock(&dumpstate_lock);
+    /* the slot may have been reused by a new dumpstate since the event */
+    if (entry->wd != event->wd) {
+        pthread_mutex_unlock(&dumpstate_lock);
+        LOGW("%s: Received a dropbox event of a previous dumpstate, drop it...\n", __FUNCTION__);
+        return -1;
+    }
+    inotify_remove_entry(gfile_monitor_fd, entry);
 
     /* gcurrent_key is in provision */
-    if (gcurrent_key[index_cons][0] == 0) {
+    if (gcurrent_key[slot][0] == 0) {
+        pthread_mutex_unlock(&dumpstate_lock);
         LOGE("%s: Received a dropbox event but no key is pending, drop it...\n", __FUNCTION__);
         return -1;
     }
 
     property_get(PROP_BOOT_STATUS, boot_state, "-1");
-    if (strcmp(boot_state, "1"))
+    if (strcmp(boot_state, "1")) {
+        pthread_mutex_unlock(&dumpstate_lock);
         return -1;
+    }
+
+    strcpy(key, gcurrent_key[slot]);
+    gcurrent_key[slot][0] = 0;
+    pthread_mutex_unlock(&dumpstate_lock);
 
     if (is_crashreport_available()) {
-        struct arg_cmd * args_thread =  malloc(sizeof(struct arg_cmd));
-        strncpy(args_thread->key,gcurrent_key[index_cons],sizeof(args_thread->key)-1);
-        args_thread->key[sizeof(args_thread->key)-1] = '\0';
-        ret = pthread_create(&thread, NULL, (void *)finalize_dropbox_system_thread, args_thread);
-        if (ret < 0) {
-            LOGE("%s: finalize_dropbox thread error", __FUNCTION__);
-            free(args_thread);
-        }
+        notifier_logs_copy_finished(key);
     } else {
         LOGW("%s: Crashreport notification (CRASH_LOGS_COPY_FINISHED) skipped!\n", __FUNCTION__);
     }
-
-    gcurrent_key[index_cons][0] = 0;
-    index_cons = (index_cons + 1) % DIM(gcurrent_key);
     return 0;
 }
 
@@ -233,8 +261,11 @@ long extract_dropbox_timestamp(char* filename)
  */
 int manage_duplicate_dropbox_events(struct inotify_event *event)
 {
+    static pthread_mutex_t previous_lock = PTHREAD_MUTEX_INITIALIZER;
     static uint32_t previous_event_cookie = 0;
     static char previous_filename[PATHMAX] = { '\0', };
+    char moved_filename[PATHMAX];
+    int moved = 0;
     char info_filename[PATHMAX] = { '\0',};
     char destination[PATHMAX] = { '\0', };
     char origin[PATHMAX] = { '\0', };
@@ -248,9 +279,11 @@ int manage_duplicate_dropbox_events(struct inotify_event *event)
      * and name shall be saved
      */
     if (event->mask & IN_MOVED_FROM) {
+        pthread_mutex_lock(&previous_lock);
         previous_event_cookie = event->cookie;
         strncpy(previous_filename, event->name, MIN(event->len, PATHMAX)-1);
         previous_filename[MIN(event->len, PATHMAX)-1] = '\0';
+        pthread_mutex_unlock(&previous_lock);
         return -1;
     }
 
@@ -263,8 +296,18 @@ int manage_duplicate_dropbox_events(struct inotify_event *event)
      * and then move events are always emitted as contiguous pairs
      * with IN_MOVED_FROM immediately followed by IN_MOVED_TO
      */
-    if ( (event->mask & IN_MOVED_TO) && (previous_event_cookie != 0)
-        && (previous_event_cookie == event->cookie) && event->len) {
+    if ((event->mask & IN_MOVED_TO) && event->len) {
+        pthread_mutex_lock(&previous_lock);
+        if (previous_event_cookie != 0 && previous_event_cookie == event->cookie) {
+            strcpy(moved_filename, previous_filename);
+            /* re-initialize variables for next event */
+            previous_event_cookie = 0;
+            strcpy(previous_filename, "");
+            moved = 1;
+        }
+        pthread_mutex_unlock(&previous_lock);
+    }
+    if (moved) {
 
         /*
          * the log file is temporaly copied from dropbox directory
@@ -293,12 +336,11 @@ int manage_duplicate_dropbox_events(struct inotify_event *event)
             do_copy_tail(origin, destination, MAXFILESIZE);
 
         //Fetch the timestamp from the original log filename and write it in infoevent as a human readable date
-        timestamp_value = extract_dropbox_timestamp(previous_filename);
+        timestamp_value = extract_dropbox_timestamp(moved_filename);
 
         if (timestamp_value != -1) {
-            struct tm *time;
-            memset(&time, 0, sizeof(time));
-            time = localtime(&timestamp_value);
+            struct tm tm_val;
+            struct tm *time = localtime_r(&timestamp_value, &tm_val);
             if (time) {
                 PRINT_TIME(human_readable_date, DUPLICATE_TIME_FORMAT , time);
             } else {
@@ -310,11 +352,7 @@ int manage_duplicate_dropbox_events(struct inotify_event *event)
          * filename as DATA0 and DATA1 and with the date previously
          * fetched set in DATA2
          */
-        create_infoevent(info_filename, previous_filename, event->name, human_readable_date);
-
-        /* re-initialize variables for next event */
-        previous_event_cookie = 0;
-        strcpy(previous_filename, "");
+        create_infoevent(info_filename, moved_filename, event->name, human_readable_date);
         return -1;
     }
     return 0;
@@ -326,7 +364,7 @@ int process_lost_event(struct watch_entry __attribute__((unused)) *entry, struct
     char losttype;
     char lostevent[32];
     char lostevent_subtype[32];
-    char *key;
+    char key[EVENT_ID_SIZE];
     int len;
     if (strstr(event->name, "anr"))
         losttype = ANR_TYPE;
@@ -364,13 +402,12 @@ int process_lost_event(struct watch_entry __attribute__((unused)) *entry, struct
     lostevent[31] = '\0';
     lostevent_subtype[31] = '\0';
 
-    key = generate_event_id(CRASHEVENT, lostevent);
+    compute_event_id(key, CRASHEVENT, lostevent);
     dir = generate_crashlog_dir(MODE_CRASH_NOSD, key);
     if (!dir) {
         LOGE("%s: Find dir for lost dropbox failed\n", __FUNCTION__);
         raise_event(key, CRASHEVENT, lostevent, lostevent_subtype, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), lostevent);
-        free(key);
         return -1;
     }
     /* Copy the *.lost dropbox file */
@@ -381,7 +418,6 @@ int process_lost_event(struct watch_entry __attribute__((unused)) *entry, struct
     do_log_copy(lostevent, dir, get_current_time_short(1), APLOG_TYPE);
     raise_event(key, CRASHEVENT, lostevent, lostevent_subtype, dir);
     LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0), lostevent, dir);
-    free(key);
     free(dir);
     return 0;
 }
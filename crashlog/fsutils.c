@@ -29,12 +29,13 @@
 #include "tcs_wrapper.h"
 #include "history.h"
 #include "utils.h"
+#include "reaper.h"
+#include "quota.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <limits.h>
 #include <dirent.h>
-#include <ftw.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -42,14 +43,15 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/statfs.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <libgen.h>
 #include <regex.h>
+#include <time.h>
+#include <zlib.h>
 
 long current_sd_size_limit = LONG_MAX;
 
-/* used by get_path_size! */
-static unsigned long long total_size = 0;
-
 #define LOGGER_APLOG_PARAM "-b all -v threadtime -d -f"
 
 #ifndef CONFIG_APLOG
@@ -60,6 +62,10 @@ static char *flush_aplog_boot_cmd = NULL;
 /* No header in bionic... */
 ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
 
+#ifndef FICLONE
+#define FICLONE                 _IOW(0x94, 9, int)
+#endif
+
 static int check_partlogfull(const char* path) {
 
     static int partlogfull_errorset = 0;
@@ -67,10 +73,10 @@ static int check_partlogfull(const char* path) {
     /* path could either indicate LOGS_DIR or SDCARD_DIR
      * CRASHLOG_ERROR_FULL shall only be raised if path indicates LOGS_DIR
      */
-    if (!partlogfull_errorset && !strncmp(path, LOGS_DIR, strlen(LOGS_DIR))) {
-        partlogfull_errorset = 1;
+    /* raised once, even by copies of several collector workers */
+    if (!strncmp(path, LOGS_DIR, strlen(LOGS_DIR)) &&
+            __sync_bool_compare_and_swap(&partlogfull_errorset, 0, 1))
         return 1;
-    }
 
     return 0;
 }
@@ -123,195 +129,403 @@ static int read_file(const char *filename, unsigned int *pcurrent) {
     return res;
 }
 
-static int update_file(const char *filename, unsigned int current) {
+void reset_file(const char *filename) {
     FILE *fd;
-    int res;
 
-    /* Open file in reading and writing */
-    fd = fopen(filename, "r+");
+    fd = fopen(filename, "w");
     if (fd == NULL) {
-        LOGE("%s: Cannot open the file %s in update mode\n", __FUNCTION__, filename);
-        raise_infoerror(ERROREVENT, CRASHLOG_ERROR_PATH);
-        return -1;
+        LOGE("%s: Cannot reset %s - %s\n", __FUNCTION__, filename,
+            strerror(errno));
+        return;
     }
+    fprintf(fd, "%4u", 0);
+    close_file(filename, fd);
+    do_chown(filename, PERM_USER, PERM_GROUP);
+}
 
-    /* Write new current value in file */
-    res = fprintf(fd, "%4u", ((current+1) % gmaxfiles));
-    if (res <= 0) {
-        LOGE("%s: Cannot update file %s - error is %s.\n", __FUNCTION__,
-                filename, strerror(errno));
-        /* Close file */
-        close_file(filename, fd);
-        return -1;
-    }
+int line_reader_fdopen(struct line_reader *lr, int fd) {
+    if (!lr || fd < 0)
+        return -EINVAL;
 
-    /* Close file */
-    return (close_file(filename, fd));
+    lr->buf = malloc(LINE_READER_BUFSIZE);
+    if (!lr->buf)
+        return -ENOMEM;
+
+    lr->fd = fd;
+    lr->owns_fd = 0;
+    lr->pos = 0;
+    lr->len = 0;
+    lr->buf_offset = lseek(fd, 0, SEEK_CUR);
+    if (lr->buf_offset < 0)
+        lr->buf_offset = 0;
+    lr->line_offset = lr->buf_offset;
+    lr->eof = 0;
+    return 0;
 }
 
-static int calculate_size_of_path(const char __attribute__((__unused__)) *fpath,
-                                   const struct stat *sb,
-                                   int tflag,
-                                   struct FTW __attribute__((__unused__)) *ftwbuf) {
+int line_reader_open(struct line_reader *lr, const char *filename, int flags) {
+    int fd, res;
 
-    if (tflag == FTW_F && (sb->st_mode & S_IFMT) == S_IFREG)
-        total_size += sb->st_size;
+    if (!lr || !filename)
+        return -EINVAL;
+
+    fd = open(filename, flags);
+    if (fd < 0)
+        return -errno;
 
+    res = line_reader_fdopen(lr, fd);
+    if (res < 0) {
+        close(fd);
+        return res;
+    }
+    lr->owns_fd = 1;
     return 0;
 }
 
-unsigned long long get_path_size(const char *path) {
-    unsigned long long size = 0;
-    int nopenfd = 20;
-    /* mutex used to protect total_size */
-    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+int line_reader_next(struct line_reader *lr, char buffer[MAXLINESIZE]) {
+    int size = 0;
+    size_t chunk;
+    ssize_t res;
+    char *start, *eol = NULL;
 
-    pthread_mutex_lock(&lock);
-    total_size = 0;
+    lr->line_offset = lr->buf_offset + lr->pos;
 
-    if (nftw(path, calculate_size_of_path, nopenfd, 0) == -1) {
-        pthread_mutex_unlock(&lock);
-        return 0;
+    /* Copy from the chunk buffer until end of line, end of file or
+     * MAXLINESIZE-1 characters; a longer line is returned in pieces
+     */
+    while (!eol && size < MAXLINESIZE-1) {
+        if (lr->pos == lr->len) {
+            if (lr->eof)
+                break;
+            lr->buf_offset += lr->len;
+            lr->pos = lr->len = 0;
+            res = do_read(lr->fd, lr->buf, LINE_READER_BUFSIZE);
+            if (res < 0)
+                return -errno;
+            if (res == 0) {
+                lr->eof = 1;
+                break;
+            }
+            lr->len = res;
+        }
+
+        start = &lr->buf[lr->pos];
+        chunk = MIN(lr->len - lr->pos, (size_t)(MAXLINESIZE-1 - size));
+        eol = memchr(start, '\n', chunk);
+        if (eol)
+            chunk = eol - start + 1;
+
+        memcpy(&buffer[size], start, chunk);
+        lr->pos += chunk;
+        size += chunk;
     }
-    size = total_size;
-    pthread_mutex_unlock(&lock);
 
+    buffer[size] = 0;
     return size;
 }
 
-static int check_free_space_available(const char* path, unsigned int req) {
-    struct statfs st;
-    char prop[PROPERTY_VALUE_MAX];
-    long available_portion;
-    unsigned long long free_space, full_space, used_space, threshold, min_free_space, stop_space;
-
-    if (statfs(path, &st) < 0) {
-        LOGE("%s: warn: statfs failed on %s, err: %s!!!", __FUNCTION__, path, strerror(errno));
+int line_reader_seek(struct line_reader *lr, off_t offset) {
+    /* Stay in the current chunk when possible */
+    if (offset >= lr->buf_offset && offset <= lr->buf_offset + (off_t)lr->len) {
+        lr->pos = offset - lr->buf_offset;
+        lr->line_offset = offset;
         return 0;
     }
+    if (lseek(lr->fd, offset, SEEK_SET) < 0)
+        return -errno;
+    lr->pos = lr->len = 0;
+    lr->buf_offset = lr->line_offset = offset;
+    lr->eof = 0;
+    return 0;
+}
 
-    property_get(PROP_DATA_QUOTA, prop, "100");
+void line_reader_close(struct line_reader *lr) {
+    if (!lr)
+        return;
 
-    available_portion = strtol(prop, NULL, 10);
-    available_portion = (available_portion > 100 || (available_portion < 0))
-        ? 100 : available_portion;
+    free(lr->buf);
+    lr->buf = NULL;
+    if (lr->owns_fd && lr->fd >= 0)
+        close(lr->fd);
+    lr->fd = -1;
+}
 
-    if (0 == available_portion) {
-        LOGW("%s: warn: no space reserved for crash logging", __FUNCTION__);
-        return -1;
+int freadline(FILE *fd, char buffer[MAXLINESIZE]) {
+    int size = 0, c = EOF;
+
+    /* stdio already buffers the stream: fetch characters from its
+     * buffer instead of issuing one fread per byte
+     */
+    while (size < MAXLINESIZE-1 && (c = getc(fd)) != EOF) {
+        buffer[size++] = c;
+        if (c == '\n')
+            break;
     }
 
-    free_space = st.f_bavail * st.f_bsize;
-    full_space = st.f_blocks * st.f_bsize;
-    used_space = get_path_size(path);
-    threshold = 100 - req;
+    /* Check the last read result */
+    if (c == EOF && ferror(fd)) {
+        /* ernno is checked in the upper layer as we could
+           print the filename here */
+        return -1;
+    }
+    buffer[size] = 0;
+    return size;
+}
 
-    min_free_space = full_space * req / 100;
-    stop_space = full_space * available_portion * threshold / 10000;
+struct keyword_node {
+    int child;          /* first child, -1 if none */
+    int sibling;        /* next child of the parent, -1 if none */
+    int fail;           /* node of the longest proper suffix */
+    int dict;           /* next node ending a keyword on the fail chain, -1 if none */
+    int keyword;        /* keyword ending on this node, -1 if none */
+    unsigned char c;
+};
+
+struct keyword_matcher {
+    struct keyword_node *nodes;
+    int nbnodes;
+    int maxnodes;
+    int root[256];      /* transitions from the root, resolved for all bytes */
+    int *next_keyword;  /* other keywords ending on the same node */
+    int nbkeywords;
+};
+
+static int keyword_node_child(const struct keyword_matcher *km, int node, unsigned char c) {
+    int child;
+
+    if (node == 0)
+        return km->root[c];
+
+    for (child = km->nodes[node].child ; child >= 0 ; child = km->nodes[child].sibling)
+        if (km->nodes[child].c == c)
+            return child;
+    return -1;
+}
 
-    if (used_space >= stop_space || free_space < min_free_space) {
-        LOGW("%s: quota reached. total space: %llu, total free space %llu, allocated space: %llu "
-            "(limit %ld%%), minimum free space: %llu", __FUNCTION__, full_space, free_space,
-            used_space, available_portion, min_free_space);
-        return -1;
+static int keyword_node_add(struct keyword_matcher *km, int parent, unsigned char c) {
+    struct keyword_node *node;
+
+    if (km->nbnodes == km->maxnodes) {
+        int maxnodes = km->maxnodes * 2;
+        node = realloc(km->nodes, maxnodes * sizeof(*node));
+        if (!node)
+            return -ENOMEM;
+        km->nodes = node;
+        km->maxnodes = maxnodes;
+    }
+
+    node = &km->nodes[km->nbnodes];
+    node->child = -1;
+    node->sibling = km->nodes[parent].child;
+    node->fail = 0;
+    node->dict = -1;
+    node->keyword = -1;
+    node->c = c;
+    km->nodes[parent].child = km->nbnodes;
+    if (parent == 0)
+        km->root[c] = km->nbnodes;
+
+    return km->nbnodes++;
+}
+
+static int keyword_matcher_link(struct keyword_matcher *km) {
+    int *queue, head = 0, tail = 0, node, child, fail;
+
+    queue = malloc(km->nbnodes * sizeof(int));
+    if (!queue)
+        return -ENOMEM;
+
+    /* Breadth first: the fail node of a child is resolved from the one of its parent */
+    for (child = km->nodes[0].child ; child >= 0 ; child = km->nodes[child].sibling)
+        queue[tail++] = child;
+
+    while (head < tail) {
+        node = queue[head++];
+        for (child = km->nodes[node].child ; child >= 0 ; child = km->nodes[child].sibling) {
+            queue[tail++] = child;
+            fail = km->nodes[node].fail;
+            while (fail && keyword_node_child(km, fail, km->nodes[child].c) < 0)
+                fail = km->nodes[fail].fail;
+            fail = keyword_node_child(km, fail, km->nodes[child].c);
+            km->nodes[child].fail = (fail > 0) ? fail : 0;
+            fail = km->nodes[child].fail;
+            km->nodes[child].dict = (km->nodes[fail].keyword >= 0) ?
+                fail : km->nodes[fail].dict;
+        }
     }
 
+    free(queue);
     return 0;
 }
 
-void reset_file(const char *filename) {
-    FILE *fd;
+struct keyword_matcher *keyword_matcher_create(const char *keywords[], int nbkeywords) {
+    struct keyword_matcher *km;
+    const unsigned char *pkw;
+    int idx, node, child, res = -ENOMEM;
 
-    fd = fopen(filename, "w");
-    if (fd == NULL) {
-        LOGE("%s: Cannot reset %s - %s\n", __FUNCTION__, filename,
-            strerror(errno));
-        return;
+    if (!keywords || nbkeywords <= 0) {
+        errno = EINVAL;
+        return NULL;
     }
-    fprintf(fd, "%4u", 0);
-    close_file(filename, fd);
-    do_chown(filename, PERM_USER, PERM_GROUP);
-}
-
-int readline(int fd, char buffer[MAXLINESIZE]) {
-    int size = 0, res;
-    char *pbuffer = &buffer[0];
 
-    /* Read the file until end of line or file */
-    while ((res = read(fd, pbuffer, 1)) == 1 && size < MAXLINESIZE-1) {
-        if (pbuffer[0] == '\n') {
-            buffer[++size] = 0;
-            return size;
+    km = calloc(1, sizeof(*km));
+    if (!km) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    km->nbkeywords = nbkeywords;
+    km->maxnodes = 64;
+    km->nodes = malloc(km->maxnodes * sizeof(*km->nodes));
+    km->next_keyword = malloc(nbkeywords * sizeof(int));
+    if (!km->nodes || !km->next_keyword)
+        goto error;
+
+    /* node 0 is the root */
+    km->nodes[0].child = -1;
+    km->nodes[0].sibling = -1;
+    km->nodes[0].fail = 0;
+    km->nodes[0].dict = -1;
+    km->nodes[0].keyword = -1;
+    km->nodes[0].c = 0;
+    km->nbnodes = 1;
+
+    for (idx = 0 ; idx < nbkeywords ; idx++) {
+        if (!keywords[idx] || !keywords[idx][0]) {
+            res = -EINVAL;
+            goto error;
+        }
+        node = 0;
+        for (pkw = (const unsigned char *)keywords[idx] ; *pkw ; pkw++) {
+            child = keyword_node_child(km, node, *pkw);
+            if (child <= 0 && (child = keyword_node_add(km, node, *pkw)) < 0)
+                goto error;
+            node = child;
         }
-        pbuffer++;
-        size++;
+        km->next_keyword[idx] = km->nodes[node].keyword;
+        km->nodes[node].keyword = idx;
     }
 
-    /* Check the last read result */
+    if ((res = keyword_matcher_link(km)) < 0)
+        goto error;
+
+    return km;
+
+error:
+    keyword_matcher_free(km);
+    errno = -res;
+    return NULL;
+}
+
+void keyword_matcher_free(struct keyword_matcher *km) {
+    if (!km)
+        return;
+
+    free(km->nodes);
+    free(km->next_keyword);
+    free(km);
+}
+
+int keyword_matcher_scan_file(const struct keyword_matcher *km, const char *filename,
+        struct keyword_hit *hits, keyword_hit_cb cb, void *ctx) {
+    char buffer[MAXLINESIZE];
+    struct line_reader lr;
+    int *lastline;
+    int res, linesize, line, idx, state, node, kw;
+
+    if (!km || !filename)
+        return -EINVAL;
+
+    lastline = malloc(km->nbkeywords * sizeof(int));
+    if (!lastline)
+        return -ENOMEM;
+
+    res = line_reader_open(&lr, filename, O_RDONLY);
     if (res < 0) {
-        /* ernno is checked in the upper layer as we could
-           print the filename here */
+        free(lastline);
         return res;
     }
-    /* last line */
-    buffer[size] = 0;
-    return size;
-}
 
-int freadline(FILE *fd, char buffer[MAXLINESIZE]) {
-    int size = 0, res;
-    char *pbuffer = &buffer[0];
-
-    /* Read the file until end of line or file */
-    while ((res = fread(pbuffer, 1 , 1, fd)) == 1 && size < MAXLINESIZE-1) {
-        if (pbuffer[0] == '\n') {
-            buffer[++size] = 0;
-            return size;
+    for (idx = 0 ; idx < km->nbkeywords ; idx++) {
+        lastline[idx] = -1;
+        if (hits) {
+            hits[idx].line = -1;
+            hits[idx].offset = 0;
         }
-        pbuffer++;
-        size++;
     }
 
-    /* Check the last read result */
-    if (res < 0) {
-        /* ernno is checked in the upper layer as we could
-           print the filename here */
-        return res;
+    for (line = 0 ; (linesize = line_reader_next(&lr, buffer)) > 0 ; line++) {
+        state = 0;
+        for (idx = 0 ; idx < linesize ; idx++) {
+            unsigned char c = buffer[idx];
+
+            while (state && keyword_node_child(km, state, c) < 0)
+                state = km->nodes[state].fail;
+            state = keyword_node_child(km, state, c);
+            if (state < 0)
+                state = 0;
+
+            node = (km->nodes[state].keyword >= 0) ? state : km->nodes[state].dict;
+            for ( ; node >= 0 ; node = km->nodes[node].dict) {
+                for (kw = km->nodes[node].keyword ; kw >= 0 ; kw = km->next_keyword[kw]) {
+                    /* report each keyword once per line */
+                    if (lastline[kw] == line)
+                        continue;
+                    lastline[kw] = line;
+                    if (hits && hits[kw].line < 0) {
+                        hits[kw].line = line;
+                        hits[kw].offset = line_reader_offset(&lr);
+                    }
+                    if (cb && cb(ctx, kw, line, line_reader_offset(&lr)))
+                        goto stop;
+                }
+            }
+        }
     }
-    /* last line */
-    buffer[size] = 0;
-    return size;
+    if (linesize < 0)
+        res = linesize;
+
+stop:
+    if (res == 0)
+        for (idx = 0 ; idx < km->nbkeywords ; idx++)
+            if (lastline[idx] >= 0)
+                res++;
+
+    line_reader_close(&lr);
+    free(lastline);
+    return res;
 }
 
 int count_lines_in_file(const char *filename) {
     char buffer[MAXLINESIZE];
-    int fd, line_idx = 0;
+    struct line_reader lr;
+    int res, line_idx = 0;
 
     if (!filename)
         return -EINVAL;
 
-    fd = open(filename, O_RDONLY);
-    if(fd == -1) return -errno;
+    res = line_reader_open(&lr, filename, O_RDONLY);
+    if (res < 0) return res;
 
-    while(readline(fd, buffer) > 0) {
+    while(line_reader_next(&lr, buffer) > 0) {
         line_idx++;
     }
-    close(fd);
+    line_reader_close(&lr);
     return line_idx;
 }
 
 int find_oneofstrings_in_file(const char *filename, const char *keywords[], int nbkeywords) {
 
     char buffer[MAXLINESIZE];
-    int fd, linesize, idx;
+    struct line_reader lr;
+    int res, linesize, idx;
 
     if (!keywords || !filename || !nbkeywords)
         return -EINVAL;
 
-    fd = open(filename, O_RDONLY);
-    if(fd == -1) return -errno;
+    res = line_reader_open(&lr, filename, O_RDONLY);
+    if (res < 0) return res;
 
-    while((linesize = readline(fd, buffer)) > 0) {
+    while((linesize = line_reader_next(&lr, buffer)) > 0) {
         /* Remove the trailing '\n' if it's there */
         if (buffer[linesize-1] == '\n') {
             linesize--;
@@ -321,12 +535,12 @@ int find_oneofstrings_in_file(const char *filename, const char *keywords[], int
         /* Check the keywords */
         for (idx = 0 ; idx < nbkeywords ; idx++) {
             if ( strstr(buffer, keywords[idx]) ) {
-                close(fd);
+                line_reader_close(&lr);
                 return 1;
             }
         }
     }
-    close(fd);
+    line_reader_close(&lr);
     return 0;
 }
 
@@ -335,18 +549,19 @@ int find_oneofstrings_in_file_with_keyword(char *filename, char **keywords, char
     char buf1[MAXLINESIZE];
     char buf2[MAXLINESIZE] = {'\0'};
     char *buffer, *old_buffer, *tmp;
-    int fd, linesize, idx;
+    struct line_reader lr;
+    int res, linesize, idx;
 
     if (!keywords || !filename || !nbkeywords || !common_keyword)
         return -EINVAL;
 
-    fd = open(filename, O_RDONLY);
-    if(fd == -1)
-        return -errno;
+    res = line_reader_open(&lr, filename, O_RDONLY);
+    if (res < 0)
+        return res;
 
     buffer = &buf1[0];
     old_buffer = &buf2[0];
-    while((linesize = readline(fd, buffer)) > 0) {
+    while((linesize = line_reader_next(&lr, buffer)) > 0) {
         /* Remove the trailing '\n' if it's there */
         if (buffer[linesize-1] == '\n') {
             linesize--;
@@ -358,7 +573,7 @@ int find_oneofstrings_in_file_with_keyword(char *filename, char **keywords, char
             if ( strstr(buffer, keywords[idx]) ) {
                 //and check the additional keyword including the previous line
                 if ( strstr(buffer, common_keyword) || strstr(old_buffer, common_keyword) ) {
-                    close(fd);
+                    line_reader_close(&lr);
                     return 1;
                 }
             }
@@ -368,7 +583,7 @@ int find_oneofstrings_in_file_with_keyword(char *filename, char **keywords, char
         old_buffer = buffer;
         buffer = tmp;
     }
-    close(fd);
+    line_reader_close(&lr);
     return 0;
 }
 
@@ -381,19 +596,20 @@ int find_oneofstrings_in_file_with_keyword(char *filename, char **keywords, char
  */
 int find_str_in_standard_file(char *filename, char *keyword, char *tail) {
     char buffer[MAXLINESIZE];
-    int fd, linesize;
+    struct line_reader lr;
+    int res, linesize;
     int taillen;
 
     if (keyword == NULL || filename == NULL)
         return -EINVAL;
-    fd = open(filename, O_RDONLY);
-    if(fd == -1)
-        return -errno;
+    res = line_reader_open(&lr, filename, O_RDONLY);
+    if (res < 0)
+        return res;
 
     /* Check the tail length once and for all */
     taillen = (tail ? strlen(tail) : 0);
 
-    while((linesize = readline(fd, buffer)) > 0) {
+    while((linesize = line_reader_next(&lr, buffer)) > 0) {
         /* Remove the trailing '\n' if it's there */
         if (buffer[linesize-1] == '\n') {
             linesize--;
@@ -413,7 +629,7 @@ int find_str_in_standard_file(char *filename, char *keyword, char *tail) {
         if ( !strncmp(&buffer[linesize - taillen], tail, taillen) ) break;
     }
 
-    close(fd);
+    line_reader_close(&lr);
     return (linesize > 0 ? 1 : 0);
 }
 
@@ -527,7 +743,7 @@ int get_sdcard_paths(e_dir_mode_t mode) {
     if ((!strncmp(value, "lowmemory", 9)) || (mode == MODE_CRASH_NOSD) || !sdcard_allowed())
         return 0;
     /* check whether there's extra available space for new logs in the SD card */
-    if (check_free_space_available(SDCARD_LOGS_DIR, SDCARD_MINIMUM_FREESPACE_PERCENT) < 0) {
+    if (quota_check(SDCARD_LOGS_DIR, SDCARD_MINIMUM_FREESPACE_PERCENT, NULL) < 0) {
         return 0;
     }
 
@@ -595,58 +811,300 @@ int rmfr_match(const char *match) {
     return 0;
 }
 
-static char *reserve_crash_folder(e_dir_mode_t mode, unsigned int *current) {
-    char path[PATHMAX];
-    int res;
+/* Crash folders allocator: the counter of each mode is loaded once. A slot
+ * is recycled by renaming its previous directories into the trash, emptied
+ * by the reaper. The directories of each slot are learnt by scanning the
+ * parent directory once, then the allocator records the ones it creates. */
+struct folder_counter {
+    const char *filename;
+    unsigned int current;
+    int loaded;
+};
+
+static struct folder_counter folder_counters[] = {
+    { CRASH_CURRENT_LOG,    0, 0 },
+    { APLOGS_CURRENT_LOG,   0, 0 },
+    { BZ_CURRENT_LOG,       0, 0 },
+    { STATS_CURRENT_LOG,    0, 0 },
+};
+
+#define FOLDER_MAPS_MAX         16
+
+struct slot_folder {
+    struct slot_folder *next;
+    char name[];
+};
+
+/* directories of each slot of a crash folder prefix (ie LOGS_DIR/crashlog) */
+struct folder_map {
+    char prefix[PATHMAX];
+    char parent[PATHMAX];
+    unsigned int nbslots;
+    struct slot_folder **slots;
+};
+
+static struct folder_map folder_maps[FOLDER_MAPS_MAX];
+static unsigned int nbfolder_maps = 0;
+/* mutex used to protect the counters and the folder maps */
+static pthread_mutex_t folder_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Called with folder_lock held: writes a new counter file and renames it
+ * over the previous one, so the counter is never seen partially written */
+static int persist_counter(const char *filename, unsigned int next) {
+    char tmp[PATHMAX], value[16];
+    int fd, len, res = 0;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    len = snprintf(value, sizeof(value), "%4u", next);
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if (fd < 0 || write(fd, value, len) != len)
+        res = -errno;
+    if (fd >= 0)
+        close(fd);
+    if (!res) {
+        do_chown(tmp, PERM_USER, PERM_GROUP);
+        if (rename(tmp, filename) < 0)
+            res = -errno;
+    }
+    if (res) {
+        LOGE("%s: Cannot update file %s - error is %s.\n", __FUNCTION__,
+                filename, strerror(-res));
+        raise_infoerror(ERROREVENT, CRASHLOG_ERROR_PATH);
+        unlink(tmp);
+    }
+    return res;
+}
+
+/* returns the slot of a folder name, -1 if the name is not the prefix
+ * base name followed by digits and '_' or the end */
+static long folder_slot(const char *name, const char *base, size_t baselen) {
+    char *end;
+    unsigned long slot;
+
+    if (strncmp(name, base, baselen) || !isdigit(name[baselen]))
+        return -1;
+    slot = strtoul(name + baselen, &end, 10);
+    if ((*end != '_' && *end != '\0') || slot > INT_MAX)
+        return -1;
+    return slot;
+}
+
+/* Called with folder_lock held: records a directory of a slot */
+static void folder_map_add(struct folder_map *map, unsigned int slot, const char *name) {
+    struct slot_folder **slots, *folder;
+    unsigned int nbslots;
+
+    if (slot >= map->nbslots) {
+        nbslots = MAX(slot + 1, map->nbslots * 2);
+        slots = realloc(map->slots, nbslots * sizeof(*slots));
+        if (!slots)
+            return;
+        memset(slots + map->nbslots, 0, (nbslots - map->nbslots) * sizeof(*slots));
+        map->slots = slots;
+        map->nbslots = nbslots;
+    }
+    if ((folder = malloc(sizeof(*folder) + strlen(name) + 1)) == NULL)
+        return;
+    strcpy(folder->name, name);
+    folder->next = map->slots[slot];
+    map->slots[slot] = folder;
+}
+
+/* Called with folder_lock held: returns the map of a prefix, scanning its
+ * parent directory the first time, NULL if no map is left */
+static struct folder_map *get_folder_map(const char *prefix) {
+    struct folder_map *map;
+    const char *base = strrchr(prefix, '/');
+    struct dirent *de;
+    size_t baselen;
+    unsigned int idx;
+    long slot;
+    DIR *d;
+
+    for (idx = 0 ; idx < nbfolder_maps ; idx++) {
+        if (!strcmp(folder_maps[idx].prefix, prefix))
+            return &folder_maps[idx];
+    }
+    if (nbfolder_maps == FOLDER_MAPS_MAX || !base)
+        return NULL;
+
+    map = &folder_maps[nbfolder_maps++];
+    snprintf(map->prefix, sizeof(map->prefix), "%s", prefix);
+    snprintf(map->parent, sizeof(map->parent), "%.*s", (int)(base - prefix), prefix);
+    map->nbslots = 0;
+    map->slots = NULL;
+
+    base++;
+    baselen = strlen(base);
+    if ((d = opendir(map->parent)) == NULL)
+        return map;
+    while ((de = readdir(d)) != NULL) {
+        if ((slot = folder_slot(de->d_name, base, baselen)) >= 0)
+            folder_map_add(map, slot, de->d_name);
+    }
+    closedir(d);
+    return map;
+}
+
+/* Called with folder_lock held: forgets the maps, the directories are
+ * scanned again on the next reservation */
+static void drop_folder_maps() {
+    struct slot_folder *folder;
+    unsigned int idx, slot;
+
+    for (idx = 0 ; idx < nbfolder_maps ; idx++) {
+        for (slot = 0 ; slot < folder_maps[idx].nbslots ; slot++) {
+            while ((folder = folder_maps[idx].slots[slot]) != NULL) {
+                folder_maps[idx].slots[slot] = folder->next;
+                free(folder);
+            }
+        }
+        free(folder_maps[idx].slots);
+    }
+    nbfolder_maps = 0;
+}
+
+/* Called with folder_lock held: moves every folder occupying a slot to the
+ * trash, the leftovers of previous runs included. Returns 1 if the folder
+ * named prefix followed by the slot was one of them */
+static int recycle_slot(const char *prefix, unsigned int slot) {
+    struct folder_map *map = get_folder_map(prefix);
+    struct slot_folder *folder;
+    char path[PATHMAX], name[PATHMAX];
+    int recycled = 0;
+
+    if (!map) {
+        /* fall back to a synchronous delete */
+        snprintf(path, sizeof(path), "%s%u_", prefix, slot);
+        rmfr_match(path);
+        snprintf(path, sizeof(path), "%s%u", prefix, slot);
+        return rmfr(path) == 0;
+    }
+
+    snprintf(name, sizeof(name), "%s%u", prefix + strlen(map->parent) + 1, slot);
+    while (slot < map->nbslots && (folder = map->slots[slot]) != NULL) {
+        map->slots[slot] = folder->next;
+        snprintf(path, sizeof(path), "%s/%s", map->parent, folder->name);
+        /* the folder may have been removed by other means */
+        if (reaper_dispose(path) == 0 && !strcmp(folder->name, name))
+            recycled = 1;
+        free(folder);
+    }
+    return recycled;
+}
+
+/* Records the folder created in a slot reserved by reserve_crash_folder */
+static void track_crash_folder(const char *prefix, unsigned int slot, const char *path) {
+    struct folder_map *map;
+
+    pthread_mutex_lock(&folder_lock);
+    if ((map = get_folder_map(prefix)) != NULL)
+        folder_map_add(map, slot, strrchr(path, '/') + 1);
+    pthread_mutex_unlock(&folder_lock);
+}
+
+static struct folder_counter *get_folder_counter(const char *filename) {
+    unsigned int idx;
+
+    for (idx = 0 ; idx < DIM(folder_counters) ; idx++) {
+        if (!strcmp(folder_counters[idx].filename, filename))
+            return &folder_counters[idx];
+    }
+    return NULL;
+}
+
+/**
+ * Name          : reset_folder_counter
+ * Description   : restarts the folders of a counter file from 0. The
+ *                 counter is read again from the file and the folders
+ *                 scanned again on the next reservation.
+ * Parameters    :
+ *   filename     -> counter file (CRASH_CURRENT_LOG, ...)
+ */
+void reset_folder_counter(const char *filename) {
+    struct folder_counter *counter = get_folder_counter(filename);
+
+    pthread_mutex_lock(&folder_lock);
+    reset_file(filename);
+    if (counter)
+        counter->loaded = 0;
+    drop_folder_maps();
+    pthread_mutex_unlock(&folder_lock);
+}
+
+/**
+ * Name          : reserve_crash_folder
+ * Description   : reserves the next folder slot of a mode and recycles the
+ *                 folder occupying it. The counter file is only read the
+ *                 first time.
+ *                 returns the folder prefix, NULL on error.
+ * Parameters    :
+ *   mode         -> folder mode
+ *   current      -> set to the reserved slot
+ *   recycled     -> set to 1 if the folder named after the slot was
+ *                   recycled, else 0
+ */
+static char *reserve_crash_folder(e_dir_mode_t mode, unsigned int *current, int *recycled) {
+    struct folder_counter *counter;
+    const char *filename;
     char *dir = NULL;
+    int res = 0;
 
     get_sdcard_paths(mode);
 
     switch(mode) {
         case MODE_CRASH:
         case MODE_CRASH_NOSD:
-            snprintf(path, sizeof(path), CRASH_CURRENT_LOG);
+            filename = CRASH_CURRENT_LOG;
             dir = CRASH_DIR;
             break;
         case MODE_APLOGS:
-            snprintf(path, sizeof(path), APLOGS_CURRENT_LOG);
+            filename = APLOGS_CURRENT_LOG;
             dir = APLOGS_DIR;
             break;
         case MODE_BZ:
-            snprintf(path, sizeof(path), BZ_CURRENT_LOG);
+            filename = BZ_CURRENT_LOG;
             dir = BZ_DIR;
             break;
         case MODE_STATS:
-            snprintf(path, sizeof(path), STATS_CURRENT_LOG);
+            filename = STATS_CURRENT_LOG;
             dir = STATS_DIR;
             break;
         case MODE_KDUMP:
-            snprintf(path, sizeof(path), CRASH_CURRENT_LOG);
+            filename = CRASH_CURRENT_LOG;
             dir = KDUMP_CRASH_DIR;
             break;
         default:
             LOGE("%s: Invalid mode %d\n", __FUNCTION__, mode);
             return NULL;
     }
+    counter = get_folder_counter(filename);
 
-    /* check whether there's extra available space for new logs */
+    /* check whether there's extra available space for new logs, the oldest
+     * folders of the mode being evicted past the high-water mark */
     if (!strncmp(dir, LOGS_DIR, strlen(LOGS_DIR))) {
-        if( check_free_space_available(LOGS_DIR, LOGSDIR_MINIMUM_FREESPACE_PERCENT) < 0) {
+        if (quota_check(LOGS_DIR, LOGSDIR_MINIMUM_FREESPACE_PERCENT, strrchr(dir, '/') + 1) < 0) {
             return NULL;
         }
     }
 
-    /* Read current value in file */
-    res = read_file(path, current);
-    if (res < 0)
-        return NULL;
-
-    /* Open file in read/write mode to update the new current */
-    res = update_file(path, *current);
+    /* collection jobs may reserve folders concurrently */
+    pthread_mutex_lock(&folder_lock);
+    if (!counter->loaded) {
+        res = read_file(filename, &counter->current);
+        counter->loaded = (res >= 0);
+    }
+    if (res >= 0)
+        res = persist_counter(filename, (counter->current + 1) % gmaxfiles);
+    if (res >= 0) {
+        *current = counter->current;
+        counter->current = (counter->current + 1) % gmaxfiles;
+        *recycled = recycle_slot(dir, *current);
+    }
+    pthread_mutex_unlock(&folder_lock);
     if (res < 0)
         return NULL;
 
-
     return dir;
 }
 
@@ -689,16 +1147,14 @@ static int create_crash_folder(char *path) {
 char *generate_crashlog_dir(e_dir_mode_t mode, char *unique) {
     char path[PATHMAX];
     unsigned int current;
+    int recycled;
     char *dir;
 
-    dir = reserve_crash_folder(mode, &current);
+    dir = reserve_crash_folder(mode, &current, &recycled);
     if (!dir)
         return NULL;
 
-    snprintf(path, sizeof(path), "%s%d_", dir, current);
-    rmfr_match(path);
-    strncat(path, unique, (strlen(path)+strlen(unique)>=sizeof(path)) ?
-            (sizeof(path) - strlen(path)) : strlen(unique));
+    snprintf(path, sizeof(path), "%s%u_%s", dir, current, unique ? unique : "");
 
     /* Check if directory is already in history, and delete path */
     if (directory_exists(path)) {
@@ -707,6 +1163,7 @@ char *generate_crashlog_dir(e_dir_mode_t mode, char *unique) {
 
     if (create_crash_folder(path) < 0)
         return NULL;
+    track_crash_folder(dir, current, path);
 
     return strdup(path);
 }
@@ -714,26 +1171,23 @@ char *generate_crashlog_dir(e_dir_mode_t mode, char *unique) {
 int find_new_crashlog_dir(e_dir_mode_t mode) {
     char path[PATHMAX];
     unsigned int current;
+    int recycled;
     char *dir;
 
-    dir = reserve_crash_folder(mode, &current);
+    dir = reserve_crash_folder(mode, &current, &recycled);
     if (!dir)
         return -1;
 
-    snprintf(path, sizeof(path), "%s%d", dir, current);
+    snprintf(path, sizeof(path), "%s%u", dir, current);
 
     /* Check if directory is already in history, and delete path */
-    if (directory_exists(path)) {
+    if (recycled) {
         history_delete_first_existent_logcrashpath(path);
     }
 
-    /* Call rmfr which will fail if the path does not exist
-     * but doesn't matter as we create it afterwards
-     */
-    rmfr(path);
-
     if (create_crash_folder(path) < 0)
         return -1;
+    track_crash_folder(dir, current, path);
 
     return current;
 }
@@ -965,75 +1419,292 @@ ssize_t do_write(int fd, const void *buf, size_t len)
     }
 }
 
-int do_copy_eof(const char *src, const char *des)
-{
-    char buffer[CPBUFFERSIZE];
-    int rc = 0;
-    int fd1 = -1, fd2 = -1;
-    struct stat info;
-    int r_count, w_count = 0;
+/**
+ * Name          : copy_fd_rw
+ * Description   : read/write fallback of the copy engine, used for pseudo
+ *                 files (procfs, debugfs, sysfs) reporting no size and when
+ *                 the kernel cannot copy between the two files.
+ *                 returns the number of bytes copied or -errno.
+ * Parameters    :
+ *   fdin         -> source, read from its current position until EOF
+ *   fdout        -> destination
+ *   count        -> max number of bytes to copy
+ */
+static ssize_t copy_fd_rw(int fdin, int fdout, size_t count) {
+    char *buffer;
+    size_t total = 0;
+    ssize_t r_count, w_count;
 
-    if (src == NULL || des == NULL) return -EINVAL;
+    if ((buffer = malloc(COPYBUFFERSIZE)) == NULL)
+        return -ENOMEM;
 
-    if (stat(src, &info) < 0) {
-        LOGE("%s: can not open file: %s\n", __FUNCTION__, src);
-        return -errno;
+    while (total < count) {
+        r_count = do_read(fdin, buffer, MIN(count - total, (size_t)COPYBUFFERSIZE));
+        if (r_count < 0) {
+            LOGE("%s: read failed, err:%s", __FUNCTION__, strerror(errno));
+            free(buffer);
+            return -errno;
+        }
+        if (r_count == 0)
+            break;
+        /* a short write to a regular file means the partition is full */
+        w_count = do_write(fdout, buffer, r_count);
+        if (w_count != r_count) {
+            free(buffer);
+            return w_count < 0 ? w_count : -ENOSPC;
+        }
+        total += r_count;
     }
+    free(buffer);
+    return total;
+}
 
-    if ( ( fd1 = open(src, O_RDONLY) ) < 0 ) {
-        return -errno;
+/* errors meaning the kernel cannot copy between these two files */
+static int copy_unsupported(int err) {
+    return (err == EINVAL || err == EXDEV || err == ENOSYS ||
+            err == EOPNOTSUPP || err == EBADF);
+}
+
+/**
+ * Name          : copy_fd
+ * Description   : copies a range of a regular file, trying copy_file_range
+ *                 first, then sendfile and at last read/write. Each method
+ *                 loops on short transfers and the next one restarts where
+ *                 the previous stopped.
+ *                 returns the number of bytes copied or -errno.
+ * Parameters    :
+ *   fdin         -> source
+ *   fdout        -> destination, written from its current position
+ *   offset       -> offset of the range in the source
+ *   count        -> size of the range
+ */
+static ssize_t copy_fd(int fdin, int fdout, off_t offset, size_t count) {
+    enum { COPY_RANGE, COPY_SENDFILE, COPY_RW } method = COPY_RANGE;
+    size_t total = 0;
+    off_t pos = offset;
+    ssize_t rc;
+
+#ifndef __NR_copy_file_range
+    method = COPY_SENDFILE;
+#endif
+    while (total < count) {
+        if (method == COPY_RW) {
+            if (lseek(fdin, pos, SEEK_SET) < 0)
+                return -errno;
+            rc = copy_fd_rw(fdin, fdout, count - total);
+            return rc < 0 ? rc : (ssize_t)(total + rc);
+        }
+#ifdef __NR_copy_file_range
+        if (method == COPY_RANGE) {
+            /* the kernel expects a 64 bits offset */
+            loff_t lpos = pos;
+            rc = syscall(__NR_copy_file_range, fdin, &lpos, fdout, NULL, count - total, 0);
+            pos = lpos;
+        } else
+#endif
+            rc = sendfile(fdout, fdin, &pos, count - total);
+
+        if (rc > 0) {
+            total += rc;
+            continue;
+        }
+        if (rc < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (rc < 0 && !copy_unsupported(errno))
+            return -errno;
+        /* unsupported or nothing copied (some kernels return 0 across
+         * filesystems): the next method will tell if EOF is reached
+         */
+        method++;
     }
+    return total;
+}
 
-    if ( ( fd2 = open(des, O_WRONLY | O_CREAT | O_TRUNC, 0660) ) < 0) {
-        LOGE("%s: can not open file: %s\n", __FUNCTION__, des);
-        close(fd1);
+static int64_t thread_cpu_ms() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* writes a buffer to a regular file, a short write meaning it is full */
+static int write_all(int fd, const unsigned char *buffer, size_t len) {
+    ssize_t w_count;
+
+    if (!len)
+        return 0;
+    w_count = do_write(fd, buffer, len);
+    if (w_count != (ssize_t)len)
+        return w_count < 0 ? w_count : -ENOSPC;
+    return 0;
+}
+
+/* deflates the pending input and writes the output, returns 0 or -errno */
+static int deflate_write(z_stream *strm, int fdout, unsigned char *out, int flush) {
+    int rc;
+
+    do {
+        strm->next_out = out;
+        strm->avail_out = COPYBUFFERSIZE;
+        if (deflate(strm, flush) == Z_STREAM_ERROR)
+            return -EIO;
+        if ((rc = write_all(fdout, out, COPYBUFFERSIZE - strm->avail_out)) < 0)
+            return rc;
+    } while (strm->avail_out == 0);
+    return 0;
+}
+
+/**
+ * Name          : deflate_fd
+ * Description   : gzip compresses a range of a file through two bounded
+ *                 buffers. Once the thread has used COMPRESS_CPU_BUDGET_MS of
+ *                 CPU time on the file, the rest of the range is stored so
+ *                 the output remains a valid gzip file.
+ *                 returns the number of bytes read from the source or -errno.
+ * Parameters    :
+ *   fdin         -> source, read until EOF or count bytes
+ *   fdout        -> destination
+ *   offset       -> offset of the range in the source
+ *   count        -> max size of the range
+ */
+static ssize_t deflate_fd(int fdin, int fdout, off_t offset, size_t count) {
+    z_stream strm;
+    unsigned char *in, *out;
+    int64_t budget_end = thread_cpu_ms() + COMPRESS_CPU_BUDGET_MS;
+    int flush, compressing = 1;
+    size_t total = 0;
+    ssize_t r_count, rc = 0;
+
+    if (offset && lseek(fdin, offset, SEEK_SET) < 0)
         return -errno;
+    if ((in = malloc(2 * COPYBUFFERSIZE)) == NULL)
+        return -ENOMEM;
+    out = in + COPYBUFFERSIZE;
+
+    memset(&strm, 0, sizeof(strm));
+    /* 16 + MAX_WBITS selects the gzip wrapper */
+    if (deflateInit2(&strm, COMPRESS_LEVEL, Z_DEFLATED, 16 + MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(in);
+        return -ENOMEM;
     }
 
-    /* Start copy loop */
-    while (1) {
-        /* Read data from src */
-        r_count = do_read(fd1, buffer, CPBUFFERSIZE);
+    do {
+        r_count = do_read(fdin, in, MIN(count - total, (size_t)COPYBUFFERSIZE));
         if (r_count < 0) {
+            rc = -errno;
             LOGE("%s: read failed, err:%s", __FUNCTION__, strerror(errno));
-            rc = -1;
             break;
         }
-
-        if (r_count == 0)
-            break;
-
-        /* Copy data to des */
-        w_count = do_write(fd2, buffer, r_count);
-        if (w_count < 0) {
-            LOGE("%s: write failed, err:%s", __FUNCTION__, strerror(errno));
-            rc = -1;
-            break;
+        total += r_count;
+        flush = (r_count == 0 || total >= count) ? Z_FINISH : Z_NO_FLUSH;
+
+        if (compressing && thread_cpu_ms() > budget_end) {
+            LOGW("%s: compression budget exhausted, store the rest\n", __FUNCTION__);
+            /* the data deflated so far may be flushed by the change */
+            strm.avail_in = 0;
+            strm.next_out = out;
+            strm.avail_out = COPYBUFFERSIZE;
+            deflateParams(&strm, Z_NO_COMPRESSION, Z_DEFAULT_STRATEGY);
+            if ((rc = write_all(fdout, out, COPYBUFFERSIZE - strm.avail_out)) < 0)
+                break;
+            compressing = 0;
         }
-        if (r_count != w_count) {
-            LOGE("%s: write failed, r_count:%d w_count:%d",
-                 __FUNCTION__, r_count, w_count);
-            rc = -1;
+        strm.next_in = in;
+        strm.avail_in = r_count;
+        if ((rc = deflate_write(&strm, fdout, out, flush)) < 0)
             break;
-        }
-    }
+    } while (flush != Z_FINISH);
 
-    /* Error occurred while copying data */
-    if ((rc == -1) && (w_count == -ENOSPC)) {
-        /* CRASHLOG_ERROR_FULL shall only be raised if des indicates LOGS_DIR */
-        if (check_partlogfull(des))
-            raise_infoerror(ERROREVENT, CRASHLOG_ERROR_FULL);
+    deflateEnd(&strm);
+    free(in);
+    return rc < 0 ? rc : (ssize_t)total;
+}
+
+/**
+ * Name          : do_copy_file
+ * Description   : copy engine used by every crashlog file copy. Whole
+ *                 regular files are cloned when the filesystem supports it,
+ *                 ranges are copied in kernel, pseudo files reporting no size
+ *                 are read until EOF. CRASHLOG_ERROR_FULL is raised when the
+ *                 logs partition is full.
+ *                 returns the number of bytes copied or -errno.
+ * Parameters    :
+ *   src          -> source file
+ *   dest         -> destination file, created or truncated
+ *   limit        -> max number of bytes to copy, 0 for no limit
+ *   flags        -> COPY_TAIL to copy the last limit bytes instead of the
+ *                   first ones (regular files only), COPY_COMPRESS to
+ *                   write dest gzip compressed
+ */
+ssize_t do_copy_file(const char *src, const char *dest, size_t limit, int flags) {
+    struct stat info;
+    int fsrc, fdest;
+    off_t offset = 0;
+    size_t count;
+    ssize_t rc;
+
+    if (src == NULL || dest == NULL) return -EINVAL;
+
+    if ( ( fsrc = open(src, O_RDONLY) ) < 0 ) {
+        return -errno;
+    }
+    if (fstat(fsrc, &info) < 0) {
+        rc = -errno;
+        close(fsrc);
+        return rc;
     }
+    if ( ( fdest = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0660) ) < 0) {
+        rc = -errno;
+        close(fsrc);
+        return rc;
+    }
+    /* owned by the crashlog user before being written */
+    do_chown(dest, PERM_USER, PERM_GROUP);
 
-    if (fd1 >= 0)
-        close(fd1);
-    if (fd2 >= 0)
-        close(fd2);
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        count = info.st_size;
+        if (limit && count > limit) {
+            if (flags & COPY_TAIL)
+                offset = count - limit;
+            count = limit;
+        }
+        if (flags & COPY_COMPRESS)
+            rc = deflate_fd(fsrc, fdest, offset, count);
+        else if (!offset && count == (size_t)info.st_size && !ioctl(fdest, FICLONE, fsrc))
+            rc = count;
+        else
+            rc = copy_fd(fsrc, fdest, offset, count);
+    } else if (flags & COPY_COMPRESS)
+        rc = deflate_fd(fsrc, fdest, 0, limit ? limit : (size_t)SSIZE_MAX);
+    else
+        rc = copy_fd_rw(fsrc, fdest, limit ? limit : (size_t)SSIZE_MAX);
 
-    do_chown(des, PERM_USER, PERM_GROUP);
+    /* CRASHLOG_ERROR_FULL shall only be raised if dest indicates LOGS_DIR */
+    if (rc == -ENOSPC && check_partlogfull(dest))
+        raise_infoerror(ERROREVENT, CRASHLOG_ERROR_FULL);
+    /* the written size differs from rc when compressed */
+    if (rc > 0 && !fstat(fdest, &info))
+        quota_account(dest, info.st_size);
+
+    close(fsrc);
+    close(fdest);
     return rc;
 }
 
+int do_copy_eof(const char *src, const char *des)
+{
+    ssize_t rc;
+
+    rc = do_copy_file(src, des, 0, 0);
+    if (rc < 0) {
+        LOGE("%s: can not copy %s to %s: %s\n", __FUNCTION__,
+             src, des, strerror(-rc));
+        return rc;
+    }
+    return 0;
+}
+
 int do_copy_eof_dir(const char *srcdir, const char *dstdir)
 {
     int ret = 0;
@@ -1126,6 +1797,8 @@ int do_copy_utf16_to_utf8(const char *src, const char *des)
         if (buf8_count != w_count) {
             LOGE("%s: write failed, r_count:%d w_count:%d",
                  __FUNCTION__, r_count, w_count);
+            /* a short write means the partition is full */
+            w_count = -ENOSPC;
             rc = -1;
             break;
         }
@@ -1148,85 +1821,25 @@ int do_copy_utf16_to_utf8(const char *src, const char *des)
 }
 
 int do_copy_tail(char *src, char *dest, int limit) {
-    int rc = 0;
-    int fsrc = -1, fdest = -1;
-    struct stat info;
-    off_t offset = 0;
-
-    if (src == NULL || dest == NULL) return -EINVAL;
-
-    if (stat(src, &info) < 0) {
-        return -errno;
-    }
-
-    if ( ( fsrc = open(src, O_RDONLY) ) < 0 ) {
-        return -errno;
-    }
-
-    if ( ( fdest = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0660) ) < 0) {
-        close(fsrc);
-        return -errno;
-    }
-
-    if ((limit == 0) || (info.st_size < limit))
-        limit = info.st_size;
-
-    if (info.st_size > limit)
-        offset = info.st_size - limit;
-
-    rc = sendfile(fdest, fsrc, &offset, limit);
-    /* CRASHLOG_ERROR_FULL shall only be raised if dest indicates LOGS_DIR */
-    if ((rc != -1) && (rc != limit) && check_partlogfull(dest))
-        raise_infoerror(ERROREVENT, CRASHLOG_ERROR_FULL);
-
-    close(fsrc);
-    close(fdest);
-    do_chown(dest, PERM_USER, PERM_GROUP);
-    return rc;
+    return do_copy_file(src, dest, limit, COPY_TAIL);
 }
 
 int do_copy(char *src, char *dest, int limit) {
-    int rc = 0;
-    int fsrc = -1, fdest = -1;
-    struct stat info;
+    int fdest;
 
     if (src == NULL || dest == NULL) return -EINVAL;
 
-    if (stat(src, &info) < 0) {
-        return -errno;
-    }
-
-    if ( ( fsrc = open(src, O_RDONLY) ) < 0 ) {
-        return -errno;
-    }
-
-    if ( ( fdest = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0660) ) < 0) {
-        close(fsrc);
-        return -errno;
-    }
-
     if (limit == 0) {
-        /* test this late as if limit is 0, the dest file shall be
-         * empty
-         */
-        close(fsrc);
+        /* the dest file shall be empty */
+        if (!file_exists(src))
+            return -ENOENT;
+        if ( ( fdest = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0660) ) < 0)
+            return -errno;
         close(fdest);
         do_chown(dest, PERM_USER, PERM_GROUP);
         return 0;
     }
-
-    if (info.st_size <= limit)
-        limit = info.st_size;
-
-    rc = sendfile(fdest, fsrc, NULL, limit);
-    /* CRASHLOG_ERROR_FULL shall only be raised if dest indicates LOGS_DIR */
-    if ((rc != -1) && (rc != limit) && check_partlogfull(dest))
-        raise_infoerror(ERROREVENT, CRASHLOG_ERROR_FULL);
-
-    close(fsrc);
-    close(fdest);
-    do_chown(dest, PERM_USER, PERM_GROUP);
-    return rc;
+    return do_copy_file(src, dest, limit, 0);
 }
 
 
@@ -1248,14 +1861,16 @@ int do_copy(char *src, char *dest, int limit) {
  *                      file index)
  * @param cnt_len - counter index len (for cases in which the rotation counter has a fixed
  *                  length eg. 01, 02 .. 99)
+ * @param flags - COPY_COMPRESS to write the copies gzip compressed, with a .gz suffix
  */
 static int do_copy_circular(const char *source, const char *destination, const char *extension,
-        const char *extra, off_t limit, unsigned int start_index, unsigned int cnt_len) {
+        const char *extra, off_t limit, unsigned int start_index, unsigned int cnt_len, int flags) {
     char path[PATHMAX] = {'\0'};
     char dest[PATHMAX] = {'\0'};
     int len_base_path, len_dest_path;
     int index = start_index, rc = 0;
     const char *file = strrchr(source,'/') + 1;
+    const char *suffix = (flags & COPY_COMPRESS) ? ".gz" : "";
     path[PATHMAX - 1] = '\0';
 
     if (!limit || !file)
@@ -1267,11 +1882,11 @@ static int do_copy_circular(const char *source, const char *destination, const c
     len_dest_path = strlen(dest);
 
     if (!index) {
-        snprintf(dest + len_dest_path, PATHMAX - len_dest_path, "%s%s", extra, extension);
+        snprintf(dest + len_dest_path, PATHMAX - len_dest_path, "%s%s%s", extra, extension, suffix);
         if (!file_exists(source))
             snprintf(path + len_base_path, PATHMAX - len_base_path, "%s", extension);
 
-        rc = do_copy_tail(path, dest, limit);
+        rc = do_copy_file(path, dest, limit, COPY_TAIL | flags);
         if (rc < 0)
             return rc;
 
@@ -1280,9 +1895,10 @@ static int do_copy_circular(const char *source, const char *destination, const c
     }
 
     while (limit) {
-        snprintf(dest + len_dest_path, PATHMAX - len_dest_path, "%s.%.*d%s", extra, cnt_len, index, extension);
+        snprintf(dest + len_dest_path, PATHMAX - len_dest_path, "%s.%.*d%s%s", extra, cnt_len, index,
+                extension, suffix);
         snprintf(path + len_base_path, PATHMAX - len_base_path, ".%.*d%s", cnt_len, index, extension);
-        rc = do_copy_tail(path, dest, limit);
+        rc = do_copy_file(path, dest, limit, COPY_TAIL | flags);
         if (rc < 0)
             return rc;
 
@@ -1334,92 +1950,6 @@ int do_mv_in_dir(char *src, char *dest_dir) {
     return do_mv(src, destination);
 }
 
-void qs_swap(void *array, int *indexes, int first, int second) {
-    int itmp;
-    char *vtmp;
-    char **carray = array;
-
-    itmp = indexes[first];
-    indexes[first] = indexes[second];
-    indexes[second] = itmp;
-
-    vtmp = carray[first];
-    carray[first] = carray[second];
-    carray[second] = vtmp;
-}
-
-int qs_partition(void *array, int *indexes, int start, int end, int pivot) {
-    int j = start, i;
-
-    qs_swap(array, indexes, pivot, end);
-    for (i = start ; i < end ; i++) {
-        if (indexes[i] <= indexes[end]) {
-            qs_swap(array, indexes, i, j);
-            j++;
-        }
-    }
-    qs_swap(array, indexes, end, j);
-    return j;
-}
-
-void __quicksort(void *array, int *indexes, int start, int end) {
-    int pivot;
-    if ( start < end ) {
-        pivot = qs_partition(array, indexes, start, end, start);
-        __quicksort(array, indexes, start, pivot-1);
-        __quicksort(array, indexes, pivot+1, end);
-    }
-}
-
-#ifdef __DEBUG_QS__
-void dump_char_array(char **array, int size) {
-    int idx;
-
-    for (idx = 0 ; idx < size ; idx++)
-        printf("line %d: %s", idx, array[idx]);
-}
-
-void dump_int_array(int *array, int size) {
-    int idx;
-
-    printf("[");
-    for (idx = 0 ; idx < size - 1 ; idx++)
-        printf("%d, ", array[idx]);
-    printf("%d]\n", array[idx]);
-}
-#endif
-
-int quicksort(void *array, int dim, int pivot) {
-    int *indexes, i, diff;
-
-    indexes = (int*)malloc(dim*sizeof(int));
-    if (indexes == NULL) return -ENOMEM;
-
-    diff = dim - pivot;
-    for (i = 0 ; i < dim ; i++) {
-        if (i < pivot)
-            indexes[i] = diff + i;
-        else indexes[i] = i - pivot;
-    }
-#ifdef __DEBUG_QS__
-    printf("Sort an array of %d items from pivot %d containing:\n", dim, pivot);
-    dump_char_array((char**)array, dim);
-    printf("Unsorted indexes: ");
-    dump_int_array(indexes, dim);
-#endif
-    __quicksort(array, indexes, 0, dim-1);
-
-#ifdef __DEBUG_QS__
-    printf("Sorted into:\n");
-    dump_char_array((char**)array, dim);
-    printf("Sorted indexes: ");
-    dump_int_array(indexes, dim);
-#endif
-
-    free(indexes);
-    return 0;
-}
-
 /*
 * Name          : cache_file
 * Description   : copy source file lines into buffer.
@@ -1429,7 +1959,8 @@ int quicksort(void *array, int dim, int pivot) {
 int cache_file(char *filename, char **records, int maxrecords, int cachemode, int offset) {
 
     char curline[MAXLINESIZE];
-    int fd, res = 0, index, line_idx = 0;
+    struct line_reader lr;
+    int res = 0, index, line_idx = 0;
 
     if (cachemode != CACHE_START && cachemode != CACHE_TAIL) {
         return -EINVAL;
@@ -1439,8 +1970,8 @@ int cache_file(char *filename, char **records, int maxrecords, int cachemode, in
     }
     if (maxrecords == 0) return 0;
 
-    if ( ( fd = open(filename, O_RDONLY) ) < 0) {
-        return -errno;
+    if ( ( res = line_reader_open(&lr, filename, O_RDONLY) ) < 0) {
+        return res;
     }
     /* Initialize the buffer to NULL pointers */
     for ( index = 0 ; index < maxrecords ; index++)
@@ -1448,15 +1979,15 @@ int cache_file(char *filename, char **records, int maxrecords, int cachemode, in
 
     if (cachemode == CACHE_START) {
         for (index = 0 ; index < maxrecords ; index++) {
-            if ( (res = readline(fd, curline)) < 0) {
-                /* readline failed, cleanup and exit */
+            if ( (res = line_reader_next(&lr, curline)) < 0) {
+                /* line reading failed, cleanup and exit */
                 goto do_cleanup;
             }
             /*Start to copy line in the buffer when line number is equal to offset value*/
             if ( line_idx >= offset) {
                 if (res == 0) {
                     /* file terminated */
-                    close(fd);
+                    line_reader_close(&lr);
                     return (index - offset);
                 }
                 /* add a new line to our buffer */
@@ -1468,46 +1999,45 @@ int cache_file(char *filename, char **records, int maxrecords, int cachemode, in
             }
             line_idx++;
         }
-        close(fd);
+        line_reader_close(&lr);
         return index;
     }
 
     if (cachemode == CACHE_TAIL) {
-        int curindex = 0, count = 0;
-        while((res = readline(fd, curline)) > 0) {
-            /*Start to copy line when line number is equal to offset value*/
-            if ( line_idx >= offset) {
-                /* add a new file to our buffer */
-                if (records[curindex] != NULL)
-                    free(records[curindex]);
-                records[curindex] = strdup(curline);
-                if (records[curindex] == NULL) {
-                    res = -errno;
-                    goto do_cleanup;
-                }
-                curindex = (curindex + 1) % maxrecords;
-                if (count < maxrecords)
-                    count++;
-            }
-            line_idx++;
+        int first = 0, count = 0;
+        off_t *offsets = malloc(maxrecords * sizeof(off_t));
+
+        if (offsets == NULL) {
+            res = -ENOMEM;
+            goto do_cleanup;
+        }
+        /* Only keep the offsets of the last lines in a ring ... */
+        while((res = line_reader_next(&lr, curline)) > 0) {
+            /*Start to count lines when line number is equal to offset value*/
+            if ( line_idx++ < offset)
+                continue;
+            offsets[(first + count) % maxrecords] = line_reader_offset(&lr);
+            if (count < maxrecords)
+                count++;
+            else
+                first = (first + 1) % maxrecords;
+        }
+        /* ... and copy them in order from the oldest one */
+        if (res == 0 && count)
+            res = line_reader_seek(&lr, offsets[first]);
+        free(offsets);
+        for (index = 0 ; index < count && res >= 0 ; index++) {
+            if ((res = line_reader_next(&lr, curline)) <= 0)
+                break;
+            if ((records[index] = strdup(curline)) == NULL)
+                res = -errno;
         }
         if ( res < 0) {
-            /* readline failed, cleanup and exit */
+            /* line reading failed, cleanup and exit */
             goto do_cleanup;
         }
-        /* res == 0 => EOF */
-        if (count == maxrecords && curindex != 0) {
-            /* Reordering the buffer is necessary */
-#ifdef __DEBUG_QS__
-            printf("Reorder the buffer (count = %d, maxrecords = %d, curindex = %d)\n", count, maxrecords, curindex);
-#endif
-            if ((res = quicksort(records, count, curindex)) < 0) {
-                LOGE("%s: Cannot sort the final array: %s\n", __FUNCTION__, strerror(-res));
-                goto do_cleanup;
-            }
-        }
-        close(fd);
-        return count;
+        line_reader_close(&lr);
+        return index;
     }
 do_cleanup:
     for ( index = 0 ; index < maxrecords ; index++)
@@ -1515,7 +2045,7 @@ do_cleanup:
             free(records[index]);
             records[index] = NULL;
         }
-    close(fd);
+    line_reader_close(&lr);
     return res;
 }
 
@@ -1692,7 +2222,8 @@ bool can_attach_bplog(int instance) {
     return 0;
 }
 
-static void copy_bplogs(const char *extra, char *dir, int limit, int instance, int start_index) {
+static void copy_bplogs(const char *extra, char *dir, int limit, int instance, int start_index,
+        int flags) {
     char logfile[PATHMAX];
 
     if (!can_attach_bplog(instance))
@@ -1701,10 +2232,10 @@ static void copy_bplogs(const char *extra, char *dir, int limit, int instance, i
     get_bplog_file(instance, logfile, PATHMAX, BPLOG_FILE_0);
     char *extension = BPLOG_FILE_EXT;
 
-    do_copy_circular(logfile, dir, extension, extra, limit, start_index, 1);
+    do_copy_circular(logfile, dir, extension, extra, limit, start_index, 1, flags);
 }
 
-static void copy_aplogs(const char *extra, char *dir, int limit, int start_index) {
+static void copy_aplogs(const char *extra, char *dir, int limit, int start_index, int flags) {
     unsigned int cnt_len = 1;
     char value[PROPERTY_VALUE_MAX];
 #ifndef CONFIG_APLOG
@@ -1716,20 +2247,20 @@ static void copy_aplogs(const char *extra, char *dir, int limit, int start_index
      * gives the same output, use it*/
     cnt_len = strlen(value);
 
-    do_copy_circular(APLOG_FILE_0, dir, "", extra, limit, start_index, cnt_len);
+    do_copy_circular(APLOG_FILE_0, dir, "", extra, limit, start_index, cnt_len, flags);
 #ifndef CONFIG_APLOG
     remove(APLOG_FILE_0);
 #endif
 }
 
 void do_logs_copy(int type, int type_extra_param, const char *dir,
-    const char *filename_tag, off_t limit) {
+    const char *filename_tag, off_t limit, int flags) {
     int start_index = 0;
     int collection_mode = 0;
 
     filename_tag = (filename_tag == NULL) ? "" : filename_tag;
     if (type == APLOG_TYPE)
-        copy_aplogs(filename_tag, (char *)dir, limit, start_index);
+        copy_aplogs(filename_tag, (char *)dir, limit, start_index, flags);
 
     if (type == BPLOG_TYPE_OLD)
         start_index = 1;
@@ -1740,17 +2271,17 @@ void do_logs_copy(int type, int type_extra_param, const char *dir,
     if (type_extra_param < 0 || collection_mode == COLLECT_BPLOG_CRASHING_ALL) {
         type_extra_param = get_modem_count();
         while (type_extra_param--)
-            copy_bplogs(filename_tag, (char *)dir, limit, type_extra_param, start_index);
+            copy_bplogs(filename_tag, (char *)dir, limit, type_extra_param, start_index, flags);
     }
     else if (collection_mode == COLLECT_BPLOG_CRASHING_MODEM)
-        copy_bplogs(filename_tag, (char *)dir, limit, type_extra_param, start_index);
+        copy_bplogs(filename_tag, (char *)dir, limit, type_extra_param, start_index, flags);
 }
 
 void do_log_copy(char *mode, char *dir, const char* timestamp, int type) {
     char extra[PATHMAX];
     snprintf(extra, sizeof(extra), "_%s_%s", mode, timestamp);
 
-    do_logs_copy(type, 0, dir, extra, MAXFILESIZE);
+    do_logs_copy(type, 0, dir, extra, MAXFILESIZE, LOG_COPY_FLAGS);
 }
 
 int copy_log(const char *src_dir, const char *src_file, e_match match,
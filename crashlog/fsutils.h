@@ -63,6 +63,18 @@ typedef enum e_match {
 #define CACHE_TAIL      0
 #define CACHE_START     1
 
+/* do_copy_file flags: copy the end of the file when it exceeds the limit,
+ * write the copy gzip compressed */
+#define COPY_TAIL       1
+#define COPY_COMPRESS   2
+
+/* flags of the logs copied by do_log_copy for the crash events */
+#ifdef CONFIG_COMPRESS_LOGS
+#define LOG_COPY_FLAGS  COPY_COMPRESS
+#else
+#define LOG_COPY_FLAGS  0
+#endif
+
 /* returns a negative value on error or the number of lines read */
 /*
 * Name          : cache_file
@@ -113,11 +125,127 @@ int find_new_crashlog_dir(e_dir_mode_t mode);
 char *generate_crashlog_dir(e_dir_mode_t mode, char *unique);
 int get_sdcard_paths(e_dir_mode_t mode);
 void do_logs_copy(int type, int type_extra_param, const char *dir,
-    const char *filename_tag, off_t limit);
+    const char *filename_tag, off_t limit, int flags);
 void do_log_copy(char *mode, char *dir, const char* ts, int type);
 long get_sd_size();
 int sdcard_allowed();
 
+/* Size of the chunks read by the buffered line reader */
+#define LINE_READER_BUFSIZE     (64 * KB)
+
+/**
+ * Buffered line reader.
+ *
+ * Reads a file by chunks of LINE_READER_BUFSIZE bytes and splits it
+ * into lines of at most MAXLINESIZE-1 characters. A longer line is
+ * returned in several pieces. The file offset of the last returned
+ * line is kept so callers can patch the file in place.
+ */
+struct line_reader {
+    int fd;
+    int owns_fd;
+    char *buf;
+    size_t pos;
+    size_t len;
+    off_t buf_offset;
+    off_t line_offset;
+    int eof;
+};
+
+/**
+ * Opens a file for buffered line reading
+ *
+ * @param lr reader to initialize
+ * @param filename path to the file
+ * @param flags open flags, O_RDONLY or O_RDWR
+ * @return 0 on success, -errno on errors
+ */
+int line_reader_open(struct line_reader *lr, const char *filename, int flags);
+
+/**
+ * Initializes a buffered line reader on an already opened file
+ * descriptor. The descriptor is not closed by line_reader_close.
+ *
+ * @param lr reader to initialize
+ * @param fd file descriptor to read from
+ * @return 0 on success, -errno on errors
+ */
+int line_reader_fdopen(struct line_reader *lr, int fd);
+
+/**
+ * Reads the next line, '\n' included when present
+ *
+ * @param lr reader
+ * @param buffer receives the nul terminated line
+ * @return line length, 0 at end of file, -errno on errors
+ */
+int line_reader_next(struct line_reader *lr, char buffer[MAXLINESIZE]);
+
+/**
+ * @return file offset of the line last returned by line_reader_next
+ */
+static inline off_t line_reader_offset(const struct line_reader *lr) {
+    return lr->line_offset;
+}
+
+/**
+ * Moves the reader to a file offset, usually one returned by
+ * line_reader_offset
+ *
+ * @param lr reader
+ * @param offset file offset of the next line to read
+ * @return 0 on success, -errno on errors
+ */
+int line_reader_seek(struct line_reader *lr, off_t offset);
+
+void line_reader_close(struct line_reader *lr);
+
+/**
+ * Multi keyword matcher.
+ *
+ * Keywords are compiled once into an Aho-Corasick automaton, a file can
+ * then be searched for all of them in a single pass. Like strstr on each
+ * line, a keyword never matches across a line boundary.
+ */
+struct keyword_matcher;
+
+struct keyword_hit {
+    int line;       /* first line containing the keyword, -1 if none */
+    off_t offset;   /* file offset of that line */
+};
+
+/**
+ * Called for each keyword found in a line, once per line
+ *
+ * @return non zero to stop the scan
+ */
+typedef int (*keyword_hit_cb)(void *ctx, int keyword, int line, off_t offset);
+
+/**
+ * Compiles a set of keywords
+ *
+ * @param keywords array of non empty keywords, duplicates are allowed
+ * @param nbkeywords number of keywords
+ * @return the matcher, NULL with errno set on errors
+ */
+struct keyword_matcher *keyword_matcher_create(const char *keywords[], int nbkeywords);
+
+/**
+ * Scans a file once for all the keywords of a matcher
+ *
+ * @param km compiled keywords
+ * @param filename file to scan
+ * @param hits array of nbkeywords entries receiving the first hit of
+ *        each keyword, may be NULL
+ * @param cb called for every hit, may be NULL
+ * @param ctx passed to cb
+ * @return number of distinct keywords found, -errno on errors
+ */
+int keyword_matcher_scan_file(const struct keyword_matcher *km, const char *filename,
+        struct keyword_hit *hits, keyword_hit_cb cb, void *ctx);
+
+void keyword_matcher_free(struct keyword_matcher *km);
+
 int count_lines_in_file(const char *filename);
 int find_matching_file(const char *dir_to_search, const char *pattern, char *filename_found);
 int get_value_in_file(char *file, char *keyword, char *value, unsigned int sizemax);
@@ -127,7 +255,7 @@ int find_oneofstrings_in_file(const char *filename, const char *keywords[], int
 int find_oneofstrings_in_file_with_keyword(char *filename, char **keywords, char *common_keyword,int nbkeywords);
 void flush_aplog(e_aplog_file_t file, const char *mode, char *dir, const char *ts);
 void reset_file(const char *filename);
-int readline(int fd, char buffer[MAXLINESIZE]);
+void reset_folder_counter(const char *filename);
 int freadline(FILE *fd, char buffer[MAXLINESIZE]);
 int append_file(char *filename, char *text);
 int overwrite_file(char *filename, char *value);
@@ -135,6 +263,7 @@ int overwrite_file(char *filename, char *value);
 mode_t get_mode(const char *s);
 int do_chmod(char *path, char *mode);
 int do_chown(const char *file, char *uid, char *gid);
+ssize_t do_copy_file(const char *src, const char *dest, size_t limit, int flags);
 int do_copy_eof(const char *src, const char *des);
 int do_copy_eof_dir(const char *srcdir, const char *dstdir);
 int do_copy_tail(char *src, char *dest, int limit);
@@ -143,6 +272,7 @@ int do_copy(char *src, char *dest, int limit);
 int do_mv(char *src, char *dest);
 int do_mv_in_dir(char *src, char *dest_dir);
 ssize_t do_read(int fd, void *buf, size_t len);
+ssize_t do_write(int fd, const void *buf, size_t len);
 int rmfr(char *path);
 void reset_log_data(const char *path, const char *rule);
 
@@ -20,8 +20,8 @@
  * for uptime management.
  *
  * This file contains the functions to handle the history file and the uptime event.
- * A circular buffer locally defined has its content synchronized on the history file
- * content.
+ * The entries are stored in append-only segments indexed in memory, the history
+ * file being kept as their exported view.
  */
 
 #include "crashutils.h"
@@ -30,6 +30,8 @@
 #include "history.h"
 #include "fsutils.h"
 #include "ingredients.h"
+#include "collector.h"
+#include "reaper.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -37,6 +39,9 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <openssl/sha.h>
 
 #define HISTORY_FIRST_LINE_FMT  "#V1.0 " UPTIME_EVNAME "   %-24s\n"
@@ -44,9 +49,58 @@
 #define HISTORY_BLANK_LINE2     "#EVENT  ID                    DATE                 TYPE\n"
 #define HISTORY_PERMISSION      "640"
 
-static char *historycache[MAX_RECORDS];
-static int nextline = -1;
-static unsigned int fileentries = 0;
+#define HISTORY_FILE_TMP        HISTORY_FILE ".tmp"
+#define HISTORY_SEGMENT_NAME    "history_event."
+#define HISTORY_INDEX_SIZE      8192 /* power of 2 */
+#define HISTORY_ARENA_SIZE      (MAX_RECORDS_HIST_FILE * 128)
+
+struct history_segment {
+    unsigned int seq;
+    int records;
+    off_t size;
+};
+
+/* The records are indexed by event ID, by crash directory and by crash
+ * folder, the last component of the crash directory */
+enum history_index_type {
+    INDEX_KEY = 0,
+    INDEX_DIR,
+    INDEX_FOLDER,
+};
+
+struct history_record {
+    unsigned int pos;       /* offset of the line in the arena */
+    unsigned short len;     /* line length, without the '\0' */
+    unsigned int seq;       /* segment of the record */
+    off_t offset;           /* offset of the line in its segment */
+    unsigned short keypos, keylen;
+    unsigned short dirpos, dirlen;
+    unsigned short folderpos, folderlen;
+    int nextkey;            /* next record in the same index bucket or -1 */
+    int nextdir;
+    int nextfolder;
+};
+
+static struct history_segment segments[HISTORY_MAX_SEGMENTS];
+static int nbsegments = 0;
+static int segment_fd = -1;
+static struct history_record records[MAX_RECORDS_HIST_FILE];
+static int firstrecord = 0;
+static int nbrecords = 0;
+static int keyindex[HISTORY_INDEX_SIZE];
+static int dirindex[HISTORY_INDEX_SIZE];
+static int folderindex[HISTORY_INDEX_SIZE];
+static off_t export_base = 0;
+static int history_loaded = 0;
+/* The record lines are stored in a single arena used as a ring, the
+ * oldest line starting at arena_head and the newest ending at arena_tail */
+static char *arena = NULL;
+static size_t arena_size = 0;
+static size_t arena_head = 0;
+static size_t arena_tail = 0;
+/* mutex used to protect the history store, entries being committed
+ * from the collection jobs */
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
 static int loop_uptime_event = 1;
 /* last uptime value set at device boot only */
 static char lastbootuptime[25] = "0000:00:00";
@@ -116,69 +170,572 @@ static int get_timed_firstline(char *buffer, int *hours, char lastuptime[24], in
     }
 }
 
-static int cache_history_file() {
+/*
+ * History store
+ *
+ * The history entries are appended to segment files of HISTORY_SEGMENT_RECORDS
+ * lines under HISTORY_SEGMENT_DIR. At most HISTORY_MAX_SEGMENTS segments are
+ * kept: when the last one is full, the oldest one is unlinked instead of
+ * rewriting the whole history. HISTORY_FILE remains the exported view read by
+ * the other tools (2 header lines followed by the segments contents); it is
+ * appended for each new entry and only rebuilt when a segment is dropped.
+ * An in-memory ring of records indexes the entries by event ID and by crash
+ * directory.
+ */
+static int history_hash(const char *str, size_t len) {
+    unsigned int hash = 2166136261U;
+
+    while (len--) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619U;
+    }
+    return hash & (HISTORY_INDEX_SIZE - 1);
+}
+
+static inline char *history_line(const struct history_record *rec) {
+    return arena + rec->pos;
+}
+
+/* Locates the event ID (2nd field), the crash directory (5th field, only
+ * when it is an absolute path) and its last component in a record line */
+static void history_record_parse(struct history_record *rec, const char *line) {
+    const char *ptr = line, *field, *end;
+    int nbfields = 0;
+
+    rec->keylen = rec->dirlen = rec->folderlen = 0;
+    while (nbfields < 5) {
+        while (*ptr == ' ') ptr++;
+        if (*ptr == '\0' || *ptr == '\n')
+            break;
+        field = ptr;
+        while (*ptr != '\0' && *ptr != ' ' && *ptr != '\n') ptr++;
+        nbfields++;
+        if (nbfields == 2) {
+            rec->keypos = field - line;
+            rec->keylen = ptr - field;
+        } else if (nbfields == 5 && field[0] == '/') {
+            rec->dirpos = field - line;
+            rec->dirlen = ptr - field;
+            for (end = ptr ; end > field + 1 && end[-1] == '/' ; end--) ;
+            for (field = end ; field > line + rec->dirpos && field[-1] != '/' ; field--) ;
+            rec->folderpos = field - line;
+            rec->folderlen = end - field;
+        }
+    }
+}
+
+static int *history_record_next(int slot, enum history_index_type type) {
+    switch (type) {
+    case INDEX_DIR: return &records[slot].nextdir;
+    case INDEX_FOLDER: return &records[slot].nextfolder;
+    default: return &records[slot].nextkey;
+    }
+}
+
+/* Returns the indexed field of a record, NULL if the line has none */
+static const char *history_record_field(const struct history_record *rec,
+        enum history_index_type type, size_t *len) {
+    unsigned short pos;
+
+    switch (type) {
+    case INDEX_DIR: pos = rec->dirpos; *len = rec->dirlen; break;
+    case INDEX_FOLDER: pos = rec->folderpos; *len = rec->folderlen; break;
+    default: pos = rec->keypos; *len = rec->keylen; break;
+    }
+    return *len ? history_line(rec) + pos : NULL;
+}
+
+static int *history_index_bucket(enum history_index_type type, const char *value, size_t len) {
+    int hash = history_hash(value, len);
+
+    switch (type) {
+    case INDEX_DIR: return &dirindex[hash];
+    case INDEX_FOLDER: return &folderindex[hash];
+    default: return &keyindex[hash];
+    }
+}
+
+static void history_index_add(int slot) {
+    struct history_record *rec = &records[slot];
+    enum history_index_type type;
+    const char *field;
+    size_t len;
+    int *bucket;
+
+    history_record_parse(rec, history_line(rec));
+    for (type = INDEX_KEY ; type <= INDEX_FOLDER ; type++) {
+        *history_record_next(slot, type) = -1;
+        if ((field = history_record_field(rec, type, &len)) == NULL)
+            continue;
+        bucket = history_index_bucket(type, field, len);
+        *history_record_next(slot, type) = *bucket;
+        *bucket = slot;
+    }
+}
+
+static void history_index_unlink(int *link, int slot, enum history_index_type type) {
+    while (*link >= 0 && *link != slot)
+        link = history_record_next(*link, type);
+    if (*link == slot)
+        *link = *history_record_next(slot, type);
+}
+
+static void history_index_remove(int slot) {
+    enum history_index_type type;
+    const char *field;
+    size_t len;
+
+    for (type = INDEX_KEY ; type <= INDEX_FOLDER ; type++) {
+        if ((field = history_record_field(&records[slot], type, &len)) != NULL)
+            history_index_unlink(history_index_bucket(type, field, len), slot, type);
+    }
+}
+
+/**
+ * Returns the first record of the chain starting at slot whose indexed
+ * field is value, -1 if none.
+ */
+static int history_index_next(int slot, const char *value, size_t len,
+        enum history_index_type type) {
+    const char *field;
+    size_t fieldlen;
+
+    for ( ; slot >= 0 ; slot = *history_record_next(slot, type)) {
+        field = history_record_field(&records[slot], type, &fieldlen);
+        if (field && fieldlen == len && !memcmp(field, value, len))
+            return slot;
+    }
+    return -1;
+}
+
+static int history_index_find(const char *value, enum history_index_type type) {
+    size_t len = strlen(value);
+
+    return history_index_next(*history_index_bucket(type, value, len), value, len, type);
+}
+
+/**
+ * Returns the first record whose crash directory ends with path, as the
+ * legacy folders looked up by clean_crashlog_in_sd, -1 if none. The records
+ * are looked up by the last component of path.
+ */
+static int history_folder_find(const char *path) {
+    const char *end = path + strlen(path), *folder, *dir;
+    struct history_record *rec;
+    size_t len;
+    int slot;
+
+    for ( ; end > path + 1 && end[-1] == '/' ; end--) ;
+    for (folder = end ; folder > path && folder[-1] != '/' ; folder--) ;
+    if (folder == end)
+        return -1;
+
+    len = end - folder;
+    slot = *history_index_bucket(INDEX_FOLDER, folder, len);
+    for ( ; (slot = history_index_next(slot, folder, len, INDEX_FOLDER)) >= 0 ;
+            slot = records[slot].nextfolder) {
+        rec = &records[slot];
+        /* the folder ends the crash directory, compare what precedes it */
+        if ((size_t)(end - path) > (size_t)(rec->folderpos + rec->folderlen - rec->dirpos))
+            continue;
+        dir = history_line(rec) + rec->folderpos + rec->folderlen - (end - path);
+        if (!memcmp(dir, path, end - path))
+            return slot;
+    }
+    return -1;
+}
+
+static void history_segment_path(char path[PATHMAX], unsigned int seq) {
+    snprintf(path, PATHMAX, "%s/%s%u", HISTORY_SEGMENT_DIR, HISTORY_SEGMENT_NAME, seq);
+}
+
+/* Moves the lines at the start of a new arena of the given size */
+static int history_arena_resize(size_t size) {
+    char *newarena = malloc(size);
+    size_t pos = 0;
+    int idx, slot;
+
+    if (newarena == NULL)
+        return -ENOMEM;
+    for (idx = 0 ; idx < nbrecords ; idx++) {
+        slot = (firstrecord + idx) % MAX_RECORDS_HIST_FILE;
+        memcpy(newarena + pos, history_line(&records[slot]), records[slot].len + 1);
+        records[slot].pos = pos;
+        pos += records[slot].len + 1;
+    }
+    free(arena);
+    arena = newarena;
+    arena_size = size;
+    arena_head = 0;
+    arena_tail = pos;
+    return 0;
+}
+
+/* Reserves size bytes after the newest line, wrapping at the end of the
+ * arena; the arena only grows when the history lines are longer than expected */
+static int history_arena_alloc(size_t size) {
+    size_t pos;
     int res;
-    if ( !file_exists(HISTORY_FILE) ) {
-        char firstline[MAXLINESIZE];
-        char lastuptime[24];
-        int tmp;
-        FILE *to = fopen(HISTORY_FILE, "w");
-        if (to == NULL) return -errno;
-
-        do_chmod(HISTORY_FILE, HISTORY_PERMISSION);
-        do_chown(HISTORY_FILE, PERM_USER, PERM_GROUP);
-        get_timed_firstline(firstline, &tmp, lastuptime, 1);
-        fprintf(to, "%s", firstline);
-        fprintf(to, HISTORY_BLANK_LINE2);
-        fclose(to);
-        nextline = 0;
-        fileentries = 0;
-        return 0;
+
+    if (!nbrecords)
+        arena_head = arena_tail = 0;
+    if (arena_tail >= arena_head && arena_size - arena_tail >= size)
+        pos = arena_tail;
+    else if (arena_tail >= arena_head && arena_head > size)
+        pos = 0;
+    else if (arena_tail < arena_head && arena_head - arena_tail > size)
+        pos = arena_tail;
+    else {
+        if ((res = history_arena_resize(arena_size ? arena_size * 2 : HISTORY_ARENA_SIZE)) < 0)
+            return res;
+        pos = arena_tail;
     }
+    arena_tail = pos + size;
+    return pos;
+}
 
-    res = count_lines_in_file(HISTORY_FILE);
-    if ( res < 0 ) {
-        LOGE("%s: Cannot count the number of lines in %s - %s.\n",
-            __FUNCTION__, HISTORY_FILE, strerror(-res));
-        return res;
+/* Releases the oldest record */
+static void history_record_drop() {
+    history_index_remove(firstrecord);
+    firstrecord = (firstrecord + 1) % MAX_RECORDS_HIST_FILE;
+    if (--nbrecords)
+        arena_head = records[firstrecord].pos;
+}
+
+static int history_record_add(const char *line, unsigned int seq, off_t offset) {
+    size_t len = strlen(line);
+    int slot, pos;
+
+    if (nbrecords == MAX_RECORDS_HIST_FILE)
+        return -ENOSPC;
+    if ((pos = history_arena_alloc(len + 1)) < 0)
+        return pos;
+    slot = (firstrecord + nbrecords) % MAX_RECORDS_HIST_FILE;
+    memcpy(arena + pos, line, len + 1);
+    records[slot].pos = pos;
+    records[slot].len = len;
+    records[slot].seq = seq;
+    records[slot].offset = offset;
+    history_index_add(slot);
+    nbrecords++;
+    return slot;
+}
+
+static void history_store_clear() {
+    firstrecord = nbrecords = nbsegments = 0;
+    arena_head = arena_tail = 0;
+    memset(keyindex, 0xff, sizeof(keyindex));
+    memset(dirindex, 0xff, sizeof(dirindex));
+    memset(folderindex, 0xff, sizeof(folderindex));
+    if (segment_fd >= 0) {
+        close(segment_fd);
+        segment_fd = -1;
     }
+}
+
+/* Drops the oldest segment file and its records */
+static void history_drop_segment() {
+    char path[PATHMAX];
+
+    while (nbrecords && records[firstrecord].seq == segments[0].seq)
+        history_record_drop();
+    history_segment_path(path, segments[0].seq);
+    if (unlink(path) < 0 && errno != ENOENT)
+        LOGE("%s: Cannot remove %s - %s\n", __FUNCTION__, path, strerror(errno));
+    nbsegments--;
+    memmove(&segments[0], &segments[1], nbsegments * sizeof(segments[0]));
+}
 
-    int offset = HIST_FILE_HEADER_SIZE;
-    if (res > (HIST_FILE_HEADER_SIZE + MAX_RECORDS)) {
-        offset = res - MAX_RECORDS;
+static int history_open_segment(unsigned int seq) {
+    char path[PATHMAX];
+
+    if (segment_fd >= 0)
+        close(segment_fd);
+    history_segment_path(path, seq);
+    segment_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+        get_mode(HISTORY_PERMISSION));
+    if (segment_fd < 0) {
+        LOGE("%s: Cannot open %s - %s\n", __FUNCTION__, path, strerror(errno));
+        return -errno;
     }
+    do_chown(path, PERM_USER, PERM_GROUP);
+    return 0;
+}
 
-    if (res > HIST_FILE_HEADER_SIZE) {
-        fileentries = res - HIST_FILE_HEADER_SIZE;
-        /* Cache the history file without the 2 first lines */
-        res = cache_file(HISTORY_FILE, (char**)historycache, MAX_RECORDS, CACHE_TAIL, offset);
+/**
+ * Appends a line to the current segment, opening a new segment when the
+ * current one is full.
+ *
+ * @return 1 if the oldest segment was dropped, 0 on success, -errno on error
+ */
+static int history_store_append(const char *line) {
+    struct history_segment *cur;
+    size_t len = strlen(line);
+    int res, slot, dropped = 0;
+
+    if (!nbsegments || segments[nbsegments-1].records >= HISTORY_SEGMENT_RECORDS) {
+        unsigned int seq = nbsegments ? segments[nbsegments-1].seq + 1 : 0;
 
-        if ( res < 0 ) {
-            LOGE("%s: Cannot cache the contents of %s - %s.\n",
-                __FUNCTION__, HISTORY_FILE, strerror(-res));
+        if ((res = history_open_segment(seq)) < 0)
             return res;
+        if (nbsegments == HISTORY_MAX_SEGMENTS) {
+            history_drop_segment();
+            dropped = 1;
         }
-    } else {
-        fileentries = 0;
-        nextline = 0;
-        return 0;
+        segments[nbsegments].seq = seq;
+        segments[nbsegments].records = 0;
+        segments[nbsegments].size = 0;
+        nbsegments++;
+    } else if (segment_fd < 0 && (res = history_open_segment(segments[nbsegments-1].seq)) < 0)
+        return res;
+
+    cur = &segments[nbsegments-1];
+    if ((slot = history_record_add(line, cur->seq, cur->size)) < 0)
+        return slot;
+    errno = EIO;
+    if (write(segment_fd, line, len) != (ssize_t)len) {
+        res = -errno;
+        LOGE("%s: Cannot write history segment %u - %s\n", __FUNCTION__,
+            cur->seq, strerror(errno));
+        /* forget the record, a partial line is truncated at next load */
+        history_index_remove(slot);
+        if (--nbrecords) {
+            slot = (firstrecord + nbrecords - 1) % MAX_RECORDS_HIST_FILE;
+            arena_tail = records[slot].pos + records[slot].len + 1;
+        }
+        return res;
     }
+    cur->size += len;
+    cur->records++;
+    return dropped;
+}
+
+/* Offset of a record in the exported history file */
+static off_t history_export_offset(const struct history_record *rec) {
+    off_t offset = export_base + rec->offset;
+    int idx;
+
+    for (idx = 0 ; idx < nbsegments && segments[idx].seq != rec->seq ; idx++)
+        offset += segments[idx].size;
+    return offset;
+}
 
-    nextline = res % MAX_RECORDS;
+/* Rebuilds HISTORY_FILE from its current first line and the segments */
+static int history_export() {
+    char firstline[MAXLINESIZE] = "";
+    char path[PATHMAX];
+    char buffer[16 * KB];
+    char lastuptime[24];
+    FILE *from;
+    ssize_t len;
+    int fd, in, idx, hours, res = 0;
+
+    /* Keep the current uptime line if any */
+    if ((from = fopen(HISTORY_FILE, "r")) != NULL) {
+        if (!fgets(firstline, sizeof(firstline), from) || strncmp(firstline, "#V1.0 ", 6))
+            firstline[0] = '\0';
+        fclose(from);
+    }
+    if (firstline[0] == '\0' && get_timed_firstline(firstline, &hours, lastuptime, 0) != 0) {
+        LOGE("%s: can't get timed first line for history file", __FUNCTION__);
+        strcpy(firstline, HISTORY_BLANK_LINE1);
+    }
+
+    fd = open(HISTORY_FILE_TMP, O_WRONLY | O_TRUNC | O_CREAT, get_mode(HISTORY_PERMISSION));
+    if (fd < 0) {
+        LOGE("%s: Cannot create %s - %s\n", __FUNCTION__, HISTORY_FILE_TMP, strerror(errno));
+        return -errno;
+    }
+    if (write(fd, firstline, strlen(firstline)) != (ssize_t)strlen(firstline) ||
+        write(fd, HISTORY_BLANK_LINE2, strlen(HISTORY_BLANK_LINE2))
+            != (ssize_t)strlen(HISTORY_BLANK_LINE2))
+        res = -errno;
+
+    for (idx = 0 ; idx < nbsegments && !res ; idx++) {
+        history_segment_path(path, segments[idx].seq);
+        if ((in = open(path, O_RDONLY)) < 0) {
+            res = -errno;
+            break;
+        }
+        while ((len = read(in, buffer, sizeof(buffer))) > 0) {
+            if (write(fd, buffer, len) != len) {
+                res = -errno;
+                break;
+            }
+        }
+        if (len < 0)
+            res = -errno;
+        close(in);
+    }
+    close(fd);
+
+    if (!res && rename(HISTORY_FILE_TMP, HISTORY_FILE) < 0)
+        res = -errno;
+    if (res) {
+        LOGE("%s: Cannot export %s - %s\n", __FUNCTION__, HISTORY_FILE, strerror(-res));
+        unlink(HISTORY_FILE_TMP);
+        return res;
+    }
+    do_chown(HISTORY_FILE, PERM_USER, PERM_GROUP);
+    export_base = strlen(firstline) + strlen(HISTORY_BLANK_LINE2);
+    return 0;
+}
+
+/* Imports the entries of a history file written without segments */
+static int history_import(const char *filename) {
+    struct line_reader lr;
+    char line[MAXLINESIZE];
+    int res;
+
+    if ((res = line_reader_open(&lr, filename, O_RDONLY)) < 0)
+        return res;
+    while ((res = line_reader_next(&lr, line)) > 0) {
+        if (line[0] == '#' || line[res-1] != '\n')
+            continue;
+        if ((res = history_store_append(line)) < 0)
+            break;
+    }
+    line_reader_close(&lr);
     return res;
 }
 
-int reset_history_cache() {
-    if ((nextline > 0) || (historycache[0] != NULL)) {
-        int idx;
-        /* delete the cache first */
-        for (idx = 0 ; idx < MAX_RECORDS ; idx++)
-            if (historycache[idx]) {
-                free(historycache[idx]);
-                historycache[idx] = NULL;
+static int history_segment_cmp(const void *a, const void *b) {
+    unsigned int seqa = *(const unsigned int *)a, seqb = *(const unsigned int *)b;
+    return (seqa > seqb) - (seqa < seqb);
+}
+
+/* Loads the records of a segment; an incomplete last line is truncated */
+static int history_load_segment(unsigned int seq) {
+    struct line_reader lr;
+    struct history_segment *cur = &segments[nbsegments];
+    char path[PATHMAX];
+    char line[MAXLINESIZE];
+    int res;
+
+    history_segment_path(path, seq);
+    if ((res = line_reader_open(&lr, path, O_RDWR)) < 0)
+        return res;
+    cur->seq = seq;
+    cur->records = 0;
+    cur->size = 0;
+    nbsegments++;
+    while ((res = line_reader_next(&lr, line)) > 0) {
+        if (line[res-1] != '\n') {
+            LOGE("%s: Truncate incomplete record in %s\n", __FUNCTION__, path);
+            if (ftruncate(lr.fd, cur->size) < 0)
+                res = -errno;
+            break;
+        }
+        if (history_record_add(line, seq, cur->size) < 0) {
+            res = -ENOSPC;
+            break;
+        }
+        cur->size += res;
+        cur->records++;
+    }
+    line_reader_close(&lr);
+    return res;
+}
+
+/**
+ * Loads the history store from the segments and synchronizes HISTORY_FILE.
+ * A missing HISTORY_FILE resets the history, a HISTORY_FILE without
+ * segments is imported.
+ *
+ * @return the number of records, -errno on error
+ */
+static int history_store_load() {
+    unsigned int seqs[HISTORY_MAX_SEGMENTS * 2], seq;
+    char path[PATHMAX];
+    struct dirent *de;
+    struct stat st;
+    DIR *d;
+    off_t expected;
+    int nbseqs = 0, idx, res, exists = file_exists(HISTORY_FILE);
+
+    history_store_clear();
+    history_loaded = 1;
+    export_base = strlen(HISTORY_BLANK_LINE1) + strlen(HISTORY_BLANK_LINE2);
+
+    if (mkdir(HISTORY_SEGMENT_DIR, 0770) == 0) {
+        do_chmod(HISTORY_SEGMENT_DIR, "770");
+        do_chown(HISTORY_SEGMENT_DIR, PERM_USER, PERM_GROUP);
+    } else if (errno != EEXIST) {
+        LOGE("%s: Cannot create %s - %s\n", __FUNCTION__, HISTORY_SEGMENT_DIR, strerror(errno));
+        return -errno;
+    }
+
+    if ((d = opendir(HISTORY_SEGMENT_DIR)) == NULL)
+        return -errno;
+    while ((de = readdir(d)) != NULL) {
+        if (sscanf(de->d_name, HISTORY_SEGMENT_NAME "%u", &seq) != 1)
+            continue;
+        if (exists && nbseqs == (int)DIM(seqs)) {
+            /* too many segments: keep the newest ones */
+            qsort(seqs, nbseqs, sizeof(seqs[0]), history_segment_cmp);
+            if (seq > seqs[0]) {
+                unsigned int oldest = seqs[0];
+                seqs[0] = seq;
+                seq = oldest;
             }
+        } else if (exists) {
+            seqs[nbseqs++] = seq;
+            continue;
+        }
+        /* the history was removed or the segment is obsolete */
+        history_segment_path(path, seq);
+        unlink(path);
     }
-    return cache_history_file();
+    closedir(d);
+    qsort(seqs, nbseqs, sizeof(seqs[0]), history_segment_cmp);
+
+    if (!exists)
+        return (res = history_export()) < 0 ? res : 0;
+
+    if (!nbseqs) {
+        if ((res = history_import(HISTORY_FILE)) < 0)
+            return res;
+        return (res = history_export()) < 0 ? res : nbrecords;
+    }
+
+    for (idx = 0 ; idx < nbseqs ; idx++) {
+        if (idx < nbseqs - HISTORY_MAX_SEGMENTS) {
+            history_segment_path(path, seqs[idx]);
+            unlink(path);
+            continue;
+        }
+        if ((res = history_load_segment(seqs[idx])) < 0) {
+            LOGE("%s: Cannot load history segment %u - %s\n", __FUNCTION__,
+                seqs[idx], strerror(-res));
+            return res;
+        }
+    }
+
+    /* Rebuild the export if it does not match the segments */
+    expected = export_base;
+    for (idx = 0 ; idx < nbsegments ; idx++)
+        expected += segments[idx].size;
+    if (stat(HISTORY_FILE, &st) < 0 || st.st_size != expected) {
+        LOGI("%s: %s out of sync, rebuilding it\n", __FUNCTION__, HISTORY_FILE);
+        if ((res = history_export()) < 0)
+            return res;
+    }
+    return nbrecords;
+}
+
+/* Resets the history store: HISTORY_FILE missing means an empty history */
+static int history_store_reset() {
+    unlink(HISTORY_FILE);
+    return history_store_load();
+}
+
+int reset_history_cache() {
+    int res;
+
+    pthread_mutex_lock(&history_lock);
+    res = history_store_load();
+    pthread_mutex_unlock(&history_lock);
+    return res;
 }
 
 static void entry_to_history_line(struct history_entry *entry,
@@ -209,31 +766,80 @@ static void entry_to_history_line(struct history_entry *entry,
     }
 }
 
+/* Appends a line to the history store and to HISTORY_FILE */
+static int history_append_line(char *newline) {
+    int res;
+
+    if ( (!history_loaded || !file_exists(HISTORY_FILE)) &&
+            (res = history_store_load()) < 0 ) {
+        LOGE("%s: Cannot load history %s - %s.\n", __FUNCTION__,
+            HISTORY_FILE, strerror(-res));
+        return res;
+    }
+
+    res = history_store_append(newline);
+    if (res > 0) {
+        /* The oldest segment was dropped, the export is rebuilt once */
+        LOGD("%s : History trimmed to %d records\n", __FUNCTION__, nbrecords);
+        return history_export();
+    }
+    if (res == 0) {
+        /* We can just write the new line at the end of the file */
+        res = append_file(HISTORY_FILE, newline);
+        if (res > 0) return 0;
+    }
+    newline[strlen(newline) - 1] = 0; /*Remove trailing character for display purpose*/
+    LOGE("%s: Cannot append the line %s to %s- %s.\n", __FUNCTION__,
+        newline, HISTORY_FILE, strerror(-res));
+    return res;
+}
+
+/**
+ * Replaces the line of a record by a line of the same length, in the
+ * segment and in HISTORY_FILE.
+ */
+static int history_record_patch(int slot, const char *line) {
+    struct history_record *rec = &records[slot];
+    struct history_record patched = *rec;
+    char path[PATHMAX];
+    size_t len = strlen(line);
+    int fd, res = 0;
+
+    if (len != rec->len)
+        return -EINVAL;
+    history_record_parse(&patched, line);
+    if (patched.keypos != rec->keypos || patched.keylen != rec->keylen ||
+            patched.dirpos != rec->dirpos || patched.dirlen != rec->dirlen ||
+            memcmp(line + patched.keypos, history_line(rec) + rec->keypos, rec->keylen) ||
+            memcmp(line + patched.dirpos, history_line(rec) + rec->dirpos, rec->dirlen)) {
+        history_index_remove(slot);
+        memcpy(history_line(rec), line, len);
+        history_index_add(slot);
+    } else
+        memcpy(history_line(rec), line, len);
+
+    history_segment_path(path, rec->seq);
+    if ((fd = open(path, O_WRONLY)) < 0 ||
+            pwrite(fd, line, len, rec->offset) != (ssize_t)len)
+        res = -errno;
+    if (fd >= 0) close(fd);
+    if ((fd = open(HISTORY_FILE, O_WRONLY)) < 0 ||
+            pwrite(fd, line, len, history_export_offset(rec)) != (ssize_t)len)
+        res = -errno;
+    if (fd >= 0) close(fd);
+    if (res)
+        LOGE("%s: Cannot update %s - %s\n", __FUNCTION__, HISTORY_FILE, strerror(-res));
+    return res;
+}
+
 int update_history_file(struct history_entry *entry) {
 
-    /* historycache is a circular buffer indexed with next index */
-    int index = 0, fd, res;
     char newline[MAXLINESIZE];
-    char firstline[MAXLINESIZE];
-    char lastuptime[24];
-    int tmp;
+    int res;
     if (!entry || !entry->key ||
             !entry->eventtime)
         return -EINVAL;
 
-    if ( !file_exists(HISTORY_FILE) && (res = reset_history_cache()) < 0 ) {
-        LOGE("%s: Cannot reset history cache %s - %s.\n", __FUNCTION__,
-            HISTORY_FILE, strerror(-res));
-        return res;
-    } else if ( nextline < 0 && (res = cache_history_file()) < 0  ) {
-        LOGE("%s: Cannot cache %s - %s.\n", __FUNCTION__,
-            HISTORY_FILE, strerror(-res));
-        return res;
-    } else if ( nextline < 0 ) {
-        /* should never enter this case - added for KW */
-        nextline = 0;
-    }
-
     entry_to_history_line(entry, newline);
 
     if (newline[0] == 0) {
@@ -241,85 +847,37 @@ int update_history_file(struct history_entry *entry) {
             __FUNCTION__, entry->key, strerror(errno));
         return -errno;
     }
+    /* Within a collection job, the line is committed once the previous
+     * jobs are done so the history order follows the events order */
+    if (collector_defer_history(newline))
+        return 0;
 
-    /* Check if the buffer is full */
-    if ( historycache[nextline] != NULL ) 
-        free(historycache[nextline]);
-
-    if ( (historycache[nextline] = strdup(newline)) == NULL) {
-        newline[strlen(newline) - 1] = 0; /*Remove trailing character for display purpose*/
-        LOGE("%s: Cannot copy the line %s - %s.\n", __FUNCTION__,
-            newline, strerror(nextline));
-        return -errno;
-    }
+    pthread_mutex_lock(&history_lock);
+    res = history_append_line(newline);
+    pthread_mutex_unlock(&history_lock);
+    return res;
+}
 
-    nextline = (nextline + 1) % MAX_RECORDS;
-    if (++fileentries < MAX_RECORDS_HIST_FILE) {
-        /* We can just write the new line at the end of the file */
-        res = append_file(HISTORY_FILE, newline);
-        if (res > 0) return 0;
-        newline[strlen(newline) - 1] = 0; /*Remove trailing character for display purpose*/
-        LOGE("%s: Cannot append the line %s to %s- %s.\n", __FUNCTION__,
-            newline, HISTORY_FILE, strerror(-res));
-        return res;
-    }
+int history_commit_line(const char *line) {
+    char newline[MAXLINESIZE];
+    int res;
 
-    /* The file reached MAX_RECORDS_HIST_FILE records append buffer */
-    LOGD("%s : History cache file trimmed from %d to %d records \n", __FUNCTION__, 
-        MAX_RECORDS_HIST_FILE, MAX_RECORDS);
+    if (!line)
+        return -EINVAL;
 
-    /* We need to recreate a new file and write the full buffer
-     * costly!!!
-     */
-    fd = open(HISTORY_FILE, O_RDWR | O_TRUNC | O_CREAT, get_mode(HISTORY_PERMISSION));
-    if (fd < 0) {
-        LOGE("%s: Cannot create %s\n", HISTORY_FILE, strerror(errno));
-        return -errno;
-    }
-    /* Write the two first lines : get 'lastuptime' last computed value */
-    if ( get_timed_firstline(firstline, &tmp, lastuptime, 0) == 0 ) {
-        if ( (write(fd, firstline, strlen(firstline))) != (int)strlen(firstline) ) {
-            close(fd);
-            return -errno;
-        }
-    }
-    else {
-        LOGE("%s: can't get timed first line for history file", __FUNCTION__);
-        if ( write(fd, HISTORY_BLANK_LINE1, strlen(HISTORY_BLANK_LINE1)) != (int)strlen(HISTORY_BLANK_LINE1) ) {
-           close(fd);
-           return -errno;
-       }
-    }
-    if ( write(fd, HISTORY_BLANK_LINE2, strlen(HISTORY_BLANK_LINE2)) != (int)strlen(HISTORY_BLANK_LINE2) ) {
-       close(fd);
-       return -errno;
-   }
-
-    /* Copy the buffer from nextline to the end */
-    for (index = nextline ; index < MAX_RECORDS ; index++) {
-        if (write(fd, historycache[index], strlen(historycache[index]))
-            != (int)strlen(historycache[index]) ) {
-            close(fd);
-            return -errno;
-        }
-    }
-    /* Copy the buffer from 0 to nextline */
-    for (index = 0 ; index < nextline ; index++) {
-        if (write(fd, historycache[index], strlen(historycache[index]))
-            != (int)strlen(historycache[index]) ) {
-            close(fd);
-            return -errno;
-        }
-    }
-    fileentries = MAX_RECORDS;
-    close(fd);
-    return 0;
+    strncpy(newline, line, MAXLINESIZE);
+    newline[MAXLINESIZE-1] = 0;
+    pthread_mutex_lock(&history_lock);
+    res = history_append_line(newline);
+    pthread_mutex_unlock(&history_lock);
+    return res;
 }
 
-int uptime_history() {
+static int priv_uptime_history() {
     FILE *to;
     int res;
     char name[32];
+    char newline[MAXLINESIZE];
     const char *datelong = get_current_time_long(1);
     to = fopen(HISTORY_FILE, "r");
     if (to == NULL) {
@@ -345,23 +903,29 @@ int uptime_history() {
         return -res;
     }
     fprintf(to, HISTORY_BLANK_LINE1);
-    strcpy(name, PER_UPTIME);
-    fseek(to, 0, SEEK_END);
-    fprintf(to, "%-8s00000000000000000000  %-20s%s\n", name, datelong, lastbootuptime);
     fclose(to);
-    return 0;
+    strcpy(name, PER_UPTIME);
+    snprintf(newline, sizeof(newline), "%-8s00000000000000000000  %-20s%s\n",
+        name, datelong, lastbootuptime);
+    return history_append_line(newline);
 }
 
-/**
-* Name          : reset_uptime_history
-* Description   : cache the history file, write the 2 first lines
-*/
-int reset_uptime_history() {
+int uptime_history() {
+    int res;
+
+    pthread_mutex_lock(&history_lock);
+    res = priv_uptime_history();
+    pthread_mutex_unlock(&history_lock);
+    return res;
+}
+
+static int priv_reset_uptime_history() {
     FILE *to;
-    if ( nextline < 0 && cache_history_file() < 0) {
-        LOGE("%s: Cannot cache %s - %s.\n", __FUNCTION__,
-            HISTORY_FILE, strerror(errno));
-        return -errno;
+    int res;
+    if ( (res = history_store_reset()) < 0) {
+        LOGE("%s: Cannot reset %s - %s.\n", __FUNCTION__,
+            HISTORY_FILE, strerror(-res));
+        return res;
     }
     // if we start from an empty file, need to ensure the permission
     do_chmod(HISTORY_FILE, HISTORY_PERMISSION);
@@ -388,23 +952,38 @@ int reset_uptime_history() {
     return 0;
 }
 
+/**
+* Name          : reset_uptime_history
+* Description   : reset the history store, write the 2 first lines
+*/
+int reset_uptime_history() {
+    int res;
+
+    pthread_mutex_lock(&history_lock);
+    res = priv_reset_uptime_history();
+    pthread_mutex_unlock(&history_lock);
+    return res;
+}
+
 int history_has_event(char *eventdir) {
 
-    int idx;
+    int res;
     if (!eventdir) return -EINVAL;
 
-    if ( nextline < 0 && cache_history_file() < 0) {
-        LOGE("%s: Cannot cache %s - %s.\n", __FUNCTION__,
-            HISTORY_FILE, strerror(errno));
-        return -errno;
+    pthread_mutex_lock(&history_lock);
+    if ( !history_loaded && (res = history_store_load()) < 0) {
+        pthread_mutex_unlock(&history_lock);
+        LOGE("%s: Cannot load %s - %s.\n", __FUNCTION__,
+            HISTORY_FILE, strerror(-res));
+        return res;
     }
 
-    for (idx = 0 ; idx < MAX_RECORDS ; idx ++) {
-        if (historycache[idx] &&
-                strstr(historycache[idx], eventdir) != NULL)
-            return 1;
-    }
-    return 0;
+    /* eventdir is either an event ID or the path of a crash directory, as
+     * clean_crashlog_in_sd looks for its folders */
+    res = (history_index_find(eventdir, INDEX_KEY) >= 0 ||
+            history_folder_find(eventdir) >= 0);
+    pthread_mutex_unlock(&history_lock);
+    return res;
 }
 
 void clean_fake_property() {
@@ -449,13 +1028,11 @@ int add_uptime_event() {
     FILE *fd;
     char firstline[MAXLINESIZE];
     char lastuptime[24];
-    fd = fopen(HISTORY_FILE, "r+");
-    if (fd == NULL) return -errno;
+    if (!file_exists(HISTORY_FILE)) return -ENOENT;
 
     res = get_timed_firstline(firstline, &hours, lastuptime, 1);
     if ( res != 0 ) {
         LOGE("%s: can't get timed first line for history file", __FUNCTION__);
-        fclose(fd);
         return res;
     }
     /* Clean obsolete legacy crashlog folders at each uptime event */
@@ -463,17 +1040,27 @@ int add_uptime_event() {
         clean_crashlog_in_sd(SDCARD_LOGS_DIR, 10);
 
     /* Update history file first line (uptime line) */
+    pthread_mutex_lock(&history_lock);
+    fd = fopen(HISTORY_FILE, "r+");
+    if (fd == NULL) {
+        res = -errno;
+        pthread_mutex_unlock(&history_lock);
+        return res;
+    }
     errno = 0;
     fputs(firstline, fd);
     fclose(fd);
-    if (errno != 0) {
-        return -errno;
+    res = -errno;
+    pthread_mutex_unlock(&history_lock);
+    if (res != 0) {
+        return res;
     }
     /* Send an uptime event every 12 hours (by default, depending on uptime frequency value set)*/
     if ((hours / gcurrent_uptime_hour_frequency) >= loop_uptime_event) {
-        char *key = generate_event_id(PER_UPTIME, "");
+        char key[EVENT_ID_SIZE];
+
+        compute_event_id(key, PER_UPTIME, "");
         raise_event(key, PER_UPTIME, "", NULL, NULL);
-        free(key);
         loop_uptime_event = (hours / gcurrent_uptime_hour_frequency) + 1;
         restart_profile_srv(2);
         check_running_power_service();
@@ -493,18 +1080,17 @@ int add_uptime_event() {
 * Description   : This function updates the history_event on a CMDDELETE command
 *                 The line of the history event containing one of events list is updated:
 *                 The CRASH keyword is replaced by DELETE keyword
-*                 The crashlog folder is removed
+*                 The crashlog folder is removed in the background
 * Parameters    :
 *   char *events          -> chain containing events separated by comma
 **/
-int update_history_on_cmd_delete(char *events) {
-    char **events_list = NULL, crashdir[MAXLINESIZE], line[MAXLINESIZE], eventid[SHA_DIGEST_LENGTH+1];
-    int nbpatterns, maxpatterns = 10, maxpatternsize = 48, res, idx;
-    FILE *fd;
-    fd = fopen(HISTORY_FILE, "r+");
-    if (!fd) {
-        LOGE("%s: Unable to open %s - %s\n",
-            __FUNCTION__, HISTORY_FILE, strerror(errno));
+static int priv_update_history_on_cmd_delete(char *events) {
+    char **events_list = NULL, crashdir[MAXLINESIZE], line[MAXLINESIZE];
+    int nbpatterns, maxpatterns = 10, maxpatternsize = 48, res, idx, slot;
+    size_t len;
+    if ( !history_loaded && (res = history_store_load()) < 0) {
+        LOGE("%s: Unable to load %s - %s\n",
+            __FUNCTION__, HISTORY_FILE, strerror(-res));
         return -1;
     }
     /* Get events list from input events comma chain*/
@@ -512,24 +1098,24 @@ int update_history_on_cmd_delete(char *events) {
     if (nbpatterns <= 0 || !events_list) {
         LOGE("%s: Not patterns found in %s... stop the operation\n",
             __FUNCTION__, events);
-        fclose(fd);
         if (events_list) {
             free(events_list);
         }
         return -1;
     }
-    /*read each line of history file and check if event id matches one of the list*/
-    while (freadline(fd, line) > 0) {
-        res = sscanf(line, "CRASH %s %*s %*s %s\n", eventid, crashdir);
-        if (res == 2) {
-            /* Found a crash line, check the patterns */
-            for (idx = 0 ; idx < nbpatterns ; idx++)
-                if (!strcmp(eventid, events_list[idx])) {
-                    fseek(fd, -strlen(line), SEEK_CUR);
-                    fwrite("DELETE", 1, 6, fd);
-                    fseek(fd, strlen(line)-6, SEEK_CUR);
-                    rmfr(crashdir);
-                }
+    /* look up the crash lines of each event id in the index */
+    for (idx = 0 ; idx < nbpatterns ; idx++) {
+        len = strlen(events_list[idx]);
+        slot = history_index_find(events_list[idx], INDEX_KEY);
+        for ( ; slot >= 0 ; slot = history_index_next(records[slot].nextkey,
+                events_list[idx], len, INDEX_KEY)) {
+            if (sscanf(history_line(&records[slot]), "CRASH %*s %*s %*s %s\n", crashdir) != 1)
+                continue;
+            /* Patch the keyword in place */
+            strcpy(line, history_line(&records[slot]));
+            memcpy(line, "DELETE", 6);
+            history_record_patch(slot, line);
+            reaper_dispose(crashdir);
         }
     }
     /*free allocated resources*/
@@ -537,61 +1123,56 @@ int update_history_on_cmd_delete(char *events) {
         free(events_list[idx]);
     }
     free(events_list);
-    fclose(fd);
     return 0;
 }
 
+int update_history_on_cmd_delete(char *events) {
+    int res;
+
+    pthread_mutex_lock(&history_lock);
+    res = priv_update_history_on_cmd_delete(events);
+    pthread_mutex_unlock(&history_lock);
+    return res;
+}
+
 int process_uptime_event(struct watch_entry __attribute__((unused)) *entry, struct inotify_event __attribute__((unused)) *event) {
 
     clean_fake_property();
     return add_uptime_event();
 }
 
-int history_delete_first_existent_logcrashpath(const char *path) {
+static int priv_history_delete_first_existent_logcrashpath(const char *path) {
 
-    char line[MAXLINESIZE] = {'\0'};
-    char crashdir_log[MAXLINESIZE] = {'\0'};
-    int i = 0;
-    int res;
-    FILE *fd = NULL;
-    char *char_i;
+    char line[MAXLINESIZE];
+    struct history_record *rec;
+    int slot;
 
     if (!path)
          return 1;
 
-    if ((fd = fopen(HISTORY_FILE, "r+")) == NULL) {
-       LOGE("history_event file is not opened.\n");
+    if (!history_loaded && history_store_load() < 0) {
+       LOGE("history_event file is not loaded.\n");
        return -1;
     }
 
-    while (freadline(fd, line) > 0) {
-        /* search line with crashdir name */
-        res = sscanf(line, "%*s %*s %*s %*s %s\n", crashdir_log);
-
-        /* match event crashdir name with history_event log crashdir name */
-        if (res != 1 || strncmp(path, crashdir_log, MAXLINESIZE))
-             continue;
+    /* match event crashdir name with history_event log crashdir name */
+    if ((slot = history_index_find(path, INDEX_DIR)) < 0)
+        return 1;
 
-        fseek(fd, -strlen(line), SEEK_CUR);
-        /* delete crashdir name */
-        if ((char_i = strstr(line, path)) == NULL)
-             continue;
+    /* delete crashdir name */
+    rec = &records[slot];
+    strcpy(line, history_line(rec));
+    memset(line + rec->dirpos, ' ', rec->dirlen);
+    history_record_patch(slot, line);
 
-        memset(char_i, ' ', strlen(crashdir_log));
-
-        fwrite(line, sizeof(char), strlen(line), fd);
-
-        for (i = 0 ; i < MAX_RECORDS ; i++) {
-            if (historycache[i] && (char_i = strstr(historycache[i], path))) {
-                *char_i++ = '\n';
-                *char_i = '\0';
-                break;
-            }
-        }
-        break;
-    }
+    return 1;
+}
 
-    fclose(fd);
+int history_delete_first_existent_logcrashpath(const char *path) {
+    int res;
 
-    return 1;
+    pthread_mutex_lock(&history_lock);
+    res = priv_history_delete_first_existent_logcrashpath(path);
+    pthread_mutex_unlock(&history_lock);
+    return res;
 }
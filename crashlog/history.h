@@ -20,8 +20,8 @@
  * for uptime management.
  *
  * This file contains the functions to handle the history file and the uptime event.
- * A circular buffer locally defined has its content synchronized on the history file
- * content.
+ * The entries are stored in append-only segments indexed in memory, the history
+ * file being kept as their exported view.
  */
 
 #ifndef __HISTORY__H__
@@ -43,6 +43,7 @@ struct history_entry {
 int get_lastboot_uptime(char lastbootuptime[24]);
 int get_uptime_string(char newuptime[24], int *hours);
 int update_history_file(struct history_entry *entry);
+int history_commit_line(const char *line);
 int reset_uptime_history();
 int uptime_history();
 int history_has_event(char *eventdir);
@@ -30,8 +30,11 @@ static inline int check_mounted_partitions(void) { return 0; }
 
 #ifdef CONFIG_FACTORY_CHECKSUM
 void check_factory_partition_checksum();
+/* runs check_factory_partition_checksum on its own thread */
+void start_factory_partition_checksum();
 #else
 static inline void check_factory_partition_checksum() {}
+static inline void start_factory_partition_checksum() {}
 #endif
 
 #endif /* __CHECK_PARTITION_H__ */
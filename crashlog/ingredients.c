@@ -19,6 +19,9 @@
  * @brief File containing functions used to handle operations on
  * ingredients.txt file.
  *
+ * The ingredients are only fetched again when one of their inputs changed
+ * since ingredients.txt was last checked: the values of the properties it
+ * lists, the modem names, ingredients.conf, or ingredients.txt itself.
  */
 
 #include "ingredients.h"
@@ -29,6 +32,8 @@
 #include <ctype.h>
 #include <cutils/properties.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #ifdef CONFIG_EFILINUX
 #include <libdmi.h>
@@ -46,7 +51,34 @@ struct {
     {"ModemExt", MODEM_FIELD2, UNDEF_INGR}
 };
 
+/* only the read-only properties of a bulk section are known not to change */
+#define STABLE_BULK_FILTER  "^ro\\."
+
+#define FNV_OFFSET          14695981039346656037ULL
+#define FNV_PRIME           1099511628211ULL
+
+/* generation of the inputs of ingredients.txt */
+struct ingredients_generation {
+    unsigned long long props;   /* hash of the property values read */
+    int stable;                 /* 0 if some input cannot be hashed */
+    unsigned long modem;        /* changes of the modem names */
+    ino_t config_ino;           /* ingredients.conf as last parsed */
+    time_t config_mtime;
+    off_t config_size;
+    ino_t file_ino;             /* ingredients.txt as last checked */
+    time_t file_mtime;
+};
+
 static bool ingredients_disabled = FALSE;
+static struct ingredients_generation checked_gen;
+static int checked = 0;
+static pconfig_handle inputs = NULL;   /* ingredients.conf, for the keys */
+static struct ingredients_generation inputs_gen;
+static unsigned long modem_generation = 0;
+static struct ingredients_stats stats;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+/* modem names, refreshed by the collector workers raising events */
+static pthread_mutex_t modem_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void get_modem_section_name(char *name, pconfig_handle handle);
 
@@ -164,22 +196,33 @@ void load_modem_config(pconfig_handle handle) {
         if (!value)
             continue;
 
-        snprintf(modem_config[instance].value, sizeof(modem_config[instance].value), "%s", value);
+        pthread_mutex_lock(&modem_lock);
+        if (strcmp(modem_config[instance].value, value)) {
+            snprintf(modem_config[instance].value, sizeof(modem_config[instance].value), "%s", value);
+            modem_generation++;
+        }
+        pthread_mutex_unlock(&modem_lock);
     }
 }
 
 static int update_modem_name(int instance) {
     char property[PROPERTY_VALUE_MAX];
+    int updated = 0;
 
-    if (property_get(modem_config[instance].property, property, UNDEF_INGR) <= 0)
+    if (property_get(modem_config[instance].property, property, UNDEF_INGR) <= 0) {
         LOGV("Property %s not readable\n", modem_config[instance].property);
-    else if (strcmp(property, UNDEF_INGR) && strcmp(modem_config[instance].value, property)) {
+        return 0;
+    }
+    pthread_mutex_lock(&modem_lock);
+    if (strcmp(property, UNDEF_INGR) && strcmp(modem_config[instance].value, property)) {
         snprintf(modem_config[instance].value, sizeof(modem_config[instance].value),
                 "%s", property);
-        return 1;
+        modem_generation++;
+        updated = 1;
     }
+    pthread_mutex_unlock(&modem_lock);
 
-    return 0;
+    return updated;
 }
 
 int conditional_ingredients_refresh() {
@@ -301,17 +344,109 @@ static int fetch_ingredients(pconfig_handle handle) {
     return fetch_result;
 }
 
+static unsigned long long hash_string(unsigned long long hash, const char *str) {
+    for (; *str; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= FNV_PRIME;
+    }
+    /* end of string, so that "ab" "c" and "a" "bc" differ */
+    hash ^= 0xff;
+    hash *= FNV_PRIME;
+    return hash;
+}
+
+static unsigned long long hash_property(unsigned long long hash, char *key) {
+    char value[PROPERTY_VALUE_MAX];
+
+    if (property_get(key, value, UNDEF_INGR) < 0)
+        snprintf(value, sizeof(value), "%s", UNDEF_INGR);
+    return hash_string(hash_string(hash, key), value);
+}
+
+/* Hashes the values of the properties the ingredients are read from. The
+ * DMI fields are firmware values and do not change while running */
+static void hash_inputs(pconfig_handle handle, struct ingredients_generation *gen) {
+    unsigned long long hash = FNV_OFFSET;
+    int instance = DIM(modem_config);
+    psection c_psection;
+    pkv kv;
+
+    gen->stable = 1;
+    hash = hash_property(hash, MODEM_SCENARIO);
+    while (instance--)
+        hash = hash_property(hash, (char *)modem_config[instance].property);
+
+    for (c_psection = handle ? handle->first : NULL ; c_psection ; c_psection = c_psection->next) {
+        if (!strncmp(c_psection->name, "GETPROP", sizeof("GETPROP"))) {
+            for (kv = c_psection->kvlist ; kv ; kv = kv->next)
+                hash = hash_property(hash, kv->key);
+        } else if (!strncmp(c_psection->name, "GETBULKPROPS", sizeof("GETBULKPROPS"))) {
+            /* listing all the properties costs as much as the refresh */
+            for (kv = c_psection->kvlist ; kv ; kv = kv->next) {
+                if (strncmp(kv->key, STABLE_BULK_FILTER, strlen(STABLE_BULK_FILTER)))
+                    gen->stable = 0;
+            }
+        }
+    }
+    gen->props = hash;
+}
+
+/* Called with the lock held: ingredients.conf is parsed again only when
+ * it changed */
+static void get_generation(struct ingredients_generation *gen) {
+    struct stat info;
+
+    memset(gen, 0, sizeof(*gen));
+    pthread_mutex_lock(&modem_lock);
+    gen->modem = modem_generation;
+    pthread_mutex_unlock(&modem_lock);
+    if (!stat(INGREDIENTS_CONFIG, &info)) {
+        gen->config_ino = info.st_ino;
+        gen->config_mtime = info.st_mtime;
+        gen->config_size = info.st_size;
+    }
+    if (!inputs || gen->config_ino != inputs_gen.config_ino ||
+            gen->config_mtime != inputs_gen.config_mtime ||
+            gen->config_size != inputs_gen.config_size) {
+        if (inputs) {
+            free_config_file(inputs);
+            free(inputs);
+        }
+        inputs = parse_ingredients_file(INGREDIENTS_CONFIG);
+        inputs_gen = *gen;
+    }
+    hash_inputs(inputs, gen);
+    if (!stat(INGREDIENTS_FILE, &info)) {
+        gen->file_ino = info.st_ino;
+        gen->file_mtime = info.st_mtime;
+    }
+}
+
+static int same_generation(const struct ingredients_generation *gen1,
+        const struct ingredients_generation *gen2) {
+    return gen1->stable && gen2->stable && gen1->props == gen2->props &&
+        gen1->modem == gen2->modem && gen1->config_ino == gen2->config_ino &&
+        gen1->config_mtime == gen2->config_mtime &&
+        gen1->config_size == gen2->config_size &&
+        gen1->file_ino == gen2->file_ino && gen1->file_mtime == gen2->file_mtime;
+}
+
 void check_ingredients_file() {
     static pconfig_handle old_values = NULL;
     pconfig_handle new_values = NULL;
+    struct ingredients_generation gen;
 
-    if (ingredients_disabled)
+    pthread_mutex_lock(&lock);
+    if (ingredients_disabled) {
+        pthread_mutex_unlock(&lock);
         return;
+    }
 
     if (!file_exists(INGREDIENTS_CONFIG)) {
         LOGE("[INGR]: File '%s' not found, disable 'ingredients' feature\n",
              INGREDIENTS_CONFIG);
         ingredients_disabled = TRUE;
+        pthread_mutex_unlock(&lock);
         return;
     }
 
@@ -321,10 +456,20 @@ void check_ingredients_file() {
         load_modem_config(old_values);
     }
 
+    stats.checks++;
+    get_generation(&gen);
+    if (checked && same_generation(&gen, &checked_gen)) {
+        stats.skips++;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    stats.refreshes++;
+
     new_values = parse_ingredients_file(INGREDIENTS_CONFIG);
 
     if (!new_values) {
         LOGW("[INGR]: Cannot load config file");
+        pthread_mutex_unlock(&lock);
         return;
     }
 
@@ -333,7 +478,7 @@ void check_ingredients_file() {
     fetch_ingredients(new_values);
 
     /*old vs new */
-    if (cmp_config(old_values, new_values)) {
+    if (cmp_config(old_values, new_values) || !gen.file_ino) {
 
         LOGI("[INGR]: Updating %s", INGREDIENTS_FILE);
         if (dump_config(INGREDIENTS_FILE, new_values)) {
@@ -342,6 +487,9 @@ void check_ingredients_file() {
                 free_config_file(new_values);
                 free(new_values);
             }
+            /* try again on the next check */
+            pthread_mutex_unlock(&lock);
+            return;
         } else {
             if (old_values) {
                 free_config_file(old_values);
@@ -350,10 +498,31 @@ void check_ingredients_file() {
             old_values = new_values;
             do_chmod(INGREDIENTS_FILE, "644");
             do_chown(INGREDIENTS_FILE, PERM_USER, PERM_GROUP);
+            stats.writes++;
         }
     } else if (new_values) {
         LOGI("[INGR]: No diff between %p and %p", old_values, new_values);
         free_config_file(new_values);
         free(new_values);
     }
+
+    /* the fetch may have updated the modem names, and the dump the file.
+     * The properties are the ones read before the fetch, a change since
+     * triggers the next refresh */
+    get_generation(&checked_gen);
+    checked_gen.props = gen.props;
+    checked_gen.stable = gen.stable;
+    checked = 1;
+    LOGD("[INGR]: %lu refreshes, %lu checks skipped, %lu writes\n",
+        stats.refreshes, stats.skips, stats.writes);
+    pthread_mutex_unlock(&lock);
+}
+
+void ingredients_get_stats(struct ingredients_stats *out) {
+    if (!out)
+        return;
+
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
 }
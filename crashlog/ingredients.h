@@ -24,22 +24,31 @@
 #ifndef __INGREDIENTS_H__
 #define __INGREDIENTS_H__
 
+struct ingredients_stats {
+    unsigned long checks;       /* calls to check_ingredients_file */
+    unsigned long refreshes;    /* checks fetching the ingredients again */
+    unsigned long skips;        /* checks with unchanged inputs */
+    unsigned long writes;       /* rewrites of ingredients.txt */
+};
+
+/* test_ingredients links the real implementation */
+#if !defined(__TEST__) || defined(TEST_INGREDIENTS)
 /**
  * @brief Get the list of ingredients based on
  * ingredients config file an write the new values
  * if necessary.
  */
-#ifndef __TEST__
 void check_ingredients_file();
 int conditional_ingredients_refresh();
 int fetch_modem_name(int instance, char **name);
+void ingredients_get_stats(struct ingredients_stats *stats);
 #else
 static inline void check_ingredients_file() {}
 static inline int conditional_ingredients_refresh() {
     return 0;
 }
 static inline int fetch_modem_name(int instance, char **name) {
-    *name = '\0';
+    *name = "";
     return -1;
 }
 #endif
@@ -24,13 +24,15 @@
  * The watcher initialization is performed with a local array containing every
  * kind of watched events. Each event is linked to a directory to be watched and linked
  * to a specific callback processing function.
- * Each time the inotify watcher file descriptor is set, the buffer is read to
- * treat each event it contains. When an event can't be processed normally the
- * buffer content not yet read is dumped and flushed to LOG.
+ * Each time the inotify watcher file descriptor is set, it is drained in
+ * batches to treat each event it contains. When an event can't be processed
+ * normally the batch content is dumped and flushed to LOG. On a queue overflow,
+ * the watched directories are rescanned.
  *
  */
 
 #include "inotify_handler.h"
+#include "collector.h"
 #include "privconfig.h"
 #include "crashutils.h"
 #include "dropbox.h"
@@ -43,40 +45,251 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 
 #define LOG_PREFIX "inotify: "
 
 extern pconfig g_first_modem_config;
 
+/* read() returns complete events only, the buffer holds many of them */
+static char inotify_buffer[INOTIFY_BUFFER_SIZE]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+static struct inotify_stats stats;
+/* time of the last drain, files modified since then are rescanned on overflow */
+static struct timespec last_drain;
+
+/* The files handled by a drain, by watch descriptor and name. The ones of
+ * the current and of the previous drains are not handled again by the
+ * rescan. */
+struct drained_file {
+    int wd;
+    unsigned int hash;
+    size_t name;                /* offset of the name in names */
+};
+
+struct drained_files {
+    struct drained_file *files;
+    int count, size;
+    char *names;
+    size_t len, namesize;
+};
+
+static struct drained_files drained[2];
+static int cur_drained = 0;
+
+/* Registered entries hashed by watch descriptor. The nodes sharing a
+ * bucket are chained in registration order, so the first registered entry
+ * matching an event handles it. */
+#define WATCH_TABLE_SIZE        64 /* power of 2 */
+
+struct watch_node {
+    struct watch_entry *entry;
+    size_t patternlen;
+    struct watch_node *next;
+};
+
+static struct watch_node *watch_table[WATCH_TABLE_SIZE];
+/* mutex used to protect watch_table, entries being registered from the
+ * collection jobs */
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /**
 * @brief structure containing directories watched by crashlogd
 *
 * This structure contains every watched directories, with the itnotify mask value, and the associated
 * filename that should trigger a processing
 * note: a watched directory can only have one mask value
+* The entries are looked up by watch descriptor in watch_table, their pattern
+* being matched against the event file name as a prefix, a suffix or a
+* substring.
 */
 struct watch_entry wd_array[] = {
     /* -------------Warning: if table is updated, don't forget to update the  enum in privconfig.h
      * ---          it should be ALWAYS aligned with this enum of event type   */
-    {0, DROPBOX_DIR_MASK,   LOST_TYPE,      0,      LOST_EVNAME,        DROPBOX_DIR,        ".lost",                    NULL}, /* for full dropbox */
-    {0, DROPBOX_DIR_MASK,   SYSSERVER_TYPE, 0,      SYSSERVER_EVNAME,   DROPBOX_DIR,        "system_server_watchdog",   NULL},
-    {0, DROPBOX_DIR_MASK,   ANR_TYPE,       0,      ANR_EVNAME,         DROPBOX_DIR,        "anr",                      NULL},
-    {0, TOMBSTONE_DIR_MASK, TOMBSTONE_TYPE, 0,      TOMBSTONE_EVNAME,   TOMBSTONE_DIR,      "tombstone",                NULL},
-    {0, DROPBOX_DIR_MASK,   JAVATOMBSTONE_TYPE, 0,  JAVA_TOMBSTONE_EVNAME,   DROPBOX_DIR,   "native_crash",             NULL},
-    {0, DROPBOX_DIR_MASK,   JAVACRASH_TYPE, 0,      JAVACRASH_EVNAME,   DROPBOX_DIR,        "app_crash",                NULL},
-    {0, DROPBOX_DIR_MASK,   JAVACRASH_TYPE2, 0,     JAVACRASH_EVNAME,   DROPBOX_DIR,        "system_server_crash",      NULL},
-    {0, CORE_DIR_MASK,      APCORE_TYPE,    0,      APCORE_EVNAME,      HISTORY_CORE_DIR,   ".core",                    NULL},
-    {0, CORE_DIR_MASK,      HPROF_TYPE,     0,      HPROF_EVNAME,       HISTORY_CORE_DIR,   ".hprof",                   NULL},
-    {0, STAT_DIR_MASK,      STATTRIG_TYPE,  0,      STATSTRIG_EVNAME,   STAT_DIR,           "_trigger",                 NULL},
-    {0, STAT_DIR_MASK,      INFOTRIG_TYPE,  0,      STATSTRIG_EVNAME,   STAT_DIR,           "_infoevent",               NULL},
-    {0, STAT_DIR_MASK,      ERRORTRIG_TYPE, 0,      STATSTRIG_EVNAME,   STAT_DIR,           "_errorevent",              NULL},
-    {0, APLOG_DIR_MASK,     APLOGTRIG_TYPE, 0,      APLOGTRIG_EVNAME,   APLOG_DIR,          "_trigger",                 NULL},
-    {0, APLOG_DIR_MASK,     CMDTRIG_TYPE,   0,      CMDTRIG_EVNAME,     APLOG_DIR,          "_cmd",                     NULL},
+    {0, DROPBOX_DIR_MASK,   LOST_TYPE,      0,      LOST_EVNAME,        DROPBOX_DIR,        ".lost",                    NULL,   MATCH_SUFFIX}, /* for full dropbox */
+    {0, DROPBOX_DIR_MASK,   SYSSERVER_TYPE, 0,      SYSSERVER_EVNAME,   DROPBOX_DIR,        "system_server_watchdog",   NULL,   MATCH_PREFIX},
+    {0, DROPBOX_DIR_MASK,   ANR_TYPE,       0,      ANR_EVNAME,         DROPBOX_DIR,        "anr",                      NULL,   MATCH_SUBSTRING},
+    {0, TOMBSTONE_DIR_MASK, TOMBSTONE_TYPE, 0,      TOMBSTONE_EVNAME,   TOMBSTONE_DIR,      "tombstone",                NULL,   MATCH_PREFIX},
+    {0, DROPBOX_DIR_MASK,   JAVATOMBSTONE_TYPE, 0,  JAVA_TOMBSTONE_EVNAME,   DROPBOX_DIR,   "native_crash",             NULL,   MATCH_SUBSTRING},
+    {0, DROPBOX_DIR_MASK,   JAVACRASH_TYPE, 0,      JAVACRASH_EVNAME,   DROPBOX_DIR,        "app_crash",                NULL,   MATCH_SUBSTRING},
+    {0, DROPBOX_DIR_MASK,   JAVACRASH_TYPE2, 0,     JAVACRASH_EVNAME,   DROPBOX_DIR,        "system_server_crash",      NULL,   MATCH_PREFIX},
+    {0, CORE_DIR_MASK,      APCORE_TYPE,    0,      APCORE_EVNAME,      HISTORY_CORE_DIR,   ".core",                    NULL,   MATCH_SUBSTRING},
+    {0, CORE_DIR_MASK,      HPROF_TYPE,     0,      HPROF_EVNAME,       HISTORY_CORE_DIR,   ".hprof",                   NULL,   MATCH_SUBSTRING},
+    {0, STAT_DIR_MASK,      STATTRIG_TYPE,  0,      STATSTRIG_EVNAME,   STAT_DIR,           "_trigger",                 NULL,   MATCH_SUBSTRING},
+    {0, STAT_DIR_MASK,      INFOTRIG_TYPE,  0,      STATSTRIG_EVNAME,   STAT_DIR,           "_infoevent",               NULL,   MATCH_SUBSTRING},
+    {0, STAT_DIR_MASK,      ERRORTRIG_TYPE, 0,      STATSTRIG_EVNAME,   STAT_DIR,           "_errorevent",              NULL,   MATCH_SUBSTRING},
+    {0, APLOG_DIR_MASK,     APLOGTRIG_TYPE, 0,      APLOGTRIG_EVNAME,   APLOG_DIR,          "_trigger",                 NULL,   MATCH_SUBSTRING},
+    {0, APLOG_DIR_MASK,     CMDTRIG_TYPE,   0,      CMDTRIG_EVNAME,     APLOG_DIR,          "_cmd",                     NULL,   MATCH_SUBSTRING},
     /* -----------------------------above is dir, below is file------------------------------------------------------------ */
-    {0, RESET_DIR_MASK,     BUILDID_TYPE,   0,      RESET_EVNAME,       LOG_BUILDID,        NULL,                      NULL},
-    {0, UPTIME_MASK,        UPTIME_TYPE,    0,      UPTIME_EVNAME,      UPTIME_FILE,        NULL,                      NULL},
+    {0, RESET_DIR_MASK,     BUILDID_TYPE,   0,      RESET_EVNAME,       LOG_BUILDID,        NULL,                      NULL,   MATCH_SUBSTRING},
+    {0, UPTIME_MASK,        UPTIME_TYPE,    0,      UPTIME_EVNAME,      UPTIME_FILE,        NULL,                      NULL,   MATCH_SUBSTRING},
 };
 
+static inline struct watch_node **watch_bucket(int wd) {
+    return &watch_table[wd & (WATCH_TABLE_SIZE - 1)];
+}
+
+/* Called with watch_lock held */
+static void watch_table_insert(struct watch_node *node) {
+    struct watch_node **link = watch_bucket(node->entry->wd);
+
+    while (*link)
+        link = &(*link)->next;
+    node->next = NULL;
+    *link = node;
+}
+
+/* Called with watch_lock held, returns NULL if the entry is not registered */
+static struct watch_node *watch_table_unlink(struct watch_entry *entry) {
+    struct watch_node **link = watch_bucket(entry->wd), *node;
+
+    for ( ; *link ; link = &(*link)->next) {
+        if ((*link)->entry == entry) {
+            node = *link;
+            *link = node->next;
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/* Called with watch_lock held */
+static struct watch_entry *watch_table_first(int wd) {
+    struct watch_node *node;
+
+    for (node = *watch_bucket(wd) ; node ; node = node->next) {
+        if (node->entry->wd == wd)
+            return node->entry;
+    }
+    return NULL;
+}
+
+/* Called with watch_lock held: moves the entries of a watch to a new one */
+static void watch_table_rewatch(int wd, int newwd) {
+    struct watch_node *moved = NULL, **tail = &moved, *node;
+    struct watch_entry *entry;
+
+    while ((entry = watch_table_first(wd)) != NULL) {
+        node = watch_table_unlink(entry);
+        node->next = NULL;
+        *tail = node;
+        tail = &node->next;
+    }
+    while ((node = moved) != NULL) {
+        moved = node->next;
+        node->entry->wd = newwd;
+        watch_table_insert(node);
+    }
+}
+
+static int watch_node_match(const struct watch_node *node, const char *eventname) {
+    const struct watch_entry *entry = node->entry;
+    size_t len;
+
+    if (!entry->eventpattern)
+        return (eventname == NULL);
+    if (!eventname)
+        return 0;
+
+    switch (entry->matchtype) {
+    case MATCH_PREFIX:
+        return !strncmp(eventname, entry->eventpattern, node->patternlen);
+    case MATCH_SUFFIX:
+        len = strlen(eventname);
+        return (len >= node->patternlen &&
+                !memcmp(eventname + len - node->patternlen, entry->eventpattern, node->patternlen));
+    default:
+        return (strstr(eventname, entry->eventpattern) != NULL);
+    }
+}
+
+/* Called with watch_lock held: the union of the masks of a watch entries */
+static int watch_table_mask(int wd) {
+    struct watch_node *node;
+    int mask = 0;
+
+    for (node = *watch_bucket(wd) ; node ; node = node->next) {
+        if (node->entry->wd == wd)
+            mask |= node->entry->eventmask;
+    }
+    return mask;
+}
+
+/* Called with watch_lock held: registers an entry already watched,
+ * replacing a previous registration */
+static int watch_table_add(struct watch_entry *entry, int wd) {
+    struct watch_node *node;
+
+    node = watch_table_unlink(entry);
+    if (!node && (node = malloc(sizeof(*node))) == NULL) {
+        LOGE(LOG_PREFIX "%s: Cannot register %s\n", __FUNCTION__, entry->eventpath);
+        return -ENOMEM;
+    }
+    node->entry = entry;
+    node->patternlen = entry->eventpattern ? strlen(entry->eventpattern) : 0;
+    entry->wd = wd;
+    watch_table_insert(node);
+    return 0;
+}
+
+/**
+ * @brief Adds a watch on the path of an entry and registers the entry
+ *
+ * The mask of the entry is added to the one of the path if it is already
+ * watched.
+ *
+ * @return the watch descriptor on success, a negative errno value on failure.
+ */
+int inotify_add_entry(int inotify_fd, struct watch_entry *entry) {
+    int wd, res;
+
+    if (!entry || !entry->eventpath)
+        return -EINVAL;
+
+    /* the watch is shared with the entries on the same path */
+    pthread_mutex_lock(&watch_lock);
+    wd = inotify_add_watch(inotify_fd, entry->eventpath, entry->eventmask | IN_MASK_ADD);
+    if (wd < 0) {
+        entry->inotify_error = errno;
+        pthread_mutex_unlock(&watch_lock);
+        LOGE(LOG_PREFIX "Can't add watch for %s - %s.\n",
+             entry->eventpath, strerror(entry->inotify_error));
+        return -entry->inotify_error;
+    }
+    entry->inotify_error = 0;
+    res = watch_table_add(entry, wd);
+    pthread_mutex_unlock(&watch_lock);
+    return res < 0 ? res : wd;
+}
+
+/**
+ * @brief Unregisters an entry, its watch being removed if no other entry
+ * uses it
+ *
+ * @return 0 on success, -ENOENT if the entry is not registered.
+ */
+int inotify_remove_entry(int inotify_fd, struct watch_entry *entry) {
+    struct watch_node *node;
+
+    if (!entry)
+        return -EINVAL;
+
+    pthread_mutex_lock(&watch_lock);
+    if ((node = watch_table_unlink(entry)) == NULL) {
+        pthread_mutex_unlock(&watch_lock);
+        return -ENOENT;
+    }
+    if (watch_table_first(entry->wd) == NULL)
+        inotify_rm_watch(inotify_fd, entry->wd);
+    entry->wd = -1;
+    pthread_mutex_unlock(&watch_lock);
+    free(node);
+    return 0;
+}
+
 int set_watch_entry_callback(unsigned int watch_type, inotify_callback pcallback) {
 
     if ( watch_type >= DIM(wd_array) ) {
@@ -109,15 +322,13 @@ int init_inotify_handler() {
 
     int fd, i;
 
-#ifndef __TEST__
-    fd = inotify_init();
-#else
+    /* Non blocking so the events can be drained until EAGAIN */
     fd = inotify_init1(IN_NONBLOCK);
-#endif
     if (fd < 0) {
         LOGE(LOG_PREFIX "inotify_init failed, %s\n", strerror(errno));
         return -errno;
     }
+    clock_gettime(CLOCK_REALTIME, &last_drain);
 
     for (i = 0; i < (int)DIM(wd_array); i++) {
         int alreadywatched = 0, j;
@@ -133,12 +344,19 @@ int init_inotify_handler() {
             if (!strcmp(wd_array[j].eventpath, wd_array[i].eventpath) ) {
                 alreadywatched = 1;
                 wd_array[i].wd = wd_array[j].wd;
+                wd_array[i].inotify_error = wd_array[j].inotify_error;
                 LOGV(LOG_PREFIX "Don't duplicate watch operation for %s\n", wd_array[i].eventpath);
                 break;
             }
         }
-        if (alreadywatched)
+        if (alreadywatched) {
+            if (wd_array[i].wd >= 0) {
+                pthread_mutex_lock(&watch_lock);
+                watch_table_add(&wd_array[i], wd_array[i].wd);
+                pthread_mutex_unlock(&watch_lock);
+            }
             continue;
+        }
 
         wd_array[i].wd = inotify_add_watch(fd, wd_array[i].eventpath,
                                            wd_array[i].eventmask);
@@ -146,8 +364,12 @@ int init_inotify_handler() {
             wd_array[i].inotify_error = errno;
             LOGE(LOG_PREFIX "Can't add watch for %s - %s.\n",
                  wd_array[i].eventpath, strerror(wd_array[i].inotify_error));
-        } else
+        } else {
             LOGI(LOG_PREFIX "%s, wd=%d has been snooped\n", wd_array[i].eventpath, wd_array[i].wd);
+            pthread_mutex_lock(&watch_lock);
+            watch_table_add(&wd_array[i], wd_array[i].wd);
+            pthread_mutex_unlock(&watch_lock);
+        }
     }
     //add generic watch here
     generic_add_watch(g_first_modem_config, fd);
@@ -251,17 +473,18 @@ void build_crashenv_dir_list_option( char crashenv_param[PATHMAX] ) {
 }
 
 static struct watch_entry *get_event_entry(int wd, char *eventname) {
-    int idx;
-    for (idx = 0 ; idx < (int)DIM(wd_array) ; idx++) {
-        if ( wd_array[idx].wd == wd ) {
-            if ( !eventname && !wd_array[idx].eventpattern )
-                return &wd_array[idx];
-            if ( eventname &&
-                    strstr(eventname, wd_array[idx].eventpattern) )
-                return &wd_array[idx];
+    struct watch_node *node;
+    struct watch_entry *entry = NULL;
+
+    pthread_mutex_lock(&watch_lock);
+    for (node = *watch_bucket(wd) ; node ; node = node->next) {
+        if (node->entry->wd == wd && watch_node_match(node, eventname)) {
+            entry = node->entry;
+            break;
         }
     }
-    return NULL;
+    pthread_mutex_unlock(&watch_lock);
+    return entry;
 }
 
 /**
@@ -272,8 +495,7 @@ static struct watch_entry *get_event_entry(int wd, char *eventname) {
  * @param buffer: buffer containing the inotify events
  * @param len: length of the buffer
  */
-static void dump_inotify_events(char *buffer, unsigned int len,
-    char *lastevent) {
+static void dump_inotify_events(char *buffer, unsigned int len) {
 
     struct inotify_event *event;
     int i;
@@ -283,209 +505,275 @@ static void dump_inotify_events(char *buffer, unsigned int len,
         LOGD("%s: wd_array[%d]: filename=%s, wd=%d\n", __FUNCTION__, i, wd_array[i].eventpath, wd_array[i].wd);
     }
 
-    while (1) {
-        if (len == 0) {
-            /* End of the buffer */
+    /* read() only returns complete events */
+    while (len >= sizeof(struct inotify_event)) {
+        event = (struct inotify_event*)buffer;
+        LOGD("%s: event received (name=%s, wd=%d, mask=0x%x, len=%d)\n", __FUNCTION__,
+            (event->len ? event->name : ""), event->wd, event->mask, event->len);
+        buffer += sizeof(struct inotify_event) + event->len;
+        len -= sizeof(struct inotify_event) + event->len;
+    }
+}
+
+static unsigned int drained_hash(int wd, const char *name) {
+    unsigned int hash = 2166136261U ^ (unsigned int)wd;
+
+    while (*name)
+        hash = (hash ^ (unsigned char)*name++) * 16777619U;
+    return hash;
+}
+
+static void drained_add(struct drained_files *d, int wd, const char *name) {
+    size_t len = strlen(name) + 1;
+    struct drained_file *files;
+    char *names;
+
+    if (d->count == d->size) {
+        files = realloc(d->files, (d->size ? d->size * 2 : 256) * sizeof(*files));
+        if (!files)
+            return;
+        d->files = files;
+        d->size = d->size ? d->size * 2 : 256;
+    }
+    if (d->len + len > d->namesize) {
+        names = realloc(d->names, MAX(d->namesize * 2, d->len + len + 4 * KB));
+        if (!names)
             return;
+        d->names = names;
+        d->namesize = MAX(d->namesize * 2, d->len + len + 4 * KB);
+    }
+    memcpy(d->names + d->len, name, len);
+    d->files[d->count].wd = wd;
+    d->files[d->count].hash = drained_hash(wd, name);
+    d->files[d->count].name = d->len;
+    d->count++;
+    d->len += len;
+}
+
+static int drained_has(const struct drained_files *d, int wd, const char *name,
+        unsigned int hash) {
+    int idx;
+
+    for (idx = 0 ; idx < d->count ; idx++) {
+        if (d->files[idx].hash == hash && d->files[idx].wd == wd &&
+                !strcmp(d->names + d->files[idx].name, name))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Rescans the watched directories after an inotify queue overflow
+ *
+ * The files modified since the previous drain are handled as if their
+ * IN_CLOSE_WRITE event had been received, but the ones already handled by
+ * this drain or the previous one.
+ *
+ * @param since: time of the previous drain
+ */
+static void rescan_watched_dirs(const struct timespec *since) {
+    char buffer[sizeof(struct inotify_event) + NAME_MAX + 1]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event *event = (struct inotify_event *)buffer;
+    struct watch_entry *entry;
+    char path[PATHMAX];
+    struct dirent *de;
+    struct stat st;
+    int idx, j, alreadydone, nbfiles = 0, nbskipped = 0;
+    unsigned int hash;
+    DIR *d;
+
+    for (idx = 0 ; idx < (int)DIM(wd_array) ; idx++) {
+        if (wd_array[idx].wd < 0 || !wd_array[idx].eventpattern)
+            continue; /* Skip unwatched directories and watched files */
+        alreadydone = 0;
+        for (j = 0 ; j < idx ; j++) {
+            if (wd_array[j].wd == wd_array[idx].wd) {
+                alreadydone = 1;
+                break;
+            }
         }
-        event = (struct inotify_event*)buffer;
-        if (len < sizeof(struct inotify_event) ||
-            len < (sizeof(struct inotify_event) + event->len)) {
-            /* Not enought room the last event,
-             * get it from the lastevent */
-            event = (struct inotify_event*)lastevent;
-            if (!event->wd && !event->mask && !event->cookie && !event->len)
-                // no last event
-                return;
-        } else {
-            buffer += sizeof(struct inotify_event) + event->len;
-            len -= sizeof(struct inotify_event) + event->len;
+        if (alreadydone) continue;
+
+        if ((d = opendir(wd_array[idx].eventpath)) == NULL)
+            continue;
+        while ((de = readdir(d)) != NULL) {
+            snprintf(path, sizeof(path), "%s/%s", wd_array[idx].eventpath, de->d_name);
+            if (stat(path, &st) < 0 || !S_ISREG(st.st_mode) ||
+                    st.st_mtim.tv_sec < since->tv_sec ||
+                    (st.st_mtim.tv_sec == since->tv_sec && st.st_mtim.tv_nsec < since->tv_nsec))
+                continue;
+            entry = get_event_entry(wd_array[idx].wd, de->d_name);
+            if (!entry || !entry->pcallback)
+                continue;
+            hash = drained_hash(wd_array[idx].wd, de->d_name);
+            if (drained_has(&drained[0], wd_array[idx].wd, de->d_name, hash) ||
+                    drained_has(&drained[1], wd_array[idx].wd, de->d_name, hash)) {
+                nbskipped++;
+                continue;
+            }
+            event->wd = wd_array[idx].wd;
+            event->mask = IN_CLOSE_WRITE;
+            event->cookie = 0;
+            event->len = strlen(de->d_name) + 1;
+            memcpy(event->name, de->d_name, event->len);
+            collector_submit(entry, event);
+            drained_add(&drained[cur_drained], event->wd, event->name);
+            nbfiles++;
         }
-        LOGD("%s: event received (name=%s, wd=%d, mask=0x%x, len=%d)\n", __FUNCTION__, event->name, event->wd, event->mask, event->len);
+        closedir(d);
     }
+    LOGW("%s: %d files modified since the last drain handled again, %d already handled\n",
+        __FUNCTION__, nbfiles, nbskipped);
 }
 
 /**
- * @brief Handle inotify events
- *
- * Calls the callcbacks
+ * @brief Handle one inotify event
  *
- * @param files nb max of logs destination directories (crashlog,
- * aplogs, bz... )
+ * Calls the callback of the watch entry matching the event
  *
  * @return 0 on success, -1 on error.
  */
-int receive_inotify_events(int inotify_fd) {
-    int len = 0, orig_len, idx, wd, missing_bytes;
-    char orig_buffer[sizeof(struct inotify_event)+PATHMAX], *buffer, lastevent[sizeof(struct inotify_event)+PATHMAX];
-    struct inotify_event *event;
+static int handle_inotify_event(int inotify_fd, struct inotify_event *event) {
+    int wd;
     struct watch_entry *entry = NULL;
 
-    len = read(inotify_fd, orig_buffer, sizeof(orig_buffer));
-    if (len < 0) {
-        LOGE("%s: Cannot read file_monitor_fd, error is %s\n", __FUNCTION__, strerror(errno));
-        return -errno;
-    }
-
-    if (len < sizeof(orig_buffer))
-        orig_buffer[len] = '\0';
-    else
-        orig_buffer[sizeof(orig_buffer)-1] = '\0';
-
-    buffer = &orig_buffer[0];
-    orig_len = len;
-    event = (struct inotify_event *)buffer;
-
-    /* Preinitialize lastevent (in case it was not used so it is not dumped) */
-    ((struct inotify_event *)lastevent)->wd = 0;
-    ((struct inotify_event *)lastevent)->mask = 0;
-    ((struct inotify_event *)lastevent)->cookie = 0;
-    ((struct inotify_event *)lastevent)->len = 0;
+    /* Handle the event read from the buffer*/
+    /* First check the kind of the subject of this event (file or directory?),
+     * the events on a watched directory itself have no IN_ISDIR */
+    if (!(event->mask & (IN_ISDIR | IN_DELETE_SELF | IN_MOVE_SELF))) {
+        /* event concerns a file into a watched directory */
+        entry = get_event_entry(event->wd, (event->len ? event->name : NULL));
+        if ( !entry ) {
+            const char *expression;
+            if (!event->len) {
+                expression = "empty event";
+            } else if ((expression = strrchr(event->name, '.')) != NULL
+                    && strncmp(expression, ".tmp", 5) == 0) {
+                return 0;
+            } else {
+                expression = event->name;
+            }
 
-    while (1) {
-        if (len == 0) {
-            /* End of the events to read */
+            /* Stray event... */
+            LOGD("%s: Can't handle the event \"%s\", no valid entry found, drop it...\n",
+                __FUNCTION__, expression);
             return 0;
         }
-        if ((unsigned int)len < sizeof(struct inotify_event)) {
-            /* Not enough room for an empty event */
-            LOGI("%s: incomplete inotify_event received (%d bytes), complete it\n", __FUNCTION__, len);
-            /* copy the last bytes received */
-            if( (unsigned int)len <= sizeof(lastevent) )
-                memcpy(lastevent, buffer, len);
-            else {
-                LOGE("%s: Cannot copy buffer\n", __FUNCTION__);
-                return -1;
-            }
-            /* read the missing bytes to get the full length */
-            missing_bytes = (int)sizeof(struct inotify_event)-len;
-            if(((int) len + missing_bytes) < ((int)sizeof(lastevent))) {
-                if (read(inotify_fd, &lastevent[len], missing_bytes) != missing_bytes ){
-                    LOGE("%s: Cannot complete the last inotify_event received (structure part) - %s\n", __FUNCTION__, strerror(errno));
+    }
+    /*event concerns a watched directory itself */
+    else {
+        /* Manage case where a watched directory is deleted*/
+        if ( event->mask & (IN_DELETE_SELF | IN_MOVE_SELF) ) {
+            /* Recreate the dir and reinstall the watch, with the masks of
+             * all its entries */
+            pthread_mutex_lock(&watch_lock);
+            entry = watch_table_first(event->wd);
+            if ( entry && entry->eventpath ) {
+                int ret = mkdir(entry->eventpath, 0777); /* TO DO : restoring previous rights/owner/group ?*/
+                if (ret < 0) {
+                    pthread_mutex_unlock(&watch_lock);
                     return -1;
                 }
+                inotify_rm_watch(inotify_fd, event->wd);
+                wd = inotify_add_watch(inotify_fd, entry->eventpath, watch_table_mask(event->wd));
+                if ( wd < 0 ) {
+                    pthread_mutex_unlock(&watch_lock);
+                    LOGE("Can't add watch for %s.\n", entry->eventpath);
+                    return -1;
+                }
+                LOGW("%s: watched directory %s : \'%s\' has been created and snooped",__FUNCTION__,
+                        (event->mask & (IN_DELETE_SELF) ? "deleted" : "moved"), entry->eventpath);
+                /* if the watch was duplicated, set it for all the entries */
+                watch_table_rewatch(event->wd, wd);
             }
-            else {
-                LOGE("%s: Cannot read missing bytes, not enought space in lastevent\n", __FUNCTION__);
-                return -1;
-            }
-            event = (struct inotify_event*)lastevent;
-            /* now, reads the full last event, including its name field */
-            if ( read(inotify_fd, &lastevent[sizeof(struct inotify_event)],
-                event->len) != (int)event->len) {
-                LOGE("%s: Cannot complete the last inotify_event received (name part) - %s\n",
-                    __FUNCTION__, strerror(errno));
-                return -1;
-            }
-            len = 0;
-            /* now, the last event is complete, we can continue the parsing */
-        } else if ( (unsigned int)len < sizeof(struct inotify_event) + event->len ) {
-            int res, missing_bytes = (int)sizeof(struct inotify_event) + event->len - len;
-            event = (struct inotify_event*)lastevent;
-            /* The event was truncated */
-            LOGI("%s: truncated inotify_event received (%d bytes missing), complete it\n", __FUNCTION__, missing_bytes);
-
-            /* Robustness : check 'lastevent' array size before reading inotify fd*/
-            if( (unsigned int)len > sizeof(lastevent) ) {
-                LOGE("%s: not enough space on array lastevent.\n", __FUNCTION__);
-                return -1;
-            }
-            /* copy the last bytes received */
-            memcpy(lastevent, buffer, len);
-            /* now, reads the full last event, including its name field */
-            res = read(inotify_fd, &lastevent[len], missing_bytes);
-            if ( res != missing_bytes ) {
-                LOGE("%s: Cannot complete the last inotify_event received (name part2); received %d bytes, expected %d bytes - %s\n",
-                    __FUNCTION__, res, missing_bytes, strerror(errno));
-                return -1;
-            }
-            len = 0;
-            /* now, the last event is complete, we can continue the parsing */
-        } else {
-            event = (struct inotify_event *)buffer;
-            buffer += sizeof(struct inotify_event) + event->len;
-            len -= sizeof(struct inotify_event) + event->len;
+            pthread_mutex_unlock(&watch_lock);
         }
-        /* Handle the event read from the buffer*/
-        /* First check the kind of the subject of this event (file or directory?) */
-        if (!(event->mask & IN_ISDIR)) {
-            /* event concerns a file into a watched directory */
-            entry = get_event_entry(event->wd, (event->len ? event->name : NULL));
-            if ( !entry ) {
-                /* Didn't find any entry for this event, check for
-                 * a dropbox final event... */
-                if (event->len > 8 && !strncmp(event->name, "dropbox-", 8)) {
-                    /* dumpstate is done so remove the watcher */
-                    LOGD("%s: Received a dropbox event(%s)...",
-                        __FUNCTION__, event->name);
-                    inotify_rm_watch(inotify_fd, event->wd);
-                    finalize_dropbox_pending_event(event);
-                    continue;
-                }
-
-                const char *expression;
-                if (!event->len) {
-                    expression = "empty event";
-                } else if ((expression = strrchr(event->name, '.')) != NULL
-                        && strncmp(expression, ".tmp", 5) == 0) {
-                    continue;
-                } else {
-                    expression = event->name;
-                }
+        /* Do nothing more on directory events */
+        return 0;
+    }
+    if (!entry->pcallback)
+        return 0;
+    if (event->len)
+        drained_add(&drained[cur_drained], event->wd, event->name);
+    if (collector_submit(entry, event) < 0) {
+        LOGE("%s: Can't handle the event %s...\n", __FUNCTION__,
+            event->name);
+        return -1;
+    }
+    return 0;
+}
 
-                /* Stray event... */
-                LOGD("%s: Can't handle the event \"%s\", no valid entry found, drop it...\n",
-                    __FUNCTION__, expression);
+/**
+ * @brief Handle inotify events
+ *
+ * Drains the inotify fd: the events are read in batches of up to
+ * INOTIFY_BUFFER_SIZE bytes until the fd would block, and the callback of
+ * each event is called.
+ *
+ * @return 0 on success, -EAGAIN if no event was read, -1 on error.
+ */
+int receive_inotify_events(int inotify_fd) {
+    int len, res = 0, nbreads = 0, nbevents = 0, overflow = 0;
+    char *buffer;
+    struct inotify_event *event;
+    struct timespec since = last_drain;
+
+    clock_gettime(CLOCK_REALTIME, &last_drain);
+    /* the files of the drain before the previous one are older than since */
+    cur_drained ^= 1;
+    drained[cur_drained].count = 0;
+    drained[cur_drained].len = 0;
+    for (;;) {
+        len = read(inotify_fd, inotify_buffer, sizeof(inotify_buffer));
+        if (len < 0) {
+            if (errno == EINTR)
                 continue;
+            if (errno != EAGAIN) {
+                LOGE("%s: Cannot read file_monitor_fd, error is %s\n", __FUNCTION__, strerror(errno));
+                res = -errno;
             }
+            break;
         }
-        /*event concerns a watched directory itself */
-        else {
-            entry = NULL;
-            /* Manage case where a watched directory is deleted*/
-            if ( event->mask & (IN_DELETE_SELF | IN_MOVE_SELF) ) {
-                /* Recreate the dir and reinstall the watch */
-                for (idx = 0 ; idx < (int)DIM(wd_array) ; idx++) {
-                    if ( wd_array[idx].wd == event->wd )
-                        entry = &wd_array[idx];
-                }
-                if ( entry && entry->eventpath ) {
-                    int ret = mkdir(entry->eventpath, 0777); /* TO DO : restoring previous rights/owner/group ?*/
-                    if (ret < 0) return -1;
-                    inotify_rm_watch(inotify_fd, event->wd);
-                    wd = inotify_add_watch(inotify_fd, entry->eventpath, entry->eventmask);
-                    if ( wd < 0 ) {
-                        LOGE("Can't add watch for %s.\n", entry->eventpath);
-                        return -1;
-                    }
-                    LOGW("%s: watched directory %s : \'%s\' has been created and snooped",__FUNCTION__,
-                            (event->mask & (IN_DELETE_SELF) ? "deleted" : "moved"), entry->eventpath);
-                    /* if the watch was duplicated, set it for all the entries */
-                    for (idx = 0 ; idx < (int)DIM(wd_array) ; idx++) {
-                        if (wd_array[idx].wd == event->wd)
-                            wd_array[idx].wd = wd;
-                    }
-                    /* Do nothing more on directory events */
-                    continue;
-                }
-            }
-            else {
-                for (idx = 0 ; idx < (int)DIM(wd_array) ; idx++) {
-                    if ( wd_array[idx].wd != event->wd )
-                        continue;
-                    entry = &wd_array[idx];
-                }
-                /* Do nothing more on directory events */
+        if (len == 0)
+            break;
+        nbreads++;
+
+        for (buffer = inotify_buffer ; buffer < inotify_buffer + len ;
+                buffer += sizeof(struct inotify_event) + event->len) {
+            event = (struct inotify_event *)buffer;
+            nbevents++;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = 1;
                 continue;
             }
-        }
-        if ( entry && entry->pcallback && entry->pcallback(entry, event) < 0 ) {
-            LOGE("%s: Can't handle the event %s...\n", __FUNCTION__,
-                event->name);
-            dump_inotify_events(orig_buffer, orig_len, lastevent);
-            return -1;
+            if (handle_inotify_event(inotify_fd, event) < 0) {
+                dump_inotify_events(inotify_buffer, len);
+                res = -1;
+            }
         }
     }
 
-    return 0;
+    if (!nbreads)
+        return (res ? res : -EAGAIN);
+
+    stats.batches++;
+    stats.reads += nbreads;
+    stats.events += nbevents;
+    if ((unsigned int)nbevents > stats.max_batch)
+        stats.max_batch = nbevents;
+    LOGD("%s: %d events in %d reads\n", __FUNCTION__, nbevents, nbreads);
+
+    if (overflow) {
+        /* Events were lost by the kernel */
+        stats.overflows++;
+        LOGE("%s: inotify queue overflow, rescan the watched directories\n", __FUNCTION__);
+        rescan_watched_dirs(&since);
+    }
+    return res;
+}
+
+void get_inotify_stats(struct inotify_stats *out) {
+    if (out)
+        *out = stats;
 }
@@ -24,9 +24,10 @@
  * The watcher initialization is performed with a local array containing every
  * kind of watched events. Each event is linked to a directory to be watched and linked
  * to a specific callback processing function.
- * Each time the inotify watcher file descriptor is set, the buffer is read to
- * treat each event it contains. When an event can't be processed normally the
- * buffer content not yet read is dumped and flushed to LOG.
+ * Each time the inotify watcher file descriptor is set, it is drained in
+ * batches to treat each event it contains. When an event can't be processed
+ * normally the batch content is dumped and flushed to LOG. On a queue overflow,
+ * the watched directories are rescanned.
  *
  */
 
@@ -49,6 +50,13 @@
 
 struct watch_entry;
 
+/* How the pattern of an entry is matched against the event file name */
+enum watch_match {
+    MATCH_SUBSTRING = 0,
+    MATCH_PREFIX,
+    MATCH_SUFFIX,
+};
+
 /* The callback API is:
  * returns a negative value if any error occurred
  * returns 0 if the event was not handled
@@ -66,6 +74,15 @@ struct watch_entry {
     char *eventpath;
     char *eventpattern;
     inotify_callback pcallback;
+    enum watch_match matchtype;
+};
+
+struct inotify_stats {
+    unsigned long batches;      /* receive_inotify_events calls reading events */
+    unsigned long reads;
+    unsigned long events;
+    unsigned int max_batch;     /* most events read in one batch */
+    unsigned long overflows;    /* IN_Q_OVERFLOW received */
 };
 
 int init_inotify_handler();
@@ -73,6 +90,9 @@ void handle_missing_watched_dir();
 int get_missing_watched_dir_nb();
 void build_crashenv_dir_list_option( char crashenv_param[PATHMAX] );
 int set_watch_entry_callback(unsigned int watch_type, inotify_callback pcallback);
+int inotify_add_entry(int inotify_fd, struct watch_entry *entry);
+int inotify_remove_entry(int inotify_fd, struct watch_entry *entry);
 int receive_inotify_events(int inotify_fd);
+void get_inotify_stats(struct inotify_stats *stats);
 
 #endif /* __INOTIFY_HANDLER_H__ */
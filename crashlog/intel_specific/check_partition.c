@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #ifdef CONFIG_PARTITIONS_CHECK
 int partition_notified = 1;
@@ -136,12 +137,17 @@ void check_factory_partition_checksum() {
     }
 
     LOGD("%s: performing factory partition checksum calculation\n", __FUNCTION__);
-    if (calculate_checksum_directory(FACTORY_PARTITION_DIR, checksum,
-            check_factory_checksum_callback, (const char**)checksum_ex_paths) != 0) {
+    if (calculate_checksum_tree(FACTORY_PARTITION_DIR, checksum,
+            check_factory_checksum_callback, (const char**)checksum_ex_paths, 0) != 0) {
         LOGE("%s: failed to calculate factory partition checksum\n", __FUNCTION__);
         return;
     }
 
+    /* the sum of the previous releases is computed differently, it is
+     * replaced without raising an event */
+    if (file_exists(FACTORY_OLD_SUM_FILE) && unlink(FACTORY_OLD_SUM_FILE) < 0)
+        LOGE("%s: cannot remove %s - %s\n", __FUNCTION__, FACTORY_OLD_SUM_FILE, strerror(errno));
+
     if (file_exists(FACTORY_SUM_FILE)) {
         unsigned char old_checksum[CRASHLOG_CHECKSUM_SIZE+1];
         if (read_binary_file(FACTORY_SUM_FILE, old_checksum, CRASHLOG_CHECKSUM_SIZE) < 0) {
@@ -150,9 +156,10 @@ void check_factory_partition_checksum() {
 
         if (memcmp(checksum, old_checksum, CRASHLOG_CHECKSUM_SIZE) != 0) {
             /* send event that something has changed */
-            char *key = generate_event_id(INFOEVENT, "FACTORY_SUM");
+            char key[EVENT_ID_SIZE];
+
+            compute_event_id(key, INFOEVENT, "FACTORY_SUM");
             raise_event(key, INFOEVENT, "FACTORY_SUM", NULL, NULL);
-            free(key);
             if (write_binary_file(FACTORY_SUM_FILE, checksum, CRASHLOG_CHECKSUM_SIZE) < 0) {
                 LOGE("%s: failed in writing checksum to file: %s\n", __FUNCTION__, FACTORY_SUM_FILE);
                 return;
@@ -171,6 +178,24 @@ void check_factory_partition_checksum() {
         LOGD("%s: %s file created\n", __FUNCTION__, FACTORY_SUM_FILE);
     }
 }
+
+static void *factory_checksum_thread(void __attribute__((unused)) *arg) {
+    check_factory_partition_checksum();
+    return NULL;
+}
+
+void start_factory_partition_checksum() {
+    pthread_t thread;
+    int res;
+
+    res = pthread_create(&thread, NULL, factory_checksum_thread, NULL);
+    if (res) {
+        LOGE("%s: Cannot create the checksum thread - %s\n", __FUNCTION__, strerror(res));
+        check_factory_partition_checksum();
+        return;
+    }
+    pthread_detach(thread);
+}
 #endif
 
 
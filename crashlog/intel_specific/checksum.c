@@ -25,12 +25,35 @@
 
 #include <ftw.h>
 #include <fcntl.h>
+#include <stdlib.h>
+
+#define CHECKSUM_READ_SIZE      (64*KB)
+#define CHECKSUM_MAX_THREADS    4
 
 /* used by calculate_checksum_directory! */
 static SHA_CTX g_sha1_context_dir_sum;
 static calculate_checksum_callback callback_dir = NULL;
 static const char **file_exceptions = NULL;
 
+struct checksum_entry {
+    char *path;
+    mode_t mode;
+    int skipped;        /* tagged as a file but not a regular one */
+    int hashed;         /* the digest of the content is combined */
+    unsigned char digest[CRASHLOG_CHECKSUM_SIZE];
+};
+
+struct checksum_tree {
+    struct checksum_entry *entries;
+    unsigned int count;
+    unsigned int size;
+    unsigned int next;  /* next entry to hash, shared by the workers */
+    int error;
+};
+
+/* used by calculate_checksum_tree to collect the paths */
+static struct checksum_tree *g_collected_tree = NULL;
+
 int calculate_checksum_buffer(const char *buffer, ssize_t buffer_size, unsigned char *result) {
     ssize_t nread;
     unsigned char *l_buffer = (unsigned char *)buffer;
@@ -76,8 +99,10 @@ int calculate_checksum_file(const char *filename, unsigned char *result) {
 
     while ((nread = do_read(fd, buffer, CRASHLOG_CHECKSUM_SIZE)) != 0) {
 
-        if (nread < 0)
+        if (nread < 0) {
+            close(fd);
             return -errno;
+        }
 
         SHA1_Update(&sha1_context, buffer, nread);
 
@@ -85,6 +110,7 @@ int calculate_checksum_file(const char *filename, unsigned char *result) {
             break;
     }
 
+    close(fd);
     SHA1_Final(result, &sha1_context);
 
     return 0;
@@ -106,8 +132,10 @@ static int calculate_checksum_file_feed(const char *filename) {
 
     while ((nread = do_read(fd, buffer, CRASHLOG_CHECKSUM_SIZE)) != 0) {
 
-        if (nread < 0)
+        if (nread < 0) {
+            close(fd);
             return -errno;
+        }
 
         SHA1_Update(&g_sha1_context_dir_sum, buffer, nread);
 
@@ -115,6 +143,7 @@ static int calculate_checksum_file_feed(const char *filename) {
             break;
     }
 
+    close(fd);
     return 0;
 }
 
@@ -195,3 +224,150 @@ int calculate_checksum_directory(const char *path, unsigned char *result,
 
     return 0;
 }
+
+static int collect_checksum_path(const char *fpath,
+                                 const struct stat *sb,
+                                 int tflag,
+                                 struct FTW __attribute__((__unused__)) *ftwbuf) {
+    struct checksum_tree *tree = g_collected_tree;
+    struct checksum_entry *entry;
+
+    if (tree->count == tree->size) {
+        unsigned int size = tree->size ? 2 * tree->size : 64;
+        struct checksum_entry *entries = realloc(tree->entries, size * sizeof(*entries));
+
+        if (!entries) {
+            tree->error = -ENOMEM;
+            return -1;
+        }
+        tree->entries = entries;
+        tree->size = size;
+    }
+    entry = &tree->entries[tree->count];
+    memset(entry, 0, sizeof(*entry));
+    if ((entry->path = strdup(fpath)) == NULL) {
+        tree->error = -ENOMEM;
+        return -1;
+    }
+    tree->count++;
+
+    /* same selection as calculate_checksum_path */
+    if (tflag == FTW_F) {
+        entry->mode = sb->st_mode;
+        if ((sb->st_mode & S_IFMT) == S_IFREG)
+            entry->hashed = (file_exceptions == NULL || !priv_filter_path(fpath, file_exceptions));
+        else
+            entry->skipped = 1;
+    }
+    return 0;
+}
+
+static int compare_checksum_entries(const void *entry1, const void *entry2) {
+    return strcmp(((const struct checksum_entry *)entry1)->path,
+        ((const struct checksum_entry *)entry2)->path);
+}
+
+static int hash_file(const char *path, unsigned char *buffer, unsigned char *result) {
+    SHA_CTX sha1_context;
+    ssize_t nread;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    SHA1_Init(&sha1_context);
+    while ((nread = do_read(fd, buffer, CHECKSUM_READ_SIZE)) > 0)
+        SHA1_Update(&sha1_context, buffer, nread);
+    close(fd);
+    if (nread < 0)
+        return -errno;
+
+    SHA1_Final(result, &sha1_context);
+    return 0;
+}
+
+static void *checksum_worker(void *arg) {
+    struct checksum_tree *tree = arg;
+    unsigned char buffer[CHECKSUM_READ_SIZE];
+    struct checksum_entry *entry;
+    unsigned int idx;
+
+    while ((idx = __sync_fetch_and_add(&tree->next, 1)) < tree->count) {
+        entry = &tree->entries[idx];
+        /* as the serial sum, an unreadable file only counts by its path */
+        if (entry->hashed && hash_file(entry->path, buffer, entry->digest) < 0)
+            entry->hashed = 0;
+    }
+    return NULL;
+}
+
+static unsigned int checksum_threads(unsigned int nbthreads) {
+    long cpus;
+
+    if (nbthreads)
+        return nbthreads;
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    return cpus < CHECKSUM_MAX_THREADS ? (unsigned int)cpus : CHECKSUM_MAX_THREADS;
+}
+
+int calculate_checksum_tree(const char *path, unsigned char *result,
+        calculate_checksum_callback callback, const char *path_exceptions[],
+        unsigned int nbthreads) {
+    /* mutex used to protect g_collected_tree and file_exceptions */
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_t threads[CHECKSUM_MAX_THREADS];
+    struct checksum_tree tree;
+    struct checksum_entry *entry;
+    unsigned int idx, nbstarted = 0;
+    SHA_CTX sha1_context;
+    int res = 0;
+
+    if (!path || !result)
+        return -EINVAL;
+
+    memset(&tree, 0, sizeof(tree));
+    pthread_mutex_lock(&lock);
+    g_collected_tree = &tree;
+    file_exceptions = path_exceptions;
+    if (nftw(path, collect_checksum_path, CRASHLOG_CHECKSUM_SIZE, 0) == -1)
+        res = tree.error ? tree.error : -1;
+    g_collected_tree = NULL;
+    pthread_mutex_unlock(&lock);
+    if (res)
+        goto out;
+
+    /* the digests are combined in the order of the paths */
+    qsort(tree.entries, tree.count, sizeof(*tree.entries), compare_checksum_entries);
+
+    nbthreads = checksum_threads(nbthreads);
+    if (nbthreads > CHECKSUM_MAX_THREADS)
+        nbthreads = CHECKSUM_MAX_THREADS;
+    for (idx = 1 ; idx < nbthreads ; idx++) {
+        if (pthread_create(&threads[nbstarted], NULL, checksum_worker, &tree))
+            break;
+        nbstarted++;
+    }
+    checksum_worker(&tree);
+    for (idx = 0 ; idx < nbstarted ; idx++)
+        pthread_join(threads[idx], NULL);
+
+    SHA1_Init(&sha1_context);
+    for (idx = 0 ; idx < tree.count ; idx++) {
+        entry = &tree.entries[idx];
+        if (entry->skipped && callback)
+            callback(entry->path, entry->mode & S_IFMT);
+        SHA1_Update(&sha1_context, entry->path, strlen(entry->path) + 1);
+        if (entry->hashed)
+            SHA1_Update(&sha1_context, entry->digest, sizeof(entry->digest));
+    }
+    SHA1_Final(result, &sha1_context);
+
+out:
+    for (idx = 0 ; idx < tree.count ; idx++)
+        free(tree.entries[idx].path);
+    free(tree.entries);
+    return res;
+}
@@ -53,6 +53,30 @@ int calculate_checksum_buffer(const char *buffer, ssize_t size, unsigned char *r
 int calculate_checksum_directory(const char *path, unsigned char *result,
         calculate_checksum_callback callback, const char *exceptions[]);
 
+/**
+ * Computes a checksum on a directory passed as parameter, hashing its files
+ * concurrently
+ *
+ * The paths of the directory are collected and sorted first, then the files
+ * are hashed by a pool of threads. The checksum combines, in the order of
+ * the paths, each path and the checksum of each file content, so it does
+ * not depend on the order of the directory entries nor on the number of
+ * threads. It differs from the checksum of calculate_checksum_directory.
+ *
+ * @param path indicates the parent directory for which we want to compute the checksum
+ * @param result represents the buffer through which the computed checksum is returned
+ * @param callback function invoked when encountering a file for which checksum is not
+ *        performed on the content of a file. Parameters passed through the callback
+ *        represent the file and reason for why it was skipped.
+ * @param exceptions points to a NULL terminated array of file paths on which checksum
+          will not be performed.
+ * @param nbthreads number of threads hashing the files, 0 for one per CPU
+ * @return 0 on succes, -1 or -errno otherwise
+ */
+int calculate_checksum_tree(const char *path, unsigned char *result,
+        calculate_checksum_callback callback, const char *exceptions[],
+        unsigned int nbthreads);
+
 /**
  * Computes a checksum on a file passed as parameter
  *
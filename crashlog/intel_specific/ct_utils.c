@@ -205,7 +205,7 @@ void process_msg(struct ct_event *ev)
     char name_event[20];
     e_dir_mode_t mode;
     char *dir;
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     /* Temporary implementation: Crashlog handles Kernel CRASH events
      * as if they were Kernel ERROR events
@@ -240,14 +240,13 @@ void process_msg(struct ct_event *ev)
     /* Convert lower-case name into upper-case name */
     convert_name_to_upper_case(name);
 
-    key = generate_event_id(name_event, name);
+    compute_event_id(key, name_event, name);
     dir = generate_crashlog_dir(mode, key);
     if (!dir) {
         LOGE("%s: Cannot get a valid new crash directory...\n", __FUNCTION__);
         raise_event(key, name_event, name, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", name_event, key,
                 get_current_time_long(0), name);
-        free(key);
         return;
     }
 
@@ -277,7 +276,6 @@ void process_msg(struct ct_event *ev)
     raise_event(key, name_event, name, NULL, dir);
     LOGE("%-8s%-22s%-20s%s %s\n", name_event, key,
             get_current_time_long(0), name, dir);
-    free(key);
     free(dir);
 }
 
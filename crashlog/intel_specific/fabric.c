@@ -81,13 +81,13 @@ int crashlog_check_fabric(char *reason, int test) {
     char event_name[10] = CRASHEVENT;
     char *dir;
     unsigned int i = 0;
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     if ( !test && !file_exists(CURRENT_PROC_FABRIC_ERROR_NAME) ) return 1;
 
     destination[0] = '\0';
 
-    key = generate_event_id(event_name, crashtype);
+    compute_event_id(key, event_name, crashtype);
     dir = generate_crashlog_dir(MODE_CRASH, key);
 
     if (!dir) {
@@ -140,7 +140,6 @@ int crashlog_check_fabric(char *reason, int test) {
         do_last_kmsg_copy(dir);
         raise_event(key, event_name, crashtype, NULL, dir);
         LOGE("%-8s%-22s%-20s%s %s\n", event_name, key, get_current_time_long(0), crashtype, dir);
-        free(key);
         free(dir);
         /* Raise an aplog event to get some logs */
         if ( process_log_event(NULL, NULL, MODE_APLOGS) < 0 )
@@ -149,7 +148,6 @@ int crashlog_check_fabric(char *reason, int test) {
     } else {
         raise_event(key, event_name, crashtype, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", event_name, key, get_current_time_long(0), crashtype);
-        free(key);
         /* Remove temporary file */
         remove(LOG_FABRICTEMP);
         return 0;
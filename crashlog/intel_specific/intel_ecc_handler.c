@@ -451,7 +451,7 @@ int dump_dmesg(const char *filepath) {
 
 int ecc_event_handle(int type, struct ecc_watch_info *entry){
     int ret = 0;
-    char *key = NULL;
+    char key[EVENT_ID_SIZE];
     char *dir = NULL;
     char path[PATHMAX];
     char destion[PATHMAX];
@@ -463,12 +463,12 @@ int ecc_event_handle(int type, struct ecc_watch_info *entry){
 		return -1;
 
 	if(type == ECC_CE) {
-		key = generate_event_id("ECC", "CE");
+		compute_event_id(key, "ECC", "CE");
 		strcpy(count_file, "dimm_ce_count");
 		strcpy(ecc_type, "ECC_CE");
 	}
 	else if(type == ECC_UE) {
-		key = generate_event_id("ECC", "UE");
+		compute_event_id(key, "ECC", "UE");
 		strcpy(count_file, "dimm_ue_count");
 		strcpy(ecc_type, "ECC_UE");
 	}
@@ -502,7 +502,6 @@ int ecc_event_handle(int type, struct ecc_watch_info *entry){
     LOGE("%-8s%-22s%-20s%s %s\n", "ECC", key, get_current_time_long(0),
             ecc_type, dir);
     free(dir);
-    free(key);
 
 	return ret;
 }
@@ -510,7 +510,8 @@ static void get_modem_version(unsigned int instance, char *version, unsigned int
 int mmgr_handle(unsigned int mdm_inst) {
     e_dir_mode_t event_mode = MODE_CRASH;
     char *dir;
-    char *event_dir, *key;
+    char key[EVENT_ID_SIZE];
+    char *event_dir;
     char event_name[MMGRMAXSTRING];
     char data[NB_DATA][MMGRMAXEXTRA];
     char modem_version[MMGRMAXEXTRA];
@@ -605,13 +606,12 @@ int mmgr_handle(unsigned int mdm_inst) {
     }
     get_modem_version(mdm_inst, modem_version, MMGRMAXEXTRA);
 
-    key = generate_event_id(CRASHEVENT, event_name);
+    compute_event_id(key, CRASHEVENT, event_name);
     dir = generate_crashlog_dir(event_mode, key);
     if (!dir) {
         LOGE("%s: Cannot get a valid new crash directory...\n", __FUNCTION__);
         raise_event(key, CRASHEVENT, event_name, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), event_name);
-        free(key);
         return -1;
     }
 
@@ -619,10 +619,10 @@ int mmgr_handle(unsigned int mdm_inst) {
     event_dir = (event_mode == MODE_STATS ? STATS_DIR : CRASH_DIR);
 
     if (copy_aplog > 0) {
-        do_logs_copy(APLOG_TYPE, 0, dir, filename_tag, copy_aplog);
+        do_logs_copy(APLOG_TYPE, 0, dir, filename_tag, copy_aplog, 0);
     }
     if (copy_bplog > 0) {
-        do_logs_copy(BPLOG_TYPE, mdm_inst, dir, filename_tag, copy_bplog);
+        do_logs_copy(BPLOG_TYPE, mdm_inst, dir, filename_tag, copy_bplog, 0);
     }
     // copying files (if required)
     do_mv_in_dir(cd_path, dir);
@@ -664,7 +664,6 @@ int mmgr_handle(unsigned int mdm_inst) {
     }
     raise_event(key, event_name, type, NULL, dir);
     LOGE("%-8s%-22s%-20s%s %s\n", event_name, key, get_current_time_long(0), type, dir);
-    free(key);
     free(dir);
     return 0;
 }
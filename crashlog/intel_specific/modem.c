@@ -79,7 +79,7 @@ static int copy_modemcoredump(char *spath, char *dpath) {
 int crashlog_check_mpanic_abort(){
     char destion[PATHMAX];
     char *dir;
-    char *key;
+    char key[EVENT_ID_SIZE];
     const char *dateshort;
     char filename_tag[PATHMAX];
     char bplogs_copied = 0;
@@ -93,13 +93,12 @@ int crashlog_check_mpanic_abort(){
     }
 
     if (mdm_inst >= 0) {
-        key = generate_event_id(CRASHEVENT, MDMCRASH_EVNAME);
+        compute_event_id(key, CRASHEVENT, MDMCRASH_EVNAME);
         dir = generate_crashlog_dir(MODE_CRASH, key);
         if (!dir) {
             LOGE("%s: generate_crashlog_dir failed\n", __FUNCTION__);
             raise_event(key, CRASHEVENT, MDMCRASH_EVNAME, NULL, NULL);
             LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), MDMCRASH_EVNAME);
-            free(key);
             return -1;
         }
 
@@ -111,7 +110,7 @@ int crashlog_check_mpanic_abort(){
             if (file_exists(destion)) {
                 if ((cfg_collection_mode_modem() != COLLECT_BPLOG_CRASHING_ALL) ||
                     !bplogs_copied)
-                    do_logs_copy(BPLOG_TYPE_OLD, mdm_inst, dir, filename_tag, MAXFILESIZE);
+                    do_logs_copy(BPLOG_TYPE_OLD, mdm_inst, dir, filename_tag, MAXFILESIZE, 0);
                 remove(destion);
                 bplogs_copied = 1;
             }
@@ -134,7 +133,6 @@ int crashlog_check_mpanic_abort(){
         raise_event(key, CRASHEVENT, MDMCRASH_EVNAME, NULL, dir);
         LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key,
                 get_current_time_long(0), MDMCRASH_EVNAME, dir);
-        free(key);
         free(dir);
     }
     return 0;
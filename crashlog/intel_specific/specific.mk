@@ -64,6 +64,10 @@ LOCAL_SRC_FILES += $(SPECIFIC_PATH)/checksum.c \
 	$(SPECIFIC_PATH)/check_partition.c
 endif
 
+ifeq ($(CRASHLOGD_FACTORY_CHECKSUM_DEFERRED),true)
+LOCAL_CFLAGS += -DCONFIG_FACTORY_CHECKSUM_DEFERRED
+endif
+
 #firmware
 ifeq ($(CRASHLOGD_MODULE_FW_UPDATE),true)
 LOCAL_CFLAGS += -DCRASHLOGD_MODULE_FW_UPDATE
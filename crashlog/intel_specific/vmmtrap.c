@@ -24,6 +24,7 @@
 #include "privconfig.h"
 #include "fsutils.h"
 #include "utils.h"
+#include "notifier.h"
 #include "config_handler.h"
 
 #include <fcntl.h>
@@ -49,7 +50,8 @@ static char coredump_dir_path[PATHMAX];
 
 #ifdef CONFIG_SOFIA
 static bool memorize_trap_info = FALSE;
-static char *vmm_crashfolder = NULL, *vmm_key = NULL;
+static char *vmm_crashfolder = NULL;
+static char vmm_key[EVENT_ID_SIZE];
 static int vmm_index = -1;
 #define INDEX_SIZE  4
 #endif
@@ -162,18 +164,19 @@ static void handle_istp_file(bool copy_istp, const char *dir, const char *cd_pat
 #ifdef CONFIG_SOFIA_LEGACY
 static void generate_event_by_type(char *type, const char *cd_path,
         const char *name, bool copy_file, bool copy_istp) {
-    char *dir, *key, *event ;
+    char key[EVENT_ID_SIZE];
+    char *dir, *event ;
     char des[PATHMAX];
 
     //we should generate only one crash per boot
     if (!crash_generated) {
         event = CRASHEVENT;
-        key = generate_event_id(event, type);
+        compute_event_id(key, event, type);
         dir = generate_crashlog_dir(MODE_CRASH, key);
         crash_generated = TRUE;
     } else {
         event = ERROREVENT;
-        key = generate_event_id(event, type);
+        compute_event_id(key, event, type);
         dir = generate_crashlog_dir(MODE_STATS, key);
     }
 
@@ -195,14 +198,14 @@ static void generate_event_by_type(char *type, const char *cd_path,
          name, (dir != NULL) ? dir : "");
 
     free(dir);
-    free(key);
 }
 
 #else // CONFIG_SOFIA
 
 static void generate_event_by_type(char *type, const char *cd_path,
         const char *name, bool copy_file, bool copy_istp, int index_trap) {
-    char *dir, *key, *event ;
+    char key[EVENT_ID_SIZE];
+    char *dir, *event ;
     char des[PATHMAX];
     bool filter_event = FALSE;
 
@@ -213,12 +216,12 @@ static void generate_event_by_type(char *type, const char *cd_path,
     } else if (!crash_generated) {
         //we should generate only one crash per boot
         event = CRASHEVENT;
-        key = generate_event_id(event, type);
+        compute_event_id(key, event, type);
         dir = generate_crashlog_dir(MODE_CRASH, key);
         crash_generated = TRUE;
     } else {
         event = ERROREVENT;
-        key = generate_event_id(event, type);
+        compute_event_id(key, event, type);
         dir = generate_crashlog_dir(MODE_STATS, key);
     }
 
@@ -250,14 +253,12 @@ static void generate_event_by_type(char *type, const char *cd_path,
     if (memorize_trap_info) {
         raise_event_dataready(key, event, type, NULL, dir, 0);
         if (vmm_crashfolder) free(vmm_crashfolder);
-        if (vmm_key) free(vmm_key);
         vmm_crashfolder = dir;
-        vmm_key = key;
+        strcpy(vmm_key, key);
         vmm_index = index_trap;
     } else {
         raise_event(key, event, type, NULL, dir);
         free(dir);
-        free(key);
     }
 }
 
@@ -400,21 +401,14 @@ static void update_sd_path() {
 
 #ifdef CONFIG_SOFIA
 static void notify_dataready_on_vmtrap() {
-    char cmd[PATHMAX];
-
-    if (vmm_key) {
+    if (vmm_key[0]) {
         // send data ready notification
-        snprintf(cmd, sizeof(cmd) - 1, "am broadcast -n com.intel.crashreport"
-            "/.specific.NotificationReceiver -a com.intel.crashreport.intent.CRASH_LOGS_COPY_FINISHED "
-            "-c android.intent.category.ALTERNATIVE --es com.intel.crashreport.extra.EVENT_ID %s",
-            vmm_key);
-        run_command(cmd, 30);
+        notifier_logs_copy_finished(vmm_key);
     }
 
     free(vmm_crashfolder);
-    free(vmm_key);
     vmm_crashfolder = NULL;
-    vmm_key = NULL;
+    vmm_key[0] = '\0';
 }
 #endif
 
@@ -462,9 +456,9 @@ static void crashlog_check_vmm(void) {
 #endif
 
         if (sdcard_write_failure != 0) {
-            char *key;
+            char key[EVENT_ID_SIZE];
             LOGI("Error while creating file on sdcard: %s\n", strerror(-sdcard_write_failure));
-            key = generate_event_id(ERROREVENT, "SDCARD_FULL");
+            compute_event_id(key, ERROREVENT, "SDCARD_FULL");
             raise_event(key, ERROREVENT, "SDCARD_FULL", NULL, NULL);
             LOGE("%-8s%-22s%-20s%s\n", ERROREVENT, key, get_current_time_long(0), "SDCARD_FULL");
             break;
@@ -53,6 +53,10 @@
 #include "last_vmm_log.h"
 #include "intel_ecc_handler.h"
 #include "check_partition.h"
+#include "collector.h"
+#include "reactor.h"
+#include "notifier.h"
+#include "reaper.h"
 
 #include <sys/types.h>
 #include <openssl/sha.h>
@@ -264,9 +268,9 @@ static void reset_after_swupdate(void)
     reset_logdir(APLOG_DIR, 1);
     reset_logdir(HISTORY_CORE_DIR, 1);
     reset_logdir(LOGS_GPS_DIR, 1);
-    reset_file(CRASH_CURRENT_LOG);
-    reset_file(STATS_CURRENT_LOG);
-    reset_file(APLOGS_CURRENT_LOG);
+    reset_folder_counter(CRASH_CURRENT_LOG);
+    reset_folder_counter(STATS_CURRENT_LOG);
+    reset_folder_counter(APLOGS_CURRENT_LOG);
     reset_file(HISTORY_FILE);
     reset_uptime_history();
     reset_log_data(LOGS_DIR, "^(aplogs|bz|crashlog|stats)[0-9]{1,3}_.*");
@@ -312,7 +316,8 @@ static void crashlog_check_fw_events(char *reason, char *watchdog, int test) {
 #ifdef CONFIG_EARLY_LOGS
 static void crashlog_check_early_logs(void)
 {
-    char *dir, *key;
+    char key[EVENT_ID_SIZE];
+    char *dir;
 
     /* Clean current early log */
     if (file_exists(EARLY_LOGS_FILE)) {
@@ -327,7 +332,7 @@ static void crashlog_check_early_logs(void)
         return;
 
     /* Copy old log file to a crash folder and raise an error */
-    key = generate_event_id(ERROREVENT, CRASHLOG_ERROR_DECRYPT);
+    compute_event_id(key, ERROREVENT, CRASHLOG_ERROR_DECRYPT);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir) {
         LOGE("%s: generate_crashlog_dir failed", __FUNCTION__);
@@ -344,7 +349,6 @@ static void crashlog_check_early_logs(void)
 
 clean:
     free(dir);
-    free(key);
     unlink(EARLY_LOGS_OLD_FILE);
 }
 #endif
@@ -354,7 +358,7 @@ static void early_check_nomain(char *boot_mode, int test) {
     char startupreason[STARTUP_REASON_LENGTH] = { '\0', };
     char watchdog[WDT_SIZE] = { '\0', };
     const char *datelong;
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     read_startupreason(startupreason);
 
@@ -366,17 +370,15 @@ static void early_check_nomain(char *boot_mode, int test) {
 #ifdef CONFIG_EARLY_LOGS
     crashlog_check_early_logs();
 #endif
-    key = generate_event_id(SYS_REBOOT, startupreason);
+    compute_event_id(key, SYS_REBOOT, startupreason);
     raise_event_nouptime(key, SYS_REBOOT, startupreason, NULL, NULL);
 
     datelong = get_current_time_long(0);
     LOGE("%-8s%-22s%-20s%s\n", SYS_REBOOT, key, datelong, startupreason);
-    free(key);
 
-    key = generate_event_id(STATEEVENT, boot_mode);
+    compute_event_id(key, STATEEVENT, boot_mode);
     raise_event_nouptime(key, STATEEVENT, boot_mode, NULL, NULL);
     LOGE("%-8s%-22s%-20s%s\n", STATEEVENT, key, datelong, boot_mode);
-    free(key);
 }
 
 static void write_prop(const char *key, const char *value, void *cookie)
@@ -403,7 +405,7 @@ static void dump_props(const char *dir)
 static void crashlog_save_boot_logs(void)
 {
     char prop[PROPERTY_VALUE_MAX] = "";
-    char *key;
+    char key[EVENT_ID_SIZE];
     char *dir;
 
     /* Check if boot logs should be stored */
@@ -411,7 +413,7 @@ static void crashlog_save_boot_logs(void)
     if (!strcmp(prop, "1"))
         return;
 
-    key = generate_event_id(INFOEVENT, BOOTLOGS_EVNAME);
+    compute_event_id(key, INFOEVENT, BOOTLOGS_EVNAME);
     dir = generate_crashlog_dir(MODE_STATS, key);
     if (!dir) {
         LOGE("%s: generate_crashlog_dir failed", __FUNCTION__);
@@ -447,21 +449,19 @@ static void crashlog_save_boot_logs(void)
     raise_event(key, INFOEVENT,  BOOTLOGS_EVNAME, NULL, dir);
 
 clean:
-    free(key);
     free(dir);
 }
 
 static void update_history() {
     const char *datelong;
-    char *key;
+    char key[EVENT_ID_SIZE];
     if (swupdated(gbuildversion) == 1) {
         reset_after_swupdate();
 
         datelong = get_current_time_long(0);
-        key = generate_event_id(INFOEVENT, "SWUPDATE");
+        compute_event_id(key, INFOEVENT, "SWUPDATE");
         raise_event_nouptime(key, INFOEVENT, "SWUPDATE", NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", INFOEVENT, key, datelong, "SWUPDATE");
-        free(key);
     }
     else {
         uptime_history();
@@ -473,7 +473,7 @@ static void early_check(char *encryptstate, int test) {
     char startupreason[STARTUP_REASON_LENGTH] = { '\0', };
     char watchdog[16] = { '\0', };
     const char *datelong;
-    char *key;
+    char key[EVENT_ID_SIZE];
     bool ipanic_generated;
 
     read_startupreason(startupreason);
@@ -492,21 +492,19 @@ static void early_check(char *encryptstate, int test) {
 #endif
     crashlog_check_last_vmm_log();
 
-    key = generate_event_id(SYS_REBOOT, startupreason);
+    compute_event_id(key, SYS_REBOOT, startupreason);
     raise_event_bootuptime(key, SYS_REBOOT, startupreason, NULL, NULL);
 
     datelong = get_current_time_long(0);
     LOGE("%-8s%-22s%-20s%s\n", SYS_REBOOT, key, datelong, startupreason);
-    free(key);
 
     crashlog_save_boot_logs();
 
     crashlog_check_fw_update_status();
 
-    key = generate_event_id(STATEEVENT, encryptstate);
+    compute_event_id(key, STATEEVENT, encryptstate);
     raise_event_nouptime(key, STATEEVENT, encryptstate, NULL, NULL);
     LOGE("%-8s%-22s%-20s%s\n", STATEEVENT, key, datelong, encryptstate);
-    free(key);
 
 #ifdef CRASHLOGD_MODULE_MODEM
     int modem_name_check_result = 0;
@@ -677,13 +675,49 @@ int process_reset_event(struct watch_entry __attribute__((unused)) *entry,
     exit(-1);
 }
 
+/* Event sources callbacks: the monitor loop is busy while they run */
+static void monitor_inotify(int fd, void __attribute__((unused)) *ctx) {
+    collector_set_ongoing(1);
+    receive_inotify_events(fd);
+}
+
+static void monitor_mmgr(int __attribute__((unused)) fd, void *ctx) {
+    int inst = (int)(long)ctx;
+
+    collector_set_ongoing(1);
+    LOGD("mmgr fd instance %i set", inst);
+    mmgr_handle(inst);
+}
+
+static void monitor_kct(int __attribute__((unused)) fd, void __attribute__((unused)) *ctx) {
+    collector_set_ongoing(1);
+    LOGD("kct fd set");
+    kct_netlink_handle_msg();
+}
+
+static void monitor_lct(int __attribute__((unused)) fd, void __attribute__((unused)) *ctx) {
+    collector_set_ongoing(1);
+    LOGD("lct fd set");
+    lct_link_handle_msg();
+}
+
+/* Periodic tasks: they don't change the processing ongoing state */
+static void monitor_watchdog(int __attribute__((unused)) fd, void __attribute__((unused)) *ctx) {
+    kick_watchdog();
+}
+
+#ifdef CONFIG_ECC
+static void monitor_ecc(int __attribute__((unused)) fd, void __attribute__((unused)) *ctx) {
+    ecc_count_handle();
+}
+#endif /*CONFIG_ECC*/
+
 int do_monitor() {
+#ifndef CONFIG_FACTORY_CHECKSUM_DEFERRED
     check_factory_partition_checksum();
+#endif
 
-    fd_set read_fds; /**< file descriptor set watching data availability from sources */
-    int max = 0; /**< select max fd value +1 {@see man select(2) nfds} */
-    int select_result; /**< select result */
-    struct timeval select_timeout;
+    int res;
     int file_monitor_fd = get_inotify_fd();
     dropbox_set_file_monitor_fd(file_monitor_fd);
     int i,num_modems;
@@ -697,6 +731,12 @@ int do_monitor() {
         handle_missing_watched_dir(file_monitor_fd);
     }
 
+    if ( (res = reactor_init()) < 0 ) {
+        LOGE("%s: failed to initialize the event loop - %s\n",
+            __FUNCTION__, strerror(-res));
+        return -1;
+    }
+
     /* Set the inotify event callbacks */
     set_watch_entry_callback(SYSSERVER_TYPE,    process_anruiwdt_event);
     set_watch_entry_callback(ANR_TYPE,          process_anruiwdt_event);
@@ -717,6 +757,11 @@ int do_monitor() {
     set_watch_entry_callback(UPTIME_TYPE,       process_uptime_event);
     set_watch_entry_callback(BUILDID_TYPE,      process_reset_event);
 
+    /* Start the workers running the event callbacks */
+    collector_init();
+    notifier_init();
+    reaper_init();
+
     num_modems = get_modem_count();
     for (i = 0; i < num_modems; i++)
         init_mmgr_cli_source(i);
@@ -730,90 +775,38 @@ int do_monitor() {
     restore_count();
 #endif /*CONFIG_ECC*/
 
-    enable_watchdog(CRASHLOG_WD_TIMEOUT);
-
-    for(;;) {
-        kick_watchdog();
-
-        // Clear fd set
-        FD_ZERO(&read_fds);
-
-        // File monitor fd setup
-        if ( file_monitor_fd > 0 ) {
-            FD_SET(file_monitor_fd, &read_fds);
-            if (file_monitor_fd > max)
-                max = file_monitor_fd;
-        }
-
-        //mmgr fd setup
-        for (i = 0; i < num_modems; i++) {
-            if (mmgr_get_fd(i) > 0) {
-                FD_SET(mmgr_get_fd(i), &read_fds);
-                if (mmgr_get_fd(i) > max)
-                    max = mmgr_get_fd(i);
-            }
-        }
-
-        //kct fd setup
-        if (kct_netlink_get_fd() > 0) {
-            FD_SET(kct_netlink_get_fd(), &read_fds);
-            if (kct_netlink_get_fd() > max)
-                max = kct_netlink_get_fd();
-        }
-
-        //lct fd setup
-        if (lct_link_get_fd() > 0) {
-            FD_SET(lct_link_get_fd(), &read_fds);
-            if (lct_link_get_fd() > max)
-                max = lct_link_get_fd();
-        }
+    /* Register the event sources once */
+    reactor_add_fd(file_monitor_fd, monitor_inotify, NULL);
+    for (i = 0; i < num_modems; i++) {
+        if (mmgr_get_fd(i) > 0)
+            reactor_add_fd(mmgr_get_fd(i), monitor_mmgr, (void *)(long)i);
+    }
+    if (kct_netlink_get_fd() > 0)
+        reactor_add_fd(kct_netlink_get_fd(), monitor_kct, NULL);
+    if (lct_link_get_fd() > 0)
+        reactor_add_fd(lct_link_get_fd(), monitor_lct, NULL);
 
+    enable_watchdog(CRASHLOG_WD_TIMEOUT);
+    kick_watchdog();
+    reactor_add_timer(CRASHLOG_WD_KICK_PERIOD, monitor_watchdog, NULL);
 #ifdef CONFIG_ECC
-        ecc_count_handle();
+    ecc_count_handle();
+    reactor_add_timer(CRASHLOG_ECC_POLL_PERIOD, monitor_ecc, NULL);
 #endif /*CONFIG_ECC*/
 
-        /*Allow reboot if not doing anything on main thread */
-        property_set(PROP_PROC_ONGOING, "0");
+#ifdef CONFIG_FACTORY_CHECKSUM_DEFERRED
+    /* the factory partition is checked while the events are serviced */
+    start_factory_partition_checksum();
+#endif
 
-        select_timeout.tv_sec = CRASHLOG_SELECT_TIMEOUT;
-        select_timeout.tv_usec = 0;
+    for(;;) {
+        /*Allow reboot if not doing anything on main thread nor in the collection jobs */
+        collector_set_ongoing(0);
 
         // Wait for events
-        select_result = select(max+1, &read_fds, NULL, NULL, &select_timeout);
-
-        property_set(PROP_PROC_ONGOING, "1");
-
-        if (select_result == -1 && errno == EINTR) // Interrupted, need to recycle
-            continue;
-
-        // Result processing
-        if (select_result > 0) {
-            // File monitor
-            if (file_monitor_fd > 0 &&
-                FD_ISSET(file_monitor_fd, &read_fds)) {
-                receive_inotify_events(file_monitor_fd);
-            }
-            // mmgr monitor
-            for (i = 0; i < num_modems; i++) {
-                if (mmgr_get_fd(i) > 0 &&
-                    FD_ISSET(mmgr_get_fd(i), &read_fds)) {
-                    LOGD("mmgr fd instance %i set", i);
-                    mmgr_handle(i);
-                }
-            }
-            // kct monitor
-            if (kct_netlink_get_fd() > 0 &&
-                FD_ISSET(kct_netlink_get_fd(), &read_fds)) {
-                LOGD("kct fd set");
-                kct_netlink_handle_msg();
-            }
-            // lct monitor
-            if (lct_link_get_fd() > 0 &&
-                FD_ISSET(lct_link_get_fd(), &read_fds)) {
-                LOGD("lct fd set");
-                lct_link_handle_msg();
-            }
-
+        if ( (res = reactor_run_once(-1)) < 0 ) {
+            LOGE("%s: event loop failed - %s\n", __FUNCTION__, strerror(-res));
+            break;
         }
     }
 
@@ -0,0 +1,292 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file notifier.c
+ * @brief File containing functions to send the crashreport notifications.
+ *
+ * The pending requests are a flag for CRASH_NOTIFY and a list of event ids
+ * for CRASH_LOGS_COPY_FINISHED, each with the time of its first request. The
+ * thread sleeps until the earliest deadline, takes the pending requests and
+ * runs the broadcasts without holding the lock.
+ */
+
+#include "notifier.h"
+#include "privconfig.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <openssl/sha.h>
+
+#include <cutils/properties.h>
+
+#define LOG_PREFIX "notifier: "
+
+#define CRASHREPORT_RECEIVER    "com.intel.crashreport/.specific.NotificationReceiver"
+#define CRASH_NOTIFY_INTENT     "com.intel.crashreport.intent.CRASH_NOTIFY"
+#define COPY_FINISHED_INTENT    "com.intel.crashreport.intent.CRASH_LOGS_COPY_FINISHED"
+#define EXTRA_EVENT_ID          "com.intel.crashreport.extra.EVENT_ID"
+#define EXTRA_EVENT_IDS         "com.intel.crashreport.extra.EVENT_IDS"
+
+#define NOTIFIER_CMD_SIZE       (256 + NOTIFIER_MAX_KEYS * (SHA_DIGEST_LENGTH + 1))
+
+static int notify_pending = 0;
+static time_t notify_since;
+static time_t last_notify;
+static char keys[NOTIFIER_MAX_KEYS][SHA_DIGEST_LENGTH + 1];
+static unsigned int nbkeys = 0;
+static time_t keys_since;
+static struct notifier_stats stats;
+static unsigned long exported_merged = 0;
+static unsigned long exported_dropped = 0;
+static int started = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond;
+
+static time_t monotonic_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static void run_broadcast(const char *cmd) {
+    int status = run_command(cmd, 30);
+
+    if (status != 0)
+        LOGI(LOG_PREFIX "%s: Notify crashreport status(%d) for command \"%s\".\n",
+            __FUNCTION__, status, cmd);
+}
+
+static void send_crash_notify() {
+    run_broadcast("am broadcast -n " CRASHREPORT_RECEIVER " -a " CRASH_NOTIFY_INTENT
+        " -c android.intent.category.ALTERNATIVE");
+}
+
+/* The first event id is kept in EXTRA_EVENT_ID, the whole batch being
+ * given in EXTRA_EVENT_IDS as a string array */
+static void send_copy_finished(char ids[][SHA_DIGEST_LENGTH + 1], unsigned int nb) {
+    char cmd[NOTIFIER_CMD_SIZE];
+    unsigned int idx;
+    int len;
+
+    if (!nb)
+        return;
+
+    len = snprintf(cmd, sizeof(cmd), "am broadcast -n " CRASHREPORT_RECEIVER
+        " -a " COPY_FINISHED_INTENT " -c android.intent.category.ALTERNATIVE"
+        " --es " EXTRA_EVENT_ID " %s", ids[0]);
+    if (nb > 1) {
+        len += snprintf(cmd + len, sizeof(cmd) - len, " --esa " EXTRA_EVENT_IDS " %s", ids[0]);
+        for (idx = 1 ; idx < nb ; idx++)
+            len += snprintf(cmd + len, sizeof(cmd) - len, ",%s", ids[idx]);
+    }
+    run_broadcast(cmd);
+}
+
+/* Called with lock held */
+static void export_counters() {
+    char value[PROPERTY_VALUE_MAX];
+
+    if (stats.merged != exported_merged) {
+        snprintf(value, sizeof(value), "%lu", stats.merged);
+        property_set(PROP_NOTIFY_MERGED, value);
+        exported_merged = stats.merged;
+    }
+    if (stats.dropped != exported_dropped) {
+        snprintf(value, sizeof(value), "%lu", stats.dropped);
+        property_set(PROP_NOTIFY_DROPPED, value);
+        exported_dropped = stats.dropped;
+    }
+}
+
+/* Called with lock held: returns the time at which the pending requests
+ * shall be sent, 0 if nothing is pending */
+static time_t next_deadline() {
+    time_t deadline = 0, notify_deadline;
+
+    if (nbkeys)
+        deadline = keys_since + NOTIFIER_DEBOUNCE;
+    if (notify_pending) {
+        notify_deadline = notify_since + NOTIFIER_DEBOUNCE;
+        if (last_notify && notify_deadline < last_notify + NOTIFIER_MIN_INTERVAL)
+            notify_deadline = last_notify + NOTIFIER_MIN_INTERVAL;
+        if (!deadline || notify_deadline < deadline)
+            deadline = notify_deadline;
+    }
+    return deadline;
+}
+
+static void *notifier_thread(void __attribute__((unused)) *arg) {
+    char ids[NOTIFIER_MAX_KEYS][SHA_DIGEST_LENGTH + 1];
+    struct timespec ts;
+    unsigned int nb;
+    int notify;
+    time_t deadline, now;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        deadline = next_deadline();
+        if (!deadline) {
+            pthread_cond_wait(&cond, &lock);
+            continue;
+        }
+        now = monotonic_now();
+        if (now < deadline) {
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += deadline - now;
+            pthread_cond_timedwait(&cond, &lock, &ts);
+            continue;
+        }
+
+        /* take what is due, CRASH_NOTIFY may have to wait longer */
+        nb = 0;
+        if (nbkeys && now >= keys_since + NOTIFIER_DEBOUNCE) {
+            nb = nbkeys;
+            memcpy(ids, keys, nb * sizeof(keys[0]));
+            nbkeys = 0;
+        }
+        notify = (notify_pending && now >= notify_since + NOTIFIER_DEBOUNCE &&
+            (!last_notify || now >= last_notify + NOTIFIER_MIN_INTERVAL));
+        if (notify) {
+            notify_pending = 0;
+            last_notify = now;
+        }
+        stats.broadcasts += (nb ? 1 : 0) + notify;
+        export_counters();
+        pthread_mutex_unlock(&lock);
+
+        if (notify)
+            send_crash_notify();
+        send_copy_finished(ids, nb);
+
+        pthread_mutex_lock(&lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the notifier thread
+ *
+ * When the thread cannot be started, the notifications are sent inline.
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int notifier_init() {
+    pthread_condattr_t attr;
+    pthread_t thread;
+    int res;
+
+    if (started)
+        return 0;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    res = pthread_create(&thread, NULL, notifier_thread, NULL);
+    if (res) {
+        LOGE(LOG_PREFIX "%s: Cannot create the notifier thread - %s\n",
+            __FUNCTION__, strerror(res));
+        return -res;
+    }
+    pthread_detach(thread);
+    started = 1;
+    return 0;
+}
+
+/**
+ * @brief Requests a CRASH_NOTIFY broadcast
+ */
+void notifier_crash_notify() {
+    pthread_mutex_lock(&lock);
+    if (!started) {
+        stats.requests++;
+        stats.broadcasts++;
+        pthread_mutex_unlock(&lock);
+        send_crash_notify();
+        return;
+    }
+
+    stats.requests++;
+    if (notify_pending) {
+        stats.merged++;
+    } else {
+        notify_pending = 1;
+        notify_since = monotonic_now();
+        pthread_cond_signal(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Requests a CRASH_LOGS_COPY_FINISHED broadcast for an event id
+ */
+void notifier_logs_copy_finished(const char *key) {
+    char id[1][SHA_DIGEST_LENGTH + 1];
+    unsigned int idx;
+
+    if (!key || !key[0])
+        return;
+
+    pthread_mutex_lock(&lock);
+    stats.requests++;
+    if (!started) {
+        stats.broadcasts++;
+        pthread_mutex_unlock(&lock);
+        strncpy(id[0], key, SHA_DIGEST_LENGTH);
+        id[0][SHA_DIGEST_LENGTH] = '\0';
+        send_copy_finished(id, 1);
+        return;
+    }
+
+    for (idx = 0 ; idx < nbkeys ; idx++) {
+        if (!strncmp(keys[idx], key, SHA_DIGEST_LENGTH))
+            break;
+    }
+    if (idx < nbkeys) {
+        stats.merged++;
+    } else if (nbkeys == NOTIFIER_MAX_KEYS) {
+        LOGE(LOG_PREFIX "%s: Too many pending notifications, drop %s\n", __FUNCTION__, key);
+        stats.dropped++;
+    } else {
+        if (nbkeys)
+            stats.merged++;
+        else
+            keys_since = monotonic_now();
+        strncpy(keys[nbkeys], key, SHA_DIGEST_LENGTH);
+        keys[nbkeys][SHA_DIGEST_LENGTH] = '\0';
+        /* a full batch is sent without waiting for the debounce window */
+        if (++nbkeys == NOTIFIER_MAX_KEYS)
+            keys_since -= NOTIFIER_DEBOUNCE;
+        pthread_cond_signal(&cond);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void notifier_get_stats(struct notifier_stats *out) {
+    if (!out)
+        return;
+
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,44 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file notifier.h
+ * @brief File containing functions to send the crashreport notifications.
+ *
+ * Each "am broadcast" starts a new VM, so the notifications are queued to a
+ * single notifier thread. The requests received within NOTIFIER_DEBOUNCE
+ * seconds are sent as one broadcast: every CRASH_NOTIFY request is merged in
+ * one intent, and the event ids of the CRASH_LOGS_COPY_FINISHED requests are
+ * sent together. CRASH_NOTIFY is sent at most once every NOTIFIER_MIN_INTERVAL
+ * seconds.
+ */
+
+#ifndef __NOTIFIER_H__
+#define __NOTIFIER_H__
+
+struct notifier_stats {
+    unsigned long requests;     /* notifications requested */
+    unsigned long merged;       /* requests sent with a previous one */
+    unsigned long dropped;      /* requests lost, queue full */
+    unsigned long broadcasts;   /* "am broadcast" commands run */
+};
+
+int notifier_init();
+void notifier_crash_notify();
+void notifier_logs_copy_finished(const char *key);
+void notifier_get_stats(struct notifier_stats *stats);
+
+#endif /* __NOTIFIER_H__ */
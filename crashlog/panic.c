@@ -38,147 +38,206 @@ typedef enum e_crashtype_mode {
     DONT_PANIC_MODE, /*< computation of panic crashtype from /data/dontpanic/ files */
 } e_crashtype_mode_t;
 
+/* Keyword groups searched in the panic console files */
+typedef enum e_panic_kw {
+    PANIC_KW_PANIC = 0,     /*< kernel panic signatures */
+    PANIC_KW_DOUBLE,        /*< panic while the crash partition was in use */
+    PANIC_KW_SWWDT,
+    PANIC_KW_SWWDT_FAKE,
+    PANIC_KW_HWWDT,
+    PANIC_KW_HWWDT_64,      /*< needs "RIP:" on the same or the previous line */
+    PANIC_KW_FAKE,
+    PANIC_KW_FAKE_64,       /*< needs "RIP:" on the same or the previous line */
+    PANIC_KW_POWER_UP,
+    PANIC_KW_APLOGS,        /*< PROP_IPANIC_PATTERN patterns */
+    PANIC_KW_APLOGS_64,     /*< needs "RIP:" on the same or the previous line */
+    PANIC_KW_RIP,
+    PANIC_KW_MAX,
+} e_panic_kw_t;
+
+struct panic_keyword {
+    e_panic_kw_t group;
+    const char *keyword;
+};
+
+static const struct panic_keyword panic_keywords[] = {
+    { PANIC_KW_PANIC,       "Kernel panic - not syncing:" },
+    { PANIC_KW_PANIC,       "BUG: unable to handle kernel" },
+    { PANIC_KW_DOUBLE,      "Crash partition in use!" },
+    { PANIC_KW_SWWDT,       "Kernel panic - not syncing: Kernel Watchdog" },
+    { PANIC_KW_SWWDT_FAKE,  "[SHTDWN] WATCHDOG TIMEOUT for test!" },
+    { PANIC_KW_HWWDT,       "EIP is at pmu_sc_irq" },
+    { PANIC_KW_HWWDT_64,    "pmu_sc_irq" },
+    { PANIC_KW_FAKE,        "EIP is at panic_dbg_set" },
+    { PANIC_KW_FAKE,        "EIP is at kwd_trigger_open" },
+    { PANIC_KW_FAKE,        "EIP is at kwd_trigger_write" },
+    { PANIC_KW_FAKE,        "EIP is at reboot_notifier" },
+    { PANIC_KW_FAKE,        "EIP is at sysrq_handle_crash" },
+    { PANIC_KW_FAKE_64,     "panic_dbg_set" },
+    { PANIC_KW_FAKE_64,     "kwd_trigger_write" },
+    { PANIC_KW_FAKE_64,     "reboot_notifier" },
+    { PANIC_KW_FAKE_64,     "sysrq_handle_crash" },
+    { PANIC_KW_POWER_UP,    "power_up_host: host controller power up is done" },
+    { PANIC_KW_RIP,         "RIP:" },
+};
+
+/* Maximum number of patterns read from PROP_IPANIC_PATTERN */
+#define IPANIC_MAX_PATTERNS     10
+/* Pattern searched when PROP_IPANIC_PATTERN is not set */
+#define IPANIC_DEFAULT_PATTERN  "SGXInitialise"
+
+#define PANIC_MAX_KEYWORDS      (DIM(panic_keywords) + 2 * IPANIC_MAX_PATTERNS)
+
+struct panic_scan {
+    bool found[PANIC_KW_MAX];
+    /* private to the scan */
+    e_panic_kw_t groups[PANIC_MAX_KEYWORDS];
+    int lastline[PANIC_KW_MAX];
+    int ripline;
+};
+
+static inline bool panic_kw_needs_rip(e_panic_kw_t group) {
+    return group == PANIC_KW_HWWDT_64 || group == PANIC_KW_FAKE_64 ||
+        group == PANIC_KW_APLOGS_64;
+}
+
+static int panic_scan_hit(void *ctx, int keyword, int line,
+        off_t __attribute__((unused)) offset) {
+    struct panic_scan *scan = ctx;
+    e_panic_kw_t group = scan->groups[keyword];
+    int idx;
+
+    if (group == PANIC_KW_RIP) {
+        scan->ripline = line;
+        for (idx = 0 ; idx < PANIC_KW_MAX ; idx++)
+            if (panic_kw_needs_rip(idx) && scan->lastline[idx] == line)
+                scan->found[idx] = TRUE;
+    } else if (panic_kw_needs_rip(group)) {
+        scan->lastline[group] = line;
+        if (scan->ripline == line || scan->ripline == line - 1)
+            scan->found[group] = TRUE;
+    } else
+        scan->found[group] = TRUE;
+
+    return 0;
+}
+
 /*
-* Name          : check_aplogs_tobackup
-* Description   : backup a number of aplogs if a patten is found in a file
+* Name          : scan_panic_console
+* Description   : searches all the panic keywords in a console file, reading
+*                 it only once. The patterns of PROP_IPANIC_PATTERN are
+*                 searched as is with "RIP:" (64 bits) and prefixed with
+*                 "EIP is at " (32 bits).
 * Parameters    :
-*   char *filename        -> filename where a pattern is searched
+*   char *console_name    -> file to scan
+*   struct panic_scan *scan -> receives the keyword groups found
 */
-static int check_aplogs_tobackup(char *filename) {
+static int scan_panic_console(const char *console_name, struct panic_scan *scan) {
     char ipanic_chain[PROPERTY_VALUE_MAX];
-    int nbpatterns, res;
-    char **patterns_array_32;
-    char **patterns_array_64;
-    char *SGX_64_pattern[] = {"SGXInitialise"};
-    int idx, nbrecords = 10, recordsize = PROPERTY_VALUE_MAX;
+    char **patterns = NULL;
+    char patterns_32[IPANIC_MAX_PATTERNS][PROPERTY_VALUE_MAX];
+    const char *keywords[PANIC_MAX_KEYWORDS];
+    struct keyword_matcher *km;
+    int idx, nbkeywords = 0, nbpatterns = 0, res;
+
+    memset(scan, 0, sizeof(*scan));
+    scan->ripline = -2;
+    for (idx = 0 ; idx < PANIC_KW_MAX ; idx++)
+        scan->lastline[idx] = -1;
+
+    for (idx = 0 ; idx < (int)DIM(panic_keywords) ; idx++) {
+        scan->groups[nbkeywords] = panic_keywords[idx].group;
+        keywords[nbkeywords++] = panic_keywords[idx].keyword;
+    }
 
     if (property_get(PROP_IPANIC_PATTERN, ipanic_chain, "") > 0) {
         /* Found the property, split it into an array */
-        patterns_array_32 = commachain_to_fixedarray(ipanic_chain, recordsize, nbrecords, &nbpatterns);
+        patterns = commachain_to_fixedarray(ipanic_chain, PROPERTY_VALUE_MAX,
+                IPANIC_MAX_PATTERNS, &nbpatterns);
         if (nbpatterns < 0) {
             LOGE("%s: Cannot transform the property %s(which is %s) into an array... error is %d - %s\n",
                 __FUNCTION__, PROP_IPANIC_PATTERN, ipanic_chain, nbpatterns, strerror(-nbpatterns));
             /* allocated memory is freed in commachain_to_fixedarray */
-            return 0;
-        }
-        if (nbpatterns == 0) {
-            if (patterns_array_32) {
-                free(patterns_array_32);
-            }
-            return 0;
-        }
-        if (!patterns_array_32) return 0;
-        //pattern 64 bit is a copy of pattern 32 before transformation
-        patterns_array_64 = (char**)malloc(nbrecords*sizeof(char*));
-        if (!patterns_array_64) {
-            /* in this case it seems logical that we should free memory as we cannot proceed. */
-            for (idx = 0 ; idx < nbrecords ; idx++) {
-                free(patterns_array_32[idx]);
-            }
-            free(patterns_array_32);
-            return 0;
-        }
-        /* Add the prepattern "EIP is at" to each of the patterns */
-        for (idx = 0 ; idx < nbpatterns ; idx++) {
-            //copy each item for 64 pattern
-            patterns_array_64[idx] = (char*)malloc(recordsize*sizeof(char));
-            if (!patterns_array_64[idx] || !patterns_array_32[idx]) {
-                LOGE("%s : We ran out of memory, performing the search only on the already allocated patterns(count: %d); \n",
-                    __FUNCTION__, idx);
-                if (idx>0){
-                    nbpatterns = idx;
-                    break;
-                }
-                else {
-                    for(idx = 0 ; idx < nbrecords ; idx++) {
-                        free(patterns_array_32[idx]);
-                    }
-                    free(patterns_array_32);
-                    free(patterns_array_64);
-                    return 0;
-                }
-            }
-            strncpy(patterns_array_64[idx], patterns_array_32[idx], recordsize-1);
-            char *prepattern = "EIP is at ";
-            int prepatternlen = strlen(prepattern);
-            memmove(&patterns_array_32[idx][prepatternlen], patterns_array_32[idx],
-                MIN((int)strlen(patterns_array_32[idx])+1, PROPERTY_VALUE_MAX-prepatternlen));
-            /* insure the chain is null terminated */
-            patterns_array_32[idx][PROPERTY_VALUE_MAX-1] = 0;
-            memcpy(patterns_array_32[idx], prepattern, prepatternlen);
+            patterns = NULL;
         }
+        nbpatterns = patterns ? MIN(nbpatterns, IPANIC_MAX_PATTERNS) : 0;
+    } else {
+        /* By default, searches for the single following pattern... */
+        snprintf(ipanic_chain, sizeof(ipanic_chain), "%s", IPANIC_DEFAULT_PATTERN);
+        keywords[nbkeywords] = ipanic_chain;
+        scan->groups[nbkeywords++] = PANIC_KW_APLOGS_64;
+        snprintf(patterns_32[0], PROPERTY_VALUE_MAX, "EIP is at %s", ipanic_chain);
+        keywords[nbkeywords] = patterns_32[0];
+        scan->groups[nbkeywords++] = PANIC_KW_APLOGS;
+    }
 
-        res = find_oneofstrings_in_file_with_keyword(filename,  (char**)patterns_array_64, "RIP:", nbpatterns);
-
-        if (res < 0) {
-            LOGE("%s : got - error %s from function call \n",
-                    __FUNCTION__, strerror(-res));
-        }
+    for (idx = 0 ; idx < nbpatterns ; idx++) {
+        if (!patterns[idx][0])
+            continue;
+        keywords[nbkeywords] = patterns[idx];
+        scan->groups[nbkeywords++] = PANIC_KW_APLOGS_64;
+        /* Add the prepattern "EIP is at" to each of the patterns */
+        snprintf(patterns_32[idx], PROPERTY_VALUE_MAX, "EIP is at %s", patterns[idx]);
+        keywords[nbkeywords] = patterns_32[idx];
+        scan->groups[nbkeywords++] = PANIC_KW_APLOGS;
+    }
 
-        res = res || find_oneofstrings_in_file(filename, (const char **)patterns_array_32, nbpatterns);
+    km = keyword_matcher_create(keywords, nbkeywords);
+    if (!km) {
+        res = -errno;
+        LOGE("%s: Cannot compile the panic keywords - %s\n", __FUNCTION__, strerror(errno));
+    } else {
+        res = keyword_matcher_scan_file(km, console_name, NULL, panic_scan_hit, scan);
+        if (res < 0)
+            LOGE("%s: search for panic keywords failed in %s (%d)\n",
+                 __FUNCTION__, console_name, res);
+        keyword_matcher_free(km);
+    }
 
-        if (res > 0){
-            LOGE("%s: before process\n", __FUNCTION__);
-            process_log_event(NULL, NULL, MODE_APLOGS);
-        }
-        /* Cleanup the patterns_array allocated in commchain... */
-        for (idx = 0 ; idx < nbrecords ; idx++) {
-            free(patterns_array_32[idx]);
-        }
-        // pattern_64 is based on nbpatterns size
-        for (idx = 0 ; idx < nbpatterns ; idx++) {
-            free(patterns_array_64[idx]);
-        }
-        free(patterns_array_32);
-        free(patterns_array_64);
+    /* Cleanup the patterns array allocated in commachain... */
+    if (patterns) {
+        for (idx = 0 ; idx < IPANIC_MAX_PATTERNS ; idx++)
+            free(patterns[idx]);
+        free(patterns);
     }
-    else {
-        /* By default, searches for the single following pattern... */
-        res = find_oneofstrings_in_file_with_keyword(filename, SGX_64_pattern, "RIP:", 1);
 
-        if (res < 0) {
-            LOGE("%s : got - error %s from function call \n",
-                    __FUNCTION__, strerror(-res));
-        }
+    return res;
+}
 
-        res = res || (find_str_in_file(filename, "EIP is at SGXInitialise", NULL));
-        if (res > 0)
-            process_log_event(NULL, NULL, MODE_APLOGS);
-    }
+/*
+* Name          : check_aplogs_tobackup
+* Description   : backup a number of aplogs if a patten was found in the console file
+* Parameters    :
+*   struct panic_scan *scan -> keywords found in the console file
+*/
+static int check_aplogs_tobackup(const struct panic_scan *scan) {
+    int res = scan->found[PANIC_KW_APLOGS] || scan->found[PANIC_KW_APLOGS_64];
+
+    if (res > 0)
+        process_log_event(NULL, NULL, MODE_APLOGS);
 
     return res;
 }
 
-static void set_ipanic_crashtype_and_reason(char *console_name, char *crashtype, char *reason,
+static void set_ipanic_crashtype_and_reason(const struct panic_scan *scan, char *crashtype, char *reason,
         e_crashtype_mode_t mode) {
-    char *fake_32_pattern[] = {"EIP is at panic_dbg_set", "EIP is at kwd_trigger_open", "EIP is at kwd_trigger_write",
-                               "EIP is at reboot_notifier", "EIP is at sysrq_handle_crash"};
-    char *fake_64_pattern[] = {"panic_dbg_set", "kwd_trigger_write", "reboot_notifier", "sysrq_handle_crash"};
-    char *hwwdt_64_pattern[] = {"pmu_sc_irq"};
-    const int size_fake_32_pattern = ( sizeof (fake_32_pattern) ) / ( sizeof fake_32_pattern[0] );
-    const int size_fake_64_pattern = ( sizeof (fake_64_pattern) ) / ( sizeof fake_64_pattern[0] );
-    const int size_hwwdt_64_pattern = ( sizeof (hwwdt_64_pattern) ) / ( sizeof hwwdt_64_pattern[0] );
-
     /* Set crash type according to pattern found in Ipanic console file or according to startup reason value*/
-    if (find_str_in_file(console_name, "Kernel panic - not syncing: Kernel Watchdog", NULL) > 0) {
+    if (scan->found[PANIC_KW_SWWDT]) {
         strcpy(crashtype, KERNEL_SWWDT_CRASH);
-        if (find_str_in_file(console_name, "[SHTDWN] WATCHDOG TIMEOUT for test!", NULL) > 0)
+        if (scan->found[PANIC_KW_SWWDT_FAKE])
             strcpy(crashtype, KERNEL_SWWDT_FAKE_CRASH);
     }
-    else if (find_str_in_file(console_name, "EIP is at pmu_sc_irq", NULL) > 0 ||
-            (find_oneofstrings_in_file_with_keyword(console_name, hwwdt_64_pattern, "RIP:", size_hwwdt_64_pattern) > 0))
+    else if (scan->found[PANIC_KW_HWWDT] || scan->found[PANIC_KW_HWWDT_64])
         // This panic is triggered by a fabric error
         // It is marked as a kernel panic linked to a HW watdchog
         // to create a link between these 2 critical crashes
         strcpy(crashtype, KERNEL_HWWDT_CRASH);
-    else if ((find_oneofstrings_in_file(console_name, (const char **)fake_32_pattern,size_fake_32_pattern) > 0) ||
-            (find_oneofstrings_in_file_with_keyword(console_name, fake_64_pattern, "RIP:", size_fake_64_pattern) > 0))
+    else if (scan->found[PANIC_KW_FAKE] || scan->found[PANIC_KW_FAKE_64])
         strcpy(crashtype, KERNEL_FAKE_CRASH);
     else
         strcpy(crashtype, KERNEL_CRASH);
 
-    if ((mode == EMMC_PANIC_MODE) &&
-            (find_str_in_file(console_name, "power_up_host: host controller power up is done", NULL) <= 0)) {
+    if ((mode == EMMC_PANIC_MODE) && !scan->found[PANIC_KW_POWER_UP]) {
         // An error is raised when the panic console file does not end normally
        raise_infoerror(ERROREVENT, IPANIC_CORRUPTED);
     }
@@ -221,7 +280,8 @@ int crashlog_check_dontpanic(char *reason) {
     char basename[PATHMAX] = {'\0'};
     char console_name[PATHMAX] = {'\0'};
     char crashtype[32] = {'\0'};
-    char *key;
+    char key[EVENT_ID_SIZE];
+    struct panic_scan scan;
 
     // Use property_get to get boot reason starting from Android 12
     ret = property_get(PROP_BOOTREASON, bootreason, "");
@@ -234,11 +294,10 @@ int crashlog_check_dontpanic(char *reason) {
         dir_contains(PANIC_DIR, CONSOLE_NAME, FALSE) <= 0)
         return 1;
 
-    key = generate_event_id(CRASHEVENT, crashtype);
+    compute_event_id(key, CRASHEVENT, crashtype);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir) {
         LOGE("%s: failed to get a new crash directory\n", __FUNCTION__);
-        free(key);
         return -1;
     }
 
@@ -250,11 +309,11 @@ int crashlog_check_dontpanic(char *reason) {
     do_last_kmsg_copy(dir);
     do_wdt_log_copy(dir);
 
-    set_ipanic_crashtype_and_reason(console_name, crashtype, reason, DONT_PANIC_MODE);
+    scan_panic_console(console_name, &scan);
+    set_ipanic_crashtype_and_reason(&scan, crashtype, reason, DONT_PANIC_MODE);
     raise_event(key, CRASHEVENT, crashtype, NULL, dir);
     LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0),
          crashtype, dir);
-    free(key);
     free(dir);
 
     return 0;
@@ -278,14 +337,15 @@ int crashlog_check_panic(char *reason, int test) {
     char *dir;
     int copy_to_crash = 0;
     const char *dateshort = get_current_time_short(1);
-    char *key;
+    char key[EVENT_ID_SIZE];
+    struct panic_scan scan;
 
     if ( !test && !file_exists(CURRENT_PANIC_CONSOLE_NAME) ) {
         /* Nothing to do */
         return 1;
     }
 
-    key = generate_event_id(CRASHEVENT, crashtype);
+    compute_event_id(key, CRASHEVENT, crashtype);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     copy_to_crash = (dir != NULL);
 
@@ -323,57 +383,46 @@ int crashlog_check_panic(char *reason, int test) {
     }
 
     //crashtype calculation should be done after CONSOLE_NAME computation
-    set_ipanic_crashtype_and_reason(crash_console_name, crashtype, reason, EMMC_PANIC_MODE);
+    scan_panic_console(crash_console_name, &scan);
+    set_ipanic_crashtype_and_reason(&scan, crashtype, reason, EMMC_PANIC_MODE);
 
     if (copy_to_crash) {
         do_wdt_log_copy(dir);
         raise_event(key, CRASHEVENT, crashtype, NULL, dir);
         LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0), crashtype, dir);
-        free(key);
         free(dir);
 
         // if a pattern is found in the console file, upload a large number of aplogs
         // property persist.vendor.crashlogd.panic.pattern is used to fill the list of pattern
         // Each pattern is split by a semicolon in the property
-        check_aplogs_tobackup(crash_console_name);
+        check_aplogs_tobackup(&scan);
         return 0;
     } else {
         raise_event(key, CRASHEVENT, crashtype, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), crashtype);
-        free(key);
         /* Remove temporary files */
         remove(LOG_PANICTEMP);
         return -1;
     }
 }
 
-static inline int
-crashlog_check_ram_panic_found(const char *ram_console,
-                               const char *panic_kw[],
-                               int nb_key,
-                               const char *extrastring)
-{
-    int ret;
-
-    ret = find_oneofstrings_in_file(ram_console, panic_kw, nb_key);
-    if (ret < 0) {
-        LOGE("%s: search for panic keywords failed in %s (%d)\n",
-             __FUNCTION__, ram_console, ret);
-        return -1;
-    }
+/* The RAM console is checked twice per boot, keep its scan */
+static char ram_scan_name[PATHMAX];
+static struct panic_scan ram_scan;
 
-    if (!extrastring)
-        return ret;
+static int scan_ram_console(const char *ram_console, const struct panic_scan **scan) {
+    int ret;
 
-    ret = find_str_in_file(ram_console, extrastring, NULL);
-    if (ret < 0) {
-        LOGE("%s: search for %s failed in %s (%d)\n",
-             __FUNCTION__, extrastring, ram_console, ret);
-        return -1;
-    } else if (ret) {
-        return 1;
+    if (strcmp(ram_scan_name, ram_console)) {
+        ret = scan_panic_console(ram_console, &ram_scan);
+        if (ret < 0) {
+            ram_scan_name[0] = 0;
+            return -1;
+        }
+        snprintf(ram_scan_name, sizeof(ram_scan_name), "%s", ram_console);
     }
 
+    *scan = &ram_scan;
     return 0;
 }
 
@@ -387,20 +436,20 @@ crashlog_check_ram_panic_found(const char *ram_console,
  *  -1 if a problem occurs (can't create crash dir)
  *   0 for nominal case
  *   1 if the RAM console doesn't exist or if it exists but no panic detected.
+ * When double_panic is set, only a panic raised while the crash partition
+ * was in use is reported.
  */
-int crashlog_check_ram_panic(char *reason, const char *extrastring) {
-    const char *panic_kw[] = {"Kernel panic - not syncing:",
-                              "BUG: unable to handle kernel"};
+int crashlog_check_ram_panic(char *reason, bool double_panic) {
+    const struct panic_scan *scan;
     char crash_ramconsole_name[PATHMAX] = {'\0'};
     char crash_ramdmesg_name[PATHMAX] = {'\0'};
     char ram_console[PATHMAX] = {'\0'};
     char ram_dmesg[PATHMAX] = {'\0'};
     char crashtype[32] = {'\0'};
     char *dir;
-    int ret;
     int copy_to_crash = 0;
     const char *dateshort = get_current_time_short(1);
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     if (file_exists(LAST_KMSG)) {
         strcpy(ram_console, LAST_KMSG);
@@ -417,15 +466,14 @@ int crashlog_check_ram_panic(char *reason, const char *extrastring) {
         strcpy(ram_dmesg, DMESG_RAMOOPS_NUM(0));
     }
 
-    ret = crashlog_check_ram_panic_found(ram_console, panic_kw, DIM(panic_kw), extrastring);
-    if (ret < 0) {
+    if (scan_ram_console(ram_console, &scan) < 0) {
         return -1;
-    } else if (!ret) {
+    } else if (double_panic ? !scan->found[PANIC_KW_DOUBLE] : !scan->found[PANIC_KW_PANIC]) {
         LOGE("%s: not a panic, return\n", __FUNCTION__);
         return 1;
     }
 
-    key = generate_event_id(CRASHEVENT, crashtype);
+    compute_event_id(key, CRASHEVENT, crashtype);
     dir = generate_crashlog_dir(MODE_CRASH, key);
 
     copy_to_crash = (dir != NULL);
@@ -446,26 +494,24 @@ int crashlog_check_ram_panic(char *reason, const char *extrastring) {
     }
 
     //crashtype calculation should be done after RAM_CONSOLE computation
-    set_ipanic_crashtype_and_reason(crash_ramconsole_name, crashtype, reason, RAM_PANIC_MODE);
+    set_ipanic_crashtype_and_reason(scan, crashtype, reason, RAM_PANIC_MODE);
 
     // if a pattern is found in the console file, upload a large number of aplogs
     // property persist.vendor.crashlogd.panic.pattern is used to fill the list of pattern
     // Each pattern is split by a semicolon in the property
-    check_aplogs_tobackup(crash_ramconsole_name);
+    check_aplogs_tobackup(scan);
 
     if (copy_to_crash) {
         do_copy_eof_dir(PANIC_DIR, dir);
         do_wdt_log_copy(dir);
         raise_event(key, CRASHEVENT, crashtype, NULL, dir);
         LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0), crashtype, dir);
-        free(key);
         free(dir);
 
         return 0;
     } else {
         raise_event(key, CRASHEVENT, crashtype, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), crashtype);
-        free(key);
         /* Remove temporary file */
         remove(LOG_PANICTEMP);
         return -1;
@@ -489,14 +535,15 @@ int crashlog_check_panic_header(char *reason) {
     char *dir;
     int copy_to_crash = 0;
     const char *dateshort = get_current_time_short(1);
-    char *key;
+    char key[EVENT_ID_SIZE];
+    struct panic_scan scan;
 
     if ( !file_exists(CURRENT_PANIC_HEADER_NAME) ) {
         /* Nothing to do */
         return 1;
     }
 
-    key = generate_event_id(CRASHEVENT, crashtype);
+    compute_event_id(key, CRASHEVENT, crashtype);
     dir = generate_crashlog_dir(MODE_CRASH, key);
 
     copy_to_crash = (dir != NULL);
@@ -516,20 +563,19 @@ int crashlog_check_panic_header(char *reason) {
     }
 
     //crashtype calculation should be done after HEADER_NAME computation
-    set_ipanic_crashtype_and_reason(crash_header_name, crashtype, reason, EMMC_PANIC_MODE);
+    scan_panic_console(crash_header_name, &scan);
+    set_ipanic_crashtype_and_reason(&scan, crashtype, reason, EMMC_PANIC_MODE);
 
     if (copy_to_crash) {
         do_wdt_log_copy(dir);
         raise_event(key, CRASHEVENT, crashtype, NULL, dir);
         LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0), crashtype, dir);
-        free(key);
         free(dir);
 
         return 0;
     } else {
         raise_event(key, CRASHEVENT, crashtype, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), crashtype);
-        free(key);
         /* Remove temporary file */
         remove(LOG_PANICTEMP);
         return -1;
@@ -554,7 +600,7 @@ int crashlog_check_kdump(char *reason __attribute__((__unused__)), int test) {
     char *crashtype = NULL;
     char destination[PATHMAX] = {'\0'};
     char *dir;
-    char *key;
+    char key[EVENT_ID_SIZE];
     const char *dateshort = get_current_time_short(1);
 
     if (file_exists(KDUMP_START_FLAG))
@@ -582,13 +628,12 @@ int crashlog_check_kdump(char *reason __attribute__((__unused__)), int test) {
 
     if ((curr_stat == 3) || (test == 1)) {
 
-        key = generate_event_id(CRASHEVENT, crashtype);
+        compute_event_id(key, CRASHEVENT, crashtype);
         dir = generate_crashlog_dir(MODE_KDUMP, key);
         if (!dir) {
             LOGE("%s: Cannot get a valid new crash directory...\n", __FUNCTION__);
             raise_event(key, CRASHEVENT, crashtype, NULL, NULL);
             LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), crashtype);
-            free(key);
             return -1;
         }
 
@@ -603,7 +648,6 @@ int crashlog_check_kdump(char *reason __attribute__((__unused__)), int test) {
 
         raise_event(key, CRASHEVENT, crashtype, NULL, dir);
         LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0), crashtype, dir);
-        free(key);
         free(dir);
 
         remove(KDUMP_START_FLAG);
@@ -625,12 +669,13 @@ int crashlog_check_kdump(char *reason __attribute__((__unused__)), int test) {
 
 bool crashlog_check_panic_events(char *reason, char *watchdog, int test) {
     ipanic_generated = FALSE;
+    ram_scan_name[0] = 0;
 
     if (crashlog_check_dontpanic(reason) == 1)
         /* No panic console file in PANIC_DIR (/data/dontpanic), fallbaack */
         if (crashlog_check_panic(reason, test) == 1)
             /* No panic console file : check RAM console to determine the watchdog event type */
-            if (crashlog_check_ram_panic(reason, NULL) == 1)
+            if (crashlog_check_ram_panic(reason, FALSE) == 1)
                 /* Last resort: copy the panic partition header */
                 if ((crashlog_check_panic_header(reason) == 1) &&
                     strstr(reason, "SWWDT_"))
@@ -640,7 +685,7 @@ bool crashlog_check_panic_events(char *reason, char *watchdog, int test) {
     overwrite_file(CURRENT_PANIC_HEADER_NAME, "1");
 
     /* check double panic through RAM console */
-    crashlog_check_ram_panic(reason, "Crash partition in use!");
+    crashlog_check_ram_panic(reason, TRUE);
 
     return ipanic_generated;
 }
@@ -23,7 +23,7 @@
 #define __PANIC_H__
 
 int crashlog_check_panic(char *reason, int test);
-int crashlog_check_ram_panic(char *reason);
+int crashlog_check_ram_panic(char *reason, bool double_panic);
 int crashlog_check_panic_header(char *reason);
 int crashlog_check_kdump(char *reason, int test);
 bool crashlog_check_panic_events(char *reason, char *watchdog, int test);
@@ -43,6 +43,8 @@
 #define MAX_RECORDS             5000
 #define MAX_RECORDS_HIST_FILE   (MAX_RECORDS + 1000)
 #define HIST_FILE_HEADER_SIZE   2
+#define HISTORY_SEGMENT_RECORDS 1000
+#define HISTORY_MAX_SEGMENTS    (MAX_RECORDS_HIST_FILE / HISTORY_SEGMENT_RECORDS)
 #define MAX_DIRS                1000
 #define PATHMAX                 512
 #define UPTIME_HOUR_FREQUENCY   6
@@ -51,6 +53,17 @@
 /* find_str_in_file was implemented with 4KB*/
 #define MAXLINESIZE             MAX((2 * PROPERTY_VALUE_MAX), (4 * KB))
 #define CPBUFFERSIZE            (4*KB)
+#define CRASHFILE_MAXSIZE       (8*KB)
+#define COPYBUFFERSIZE          (128*KB)
+/* gzip level and CPU time in ms allowed per compressed log */
+#define COMPRESS_LEVEL          6
+#define COMPRESS_CPU_BUDGET_MS  2000
+/* quota manager: free space cache lifetime and full rescan period, in
+ * seconds, and eviction start in percents of the quota */
+#define QUOTA_REFRESH_PERIOD    30
+#define QUOTA_RESCAN_PERIOD     3600
+#define QUOTA_HIGH_WATER_PERCENT 90
+#define INOTIFY_BUFFER_SIZE     (64*KB)
 #define SIZE_FOOTPRINT_MAX      ((PROPERTY_VALUE_MAX + 1) * 11)
 #define TIMEOUT_VALUE           (20*1000)
 #define MAX_WAIT_MMGR_CONNECT_SECONDS  5
@@ -65,7 +78,16 @@
 /* crashlog wd timeout in seconds */
 #define CRASHLOG_WD_TIMEOUT     120
 #define CRASHLOG_WD_GRANULARITY 8
-#define CRASHLOG_SELECT_TIMEOUT 10
+/* collection jobs worker pool */
+#define COLLECTOR_WORKERS       3
+#define COLLECTOR_QUEUE_SIZE    64
+/* crashreport notifications, in seconds */
+#define NOTIFIER_DEBOUNCE       2
+#define NOTIFIER_MIN_INTERVAL   60
+#define NOTIFIER_MAX_KEYS       16
+/* monitor loop periodic tasks, in seconds */
+#define CRASHLOG_WD_KICK_PERIOD (CRASHLOG_WD_TIMEOUT / 4)
+#define CRASHLOG_ECC_POLL_PERIOD 60
 
 /* Percentage of guaranteed available space checked by crashlogd
  * to determine whether to generate new crash logs
@@ -304,6 +326,9 @@ extern enum crashlog_mode g_crashlog_mode;
 #define PROP_CRASH_MODE         "persist.vendor.sys.crashlogd.mode"
 #define PROP_PROFILE            "persist.vendor.service.profile.enable"
 #define PROP_PROC_ONGOING       "crashlogd.vendor.processing.ongoing"
+#define PROP_QUEUE_MAXDEPTH     "crashlogd.vendor.queue.maxdepth"
+#define PROP_NOTIFY_MERGED      "crashlogd.vendor.notify.merged"
+#define PROP_NOTIFY_DROPPED     "crashlogd.vendor.notify.dropped"
 #define PROP_BOOTREASON         "sys.boot.reason"
 #define PROP_BOOT_STATUS        "sys.boot_completed"
 #define PROP_BUILD_FIELD        "ro.build.version.incremental"
@@ -392,11 +417,14 @@ extern enum crashlog_mode g_crashlog_mode;
 /* FILES */
 #define SYS_PROP                SYSTEM_DIR "/build.prop"
 #define HISTORY_FILE            LOGS_DIR "/history_event"
+#define HISTORY_SEGMENT_DIR     LOGS_DIR "/history"
 #define UPTIME_FILE             LOGS_DIR "/uptime"
 #define BZ_CURRENT_LOG          LOGS_DIR "/currentbzlog"
 #define CRASH_CURRENT_LOG       LOGS_DIR "/currentcrashlog"
 #define STATS_CURRENT_LOG       LOGS_DIR "/currentstatslog"
 #define APLOGS_CURRENT_LOG      LOGS_DIR "/currentaplogslog"
+/* recycled crash folders are moved there before their deletion */
+#define TRASH_DIR_NAME          ".trash"
 #define LOG_UUID                LOGS_DIR "/uuid.txt"
 #define LOG_BUILDID             LOGS_DIR "/buildid.txt"
 #define LOG_MODEM_VERSION_BASE  LOGS_DIR "/modem_version"
@@ -431,6 +459,7 @@ extern enum crashlog_mode g_crashlog_mode;
 #define GBUFFER_NAME            "emmc_ipanic_gbuffer"
 #define CMDLINE_NAME            "cmdline"
 #define CRASHFILE_NAME          "crashfile"
+#define CRASHFILE_TMP_NAME      "." CRASHFILE_NAME ".tmp"
 #define LAST_VMM_LOG            "last_vmm_log"
 #define LAST_VMM_LOG_FILE       LOGS_DIR "/" LAST_VMM_LOG
 #define LAST_KMSG               PROC_DIR "/" LAST_KMSG_FILE
@@ -477,9 +506,15 @@ extern enum crashlog_mode g_crashlog_mode;
 #define EVENTFILE_NAME          "eventfile"
 #define IPTRAK_FILE             LOGS_DIR "/iptrak"
 #define FW_UPDATE_STATUS_PATH   "/sys/firmware/osnib/fw_update_status"
+/* the tests use their own copies */
+#ifndef INGREDIENTS_CONFIG
 #define INGREDIENTS_CONFIG      SYSTEM_DIR "/vendor/etc/ingredients.conf"
+#endif
+#ifndef INGREDIENTS_FILE
 #define INGREDIENTS_FILE        LOGS_DIR "/ingredients.txt"
-#define FACTORY_SUM_FILE        LOGS_DIR "/factory_sum"
+#endif
+#define FACTORY_SUM_FILE        LOGS_DIR "/factory_tree_sum"
+#define FACTORY_OLD_SUM_FILE    LOGS_DIR "/factory_sum"
 #define BINDER_TRANSACTIONS     DEBUGFS_DIR "/binder/transactions"
 #define BINDER_TRANSACTION_LOG  DEBUGFS_DIR "/binder/transaction_log"
 #define BINDER_FAILED_TRANSACTION_LOG   DEBUGFS_DIR "/binder/failed_transaction_log"
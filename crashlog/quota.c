@@ -0,0 +1,461 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file quota.c
+ * @brief File containing functions to account the space used by the logs.
+ *
+ * A root is registered by its first quota check. Its top level directories
+ * are the folders (crashlog0, aplogs3, ...), each with its size and time;
+ * the top level files are only summed. The copy helpers account the bytes
+ * they write and the reaper forgets the folders it disposes, so the root
+ * is walked again only every QUOTA_RESCAN_PERIOD seconds, to catch the
+ * files written by other means.
+ */
+
+#include "quota.h"
+#include "privconfig.h"
+#include "reaper.h"
+#include "history.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+
+#include <cutils/properties.h>
+
+#define LOG_PREFIX "quota: "
+
+#define QUOTA_MAX_ROOTS         4
+
+struct quota_folder {
+    char *name;
+    unsigned long long size;
+    time_t time;
+};
+
+struct quota_root {
+    char path[PATHMAX];
+    size_t pathlen;
+    unsigned long long loose;       /* size of the top level files */
+    unsigned long long used;        /* loose and the size of the folders */
+    struct quota_folder *folders;
+    unsigned int nbfolders;
+    unsigned int maxfolders;
+    time_t scanned;
+    /* cached for QUOTA_REFRESH_PERIOD */
+    time_t refreshed;
+    int statfs_ok;
+    unsigned long long free_space;
+    unsigned long long full_space;
+    long portion;
+};
+
+static struct quota_root roots[QUOTA_MAX_ROOTS];
+static unsigned int nbroots = 0;
+static struct quota_stats stats;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static time_t monotonic_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/* Returns the size of the regular files under the entry name of dirfd */
+static unsigned long long walk_size(int dirfd, const char *name) {
+    unsigned long long size = 0;
+    struct dirent *de;
+    struct stat info;
+    DIR *d;
+    int fd;
+
+    if (fstatat(dirfd, name, &info, AT_SYMLINK_NOFOLLOW) < 0)
+        return 0;
+    if (S_ISREG(info.st_mode))
+        return info.st_size;
+    if (!S_ISDIR(info.st_mode))
+        return 0;
+
+    fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    if ((d = fdopendir(fd)) == NULL) {
+        close(fd);
+        return 0;
+    }
+    while ((de = readdir(d)) != NULL) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+        size += walk_size(fd, de->d_name);
+    }
+    closedir(d);
+    return size;
+}
+
+/* Called with lock held */
+static struct quota_folder *add_folder(struct quota_root *root, const char *name, size_t len,
+        time_t time) {
+    struct quota_folder *folders, *folder;
+    unsigned int max;
+
+    if (root->nbfolders == root->maxfolders) {
+        max = root->maxfolders ? root->maxfolders * 2 : 64;
+        folders = realloc(root->folders, max * sizeof(*folders));
+        if (!folders)
+            return NULL;
+        root->folders = folders;
+        root->maxfolders = max;
+    }
+    folder = &root->folders[root->nbfolders];
+    if ((folder->name = strndup(name, len)) == NULL)
+        return NULL;
+    folder->size = 0;
+    folder->time = time;
+    root->nbfolders++;
+    return folder;
+}
+
+/* Called with lock held: the space of the folder is freed */
+static void remove_folder(struct quota_root *root, struct quota_folder *folder) {
+    root->used -= (folder->size < root->used) ? folder->size : root->used;
+    root->free_space += folder->size;
+    free(folder->name);
+    *folder = root->folders[--root->nbfolders];
+}
+
+/* Called with lock held */
+static struct quota_folder *find_folder(struct quota_root *root, const char *name, size_t len) {
+    unsigned int idx;
+
+    for (idx = 0 ; idx < root->nbfolders ; idx++) {
+        if (!strncmp(root->folders[idx].name, name, len) && !root->folders[idx].name[len])
+            return &root->folders[idx];
+    }
+    return NULL;
+}
+
+/* Called with lock held: computes the size of each folder of a root */
+static void scan_root(struct quota_root *root) {
+    struct quota_folder *folder;
+    struct dirent *de;
+    struct stat info;
+    DIR *d;
+    int fd;
+
+    while (root->nbfolders)
+        free(root->folders[--root->nbfolders].name);
+    root->loose = root->used = 0;
+    root->scanned = monotonic_now();
+    stats.scans++;
+
+    fd = open(root->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    if ((d = fdopendir(fd)) == NULL) {
+        close(fd);
+        return;
+    }
+    while ((de = readdir(d)) != NULL) {
+        /* the trash is emptied by the reaper */
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..") ||
+                !strcmp(de->d_name, TRASH_DIR_NAME))
+            continue;
+        if (fstatat(fd, de->d_name, &info, AT_SYMLINK_NOFOLLOW) < 0)
+            continue;
+        if (S_ISREG(info.st_mode)) {
+            root->loose += info.st_size;
+            root->used += info.st_size;
+        } else if (S_ISDIR(info.st_mode) &&
+                (folder = add_folder(root, de->d_name, strlen(de->d_name),
+                    info.st_mtime)) != NULL) {
+            folder->size = walk_size(fd, de->d_name);
+            root->used += folder->size;
+        }
+    }
+    closedir(d);
+}
+
+/* Called with lock held: returns the registered root containing path, rel
+ * being set to the offset of the path relative to the root */
+static struct quota_root *find_root(const char *path, size_t *rel) {
+    unsigned int idx;
+
+    for (idx = 0 ; idx < nbroots ; idx++) {
+        if (!strncmp(roots[idx].path, path, roots[idx].pathlen) &&
+                path[roots[idx].pathlen] == '/') {
+            *rel = roots[idx].pathlen + 1;
+            return &roots[idx];
+        }
+    }
+    return NULL;
+}
+
+/* Called with lock held: returns a root, registered and walked on first use */
+static struct quota_root *get_root(const char *path) {
+    struct quota_root *root = NULL;
+    unsigned int idx;
+
+    for (idx = 0 ; idx < nbroots ; idx++) {
+        if (!strcmp(roots[idx].path, path)) {
+            root = &roots[idx];
+            break;
+        }
+    }
+    if (!root) {
+        if (nbroots == QUOTA_MAX_ROOTS)
+            return NULL;
+        root = &roots[nbroots++];
+        snprintf(root->path, sizeof(root->path), "%s", path);
+        root->pathlen = strlen(root->path);
+        scan_root(root);
+    } else if (monotonic_now() - root->scanned >= QUOTA_RESCAN_PERIOD) {
+        scan_root(root);
+    }
+    return root;
+}
+
+/* Called with lock held: reads the free space and the quota property when
+ * the cached ones are older than QUOTA_REFRESH_PERIOD */
+static void refresh_root(struct quota_root *root) {
+    char prop[PROPERTY_VALUE_MAX];
+    struct statfs st;
+    time_t now = monotonic_now();
+
+    if (root->refreshed && now - root->refreshed < QUOTA_REFRESH_PERIOD)
+        return;
+    root->refreshed = now;
+    stats.refreshes++;
+
+    root->statfs_ok = (statfs(root->path, &st) == 0);
+    if (!root->statfs_ok) {
+        LOGE(LOG_PREFIX "%s: warn: statfs failed on %s, err: %s!!!", __FUNCTION__,
+            root->path, strerror(errno));
+        return;
+    }
+    root->free_space = (unsigned long long)st.f_bavail * st.f_bsize;
+    root->full_space = (unsigned long long)st.f_blocks * st.f_bsize;
+
+    property_get(PROP_DATA_QUOTA, prop, "100");
+    root->portion = strtol(prop, NULL, 10);
+    root->portion = (root->portion > 100 || (root->portion < 0)) ? 100 : root->portion;
+}
+
+/* Called with lock held: returns the oldest folder of a mode, NULL if the
+ * mode has less than two folders; the newest one is never evicted */
+static struct quota_folder *oldest_folder(struct quota_root *root, const char *prefix) {
+    struct quota_folder *oldest = NULL;
+    size_t len = strlen(prefix);
+    unsigned int idx, count = 0;
+
+    for (idx = 0 ; idx < root->nbfolders ; idx++) {
+        if (strncmp(root->folders[idx].name, prefix, len) ||
+                !isdigit(root->folders[idx].name[len]))
+            continue;
+        count++;
+        if (!oldest || root->folders[idx].time < oldest->time)
+            oldest = &root->folders[idx];
+    }
+    return count > 1 ? oldest : NULL;
+}
+
+/**
+ * @brief Evicts the oldest folders of a mode
+ *
+ * The folders named prefix followed by their slot are disposed, oldest
+ * first, until the root uses no more than target bytes, and their path is
+ * deleted from the history. The newest folder of the mode is kept.
+ *
+ * @param root directory holding the folders
+ * @param prefix of the folders of the mode (ie "crashlog")
+ * @param target size of the root to reach
+ * @return the number of folders evicted.
+ */
+int quota_evict(const char *root, const char *prefix, unsigned long long target) {
+    struct quota_folder *folder;
+    struct quota_root *qroot;
+    char path[PATHMAX];
+    int count = 0, len;
+
+    if (!root || !prefix)
+        return 0;
+
+    pthread_mutex_lock(&lock);
+    qroot = get_root(root);
+    while (qroot && qroot->used > target && (folder = oldest_folder(qroot, prefix)) != NULL) {
+        len = snprintf(path, sizeof(path), "%s/%s", qroot->path, folder->name);
+        if (len < 0 || len >= (int)sizeof(path)) {
+            /* not a path the reaper can handle, stop accounting it */
+            LOGE(LOG_PREFIX "%s: path of %s too long, forget it\n", __FUNCTION__, folder->name);
+            remove_folder(qroot, folder);
+            continue;
+        }
+        LOGI(LOG_PREFIX "%s: evict %s (%llu bytes)\n", __FUNCTION__, path, folder->size);
+        remove_folder(qroot, folder);
+        stats.evicted++;
+        count++;
+        /* the reaper forgets the path, the lock cannot be held */
+        pthread_mutex_unlock(&lock);
+        reaper_dispose(path);
+        history_delete_first_existent_logcrashpath(path);
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return count;
+}
+
+/**
+ * @brief Checks whether the logs of a root may grow
+ *
+ * When prefix is given and the logs reach QUOTA_HIGH_WATER_PERCENT of
+ * their quota, the oldest folders of the mode are evicted first.
+ *
+ * @param root logs directory
+ * @param req minimum free space of the partition, in percents
+ * @param prefix of the folders of the mode being allocated, NULL for none
+ * @return 0 if there's space left, -1 otherwise.
+ */
+int quota_check(const char *root, unsigned int req, const char *prefix) {
+    unsigned long long min_free_space, stop_space, high_water;
+    struct quota_root *qroot;
+    int res = 0;
+
+    pthread_mutex_lock(&lock);
+    stats.checks++;
+    qroot = get_root(root);
+    if (!qroot) {
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    refresh_root(qroot);
+    if (!qroot->statfs_ok) {
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    if (0 == qroot->portion) {
+        LOGW(LOG_PREFIX "%s: warn: no space reserved for crash logging", __FUNCTION__);
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+
+    min_free_space = qroot->full_space * req / 100;
+    stop_space = qroot->full_space * qroot->portion * (100 - req) / 10000;
+    high_water = stop_space * QUOTA_HIGH_WATER_PERCENT / 100;
+    if (prefix && qroot->used >= high_water) {
+        pthread_mutex_unlock(&lock);
+        quota_evict(root, prefix, high_water);
+        pthread_mutex_lock(&lock);
+    }
+
+    if (qroot->used >= stop_space || qroot->free_space < min_free_space) {
+        LOGW(LOG_PREFIX "%s: quota reached. total space: %llu, total free space %llu, "
+            "allocated space: %llu (limit %ld%%), minimum free space: %llu", __FUNCTION__,
+            qroot->full_space, qroot->free_space, qroot->used, qroot->portion, min_free_space);
+        res = -1;
+    }
+    pthread_mutex_unlock(&lock);
+    return res;
+}
+
+/**
+ * @brief Returns the size of the regular files of a root
+ */
+unsigned long long quota_used(const char *root) {
+    struct quota_root *qroot;
+    unsigned long long used = 0;
+
+    pthread_mutex_lock(&lock);
+    if ((qroot = get_root(root)) != NULL)
+        used = qroot->used;
+    pthread_mutex_unlock(&lock);
+    return used;
+}
+
+/**
+ * @brief Accounts the bytes written to, or removed from, a file
+ *
+ * The paths out of the registered roots are ignored.
+ *
+ * @param path of the file
+ * @param delta size change of the file
+ */
+void quota_account(const char *path, long long delta) {
+    struct quota_folder *folder;
+    struct quota_root *root;
+    const char *name, *end;
+    size_t rel;
+
+    if (!path || !delta)
+        return;
+
+    pthread_mutex_lock(&lock);
+    if ((root = find_root(path, &rel)) == NULL) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    name = path + rel;
+    end = strchr(name, '/');
+    if (!end) {
+        root->loose += delta;
+    } else if ((folder = find_folder(root, name, end - name)) != NULL ||
+            (folder = add_folder(root, name, end - name, time(NULL))) != NULL) {
+        folder->size += delta;
+    }
+    root->used += delta;
+    if (delta < 0 || (unsigned long long)delta < root->free_space)
+        root->free_space -= delta;
+    else
+        root->free_space = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Forgets a folder of a root, which has been deleted
+ */
+void quota_forget(const char *path) {
+    struct quota_folder *folder;
+    struct quota_root *root;
+    size_t rel;
+
+    if (!path)
+        return;
+
+    pthread_mutex_lock(&lock);
+    root = find_root(path, &rel);
+    if (root && !strchr(path + rel, '/') &&
+            (folder = find_folder(root, path + rel, strlen(path + rel))) != NULL)
+        remove_folder(root, folder);
+    pthread_mutex_unlock(&lock);
+}
+
+void quota_get_stats(struct quota_stats *out) {
+    if (!out)
+        return;
+
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
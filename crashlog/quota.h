@@ -0,0 +1,45 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file quota.h
+ * @brief File containing functions to account the space used by the logs.
+ *
+ * The size of each folder of a logs root directory is computed once, then
+ * updated as crashlogd writes and deletes files. The free space of the
+ * partition is cached for QUOTA_REFRESH_PERIOD seconds. When the logs reach
+ * QUOTA_HIGH_WATER_PERCENT of their quota, the oldest folders of the mode
+ * being allocated are evicted.
+ */
+
+#ifndef __QUOTA_H__
+#define __QUOTA_H__
+
+struct quota_stats {
+    unsigned long scans;        /* walks of a logs root directory */
+    unsigned long checks;       /* quota checks */
+    unsigned long refreshes;    /* statfs calls */
+    unsigned long evicted;      /* folders evicted */
+};
+
+int quota_check(const char *root, unsigned int req, const char *prefix);
+unsigned long long quota_used(const char *root);
+void quota_account(const char *path, long long delta);
+void quota_forget(const char *path);
+int quota_evict(const char *root, const char *prefix, unsigned long long target);
+void quota_get_stats(struct quota_stats *stats);
+
+#endif /* __QUOTA_H__ */
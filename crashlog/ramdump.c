@@ -55,15 +55,14 @@ static int crashlog_check_ramdump(const char * reason)
     char *crashtype = RAMDUMP_EVENT;
     char *dir;
     const char *dateshort = get_current_time_short(1);
-    char *key;
+    char key[EVENT_ID_SIZE];
 
-    key = generate_event_id(CRASHEVENT, crashtype);
+    compute_event_id(key, CRASHEVENT, crashtype);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir) {
         LOGE("%s: Cannot get a valid new crash directory...\n", __FUNCTION__);
         raise_event(key, CRASHEVENT, crashtype, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), crashtype);
-        free(key);
         return -1;
     }
     /* Copy */
@@ -98,7 +97,6 @@ static int crashlog_check_ramdump(const char * reason)
     LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0),
             crashtype, dir);
     free(dir);
-    free(key);
 
     return 0;
 }
@@ -154,7 +152,7 @@ int do_ramdump_checks(int test) {
 
     char startupreason[STARTUP_REASON_LENGTH] = { '\0', };
     char watchdog[16] = { '\0', };
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     strcpy(watchdog,"WDT");
 
@@ -179,10 +177,9 @@ int do_ramdump_checks(int test) {
 #endif
 
     /* Raise REBOOT event*/
-    key = generate_event_id(SYS_REBOOT, RAMCONSOLE);
+    compute_event_id(key, SYS_REBOOT, RAMCONSOLE);
     raise_event(key, SYS_REBOOT, RAMCONSOLE, NULL, NULL);
     LOGE("%-8s%-22s%-20s%s\n", SYS_REBOOT, key, get_current_time_long(0), RAMCONSOLE);
-    free(key);
 
 #ifdef CONFIG_RAMDUMP_CRASHLOG
     request_cold_reset();
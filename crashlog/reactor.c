@@ -0,0 +1,199 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file reactor.c
+ * @brief File containing the crashlogd event loop.
+ *
+ * Each source is kept in a static slot whose address is stored in the epoll
+ * event data, so dispatching a ready source does not require any lookup.
+ */
+
+#include "reactor.h"
+#include "privconfig.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#define LOG_PREFIX "reactor: "
+
+#define REACTOR_MAX_SOURCES     16
+#define REACTOR_MAX_EVENTS      8
+
+struct reactor_source {
+    int fd;
+    int timer;
+    reactor_callback callback;
+    void *ctx;
+};
+
+static struct reactor_source sources[REACTOR_MAX_SOURCES];
+static int epoll_fd = -1;
+static struct reactor_stats stats;
+
+/**
+ * @brief Creates the epoll instance
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int reactor_init() {
+    int idx;
+
+    if (epoll_fd >= 0)
+        return 0;
+
+    for (idx = 0 ; idx < REACTOR_MAX_SOURCES ; idx++)
+        sources[idx].fd = -1;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        LOGE(LOG_PREFIX "%s: epoll_create1 failed - %s\n", __FUNCTION__, strerror(errno));
+        return -errno;
+    }
+    return 0;
+}
+
+static int reactor_register(int fd, int timer, reactor_callback callback, void *ctx) {
+    struct epoll_event ev;
+    int idx;
+
+    if (epoll_fd < 0 || fd < 0 || !callback)
+        return -EINVAL;
+
+    for (idx = 0 ; idx < REACTOR_MAX_SOURCES ; idx++) {
+        if (sources[idx].fd < 0)
+            break;
+    }
+    if (idx == REACTOR_MAX_SOURCES) {
+        LOGE(LOG_PREFIX "%s: Too many sources, cannot add fd %d\n", __FUNCTION__, fd);
+        return -ENOSPC;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = &sources[idx];
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOGE(LOG_PREFIX "%s: Cannot add fd %d - %s\n", __FUNCTION__, fd, strerror(errno));
+        return -errno;
+    }
+    sources[idx].fd = fd;
+    sources[idx].timer = timer;
+    sources[idx].callback = callback;
+    sources[idx].ctx = ctx;
+    return 0;
+}
+
+/**
+ * @brief Registers a source, callback being called each time fd is readable
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int reactor_add_fd(int fd, reactor_callback callback, void *ctx) {
+    return reactor_register(fd, 0, callback, ctx);
+}
+
+int reactor_del_fd(int fd) {
+    int idx;
+
+    for (idx = 0 ; idx < REACTOR_MAX_SOURCES ; idx++) {
+        if (sources[idx].fd != fd)
+            continue;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        if (sources[idx].timer)
+            close(fd);
+        sources[idx].fd = -1;
+        return 0;
+    }
+    return -ENOENT;
+}
+
+/**
+ * @brief Registers a periodic timer, callback being called every period
+ * seconds
+ *
+ * @return the timer fd on success, a negative errno value on failure.
+ */
+int reactor_add_timer(unsigned int period, reactor_callback callback, void *ctx) {
+    struct itimerspec spec;
+    int fd, res;
+
+    if (!period)
+        return -EINVAL;
+
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        LOGE(LOG_PREFIX "%s: timerfd_create failed - %s\n", __FUNCTION__, strerror(errno));
+        return -errno;
+    }
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = spec.it_interval.tv_sec = period;
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0) {
+        res = -errno;
+        LOGE(LOG_PREFIX "%s: timerfd_settime failed - %s\n", __FUNCTION__, strerror(errno));
+        close(fd);
+        return res;
+    }
+
+    if ((res = reactor_register(fd, 1, callback, ctx)) < 0) {
+        close(fd);
+        return res;
+    }
+    return fd;
+}
+
+/**
+ * @brief Waits for the ready sources and calls their callbacks
+ *
+ * @param timeout_ms maximum time to wait, -1 to wait until a source is ready
+ *
+ * @return number of sources dispatched, a negative errno value on failure.
+ */
+int reactor_run_once(int timeout_ms) {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    struct reactor_source *source;
+    uint64_t expirations;
+    int nb, idx;
+
+    nb = epoll_wait(epoll_fd, events, REACTOR_MAX_EVENTS, timeout_ms);
+    if (nb < 0)
+        return (errno == EINTR ? 0 : -errno);
+
+    stats.wakeups++;
+    for (idx = 0 ; idx < nb ; idx++) {
+        source = (struct reactor_source *)events[idx].data.ptr;
+        /* the source may have been removed by a previous callback */
+        if (source->fd < 0)
+            continue;
+        if (source->timer) {
+            if (read(source->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                continue;
+            stats.expirations += expirations;
+        }
+        stats.events++;
+        source->callback(source->fd, source->ctx);
+    }
+    return nb;
+}
+
+void reactor_get_stats(struct reactor_stats *out) {
+    if (out)
+        *out = stats;
+}
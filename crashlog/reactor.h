@@ -0,0 +1,47 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file reactor.h
+ * @brief File containing the crashlogd event loop.
+ *
+ * The event sources (inotify, mmgr, kct, lct...) are registered once with a
+ * callback in an epoll instance. The periodic tasks are timerfd sources, so
+ * the loop only wakes up when a source is ready or a timer expires.
+ */
+
+#ifndef __REACTOR_H__
+#define __REACTOR_H__
+
+/* The callback API is:
+ * fd is the ready file descriptor, ctx the pointer given at registration
+ */
+typedef void (*reactor_callback) (int fd, void *ctx);
+
+struct reactor_stats {
+    unsigned long wakeups;      /* epoll_wait returns */
+    unsigned long events;       /* sources dispatched */
+    unsigned long expirations;  /* timers expirations */
+};
+
+int reactor_init();
+int reactor_add_fd(int fd, reactor_callback callback, void *ctx);
+int reactor_del_fd(int fd);
+int reactor_add_timer(unsigned int period, reactor_callback callback, void *ctx);
+int reactor_run_once(int timeout_ms);
+void reactor_get_stats(struct reactor_stats *stats);
+
+#endif /* __REACTOR_H__ */
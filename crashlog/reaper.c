@@ -0,0 +1,272 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file reaper.c
+ * @brief File containing functions to delete the recycled crash folders.
+ *
+ * A disposed path is renamed into the trash directory of its parent, which
+ * is registered when first used. The reaper thread runs with the idle I/O
+ * priority: it sleeps until a kick, then empties every registered trash
+ * directory with fdopendir/unlinkat so no path is rebuilt per entry.
+ */
+
+#include "reaper.h"
+#include "privconfig.h"
+#include "fsutils.h"
+#include "quota.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define LOG_PREFIX "reaper: "
+
+#define REAPER_MAX_TRASH        8
+
+#define IOPRIO_WHO_PROCESS      1
+#define IOPRIO_CLASS_IDLE       3
+#define IOPRIO_CLASS_SHIFT      13
+
+/* trash directories emptied at start, they may hold the folders disposed
+ * before a reboot */
+static const char *startup_trash[] = {
+    LOGS_DIR "/" TRASH_DIR_NAME,
+    SDCARD_LOGS_DIR "/" TRASH_DIR_NAME,
+};
+
+static char *trash_dirs[REAPER_MAX_TRASH];
+static int nbtrash = 0;
+static int pending = 0;
+static int started = 0;
+static unsigned int dispose_seq = 0;
+static struct reaper_stats stats;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* Deletes the entry name of the directory dirfd, recursively. Returns the
+ * number of entries deleted */
+static unsigned long remove_at(int dirfd, const char *name) {
+    unsigned long count = 0;
+    struct dirent *de;
+    DIR *d;
+    int fd;
+
+    if (!unlinkat(dirfd, name, 0))
+        return 1;
+    if (errno != EISDIR && errno != EPERM)
+        return 0;
+
+    fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    if ((d = fdopendir(fd)) == NULL) {
+        close(fd);
+        return 0;
+    }
+    while ((de = readdir(d)) != NULL) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+        count += remove_at(fd, de->d_name);
+    }
+    closedir(d);
+
+    if (unlinkat(dirfd, name, AT_REMOVEDIR) < 0) {
+        LOGE(LOG_PREFIX "%s: Cannot remove %s - %s\n", __FUNCTION__, name, strerror(errno));
+        return count;
+    }
+    return count + 1;
+}
+
+static void empty_trash(const char *trash) {
+    unsigned long count = 0;
+    struct dirent *de;
+    DIR *d;
+    int fd;
+
+    fd = open(trash, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    if ((d = fdopendir(fd)) == NULL) {
+        close(fd);
+        return;
+    }
+    while ((de = readdir(d)) != NULL) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+        count += remove_at(fd, de->d_name);
+    }
+    closedir(d);
+
+    pthread_mutex_lock(&lock);
+    stats.deleted += count;
+    pthread_mutex_unlock(&lock);
+}
+
+/* Called with lock held: returns whether the trash is registered */
+static int register_trash(const char *trash) {
+    int idx;
+
+    for (idx = 0 ; idx < nbtrash ; idx++) {
+        if (!strcmp(trash_dirs[idx], trash))
+            return 1;
+    }
+    if (nbtrash == REAPER_MAX_TRASH || (trash_dirs[nbtrash] = strdup(trash)) == NULL)
+        return 0;
+    nbtrash++;
+    return 1;
+}
+
+static void *reaper_thread(void __attribute__((unused)) *arg) {
+    char *dirs[REAPER_MAX_TRASH];
+    int idx, nb;
+
+    /* the deletions only use the disk when nothing else does */
+    if (syscall(__NR_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+            IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) < 0)
+        LOGW(LOG_PREFIX "%s: Cannot set the idle I/O priority - %s\n",
+            __FUNCTION__, strerror(errno));
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!pending)
+            pthread_cond_wait(&cond, &lock);
+        pending = 0;
+        nb = nbtrash;
+        memcpy(dirs, trash_dirs, nb * sizeof(dirs[0]));
+        stats.runs++;
+        pthread_mutex_unlock(&lock);
+
+        for (idx = 0 ; idx < nb ; idx++)
+            empty_trash(dirs[idx]);
+
+        pthread_mutex_lock(&lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the reaper thread
+ *
+ * The leftovers of the default trash directories are deleted first. When
+ * the thread cannot be started, the trash is emptied by reaper_kick.
+ *
+ * @return 0 on success, a negative errno value on failure.
+ */
+int reaper_init() {
+    pthread_t thread;
+    unsigned int idx;
+    int res;
+
+    if (started)
+        return 0;
+
+    res = pthread_create(&thread, NULL, reaper_thread, NULL);
+    if (res) {
+        LOGE(LOG_PREFIX "%s: Cannot create the reaper thread - %s\n",
+            __FUNCTION__, strerror(res));
+        return -res;
+    }
+    pthread_detach(thread);
+    started = 1;
+
+    for (idx = 0 ; idx < DIM(startup_trash) ; idx++) {
+        if (directory_exists((char *)startup_trash[idx]))
+            reaper_kick(startup_trash[idx]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Requests the deletion of the content of a trash directory
+ */
+void reaper_kick(const char *trash) {
+    if (!trash)
+        return;
+
+    pthread_mutex_lock(&lock);
+    if (!started || !register_trash(trash)) {
+        pthread_mutex_unlock(&lock);
+        empty_trash(trash);
+        return;
+    }
+    pending = 1;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Deletes a file or a directory in the background
+ *
+ * The path is renamed into the trash directory of its parent, then the
+ * reaper is kicked. If the path cannot be renamed, it is deleted at once.
+ *
+ * @param path to delete
+ * @return 0 on success, a negative errno value on failure.
+ */
+int reaper_dispose(const char *path) {
+    char trash[PATHMAX], dest[PATHMAX];
+    const char *base;
+    unsigned int seq;
+    int len;
+
+    if (!path || (base = strrchr(path, '/')) == NULL || !base[1])
+        return -EINVAL;
+
+    snprintf(trash, sizeof(trash), "%.*s/" TRASH_DIR_NAME, (int)(base - path), path);
+    if (mkdir(trash, 0770) < 0 && errno != EEXIST)
+        LOGW(LOG_PREFIX "%s: Cannot create %s - %s\n", __FUNCTION__, trash, strerror(errno));
+
+    pthread_mutex_lock(&lock);
+    seq = dispose_seq++;
+    stats.disposed++;
+    pthread_mutex_unlock(&lock);
+
+    /* the time keeps the names unique with the leftovers of a previous run */
+    len = snprintf(dest, sizeof(dest), "%s/%lx.%u_%s", trash, (unsigned long)time(NULL), seq, base + 1);
+    if (len < 0 || len >= (int)sizeof(dest))
+        errno = ENAMETOOLONG;
+    else if (rename(path, dest) == 0) {
+        quota_forget(path);
+        reaper_kick(trash);
+        return 0;
+    } else if (errno == ENOENT)
+        return -ENOENT;
+
+    LOGW(LOG_PREFIX "%s: Cannot move %s to the trash - %s, delete it\n", __FUNCTION__,
+        path, strerror(errno));
+    if (rmfr((char *)path) < 0)
+        return -errno;
+    quota_forget(path);
+    return 0;
+}
+
+void reaper_get_stats(struct reaper_stats *out) {
+    if (!out)
+        return;
+
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
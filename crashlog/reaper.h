@@ -0,0 +1,41 @@
+/* Copyright (C) Intel 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file reaper.h
+ * @brief File containing functions to delete the recycled crash folders.
+ *
+ * The crash folders recycled by the allocator are renamed into a trash
+ * directory, whose content is deleted in the background so the events do
+ * not wait for a recursive delete. The deletions run with the idle I/O
+ * priority, and the trash left by a previous run is emptied at start.
+ */
+
+#ifndef __REAPER_H__
+#define __REAPER_H__
+
+struct reaper_stats {
+    unsigned long disposed;     /* paths moved to a trash directory */
+    unsigned long deleted;      /* files and directories deleted */
+    unsigned long runs;         /* passes over the trash directories */
+};
+
+int reaper_init();
+void reaper_kick(const char *trash);
+int reaper_dispose(const char *path);
+void reaper_get_stats(struct reaper_stats *stats);
+
+#endif /* __REAPER_H__ */
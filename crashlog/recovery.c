@@ -28,7 +28,7 @@
 int crashlog_check_recovery() {
     char destination[PATHMAX];
     char *dir;
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     //Check if trigger file exists
     if ( !file_exists(RECOVERY_ERROR_TRIGGER) ) {
@@ -36,14 +36,13 @@ int crashlog_check_recovery() {
         return 0;
     }
 
-    key = generate_event_id(CRASHEVENT, RECOVERY_ERROR);
+    compute_event_id(key, CRASHEVENT, RECOVERY_ERROR);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir) {
         LOGE("%s: Cannot get a valid new crash directory...\n", __FUNCTION__);
         raise_event(key, CRASHEVENT, RECOVERY_ERROR, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), RECOVERY_ERROR);
         remove(RECOVERY_ERROR_TRIGGER);
-        free(key);
         return -1;
     }
 
@@ -56,7 +55,6 @@ int crashlog_check_recovery() {
     raise_event(key, CRASHEVENT, RECOVERY_ERROR, NULL, dir);
     LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0), RECOVERY_ERROR, dir);
     remove(RECOVERY_ERROR_TRIGGER);
-    free(key);
     free(dir);
 
     return 0;
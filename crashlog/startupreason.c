@@ -507,7 +507,7 @@ int read_shutdownsource(char * shutdownsource)
 int crashlog_check_startupreason(char *reason, char *watchdog) {
     const char *dateshort = get_current_time_short(1);
     char *dir;
-    char *key;
+    char key[EVENT_ID_SIZE];
 
     LOGV("%s: reason:%s watchdog:%s\n", __FUNCTION__, reason, watchdog);
 #ifdef CONFIG_SOFIA
@@ -530,13 +530,12 @@ int crashlog_check_startupreason(char *reason, char *watchdog) {
         return 0;
     }
 
-    key = generate_event_id(CRASHEVENT, watchdog);
+    compute_event_id(key, CRASHEVENT, watchdog);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir) {
         LOGE("%s: generate_crashlog_dir failed\n", __FUNCTION__);
         raise_event(key, CRASHEVENT, watchdog, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), "WDT");
-        free(key);
         return -1;
     }
 
@@ -548,7 +547,6 @@ int crashlog_check_startupreason(char *reason, char *watchdog) {
     do_last_kmsg_copy(dir);
     do_last_fw_msg_copy(dir);
     free(dir);
-    free(key);
 
     return 0;
 }
@@ -20,14 +20,15 @@ typedef struct {
 static stubproperty cache[MAX_PROPERTIES] = { {{0,}, {0,}}, };
 
 int file_to_cache() {
-    int fd, res, idx = 0, len;
+    int res, idx = 0, len;
     char tmpbuf[MAXLINESIZE];
     char *pvalue;
+    struct line_reader lr;
     
-    fd = open(DEFAULT_PROPS, O_RDONLY);
-    if (fd < 0) return -errno;
+    res = line_reader_open(&lr, DEFAULT_PROPS, O_RDONLY);
+    if (res < 0) return res;
     
-    while ( idx < MAX_PROPERTIES && (res = readline(fd, tmpbuf)) > 0) {
+    while ( idx < MAX_PROPERTIES && (res = line_reader_next(&lr, tmpbuf)) > 0) {
         len = strlen(tmpbuf);
 		if (tmpbuf[len-1] == '\n') tmpbuf[len-1] = 0;
         pvalue = strchr(tmpbuf, '=');
@@ -43,6 +44,7 @@ int file_to_cache() {
             __FUNCTION__, idx, cache[idx].key, cache[idx].value);*/
         idx++;
     }
+    line_reader_close(&lr);
     return res;
 }
 
@@ -0,0 +1,203 @@
+#define _XOPEN_SOURCE 700
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <privconfig.h>
+#include <checksum.h>
+
+#define TEST_DIR    "/tmp/test_checksum"
+#define NB_DIRS     8
+#define NB_FILES    25
+
+static const char *exceptions[] = {
+    TEST_DIR "/excluded",
+    NULL
+};
+
+/* fsutils stub */
+ssize_t do_read(int fd, void *buf, size_t len) {
+    ssize_t nr;
+
+    do {
+        nr = read(fd, buf, len);
+    } while (nr < 0 && (errno == EAGAIN || errno == EINTR));
+    return nr;
+}
+
+static long long now_ms() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static int skipped = 0;
+
+static void skipped_callback(const char __attribute__((unused)) *file,
+        mode_t __attribute__((unused)) mode) {
+    skipped++;
+}
+
+static void create_file(const char *path, size_t size, char fill) {
+    char data[4096];
+    size_t len;
+    int fd;
+
+    memset(data, fill, sizeof(data));
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if (fd < 0)
+        return;
+    for ( ; size ; size -= len) {
+        len = size < sizeof(data) ? size : sizeof(data);
+        if (write(fd, data, len) < 0)
+            break;
+    }
+    close(fd);
+}
+
+/* Creates NB_DIRS directories of NB_FILES files of various sizes, a fifo
+ * and an excluded file */
+static void populate() {
+    char path[PATHMAX];
+    int dir, file;
+
+    for (dir = 0 ; dir < NB_DIRS ; dir++) {
+        snprintf(path, sizeof(path), "%s/dir%d", TEST_DIR, dir);
+        mkdir(path, 0770);
+        for (file = 0 ; file < NB_FILES ; file++) {
+            snprintf(path, sizeof(path), "%s/dir%d/file%d", TEST_DIR, dir, file);
+            create_file(path, (file % 5) * 64 * KB + file, 'a' + dir);
+        }
+    }
+    create_file(TEST_DIR "/excluded", 100, 'x');
+    mkfifo(TEST_DIR "/fifo", 0660);
+}
+
+/* Serial reference: the sorted paths and the checksum of each file,
+ * computed one by one */
+static char *ref_paths[NB_DIRS * NB_FILES + 16];
+static int ref_hashed[NB_DIRS * NB_FILES + 16];
+static int ref_count = 0;
+
+static int ref_collect(const char *fpath, const struct stat *sb, int tflag,
+        struct FTW __attribute__((unused)) *ftwbuf) {
+    if (ref_count == (int)(sizeof(ref_paths) / sizeof(ref_paths[0])))
+        return -1;
+    ref_hashed[ref_count] = tflag == FTW_F && S_ISREG(sb->st_mode) && strcmp(fpath, exceptions[0]);
+    ref_paths[ref_count++] = strdup(fpath);
+    return 0;
+}
+
+static int ref_compare(const void *idx1, const void *idx2) {
+    return strcmp(ref_paths[*(const int *)idx1], ref_paths[*(const int *)idx2]);
+}
+
+static int ref_checksum(unsigned char *result) {
+    unsigned char digest[CRASHLOG_CHECKSUM_SIZE];
+    int order[NB_DIRS * NB_FILES + 16];
+    SHA_CTX context;
+    int idx;
+
+    ref_count = 0;
+    if (nftw(TEST_DIR, ref_collect, 16, 0) < 0)
+        return -1;
+    for (idx = 0 ; idx < ref_count ; idx++)
+        order[idx] = idx;
+    qsort(order, ref_count, sizeof(order[0]), ref_compare);
+
+    SHA1_Init(&context);
+    for (idx = 0 ; idx < ref_count ; idx++) {
+        const char *path = ref_paths[order[idx]];
+
+        SHA1_Update(&context, path, strlen(path) + 1);
+        if (ref_hashed[order[idx]] && !calculate_checksum_file(path, digest))
+            SHA1_Update(&context, digest, sizeof(digest));
+    }
+    SHA1_Final(result, &context);
+    for (idx = 0 ; idx < ref_count ; idx++)
+        free(ref_paths[idx]);
+    return 0;
+}
+
+/* The tree checksum is the serial reference, whatever the number of threads */
+void test_checksum_tree_reference() {
+    unsigned char ref[CRASHLOG_CHECKSUM_SIZE], sum[CRASHLOG_CHECKSUM_SIZE];
+    unsigned int nbthreads;
+
+    if (ref_checksum(ref) < 0) {
+        printf("%s failed; cannot compute the reference\n", __FUNCTION__);
+        return;
+    }
+    for (nbthreads = 1 ; nbthreads <= 4 ; nbthreads++) {
+        skipped = 0;
+        if (calculate_checksum_tree(TEST_DIR, sum, skipped_callback, exceptions, nbthreads) ||
+                memcmp(ref, sum, sizeof(sum)) || skipped != 1) {
+            printf("%s failed; %u threads differ from the serial reference (%d skipped)\n",
+                __FUNCTION__, nbthreads, skipped);
+            return;
+        }
+    }
+    printf("%s succeeded\n", __FUNCTION__);
+}
+
+/* The tree checksum detects the changes the directory checksum detects */
+void test_checksum_tree_changes() {
+    unsigned char dir1[CRASHLOG_CHECKSUM_SIZE], dir2[CRASHLOG_CHECKSUM_SIZE];
+    unsigned char tree1[CRASHLOG_CHECKSUM_SIZE], tree2[CRASHLOG_CHECKSUM_SIZE];
+    int dir_changed, tree_changed;
+
+    calculate_checksum_directory(TEST_DIR, dir1, NULL, exceptions);
+    calculate_checksum_tree(TEST_DIR, tree1, NULL, exceptions, 0);
+    create_file(TEST_DIR "/excluded", 200, 'y');
+    calculate_checksum_directory(TEST_DIR, dir2, NULL, exceptions);
+    calculate_checksum_tree(TEST_DIR, tree2, NULL, exceptions, 0);
+    if (memcmp(dir1, dir2, sizeof(dir1)) || memcmp(tree1, tree2, sizeof(tree1))) {
+        printf("%s failed; an excluded file changed the checksum\n", __FUNCTION__);
+        return;
+    }
+
+    create_file(TEST_DIR "/dir3/file7", 100, 'z');
+    calculate_checksum_directory(TEST_DIR, dir2, NULL, exceptions);
+    calculate_checksum_tree(TEST_DIR, tree2, NULL, exceptions, 0);
+    dir_changed = memcmp(dir1, dir2, sizeof(dir1)) != 0;
+    tree_changed = memcmp(tree1, tree2, sizeof(tree1)) != 0;
+    if (dir_changed && tree_changed)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; changed: directory %d, tree %d\n", __FUNCTION__, dir_changed, tree_changed);
+}
+
+void test_checksum_tree_timing() {
+    unsigned char sum[CRASHLOG_CHECKSUM_SIZE];
+    long long start, serial, parallel;
+
+    start = now_ms();
+    calculate_checksum_directory(TEST_DIR, sum, NULL, exceptions);
+    serial = now_ms() - start;
+    start = now_ms();
+    calculate_checksum_tree(TEST_DIR, sum, NULL, exceptions, 0);
+    parallel = now_ms() - start;
+    printf("%s succeeded; %lld ms serial, %lld ms on %ld CPUs\n", __FUNCTION__, serial, parallel,
+        sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (system("rm -rf " TEST_DIR) || mkdir(TEST_DIR, 0770) < 0) {
+        printf("cannot create %s\n", TEST_DIR);
+        return -1;
+    }
+    populate();
+    test_checksum_tree_reference();
+    test_checksum_tree_timing();
+    test_checksum_tree_changes();
+    system("rm -rf " TEST_DIR);
+    return 0;
+}
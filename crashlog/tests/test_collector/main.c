@@ -0,0 +1,234 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <cutils/properties.h>
+
+#include <privconfig.h>
+#include <collector.h>
+
+#define TEST_JOBS           60
+#define TEST_TYPES          4
+#define TEST_TIMEOUT        10      /* seconds */
+#define TEST_BLOCKED_JOBS   (4 * COLLECTOR_QUEUE_SIZE)
+
+int property_get(char __attribute__((unused)) *name, char *value, char *def) {
+    if (!value) return -EINVAL;
+    strncpy(value, def ? def : "", PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+int property_set(char __attribute__((unused)) *name, char __attribute__((unused)) *value) {
+    return 0;
+}
+
+static pthread_mutex_t test_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int running = 0;
+static unsigned int max_running = 0;
+static unsigned int type_running[EVENT_TYPE_NUMBER];
+static unsigned int type_overlaps = 0;
+static int next_line = 0;
+static unsigned int misordered = 0;
+static unsigned int notifications = 0;
+static const char *current_test = "";
+static int head_blocked = 0;
+static unsigned int fast_done = 0;
+static pthread_cond_t head_cond = PTHREAD_COND_INITIALIZER;
+
+/* Called by the thread committing the jobs: the collector lock shall not
+ * be held, collector_get_stats would never return */
+int history_commit_line(const char *line) {
+    struct collector_stats stats;
+
+    collector_get_stats(&stats);
+    pthread_mutex_lock(&test_lock);
+    if (atoi(line) != next_line)
+        misordered++;
+    next_line++;
+    pthread_mutex_unlock(&test_lock);
+    return 0;
+}
+
+void notify_crashreport() {
+    struct collector_stats stats;
+
+    collector_get_stats(&stats);
+    pthread_mutex_lock(&test_lock);
+    notifications++;
+    pthread_mutex_unlock(&test_lock);
+}
+
+/* The later jobs are the shorter ones so they are done first */
+static int on_job(struct watch_entry *entry, struct inotify_event *event) {
+    int seq = atoi(event->name);
+
+    pthread_mutex_lock(&test_lock);
+    if (++running > max_running)
+        max_running = running;
+    if (++type_running[entry->eventtype] > 1)
+        type_overlaps++;
+    pthread_mutex_unlock(&test_lock);
+
+    usleep(1000 * (TEST_JOBS - seq) / 10);
+    collector_defer_history(event->name);
+    collector_defer_notify();
+
+    pthread_mutex_lock(&test_lock);
+    running--;
+    type_running[entry->eventtype]--;
+    pthread_mutex_unlock(&test_lock);
+    return 1;
+}
+
+/* The job at the head of the queue, blocked as a long gzip would be */
+static int on_blocked_job(struct watch_entry __attribute__((unused)) *entry,
+        struct inotify_event *event) {
+    collector_defer_history(event->name);
+    pthread_mutex_lock(&test_lock);
+    while (head_blocked)
+        pthread_cond_wait(&head_cond, &test_lock);
+    pthread_mutex_unlock(&test_lock);
+    return 1;
+}
+
+static int on_fast_job(struct watch_entry __attribute__((unused)) *entry,
+        struct inotify_event *event) {
+    collector_defer_history(event->name);
+    collector_defer_notify();
+    pthread_mutex_lock(&test_lock);
+    fast_done++;
+    pthread_mutex_unlock(&test_lock);
+    return 1;
+}
+
+static void on_timeout(int __attribute__((unused)) sig) {
+    const char msg[] = " failed; jobs not committed in time\n";
+
+    write(STDOUT_FILENO, current_test, strlen(current_test));
+    write(STDOUT_FILENO, msg, sizeof(msg) - 1);
+    _exit(1);
+}
+
+/* Jobs of several types run at the same time, at most one per type, and
+ * their history lines are committed in the submission order */
+void test_collector_jobs() {
+    struct watch_entry entries[TEST_TYPES];
+    struct {
+        struct inotify_event event;
+        char name[16];
+    } ev;
+    struct collector_stats stats;
+    int idx;
+
+    memset(entries, 0, sizeof(entries));
+    for (idx = 0 ; idx < TEST_TYPES ; idx++) {
+        entries[idx].eventtype = LOST_TYPE + idx;
+        entries[idx].pcallback = on_job;
+    }
+
+    current_test = __FUNCTION__;
+    signal(SIGALRM, on_timeout);
+    alarm(TEST_TIMEOUT);
+    for (idx = 0 ; idx < TEST_JOBS ; idx++) {
+        memset(&ev, 0, sizeof(ev));
+        ev.event.len = snprintf(ev.name, sizeof(ev.name), "%d", idx) + 1;
+        if (collector_submit(&entries[idx % TEST_TYPES], &ev.event) != 1) {
+            printf("%s failed; job %d not queued\n", __FUNCTION__, idx);
+            return;
+        }
+    }
+    do {
+        usleep(10000);
+        collector_get_stats(&stats);
+    } while (stats.completed != stats.submitted);
+    alarm(0);
+
+    if (max_running < 2 || type_overlaps || misordered ||
+            next_line != TEST_JOBS || notifications != TEST_JOBS)
+        printf("%s failed; %u running at most, %u overlaps, %u misordered,"
+            " %d lines, %u notifications\n", __FUNCTION__, max_running,
+            type_overlaps, misordered, next_line, notifications);
+    else printf("%s succeeded\n", __FUNCTION__);
+}
+
+/* A job blocked at the head of the queue does not hold back the
+ * submissions: the jobs done after it free their slot and are committed
+ * once it is done, in the submission order */
+void test_collector_blocked_head() {
+    struct watch_entry blocked, entries[TEST_TYPES - 1];
+    struct {
+        struct inotify_event event;
+        char name[16];
+    } ev;
+    struct collector_stats stats;
+    unsigned int done, committed;
+    int idx, seq = TEST_JOBS;
+
+    memset(&blocked, 0, sizeof(blocked));
+    blocked.eventtype = LOST_TYPE;
+    blocked.pcallback = on_blocked_job;
+    memset(entries, 0, sizeof(entries));
+    for (idx = 0 ; idx < TEST_TYPES - 1 ; idx++) {
+        entries[idx].eventtype = LOST_TYPE + 1 + idx;
+        entries[idx].pcallback = on_fast_job;
+    }
+
+    current_test = __FUNCTION__;
+    alarm(TEST_TIMEOUT);
+    head_blocked = 1;
+    memset(&ev, 0, sizeof(ev));
+    ev.event.len = snprintf(ev.name, sizeof(ev.name), "%d", seq++) + 1;
+    collector_submit(&blocked, &ev.event);
+    for (idx = 0 ; idx < TEST_BLOCKED_JOBS ; idx++) {
+        memset(&ev, 0, sizeof(ev));
+        ev.event.len = snprintf(ev.name, sizeof(ev.name), "%d", seq++) + 1;
+        if (collector_submit(&entries[idx % (TEST_TYPES - 1)], &ev.event) != 1) {
+            printf("%s failed; job %d not queued\n", __FUNCTION__, idx);
+            return;
+        }
+    }
+    do {
+        usleep(10000);
+        pthread_mutex_lock(&test_lock);
+        done = fast_done;
+        pthread_mutex_unlock(&test_lock);
+    } while (done != TEST_BLOCKED_JOBS);
+    collector_get_stats(&stats);
+    pthread_mutex_lock(&test_lock);
+    committed = next_line;
+    head_blocked = 0;
+    pthread_cond_broadcast(&head_cond);
+    pthread_mutex_unlock(&test_lock);
+
+    if (committed != TEST_JOBS || stats.depth != TEST_BLOCKED_JOBS + 1) {
+        printf("%s failed; %u lines committed, depth %u behind the blocked job\n",
+            __FUNCTION__, committed, stats.depth);
+        return;
+    }
+    do {
+        usleep(10000);
+        collector_get_stats(&stats);
+    } while (stats.completed != stats.submitted);
+    alarm(0);
+
+    if (misordered || next_line != seq || notifications != TEST_JOBS + TEST_BLOCKED_JOBS)
+        printf("%s failed; %u misordered, %d lines, %u notifications\n", __FUNCTION__,
+            misordered, next_line, notifications);
+    else printf("%s succeeded\n", __FUNCTION__);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (collector_init() < 2) {
+        printf("collector_init failed\n");
+        return -1;
+    }
+    test_collector_jobs();
+    test_collector_blocked_head();
+    return 0;
+}
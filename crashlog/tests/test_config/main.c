@@ -0,0 +1,164 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <config.h>
+
+#define TEST_DIR            "/tmp/test_config"
+#define INGREDIENTS_CONF    "../intel_specific/ingredients.conf"
+#define NB_SECTIONS         100
+#define NB_KEYS             20
+
+static long long now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Reference lookup, walking the lists as config.c did before the index */
+static char *walk_value(char *section, char *name, pconfig_handle handle) {
+    psection s;
+    pkv kv;
+
+    for (s = handle->first ; s ; s = s->next) {
+        if (strcmp(s->name, section))
+            continue;
+        for (kv = s->kvlist ; kv ; kv = kv->next) {
+            if (!strcmp(kv->key, name))
+                return kv->value;
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+/* Writes NB_SECTIONS sections of NB_KEYS keys, then optionally repeats a key
+ * in the last section and the first section */
+static int create_synthetic(const char *path, int duplicates) {
+    FILE *fp;
+    int section, key;
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+    fprintf(fp, "# synthetic config\n");
+    for (section = 0 ; section < NB_SECTIONS ; section++) {
+        fprintf(fp, "\n[SECTION%d]\n", section);
+        for (key = 0 ; key < NB_KEYS ; key++)
+            fprintf(fp, "key%d=value%d_%d\n", key, section, key);
+    }
+    if (duplicates)
+        fprintf(fp, "key0=duplicate\n\n[SECTION0]\nkey0=duplicate\nextra=only\n");
+    fclose(fp);
+    return 0;
+}
+
+/* Every lookup returns what a list walk returns, and the dump keeps the
+ * order of the file */
+void test_config_lookup(const char *path) {
+    struct config_handle handle, reloaded;
+    char section[32], key[32], *value;
+    int idx, jdx;
+
+    handle.first = NULL;
+    handle.current = NULL;
+    if (init_config_file(path, &handle) < 0) {
+        printf("%s failed; cannot load %s\n", __FUNCTION__, path);
+        return;
+    }
+    for (idx = 0 ; idx < NB_SECTIONS ; idx++) {
+        snprintf(section, sizeof(section), "SECTION%d", idx);
+        for (jdx = 0 ; jdx < NB_KEYS + 1 ; jdx++) {
+            snprintf(key, sizeof(key), "key%d", jdx);
+            /* both would return the section of the previous lookup */
+            handle.current = NULL;
+            value = get_value(section, key, &handle);
+            if (value != walk_value(section, key, &handle)) {
+                printf("%s failed; %s/%s returned %s\n", __FUNCTION__, section, key, value);
+                free_config_file(&handle);
+                return;
+            }
+        }
+    }
+    handle.current = NULL;
+    if (strcmp(get_value("SECTION99", "key0", &handle), "value99_0") ||
+            get_value("SECTION0", "extra", &handle) || get_value("NOSECTION", "key0", &handle) ||
+            !sk_exists("SECTION1", "key1", &handle) || sk_exists("SECTION1", "nokey", &handle)) {
+        printf("%s failed; duplicated or missing items\n", __FUNCTION__);
+        free_config_file(&handle);
+        return;
+    }
+
+    reloaded.first = NULL;
+    reloaded.current = NULL;
+    if (dump_config(TEST_DIR "/dump.conf", &handle) || init_config_file(TEST_DIR "/dump.conf", &reloaded) < 0 ||
+            cmp_config(&handle, &reloaded))
+        printf("%s failed; the dump differs from the config\n", __FUNCTION__);
+    else printf("%s succeeded\n", __FUNCTION__);
+    free_config_file(&reloaded);
+    free_config_file(&handle);
+}
+
+/* Looks up every key of the config nbloops times, with the index and with
+ * a list walk */
+void test_config_benchmark(const char *path, int nbloops, int must_be_faster) {
+    struct config_handle handle;
+    long long start, indexed, walked;
+    unsigned long count = 0;
+    psection s;
+    pkv kv;
+    int loop, res = 0;
+
+    handle.first = NULL;
+    handle.current = NULL;
+    if (init_config_file(path, &handle) < 0) {
+        printf("%s failed; cannot load %s\n", __FUNCTION__, path);
+        return;
+    }
+    start = now_ns();
+    for (loop = 0 ; loop < nbloops ; loop++) {
+        for (s = handle.first ; s ; s = s->next) {
+            for (kv = s->kvlist ; kv ; kv = kv->next) {
+                /* the cached current section would hide the section lookup */
+                handle.current = NULL;
+                res |= get_value(s->name, kv->key, &handle) == NULL;
+                count++;
+            }
+        }
+    }
+    indexed = now_ns() - start;
+    start = now_ns();
+    for (loop = 0 ; loop < nbloops ; loop++) {
+        for (s = handle.first ; s ; s = s->next) {
+            for (kv = s->kvlist ; kv ; kv = kv->next)
+                res |= walk_value(s->name, kv->key, &handle) == NULL;
+        }
+    }
+    walked = now_ns() - start;
+    free_config_file(&handle);
+
+    if (!res && count && (!must_be_faster || indexed < walked))
+        printf("%s (%s) succeeded; %lld ns per lookup, %lld ns per list walk\n", __FUNCTION__, path,
+            indexed / (long long)count, walked / (long long)count);
+    else printf("%s (%s) failed; %lu lookups, %lld ns per lookup, %lld ns per list walk\n",
+        __FUNCTION__, path, count, count ? indexed / (long long)count : 0,
+        count ? walked / (long long)count : 0);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (system("rm -rf " TEST_DIR) || mkdir(TEST_DIR, 0770) < 0 ||
+            create_synthetic(TEST_DIR "/duplicates.conf", 1) < 0 ||
+            create_synthetic(TEST_DIR "/synthetic.conf", 0) < 0) {
+        printf("cannot create %s\n", TEST_DIR);
+        return -1;
+    }
+    test_config_lookup(TEST_DIR "/duplicates.conf");
+    test_config_benchmark(INGREDIENTS_CONF, 10000, 0);
+    test_config_benchmark(TEST_DIR "/synthetic.conf", 20, 1);
+    system("rm -rf " TEST_DIR);
+    return 0;
+}
@@ -8,12 +8,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <stdio.h>
 
+#include <pthread.h>
+
 #include <cutils/properties.h>
-#include <sha1.h>
 
 #include <crashutils.h>
+#include <privconfig.h>
 #include <history.h>
 #include <config.h>
 
@@ -56,6 +59,137 @@ void test_raise_event(char *key, char *event, char *type, char *subtype,
     else printf("%s (%s, %s, %s, %s) failed; returned %d and errno=%d expected_error=%d\n", __FUNCTION__, event, type, subtype, log, res, errno, errno_expected);
 }
 
+/* The crashfile is published complete, with the DATA0 of the mpanic file */
+void test_minimal_crashfile(char *log) {
+    char path[PATHMAX], content[CRASHFILE_MAXSIZE];
+    struct stat info;
+    ssize_t len = -1;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/mpanic.txt", log);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if (fd >= 0) {
+        if (write(fd, "MDM_PANIC_ID\n", 13) != 13)
+            printf("%s: cannot write %s\n", __FUNCTION__, path);
+        close(fd);
+    }
+    raise_event("SHA1_MPANIC", "CRASH", "MPANIC", NULL, log);
+
+    snprintf(path, sizeof(path), "%s/" CRASHFILE_NAME, log);
+    fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        len = read(fd, content, sizeof(content) - 1);
+        close(fd);
+    }
+    if (len > 0)
+        content[len] = '\0';
+    snprintf(path, sizeof(path), "%s/" CRASHFILE_TMP_NAME, log);
+    if (len > 0 && strstr(content, "TYPE=MPANIC\n") && strstr(content, "\nDATA0=MDM_PANIC_ID\n") &&
+            !strcmp(content + len - 5, "_END\n") && stat(path, &info) < 0)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; crashfile of %zd bytes:\n%s\n", __FUNCTION__, len, len > 0 ? content : "");
+}
+
+#define EVENT_ID_THREADS    4
+
+struct event_id_job {
+    char (*keys)[EVENT_ID_SIZE];
+    unsigned int nbkeys;
+};
+
+static void *event_id_worker(void *arg) {
+    struct event_id_job *job = arg;
+    unsigned int idx;
+
+    for (idx = 0 ; idx < job->nbkeys ; idx++)
+        compute_event_id(job->keys[idx], "CRASH", "JAVACRASH");
+    return NULL;
+}
+
+static int compare_keys(const void *key1, const void *key2) {
+    return memcmp(key1, key2, EVENT_ID_SIZE);
+}
+
+/* The ids computed by concurrent threads with the same seeds are unique */
+void test_compute_event_id(unsigned int nbkeys, long max_ns_per_key) {
+    struct event_id_job jobs[EVENT_ID_THREADS];
+    pthread_t threads[EVENT_ID_THREADS];
+    char (*keys)[EVENT_ID_SIZE];
+    struct timespec start, end;
+    unsigned int idx, duplicates = 0, invalid = 0;
+    long ns_per_key;
+
+    keys = calloc(nbkeys, EVENT_ID_SIZE);
+    if (!keys) {
+        printf("%s cannot be tested; allocation failed\n", __FUNCTION__);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (idx = 0 ; idx < EVENT_ID_THREADS ; idx++) {
+        jobs[idx].keys = keys + idx * (nbkeys / EVENT_ID_THREADS);
+        jobs[idx].nbkeys = nbkeys / EVENT_ID_THREADS;
+        pthread_create(&threads[idx], NULL, event_id_worker, &jobs[idx]);
+    }
+    for (idx = 0 ; idx < EVENT_ID_THREADS ; idx++)
+        pthread_join(threads[idx], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns_per_key = ((end.tv_sec - start.tv_sec) * 1000000000L + end.tv_nsec - start.tv_nsec) / nbkeys;
+
+    nbkeys = EVENT_ID_THREADS * (nbkeys / EVENT_ID_THREADS);
+    qsort(keys, nbkeys, EVENT_ID_SIZE, compare_keys);
+    for (idx = 0 ; idx < nbkeys ; idx++) {
+        if (strlen(keys[idx]) != EVENT_ID_SIZE - 1 ||
+                strspn(keys[idx], "0123456789abcdef") != EVENT_ID_SIZE - 1)
+            invalid++;
+        if (idx && !memcmp(keys[idx], keys[idx - 1], EVENT_ID_SIZE))
+            duplicates++;
+    }
+    free(keys);
+
+    if (!duplicates && !invalid && ns_per_key <= max_ns_per_key)
+        printf("%s (%u) succeeded; %ld ns per key\n", __FUNCTION__, nbkeys, ns_per_key);
+    else printf("%s (%u) failed; %u duplicates, %u invalid, %ld ns per key\n",
+        __FUNCTION__, nbkeys, duplicates, invalid, ns_per_key);
+}
+
+#define FOOTPRINT_THREADS   4
+
+static pthread_barrier_t footprint_barrier;
+
+static void *footprint_worker(void *arg) {
+    char *footprint = arg;
+
+    pthread_barrier_wait(&footprint_barrier);
+    strncpy(footprint, get_build_footprint(), SIZE_FOOTPRINT_MAX);
+    return NULL;
+}
+
+/* The first crashfiles of the collector workers are written at the same
+ * time: they read the same footprint, of the 10 fields */
+void test_build_footprint() {
+    char footprints[FOOTPRINT_THREADS][SIZE_FOOTPRINT_MAX + 1];
+    pthread_t threads[FOOTPRINT_THREADS];
+    const char *comma;
+    int idx, fields = 1;
+
+    memset(footprints, 0, sizeof(footprints));
+    pthread_barrier_init(&footprint_barrier, NULL, FOOTPRINT_THREADS);
+    for (idx = 0 ; idx < FOOTPRINT_THREADS ; idx++)
+        pthread_create(&threads[idx], NULL, footprint_worker, footprints[idx]);
+    for (idx = 0 ; idx < FOOTPRINT_THREADS ; idx++)
+        pthread_join(threads[idx], NULL);
+    pthread_barrier_destroy(&footprint_barrier);
+
+    for (comma = strchr(footprints[0], ',') ; comma ; comma = strchr(comma + 1, ','))
+        fields++;
+    for (idx = 1 ; idx < FOOTPRINT_THREADS ; idx++)
+        if (strcmp(footprints[idx], footprints[0]))
+            break;
+    if (idx == FOOTPRINT_THREADS && fields == 10)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %d fields in %s\n", __FUNCTION__, fields, footprints[idx % FOOTPRINT_THREADS]);
+}
+
 int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
     
     test_commachain_to_fixedarray("lkjlkj;kjlk,iuin", 20, 20, 2);
@@ -68,6 +202,9 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     test_commachain_to_fixedarray("lkjlkj;kjlk,iuin;;", 20, -1, -ENOMEM); /* unsigned int so 0xffffffff as max */
     test_commachain_to_fixedarray("lkjlkj;kjlk,iuin;;", 5, 5, 2); /* len of the first extracted shall be caped to 5*/
 
+    test_compute_event_id(1000000, 5000);
+    test_build_footprint();
+
     system("touch res/logs/modemid.txt");
 
     system("rm -f res/logs/history_event");
@@ -86,6 +223,10 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     system("rm -fr res/logs/log1");
     system("rm -fr res/logs/log2");
 
+    system("mkdir res/logs/log3");
+    test_minimal_crashfile("res/logs/log3");
+    system("rm -fr res/logs/log3");
+
     /* Cleanup */
     system("rm -f res/logs/modemid.txt");
     system("rm -f res/logs/history_event");
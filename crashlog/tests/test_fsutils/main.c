@@ -2,11 +2,18 @@
 #include <stdio.h>
 #include <errno.h>
 #include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <zlib.h>
 
 #include <cutils/properties.h>
 
 #include <crashutils.h>
 #include <fsutils.h>
+#include <reaper.h>
 
 #include "test_framework.h"
 
@@ -17,7 +24,10 @@ int get_file_size(char *filename);
 int do_chown(char *file, char *uid, char *gid);
 int do_copy_tail(char *src, char *dest, int limit);
 int find_matching_file(char *dir_to_search, char *pattern, char *filename_found);
-int readline(int fd, char buffer[MAXLINESIZE]); -- tested with cache_file
+int line_reader_next(struct line_reader *lr, char buffer[MAXLINESIZE]);
+int count_lines_in_file(const char *filename);
+int keyword_matcher_scan_file(const struct keyword_matcher *km, const char *filename,
+        struct keyword_hit *hits, keyword_hit_cb cb, void *ctx);
 int find_str_in_file(char *file, char *keyword, char *tail);
 int find_oneofstrings_in_file(char *file, char **keywords, int nbkeywords);
 int append_file(char *filename, char *text);
@@ -25,6 +35,15 @@ void get_sdcard_paths(int mode);
 int find_new_crashlog_dir(int mode);
 */
 
+/* the recycled crash folders, deleted from the history */
+static char history_deleted[2 * PATHMAX];
+
+int history_delete_first_existent_logcrashpath(const char *path) {
+    strncat(history_deleted, path, sizeof(history_deleted) - strlen(history_deleted) - 2);
+    strcat(history_deleted, ";");
+    return 1;
+}
+
 int raise_infoerror(char *type, char *subtype) {
     printf("LOGE: %s: type:%s subtype:%s\n", __FUNCTION__, type, subtype);
     return 0;
@@ -56,6 +75,158 @@ void test_cache_file(char *testfile, int cachemode, int expect) {
     //if (res > 0) dump_cachefile((char**)cachefile, CACHE_NBROWS);    
 }
 
+/* Reference one byte per read() implementation, used to check that the
+ * buffered line reader splits the files in exactly the same lines
+ */
+static int ref_readline(int fd, char buffer[MAXLINESIZE]) {
+    int size = 0, res;
+
+    while (size < MAXLINESIZE-1 && (res = read(fd, &buffer[size], 1)) == 1) {
+        if (buffer[size++] == '\n')
+            break;
+    }
+    if (res < 0)
+        return res;
+    buffer[size] = 0;
+    return size;
+}
+
+void test_line_reader(char *filename) {
+    char ref[MAXLINESIZE], line[MAXLINESIZE];
+    struct line_reader lr;
+    int fd, res, refres, lines = 0;
+    off_t offset = 0;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || line_reader_open(&lr, filename, O_RDONLY) < 0) {
+        printf("%s with %s failed; cannot open\n", __FUNCTION__, filename);
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    do {
+        refres = ref_readline(fd, ref);
+        res = line_reader_next(&lr, line);
+        if (res != refres || memcmp(ref, line, res + 1) ||
+                (res > 0 && line_reader_offset(&lr) != offset)) {
+            printf("%s with %s failed at line %d; returned %d instead of %d\n",
+                __FUNCTION__, filename, lines, res, refres);
+            break;
+        }
+        offset += res;
+        lines++;
+    } while (res > 0);
+
+    line_reader_close(&lr);
+    close(fd);
+    if (res == refres && res <= 0) {
+        if (count_lines_in_file(filename) == lines - 1)
+            printf("%s with %s succeeded (%d lines)\n", __FUNCTION__, filename, lines - 1);
+        else
+            printf("%s with %s failed; count_lines_in_file returned %d\n",
+                __FUNCTION__, filename, count_lines_in_file(filename));
+    }
+}
+
+void test_line_reader_long_line(void) {
+    char line[MAXLINESIZE];
+    struct line_reader lr;
+    FILE *fd;
+    int idx, res1, res2, res3;
+
+    /* A line of 1.5 MAXLINESIZE characters is returned in two pieces */
+    fd = fopen("res/line_reader_long", "w");
+    if (!fd) {
+        printf("%s cannot be tested; fopen failed\n", __FUNCTION__);
+        return;
+    }
+    for (idx = 0 ; idx < MAXLINESIZE + MAXLINESIZE / 2 ; idx++)
+        fputc('a' + idx % 26, fd);
+    fputs("\nlast", fd);
+    fclose(fd);
+
+    if (line_reader_open(&lr, "res/line_reader_long", O_RDONLY) < 0) {
+        printf("%s failed; cannot open\n", __FUNCTION__);
+        return;
+    }
+    res1 = line_reader_next(&lr, line);
+    res2 = line_reader_next(&lr, line);
+    res3 = line_reader_next(&lr, line);
+    line_reader_close(&lr);
+    remove("res/line_reader_long");
+
+    if (res1 == MAXLINESIZE-1 && res2 == MAXLINESIZE / 2 + 2 &&
+            res3 == 4 && !strcmp(line, "last"))
+        printf("%s succeeded\n", __FUNCTION__);
+    else
+        printf("%s failed; returned %d, %d, %d\n", __FUNCTION__, res1, res2, res3);
+}
+
+static int count_hits(void *ctx, int __attribute__((unused)) keyword,
+        int __attribute__((unused)) line, off_t __attribute__((unused)) offset) {
+    int *count = ctx;
+
+    return (++(*count) == 2);
+}
+
+void test_keyword_matcher(void) {
+    /* overlapping keywords, a duplicate and a missing one */
+    const char *keywords[] = {"testprop1", "lateteatoto", "toto", "missing",
+                              "prop", "a toto", "toto"};
+    const int expect_line[] = {1, 0, 0, -1, 0, 2, 0};
+    const off_t expect_offset[] = {22, 0, 0, 0, 0, 46, 0};
+    struct keyword_hit hits[DIM(keywords)];
+    struct keyword_matcher *km;
+    int res, idx, count = 0;
+
+    km = keyword_matcher_create(keywords, DIM(keywords));
+    if (!km) {
+        printf("%s failed; cannot compile keywords\n", __FUNCTION__);
+        return;
+    }
+
+    res = keyword_matcher_scan_file(km, "res/content_str_in_file.txt", hits, NULL, NULL);
+    if (res != 6) {
+        printf("%s failed; returned %d\n", __FUNCTION__, res);
+        goto out;
+    }
+    for (idx = 0 ; idx < (int)DIM(keywords) ; idx++) {
+        if (hits[idx].line != expect_line[idx] ||
+                (hits[idx].line >= 0 && hits[idx].offset != expect_offset[idx])) {
+            printf("%s failed; %s found at line %d offset %ld\n", __FUNCTION__,
+                keywords[idx], hits[idx].line, (long)hits[idx].offset);
+            goto out;
+        }
+    }
+
+    /* the callback stops the scan at the second hit */
+    res = keyword_matcher_scan_file(km, "res/content_str_in_file.txt", NULL, count_hits, &count);
+    if (count != 2 || res != 2) {
+        printf("%s failed; callback stop returned %d after %d hits\n", __FUNCTION__, res, count);
+        goto out;
+    }
+
+    res = keyword_matcher_scan_file(km, "res/proddperties.txt", NULL, NULL, NULL);
+    if (res != -ENOENT) {
+        printf("%s failed; missing file returned %d\n", __FUNCTION__, res);
+        goto out;
+    }
+    printf("%s succeeded\n", __FUNCTION__);
+out:
+    keyword_matcher_free(km);
+}
+
+void test_keyword_matcher_invalid(void) {
+    const char *keywords[] = {"testprop1", ""};
+
+    if (keyword_matcher_create(keywords, 2) == NULL && errno == EINVAL &&
+            keyword_matcher_create(NULL, 1) == NULL &&
+            keyword_matcher_create(keywords, 0) == NULL)
+        printf("%s succeeded\n", __FUNCTION__);
+    else
+        printf("%s failed\n", __FUNCTION__);
+}
+
 void test_file_exists(char *filename, int expect) {
     int res;
 
@@ -80,6 +251,214 @@ void test_do_chown(char *filename, char *uid, char *gid, int expect) {
     else printf("%s with (%s, %s, %s) failed; returned %d\n", __FUNCTION__, filename, uid, gid, res);
 }
 
+/* Compares the content of dest with the content of src from offset */
+static int copy_matches(const char *src, const char *dest, off_t offset) {
+    char bufsrc[CPBUFFERSIZE], bufdest[CPBUFFERSIZE];
+    int fsrc, fdest, res = 1;
+    ssize_t rsrc, rdest;
+
+    fsrc = open(src, O_RDONLY);
+    fdest = open(dest, O_RDONLY);
+    if (fsrc < 0 || fdest < 0 || lseek(fsrc, offset, SEEK_SET) < 0)
+        res = 0;
+    while (res) {
+        rdest = read(fdest, bufdest, sizeof(bufdest));
+        if (rdest <= 0)
+            break;
+        rsrc = read(fsrc, bufsrc, rdest);
+        if (rsrc != rdest || memcmp(bufsrc, bufdest, rsrc))
+            res = 0;
+    }
+    if (fsrc >= 0) close(fsrc);
+    if (fdest >= 0) close(fdest);
+    return res;
+}
+
+/* Reference copy: 4 KB read/write loop, as the copy helpers used to do */
+static ssize_t copy_reference(const char *src, const char *dest) {
+    char buffer[CPBUFFERSIZE];
+    ssize_t count, total = 0;
+    int fsrc = open(src, O_RDONLY);
+    int fdest = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+
+    while (fsrc >= 0 && fdest >= 0 && (count = read(fsrc, buffer, sizeof(buffer))) > 0)
+        total += write(fdest, buffer, count);
+    if (fsrc >= 0) close(fsrc);
+    if (fdest >= 0) close(fdest);
+    return total;
+}
+
+static long elapsed_us(struct timespec *start) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000L + (end.tv_nsec - start->tv_nsec) / 1000;
+}
+
+void test_do_copy_file(char *src, size_t limit, int flags, ssize_t expect) {
+    char dest[PATHMAX];
+    struct stat info;
+    off_t offset = 0;
+    ssize_t res;
+
+    snprintf(dest, sizeof(dest), "res/%s_copy", strrchr(src, '/') + 1);
+    res = do_copy_file(src, dest, limit, flags);
+    if ((flags & COPY_TAIL) && !stat(src, &info) && info.st_size > (off_t)limit)
+        offset = info.st_size - limit;
+    /* pseudo files content changes between two reads: check the size only */
+    if (res == expect || (expect == -1 && res > 0 && !stat(dest, &info) && info.st_size == res)) {
+        if (expect == -1 || res < 0 || copy_matches(src, dest, offset))
+            printf("%s with (%s, %zu, %d) succeeded\n", __FUNCTION__, src, limit, flags);
+        else
+            printf("%s with (%s, %zu, %d) failed; content differs\n", __FUNCTION__, src, limit, flags);
+    } else
+        printf("%s with (%s, %zu, %d) failed; returned %zd\n", __FUNCTION__, src, limit, flags, res);
+    unlink(dest);
+}
+
+/* Copies a 10 MB file with the copy engine and with a 4 KB read/write loop */
+void test_do_copy_file_benchmark(char *src, const char *line) {
+    char dest[PATHMAX];
+    struct timespec start;
+    long engine, reference;
+    ssize_t res;
+    FILE *fd;
+    size_t size;
+
+    if ((fd = fopen(src, "w")) == NULL) {
+        printf("%s with %s cannot be tested; creation failed\n", __FUNCTION__, src);
+        return;
+    }
+    for (size = 0 ; size < 10 * MB ; size += strlen(line))
+        fputs(line, fd);
+    fclose(fd);
+
+    snprintf(dest, sizeof(dest), "%s_copy", src);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    copy_reference(src, dest);
+    reference = elapsed_us(&start);
+    unlink(dest);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    res = do_copy_file(src, dest, 0, 0);
+    engine = elapsed_us(&start);
+
+    printf("%s: %s (%zu bytes) copied in %ld us, 4 KB read/write loop %ld us\n",
+        __FUNCTION__, src, size, engine, reference);
+    if (res == (ssize_t)size && copy_matches(src, dest, 0))
+        printf("%s with %s succeeded\n", __FUNCTION__, src);
+    else
+        printf("%s with %s failed; returned %zd\n", __FUNCTION__, src, res);
+    unlink(dest);
+    unlink(src);
+}
+
+/* Checks that the gzip file dest inflates to the source from offset */
+static int gzip_matches(const char *src, const char *dest, off_t offset, size_t size) {
+    char bufsrc[CPBUFFERSIZE], bufdest[CPBUFFERSIZE];
+    gzFile gz;
+    int fsrc, res = 1;
+    size_t total = 0;
+    ssize_t rsrc, rdest;
+
+    fsrc = open(src, O_RDONLY);
+    gz = gzopen(dest, "rb");
+    if (fsrc < 0 || !gz || lseek(fsrc, offset, SEEK_SET) < 0)
+        res = 0;
+    while (res) {
+        rdest = gzread(gz, bufdest, sizeof(bufdest));
+        if (rdest <= 0) {
+            res = (rdest == 0);
+            break;
+        }
+        rsrc = read(fsrc, bufsrc, rdest);
+        if (rsrc != rdest || memcmp(bufsrc, bufdest, rsrc))
+            res = 0;
+        total += rdest;
+    }
+    if (fsrc >= 0) close(fsrc);
+    if (gz) gzclose(gz);
+    return res && total == size;
+}
+
+void test_do_copy_file_compress(char *src, size_t limit, int flags, ssize_t expect) {
+    char dest[PATHMAX];
+    struct stat info;
+    off_t offset = 0;
+    ssize_t res;
+
+    snprintf(dest, sizeof(dest), "res/%s_copy.gz", strrchr(src, '/') + 1);
+    res = do_copy_file(src, dest, limit, flags | COPY_COMPRESS);
+    if ((flags & COPY_TAIL) && !stat(src, &info) && info.st_size > (off_t)limit)
+        offset = info.st_size - limit;
+    if (res == expect && (res < 0 || gzip_matches(src, dest, offset, res)))
+        printf("%s with (%s, %zu, %d) succeeded\n", __FUNCTION__, src, limit, flags);
+    else
+        printf("%s with (%s, %zu, %d) failed; returned %zd\n", __FUNCTION__, src, limit, flags, res);
+    unlink(dest);
+}
+
+/* A file size limit makes the writes short, as a full partition would */
+void test_do_copy_file_full(char *src, size_t limit, int flags) {
+    char dest[PATHMAX];
+    struct rlimit old, full;
+    ssize_t res;
+
+    snprintf(dest, sizeof(dest), "res/%s_copy", strrchr(src, '/') + 1);
+    getrlimit(RLIMIT_FSIZE, &old);
+    full = old;
+    full.rlim_cur = 64 * KB + 100;
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &full);
+    res = do_copy_file(src, dest, limit, flags);
+    setrlimit(RLIMIT_FSIZE, &old);
+    signal(SIGXFSZ, SIG_DFL);
+    if (res == -ENOSPC)
+        printf("%s with (%s, %zu, %d) succeeded\n", __FUNCTION__, src, limit, flags);
+    else
+        printf("%s with (%s, %zu, %d) failed; returned %zd\n", __FUNCTION__, src, limit, flags, res);
+    unlink(dest);
+}
+
+/* Compresses a 10 MB aplog in process and with a gzip command */
+void test_do_copy_file_compress_benchmark(char *src, const char *line) {
+    char dest[PATHMAX], cmd[2 * PATHMAX];
+    struct timespec start;
+    struct stat info;
+    long engine, reference;
+    ssize_t res;
+    FILE *fd;
+    size_t size;
+
+    if ((fd = fopen(src, "w")) == NULL) {
+        printf("%s with %s cannot be tested; creation failed\n", __FUNCTION__, src);
+        return;
+    }
+    for (size = 0 ; size < 10 * MB ; size += strlen(line))
+        fputs(line, fd);
+    fclose(fd);
+
+    snprintf(dest, sizeof(dest), "%s_copy.gz", src);
+    snprintf(cmd, sizeof(cmd), "gzip -c %s > %s", src, dest);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    res = system(cmd);
+    reference = elapsed_us(&start);
+    unlink(dest);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    res = do_copy_file(src, dest, 0, COPY_COMPRESS);
+    engine = elapsed_us(&start);
+
+    printf("%s: %s (%zu bytes) compressed to %ld bytes in %ld us, gzip command %ld us\n",
+        __FUNCTION__, src, size, stat(dest, &info) ? -1L : (long)info.st_size, engine, reference);
+    if (res == (ssize_t)size && gzip_matches(src, dest, 0, size))
+        printf("%s with %s succeeded\n", __FUNCTION__, src);
+    else
+        printf("%s with %s failed; returned %zd\n", __FUNCTION__, src, res);
+    unlink(dest);
+    unlink(src);
+}
+
 void test_do_copy_tail(char *src, int limit, int expect) {
 	int res;
 	char *dest;
@@ -179,6 +558,7 @@ void test_generate_crashlog_dir(int mode, char *unique, int other_folders) {
     char temp[256];
     int count = other_folders;
 
+    reset_folder_counter(CRASH_CURRENT_LOG);
     system("rm -f res/logs/currentcrashlog");
     system("rm -rf res/logs/crashlog0_*");
     while(count--) {
@@ -210,6 +590,70 @@ void test_generate_crashlog_dir(int mode, char *unique, int other_folders) {
     free(path);
 }
 
+/* The history line of a slot is deleted when its crash folder is recycled,
+ * whatever the other folders of the slot, found at load time or created by
+ * the allocator */
+void test_find_new_crashlog_dir_history() {
+    const char *expect = LOGS_DIR "/crashlog0;" LOGS_DIR "/crashlog0;";
+    int first, second;
+
+    gmaxfiles = 1;
+    reset_folder_counter(CRASH_CURRENT_LOG);
+    system("rm -f res/logs/currentcrashlog");
+    system("rm -rf res/logs/crashlog0*");
+    system("mkdir res/logs/crashlog0 res/logs/crashlog0_a res/logs/crashlog0_z");
+    history_deleted[0] = '\0';
+
+    first = find_new_crashlog_dir(MODE_CRASH);
+    second = find_new_crashlog_dir(MODE_CRASH);
+    if (first == 0 && second == 0 && !strcmp(history_deleted, expect))
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; returned %d and %d, deleted %s\n", __FUNCTION__,
+            first, second, history_deleted);
+    system("rm -rf res/logs/crashlog0");
+}
+
+/* Recycling a slot holding a large folder does not delete it on the
+ * caller thread */
+void test_generate_crashlog_dir_timing(int nbfiles, long max_us) {
+    char name[PATHMAX], data[4096];
+    char *first, *second;
+    struct stat info;
+    struct timespec start;
+    long elapsed;
+    int idx, fd;
+
+    gmaxfiles = 1;
+    reset_folder_counter(CRASH_CURRENT_LOG);
+    first = generate_crashlog_dir(MODE_CRASH, "FIRST");
+    if (!first) {
+        printf("%s failed on creating the first crash directory\n", __FUNCTION__);
+        return;
+    }
+    memset(data, 'x', sizeof(data));
+    for (idx = 0 ; idx < nbfiles ; idx++) {
+        snprintf(name, sizeof(name), "%s/file%d", first, idx);
+        fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+        if (fd < 0)
+            continue;
+        if (write(fd, data, sizeof(data)) < 0)
+            printf("%s: cannot write %s\n", __FUNCTION__, name);
+        close(fd);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    second = generate_crashlog_dir(MODE_CRASH, "SECOND");
+    elapsed = elapsed_us(&start);
+
+    if (second && !stat(second, &info) && stat(first, &info) && elapsed <= max_us)
+        printf("%s succeeded; slot of %d files recycled in %ld us\n", __FUNCTION__, nbfiles, elapsed);
+    else printf("%s failed; second directory %s after %ld us\n", __FUNCTION__, second, elapsed);
+    if (second)
+        rmfr(second);
+    free(first);
+    free(second);
+}
+
 void test_file_read_string(const char *file, char *buffer, int expect) {
     int res;
 
@@ -240,6 +684,15 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     test_cache_file("res/cache_file_twicelines", CACHE_TAIL, 12);
     test_cache_file(NULL, CACHE_TAIL, -EINVAL);
 
+    test_line_reader("res/cache_file_empty");
+    test_line_reader("res/cache_file_tooshort");
+    test_line_reader("res/cache_file_longer");
+    test_line_reader("res/cache_file_twicelines");
+    test_line_reader("res/history_event.base");
+    test_line_reader("res/system_server_watchdogh@1364370757872.txt");
+    test_line_reader("res/tombstone_00");
+    test_line_reader_long_line();
+
     test_file_exists("res/cache_file_missing", 0);
     test_file_exists("res/cache_file_empty", 1);
     test_file_exists("/root/kjsdfjksdfgj", 0);
@@ -264,6 +717,25 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     test_do_copy_tail("res/cache_file_tooshort", 10, 10);
     test_do_copy_tail("res/cache_file_tooshort", 1000, 180);
     test_do_copy_tail(NULL, 1000, -EINVAL);
+
+    test_do_copy_file("res/cache_file_longer", 0, 0, 1110);
+    test_do_copy_file("res/cache_file_longer", 100, 0, 100);
+    test_do_copy_file("res/cache_file_longer", 100, COPY_TAIL, 100);
+    test_do_copy_file("res/cache_file_empty", 0, 0, 0);
+    test_do_copy_file("res/cache_file_missing", 0, 0, -ENOENT);
+    test_do_copy_file("/proc/self/status", 0, 0, -1);
+    test_do_copy_file_benchmark("res/bench_tombstone",
+        "    #00 pc 0001b2c4  /system/lib/libc.so (tgkill+12)\n");
+    test_do_copy_file_benchmark("res/bench_aplog",
+        "01-01 00:00:00.000  1234  1234 I ActivityManager: Start proc com.android.phone\n");
+    test_do_copy_file_compress("res/cache_file_longer", 0, 0, 1110);
+    test_do_copy_file_compress("res/cache_file_longer", 100, COPY_TAIL, 100);
+    test_do_copy_file_compress("res/cache_file_empty", 0, 0, 0);
+    test_do_copy_file_compress("res/cache_file_missing", 0, 0, -ENOENT);
+    test_do_copy_file_full("/dev/zero", 1 * MB, 0);
+    test_do_copy_file_full("/dev/urandom", 1 * MB, COPY_COMPRESS);
+    test_do_copy_file_compress_benchmark("res/bench_aplog",
+        "01-01 00:00:00.000  1234  1234 I ActivityManager: Start proc com.android.phone\n");
     test_do_copy_tail("res/cache_file_tooshort", 0, 180);
     test_do_copy_tail("res/cache_fissle_tooshort", 10, -ENOENT);
 
@@ -295,6 +767,9 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     test_find_oneofstrings_in_file("res/proddperties.txt", in_3props, 3, -ENOENT);
     test_find_oneofstrings_in_file("res/content_str_in_file.txt", in_3props, 0, -EINVAL);
 
+    test_keyword_matcher();
+    test_keyword_matcher_invalid();
+
     system("rm -f res/file_to_append && touch res/file_to_append");
     test_append_file("res/file_to_append", "text", 4);
     test_append_file("res/file_to_appen", "text", -ENOENT);
@@ -314,16 +789,21 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     /* reset_property_cache(); */
     /* test_get_sdcard_paths(MODE_CRASH, 0); */
 
+    /* the counters are kept in memory, drop them before changing the files */
+    reset_folder_counter(CRASH_CURRENT_LOG);
     system("rm -f res/logs/currentcrashlog");
     gmaxfiles = 10;
     test_find_new_crashlog_dir(MODE_CRASH, 0);
     test_find_new_crashlog_dir(MODE_CRASH, 1); /* increment the counter */
+    reset_folder_counter(CRASH_CURRENT_LOG);
     system("echo 5 > res/logs/currentcrashlog"); /* reset the counter to something else */
     test_find_new_crashlog_dir(MODE_CRASH, 5);
     test_find_new_crashlog_dir(MODE_CRASH, 6);
+    reset_folder_counter(CRASH_CURRENT_LOG);
     system("rm -f res/logs/currentcrashlog");
     test_find_new_crashlog_dir(MODE_CRASH_NOSD, 0);
     test_find_new_crashlog_dir(MODE_CRASH_NOSD, 1);
+    reset_folder_counter(CRASH_CURRENT_LOG);
     system("echo 5 > res/logs/currentcrashlog"); /* reset the counter to something else */
     test_find_new_crashlog_dir(MODE_CRASH_NOSD, 5);
     test_find_new_crashlog_dir(MODE_CRASH_NOSD, 6);
@@ -337,12 +817,16 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     test_find_new_crashlog_dir(MODE_CRASH_NOSD, 3);
     test_find_new_crashlog_dir(MODE_CRASH_NOSD, 4);
     test_find_new_crashlog_dir(MODE_CRASH_NOSD, 0);
+    reset_folder_counter(APLOGS_CURRENT_LOG);
     system("rm -f res/logs/currentaplogslog");
     test_find_new_crashlog_dir(MODE_APLOGS, 0);
+    reset_folder_counter(APLOGS_CURRENT_LOG);
     system("echo 3 > res/logs/currentaplogslog");
     test_find_new_crashlog_dir(MODE_APLOGS, 3);
+    reset_folder_counter(BZ_CURRENT_LOG);
     system("rm -f res/logs/currentbzlog");
     test_find_new_crashlog_dir(MODE_BZ, 0);
+    reset_folder_counter(BZ_CURRENT_LOG);
     system("echo 4 > res/logs/currentbzlog");
     test_find_new_crashlog_dir(MODE_BZ, 4);
     system("rm -f res/logs/currentstatslog");
@@ -351,6 +835,9 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     test_find_new_crashlog_dir(MODE_BZ+1, -1);
 
     test_generate_crashlog_dir(MODE_CRASH, "A5A5A5", 2);
+    reaper_init();
+    test_generate_crashlog_dir_timing(5000, 50000);
+    test_find_new_crashlog_dir_history();
 
     test_file_read_string("res/file_to_append", buffer, 4); // data is 'text'
     test_file_read_string("res/cache_file_empty", buffer, 0);
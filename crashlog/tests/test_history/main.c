@@ -9,12 +9,15 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <utime.h>
 
 #include <cutils/properties.h>
 
 #include <crashutils.h>
 #include <history.h>
 #include <fsutils.h>
+#include <quota.h>
 #include <config.h>
 
 #include "test_framework.h"
@@ -71,6 +74,143 @@ void test_reset_history_cache(int expect) {
     else printf("%s failed; returned %d\n", __FUNCTION__, res);
 }
 
+static int rotation_has_event(int idx) {
+    char key[32];
+
+    snprintf(key, sizeof(key), "%020d", idx);
+    return history_has_event(key);
+}
+
+/* Fills the history up to the segments limit and crosses it by one entry */
+void test_history_rotation() {
+    struct history_entry entry;
+    char key[32];
+    int idx, res = 0, total = HISTORY_SEGMENT_RECORDS * HISTORY_MAX_SEGMENTS;
+
+    entry.event = "INFO";
+    entry.type = "ROTATION";
+    entry.log = NULL;
+    entry.lastuptime = NULL;
+    entry.key = key;
+    entry.eventtime = "2013-03-15/19:15:32";
+
+    system("rm -rf " HISTORY_FILE " " HISTORY_SEGMENT_DIR);
+    reset_history_cache();
+    for (idx = 0 ; idx < total && !res ; idx++) {
+        snprintf(key, sizeof(key), "%020d", idx);
+        res = update_history_file(&entry);
+    }
+    if (!res && (res = count_lines_in_file(HISTORY_FILE)) == HIST_FILE_HEADER_SIZE + total &&
+            rotation_has_event(0) == 1)
+        printf("%s before rotation succeeded\n", __FUNCTION__);
+    else
+        printf("%s before rotation failed; returned %d\n", __FUNCTION__, res);
+
+    snprintf(key, sizeof(key), "%020d", total);
+    res = update_history_file(&entry);
+    total = total - HISTORY_SEGMENT_RECORDS + 1;
+    if (!res && (res = count_lines_in_file(HISTORY_FILE)) == HIST_FILE_HEADER_SIZE + total &&
+            rotation_has_event(HISTORY_SEGMENT_RECORDS - 1) == 0 &&
+            rotation_has_event(HISTORY_SEGMENT_RECORDS) == 1 &&
+            rotation_has_event(total + HISTORY_SEGMENT_RECORDS - 1) == 1)
+        printf("%s after rotation succeeded\n", __FUNCTION__);
+    else
+        printf("%s after rotation failed; returned %d\n", __FUNCTION__, res);
+
+    /* The export and the segments must reload to the same records */
+    res = reset_history_cache();
+    if (res == total && count_lines_in_file(HISTORY_FILE) == HIST_FILE_HEADER_SIZE + total &&
+            rotation_has_event(HISTORY_SEGMENT_RECORDS) == 1)
+        printf("%s reload succeeded\n", __FUNCTION__);
+    else
+        printf("%s reload failed; returned %d\n", __FUNCTION__, res);
+}
+
+#define EVICT_DIR   "/tmp/test_history_evict"
+
+/* Creates a crash folder of 4 KB modified age seconds ago, in the history */
+static void evict_folder(const char *path, time_t age) {
+    struct history_entry entry;
+    struct utimbuf times;
+    char file[PATHMAX], key[32], data[4 * KB];
+    int fd;
+
+    mkdir(path, 0770);
+    snprintf(file, sizeof(file), "%s/file", path);
+    memset(data, 'x', sizeof(data));
+    if ((fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0660)) >= 0) {
+        if (write(fd, data, sizeof(data)) < 0)
+            printf("%s: cannot write %s\n", __FUNCTION__, file);
+        close(fd);
+    }
+    times.actime = times.modtime = time(NULL) - age;
+    utime(path, &times);
+
+    snprintf(key, sizeof(key), "%020ld", (long)age);
+    entry.event = "CRASH";
+    entry.type = "JAVACRASH";
+    entry.log = (char *)path;
+    entry.lastuptime = NULL;
+    entry.key = key;
+    entry.eventtime = "2013-03-15/19:15:32";
+    update_history_file(&entry);
+}
+
+/* The folders evicted by the quota leave the history */
+void test_history_quota_evict() {
+    unsigned long long used;
+    int count;
+
+    system("rm -rf " EVICT_DIR " " HISTORY_FILE " " HISTORY_SEGMENT_DIR);
+    reset_history_cache();
+    mkdir(EVICT_DIR, 0770);
+    evict_folder(EVICT_DIR "/crashlog0", 300);
+    evict_folder(EVICT_DIR "/crashlog1", 200);
+    evict_folder(EVICT_DIR "/crashlog2", 100);
+    used = quota_used(EVICT_DIR);
+
+    count = quota_evict(EVICT_DIR, "crashlog", used - 5 * KB);
+    if (count == 2 && !history_has_event(EVICT_DIR "/crashlog0") &&
+            !history_has_event(EVICT_DIR "/crashlog1") &&
+            history_has_event(EVICT_DIR "/crashlog2") == 1 &&
+            find_str_in_file(HISTORY_FILE, EVICT_DIR "/crashlog0", NULL) != 1 &&
+            find_str_in_file(HISTORY_FILE, EVICT_DIR "/crashlog2", NULL) == 1)
+        printf("%s succeeded\n", __FUNCTION__);
+    else
+        printf("%s failed; %d folders evicted\n", __FUNCTION__, count);
+    system("rm -rf " EVICT_DIR);
+}
+
+static long get_vmrss_kb() {
+    char line[128];
+    long rss = -1;
+    FILE *status = fopen("/proc/self/status", "r");
+
+    if (!status) return -1;
+    while (fgets(line, sizeof(line), status))
+        if (sscanf(line, "VmRSS: %ld kB", &rss) == 1)
+            break;
+    fclose(status);
+    return rss;
+}
+
+/* Reports the boot time cache load duration and the resident memory */
+void test_history_load_stats(int expect) {
+    struct timespec start, end;
+    long rss, elapsed;
+    int res;
+
+    rss = get_vmrss_kb();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    res = reset_history_cache();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+    printf("%s: %d records loaded in %ld us, VmRSS %ld kB (%+ld kB)\n", __FUNCTION__,
+        res, elapsed, get_vmrss_kb(), get_vmrss_kb() - rss);
+    if (res == expect) printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; returned %d\n", __FUNCTION__, res);
+}
+
 static void history_file_write(char *event, char *type, char *subtype, char *log, char* lastuptime, char* key, char* date_tmp_2)
 {
     char uptime[32];
@@ -174,18 +314,28 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     
     test_reset_uptime_history(0);
     system("rm -f res/logs/history_event");
-    test_reset_history_cache(2); // two head lines
+    test_reset_history_cache(0); // the records, without the two head lines
     test_reset_uptime_history(0);
     system("cp res/history_event.base res/logs/history_event");
     test_reset_uptime_history(0);
     
+    system("rm -rf " HISTORY_SEGMENT_DIR);
     system("cp res/history_event.base res/logs/history_event");
-    test_reset_history_cache(45);
+    test_reset_history_cache(43);
     test_history_has_event("e23eb993705d3199db53", 1);
+    test_history_has_event("/mnt/sdcard/logs/stats1", 1);
+    test_history_has_event("logs/stats2", 1);
+    test_history_has_event("/mnt/sdcard/logs/stats2/", 1);
+    test_history_has_event("/mnt/sdcard/logs/stats", 0);
+    test_history_has_event("/mnt/sdcard/logs/crashlog1", 0);
     test_history_has_event("toto", 0);
     system("rm -f res/logs/history_event");
-    test_reset_history_cache(2);
+    test_reset_history_cache(0);
     test_history_has_event("toto", 0);
-    
+
+    test_history_rotation();
+    test_history_load_stats(HISTORY_SEGMENT_RECORDS * (HISTORY_MAX_SEGMENTS - 1) + 1);
+    test_history_quota_evict();
+
     return 0;
 }
@@ -0,0 +1,131 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cutils/properties.h>
+#include <privconfig.h>
+#include <fsutils.h>
+#include <ingredients.h>
+
+#define TEST_DIR            "/tmp/test_ingredients"
+
+static char ifwi_version[PROPERTY_VALUE_MAX];
+
+/* the properties of a board, fsutils and its dependencies are not linked */
+int property_get(char *name, char *value, char *def) {
+    const char *found = def;
+
+    if (!strcmp(name, "sys.ifwi.version"))
+        found = ifwi_version;
+    else if (!strcmp(name, "sys.ia32.version"))
+        found = "IA32.01";
+    else if (!strcmp(name, MODEM_FIELD))
+        found = "XMM.42";
+    if (!found)
+        return -1;
+    snprintf(value, PROPERTY_VALUE_MAX, "%s", found);
+    return strlen(value);
+}
+
+char *retrieve_props_json(char *filter) {
+    (void)filter;
+    return strdup("{}");
+}
+
+int do_chmod(char *path, char *mode) {
+    (void)path;
+    (void)mode;
+    return 0;
+}
+
+int do_chown(const char *file, char *uid, char *gid) {
+    (void)file;
+    (void)uid;
+    (void)gid;
+    return 0;
+}
+
+static int write_file(const char *path, const char *content) {
+    FILE *fp = fopen(path, "w");
+
+    if (!fp)
+        return -1;
+    fputs(content, fp);
+    fclose(fp);
+    return 0;
+}
+
+static void set_properties(const char *ifwi) {
+    snprintf(ifwi_version, sizeof(ifwi_version), "%s", ifwi);
+}
+
+/* Checks the ingredients and compares the counters moved since before */
+static int check(struct ingredients_stats *before, unsigned long refreshes,
+        unsigned long skips, unsigned long writes) {
+    struct ingredients_stats after;
+
+    check_ingredients_file();
+    ingredients_get_stats(&after);
+    if (after.refreshes - before->refreshes != refreshes ||
+            after.skips - before->skips != skips ||
+            after.writes - before->writes != writes) {
+        printf("%lu refreshes, %lu skips, %lu writes\n", after.refreshes - before->refreshes,
+            after.skips - before->skips, after.writes - before->writes);
+        return -1;
+    }
+    *before = after;
+    return 0;
+}
+
+/* A check with the same properties, config and ingredients.txt skips the
+ * refresh, any change of them does not */
+void test_ingredients_skip() {
+    struct ingredients_stats stats;
+
+    mkdir(TEST_DIR, 0770);
+    unlink(INGREDIENTS_FILE);
+    write_file(INGREDIENTS_CONFIG, "[GETPROP]\nsys.ifwi.version=true\nsys.ia32.version=true\n\n"
+        "[MODEM]\nModem=false\n");
+    set_properties("IFWI.01");
+    ingredients_get_stats(&stats);
+
+    if (check(&stats, 1, 0, 1) || !file_exists(INGREDIENTS_FILE)) {
+        printf("%s failed on the first check\n", __FUNCTION__);
+        return;
+    }
+    if (check(&stats, 0, 1, 0)) {
+        printf("%s failed; second check with the same inputs not skipped\n", __FUNCTION__);
+        return;
+    }
+
+    set_properties("IFWI.02");
+    if (check(&stats, 1, 0, 1) || check(&stats, 0, 1, 0)) {
+        printf("%s failed on a property change\n", __FUNCTION__);
+        return;
+    }
+
+    unlink(INGREDIENTS_FILE);
+    if (check(&stats, 1, 0, 1) || !file_exists(INGREDIENTS_FILE)) {
+        printf("%s failed on a removed %s\n", __FUNCTION__, INGREDIENTS_FILE);
+        return;
+    }
+
+    /* a bulk section matching writable properties cannot be skipped */
+    write_file(INGREDIENTS_CONFIG, "[GETPROP]\nsys.ifwi.version=true\n\n"
+        "[GETBULKPROPS]\n^persist\\.=false\n");
+    if (check(&stats, 1, 0, 1) || check(&stats, 1, 0, 0)) {
+        printf("%s failed on a bulk section\n", __FUNCTION__);
+        return;
+    }
+    printf("%s succeeded\n", __FUNCTION__);
+}
+
+int main() {
+    test_ingredients_skip();
+    unlink(INGREDIENTS_FILE);
+    unlink(INGREDIENTS_CONFIG);
+    rmdir(TEST_DIR);
+    return 0;
+}
@@ -9,21 +9,42 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <cutils/properties.h>
 
 #include <inotify_handler.h>
-#include <config.h>
+#include <config_handler.h>
+#include <crashutils.h>
+#include <fsutils.h>
+#include <history.h>
 
 #include "test_framework.h"
 
+#define TEST_REWATCH_DIR    "/tmp/test_inotify_rewatch"
+
 /*
  * int init_inotify_handler();
  * int set_watch_entry_callback(unsigned int watch_type, inotify_callback pcallback);
  * int handle_inotify_events(int inotify_fd);
 */
 
-int finalize_dropbox_pending_event(const struct inotify_event __attribute__((unused)) *event) {
+/* crashlogd dependencies, ignored */
+pconfig g_first_modem_config = NULL;
+void generic_add_watch(pconfig __attribute__((unused)) config_to_watch,
+    int __attribute__((unused)) fd) {}
+int raise_infoerror(char __attribute__((unused)) *type, char __attribute__((unused)) *subtype) {
+    return 0;
+}
+void create_infoevent(char __attribute__((unused)) *filename, char __attribute__((unused)) *data0,
+    char __attribute__((unused)) *data1, char __attribute__((unused)) *data2) {}
+int get_parent_dir(char __attribute__((unused)) *dir, char __attribute__((unused)) *parent_dir) {
+    return -1;
+}
+const char *get_current_time_long(int __attribute__((unused)) refresh) { return ""; }
+int history_commit_line(const char __attribute__((unused)) *line) { return 0; }
+void notify_crashreport() {}
+int property_set(char __attribute__((unused)) *name, char __attribute__((unused)) *value) {
     return 0;
 }
 
@@ -36,6 +57,14 @@ int dummy_callback(struct watch_entry *entry, struct inotify_event *event) {
     return 0;
 }
 
+int gevcount = 0;
+
+int counting_callback(struct watch_entry __attribute__((unused)) *entry,
+    struct inotify_event __attribute__((unused)) *event) {
+    gevcount++;
+    return 0;
+}
+
 void test_set_watch_entry_callback(unsigned int watch_type, inotify_callback pcallback, int expect) {
     int res;
 
@@ -55,6 +84,136 @@ void test_handle_inotify_events(int fd, int expect, int evdetected) {
         __FUNCTION__, fd, res, gevdetected);
 }
 
+void test_receive_inotify_events_burst(int fd, int nbfiles) {
+    char path[PATHMAX];
+    struct inotify_stats before, after;
+    int idx, file, res;
+
+    /* Generate the files without draining the events */
+    gevcount = 0;
+    get_inotify_stats(&before);
+    for (idx = 0 ; idx < nbfiles ; idx++) {
+        snprintf(path, sizeof(path), DROPBOX_DIR "/system_server_watchdog@burst%d.txt", idx);
+        file = open(path, O_WRONLY | O_CREAT, 0644);
+        if (file >= 0) close(file);
+    }
+    while ((res = receive_inotify_events(fd)) == 0);
+    get_inotify_stats(&after);
+
+    if (res == -EAGAIN && gevcount == nbfiles)
+        printf("%s (%d) succeeded; %lu batches, %lu reads\n", __FUNCTION__, nbfiles,
+            after.batches - before.batches, after.reads - before.reads);
+    else printf("%s (%d) failed; returned %d and %d events detected (%lu overflows)\n",
+        __FUNCTION__, nbfiles, res, gevcount, after.overflows - before.overflows);
+}
+
+/* More files than the inotify queue holds: the rescan after the overflow
+ * handles the files whose event was lost, and only them */
+void test_receive_inotify_events_overflow(int fd) {
+    char path[PATHMAX];
+    struct inotify_stats before, after;
+    int idx, file, nbfiles = 16384;
+    FILE *fp;
+
+    fp = fopen("/proc/sys/fs/inotify/max_queued_events", "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &nbfiles) != 1)
+            nbfiles = 16384;
+        fclose(fp);
+    }
+    nbfiles += 1000;
+
+    gevcount = 0;
+    get_inotify_stats(&before);
+    for (idx = 0 ; idx < nbfiles ; idx++) {
+        snprintf(path, sizeof(path), DROPBOX_DIR "/system_server_watchdog@overflow%d.txt", idx);
+        file = open(path, O_WRONLY | O_CREAT, 0644);
+        if (file >= 0) close(file);
+    }
+    while (receive_inotify_events(fd) == 0);
+    get_inotify_stats(&after);
+
+    if (after.overflows - before.overflows == 1 && gevcount == nbfiles)
+        printf("%s (%d) succeeded\n", __FUNCTION__, nbfiles);
+    else printf("%s (%d) failed; %d events detected (%lu overflows)\n",
+        __FUNCTION__, nbfiles, gevcount, after.overflows - before.overflows);
+}
+
+/* A dynamic entry matches on its prefix only and stops matching once removed */
+void test_inotify_add_remove_entry(int fd) {
+    struct watch_entry entry = {
+        .wd = -1,
+        .eventmask = IN_CLOSE_WRITE,
+        .eventtype = -1,
+        .eventname = "DYNAMIC",
+        .eventpath = DROPBOX_DIR,
+        .eventpattern = "dropbox-",
+        .pcallback = counting_callback,
+        .matchtype = MATCH_PREFIX,
+    };
+    int res, count;
+
+    gevcount = 0;
+    if ((res = inotify_add_entry(fd, &entry)) < 0) {
+        printf("%s failed; inotify_add_entry returned %d\n", __FUNCTION__, res);
+        return;
+    }
+    system("touch " DROPBOX_DIR "/dropbox-0-0-0.txt " DROPBOX_DIR "/nodropbox-0-0-0.txt");
+    while (receive_inotify_events(fd) == 0);
+    count = gevcount;
+
+    res = inotify_remove_entry(fd, &entry);
+    system("touch " DROPBOX_DIR "/dropbox-0-0-1.txt");
+    while (receive_inotify_events(fd) == 0);
+
+    if (count == 1 && gevcount == 1 && res == 0 && entry.wd == -1 &&
+            inotify_remove_entry(fd, &entry) == -ENOENT)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %d events before removal, %d after, removal returned %d\n",
+        __FUNCTION__, count, gevcount, res);
+}
+
+/* A deleted directory is watched again with the events of all its entries */
+void test_inotify_rewatch(int fd) {
+    struct watch_entry written = {
+        .wd = -1,
+        .eventmask = IN_CLOSE_WRITE | IN_DELETE_SELF,
+        .eventtype = -1,
+        .eventname = "WRITTEN",
+        .eventpath = TEST_REWATCH_DIR,
+        .eventpattern = "written-",
+        .pcallback = counting_callback,
+        .matchtype = MATCH_PREFIX,
+    };
+    struct watch_entry moved = written;
+    int res;
+
+    moved.eventmask = IN_MOVED_TO;
+    moved.eventname = "MOVED";
+    moved.eventpattern = "moved-";
+
+    mkdir(TEST_REWATCH_DIR, 0770);
+    if (inotify_add_entry(fd, &written) < 0 || inotify_add_entry(fd, &moved) < 0) {
+        printf("%s failed; cannot add the entries\n", __FUNCTION__);
+        return;
+    }
+    rmdir(TEST_REWATCH_DIR);
+    while (receive_inotify_events(fd) == 0);
+
+    gevcount = 0;
+    system("touch " TEST_REWATCH_DIR "/written-0 /tmp/moved-0");
+    system("mv /tmp/moved-0 " TEST_REWATCH_DIR "/moved-0");
+    while (receive_inotify_events(fd) == 0);
+
+    res = (written.wd >= 0 && written.wd == moved.wd && gevcount == 2);
+    inotify_remove_entry(fd, &written);
+    inotify_remove_entry(fd, &moved);
+    system("rm -rf " TEST_REWATCH_DIR);
+    if (res)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %d events detected after the new watch\n", __FUNCTION__, gevcount);
+}
+
 int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
     int fd = init_inotify_handler();
     if ( fd < 0 ) {
@@ -76,6 +235,19 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
     test_handle_inotify_events(fd, 0, ANR_TYPE);
     system("rm " DROPBOX_DIR "/anr@jshdfkgj2.txt");
     test_handle_inotify_events(fd, -EAGAIN, -1);
+
+    /* No event shall be lost in a burst */
+    test_set_watch_entry_callback(SYSSERVER_TYPE, counting_callback, 0);
+    system("rm -fr " DROPBOX_DIR "/*");
+    receive_inotify_events(fd);
+    test_receive_inotify_events_burst(fd, 1000);
+    system("rm -fr " DROPBOX_DIR "/*");
+    while (receive_inotify_events(fd) == 0);
+    test_receive_inotify_events_overflow(fd);
+    system("rm -fr " DROPBOX_DIR "/*");
+    while (receive_inotify_events(fd) == 0);
+    test_inotify_add_remove_entry(fd);
+    test_inotify_rewatch(fd);
     
     /* Cleanup the tmp files */
     system("rm -fr " DROPBOX_DIR "/*");
@@ -0,0 +1,97 @@
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+
+#include <privconfig.h>
+#include <notifier.h>
+
+/* Properties stubs */
+int property_get(char __attribute__((unused)) *name, char *value, char *def) {
+    if (!value) return -EINVAL;
+    strncpy(value, def ? def : "", PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+int property_set(char __attribute__((unused)) *name, char __attribute__((unused)) *value) {
+    return 0;
+}
+
+/* run_command stub recording the broadcasts instead of running them */
+static char last_copy_cmd[4096];
+static unsigned int notify_cmds = 0;
+static unsigned int copy_cmds = 0;
+
+int run_command(const char *command, unsigned int __attribute__((unused)) timeout) {
+    if (strstr(command, "CRASH_NOTIFY")) {
+        notify_cmds++;
+    } else if (strstr(command, "CRASH_LOGS_COPY_FINISHED")) {
+        copy_cmds++;
+        strncpy(last_copy_cmd, command, sizeof(last_copy_cmd) - 1);
+    }
+    return 0;
+}
+
+/* Requests received within the debounce window are sent in one broadcast
+ * per intent */
+void test_notifier_debounce() {
+    struct notifier_stats stats;
+    int idx;
+
+    for (idx = 0 ; idx < 5 ; idx++)
+        notifier_crash_notify();
+    notifier_logs_copy_finished("aaaaaaaaaaaaaaaaaaaa");
+    notifier_logs_copy_finished("bbbbbbbbbbbbbbbbbbbb");
+    notifier_logs_copy_finished("aaaaaaaaaaaaaaaaaaaa");
+    notifier_logs_copy_finished("cccccccccccccccccccc");
+
+    /* nothing is sent before the end of the window */
+    usleep(500 * 1000);
+    if (notify_cmds || copy_cmds) {
+        printf("%s failed; %u notify and %u copy broadcasts sent before the window end\n",
+            __FUNCTION__, notify_cmds, copy_cmds);
+        return;
+    }
+
+    sleep(NOTIFIER_DEBOUNCE + 1);
+    notifier_get_stats(&stats);
+    if (notify_cmds == 1 && copy_cmds == 1 && stats.requests == 9 &&
+            stats.merged == 7 && stats.broadcasts == 2 && !stats.dropped &&
+            strstr(last_copy_cmd, "aaaaaaaaaaaaaaaaaaaa,bbbbbbbbbbbbbbbbbbbb,cccccccccccccccccccc"))
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %u notify, %u copy, %lu requests, %lu merged, %lu broadcasts\n",
+        __FUNCTION__, notify_cmds, copy_cmds, stats.requests, stats.merged, stats.broadcasts);
+}
+
+/* CRASH_NOTIFY is held until NOTIFIER_MIN_INTERVAL after the previous one,
+ * while a full batch of event ids is sent at once */
+void test_notifier_rate_limit() {
+    char key[32];
+    unsigned int notify = notify_cmds, copy = copy_cmds;
+    int idx;
+
+    notifier_crash_notify();
+    for (idx = 0 ; idx < NOTIFIER_MAX_KEYS ; idx++) {
+        snprintf(key, sizeof(key), "%020d", idx);
+        notifier_logs_copy_finished(key);
+    }
+    usleep(500 * 1000);
+
+    if (notify_cmds == notify && copy_cmds == copy + 1)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %u notify and %u copy broadcasts sent\n", __FUNCTION__,
+        notify_cmds - notify, copy_cmds - copy);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (notifier_init() < 0) {
+        printf("notifier_init failed\n");
+        return -1;
+    }
+    test_notifier_debounce();
+    test_notifier_rate_limit();
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include <cutils/properties.h>
+
+#include <privconfig.h>
+#include <quota.h>
+
+#define TEST_DIR    "/tmp/test_quota"
+
+/* Properties stubs */
+int property_get(char __attribute__((unused)) *name, char *value, char *def) {
+    if (!value) return -EINVAL;
+    strncpy(value, def ? def : "", PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+int property_set(char __attribute__((unused)) *name, char __attribute__((unused)) *value) {
+    return 0;
+}
+
+int rmfr(char __attribute__((unused)) *path) {
+    return 0;
+}
+
+/* the paths evicted, deleted from the history */
+static char history_deleted[2 * PATHMAX];
+
+int history_delete_first_existent_logcrashpath(const char *path) {
+    strncat(history_deleted, path, sizeof(history_deleted) - strlen(history_deleted) - 2);
+    strcat(history_deleted, ";");
+    return 1;
+}
+
+static void create_file(const char *path, size_t size) {
+    char data[KB];
+    int fd;
+
+    memset(data, 'x', sizeof(data));
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if (fd < 0)
+        return;
+    for ( ; size >= sizeof(data) ; size -= sizeof(data))
+        if (write(fd, data, sizeof(data)) < 0)
+            break;
+    close(fd);
+}
+
+/* Creates a folder holding a file of size, modified age seconds ago */
+static void create_folder(const char *name, size_t size, time_t age) {
+    char path[PATHMAX];
+    struct utimbuf times;
+
+    snprintf(path, sizeof(path), "%s/file", name);
+    mkdir(name, 0770);
+    create_file(path, size);
+    times.actime = times.modtime = time(NULL) - age;
+    utime(name, &times);
+}
+
+static int exists(const char *path) {
+    struct stat info;
+
+    return !stat(path, &info);
+}
+
+/* The root is walked once, then its size follows the accounting */
+void test_quota_account() {
+    struct quota_stats stats;
+    unsigned long long used, expect;
+
+    create_folder(TEST_DIR "/crashlog0", 8 * KB, 0);
+    create_folder(TEST_DIR "/crashlog1", 4 * KB, 0);
+    create_file(TEST_DIR "/currentcrashlog", 2 * KB);
+    used = quota_used(TEST_DIR);
+    if (used != 14 * KB) {
+        printf("%s failed; walk returned %llu\n", __FUNCTION__, used);
+        return;
+    }
+
+    create_file(TEST_DIR "/crashlog1/other", 3 * KB);
+    quota_account(TEST_DIR "/crashlog1/other", 3 * KB);
+    create_folder(TEST_DIR "/aplogs0", 5 * KB, 0);
+    quota_account(TEST_DIR "/aplogs0/file", 5 * KB);
+    quota_account("/elsewhere/file", 100 * KB);
+    expect = 22 * KB;
+    used = quota_used(TEST_DIR);
+
+    quota_forget(TEST_DIR "/crashlog0");
+    quota_get_stats(&stats);
+    if (used == expect && quota_used(TEST_DIR) == expect - 8 * KB && stats.scans == 1)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; used %llu (expected %llu), %llu after forget, %lu scans\n",
+        __FUNCTION__, used, expect, quota_used(TEST_DIR), stats.scans);
+    system("rm -rf " TEST_DIR "/crashlog0");
+}
+
+/* The oldest folders of the mode are evicted first, the newest one is kept */
+void test_quota_evict() {
+    unsigned long long used;
+    int count;
+
+    mkdir(TEST_DIR "/evict", 0770);
+    create_folder(TEST_DIR "/evict/crashlog0", 4 * KB, 300);
+    create_folder(TEST_DIR "/evict/crashlog1", 4 * KB, 200);
+    create_folder(TEST_DIR "/evict/crashlog2", 4 * KB, 100);
+    create_folder(TEST_DIR "/evict/aplogs0", 4 * KB, 400);
+    used = quota_used(TEST_DIR "/evict");
+
+    count = quota_evict(TEST_DIR "/evict", "crashlog", used - 5 * KB);
+    if (count != 2 || exists(TEST_DIR "/evict/crashlog0") || exists(TEST_DIR "/evict/crashlog1") ||
+            !exists(TEST_DIR "/evict/crashlog2") || !exists(TEST_DIR "/evict/aplogs0") ||
+            quota_used(TEST_DIR "/evict") != used - 8 * KB) {
+        printf("%s failed; %d folders evicted, %llu bytes left\n", __FUNCTION__, count,
+            quota_used(TEST_DIR "/evict"));
+        return;
+    }
+    if (strcmp(history_deleted, TEST_DIR "/evict/crashlog0;" TEST_DIR "/evict/crashlog1;")) {
+        printf("%s failed; %s deleted from the history\n", __FUNCTION__, history_deleted);
+        return;
+    }
+    count = quota_evict(TEST_DIR "/evict", "crashlog", 0);
+    if (count == 0 && exists(TEST_DIR "/evict/crashlog2"))
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %d folders evicted past the newest\n", __FUNCTION__, count);
+}
+
+/* Consecutive checks use the cached free space */
+void test_quota_check(int nbchecks) {
+    struct quota_stats before, after;
+    int idx, res = 0;
+
+    quota_get_stats(&before);
+    for (idx = 0 ; idx < nbchecks ; idx++)
+        res |= quota_check(TEST_DIR, 1, NULL);
+    quota_get_stats(&after);
+    if (!res && after.checks - before.checks == (unsigned long)nbchecks &&
+            after.refreshes - before.refreshes <= 1 && after.scans == before.scans)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; returned %d, %lu statfs and %lu walks for %d checks\n", __FUNCTION__,
+        res, after.refreshes - before.refreshes, after.scans - before.scans, nbchecks);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (system("rm -rf " TEST_DIR) || mkdir(TEST_DIR, 0770) < 0) {
+        printf("cannot create %s\n", TEST_DIR);
+        return -1;
+    }
+    test_quota_account();
+    test_quota_evict();
+    test_quota_check(1000);
+    system("rm -rf " TEST_DIR);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+
+#include <privconfig.h>
+#include <collector.h>
+#include <reactor.h>
+
+/* Properties stubs counting the writes */
+static unsigned int property_writes = 0;
+
+int property_get(char __attribute__((unused)) *name, char *value, char *def) {
+    if (!value) return -EINVAL;
+    strncpy(value, def ? def : "", PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+int property_set(char __attribute__((unused)) *name, char __attribute__((unused)) *value) {
+    property_writes++;
+    return 0;
+}
+
+/* collector dependencies, ignored */
+int history_commit_line(const char __attribute__((unused)) *line) { return 0; }
+void notify_crashreport() {}
+
+static unsigned int fd_events = 0;
+static unsigned int timer_events = 0;
+
+static void on_fd(int fd, void __attribute__((unused)) *ctx) {
+    char c;
+
+    collector_set_ongoing(1);
+    if (read(fd, &c, 1) == 1)
+        fd_events++;
+}
+
+static void on_timer(int __attribute__((unused)) fd, void __attribute__((unused)) *ctx) {
+    timer_events++;
+}
+
+static long long elapsed_ms(struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000LL + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+void test_reactor_fd() {
+    int fds[2];
+    unsigned int writes;
+
+    if (pipe(fds) < 0 || reactor_add_fd(fds[0], on_fd, NULL) < 0) {
+        printf("%s failed; cannot register the pipe\n", __FUNCTION__);
+        return;
+    }
+    collector_set_ongoing(0);
+    writes = property_writes;
+
+    /* one write per state change: busy then idle */
+    write(fds[1], "x", 1);
+    reactor_run_once(1000);
+    collector_set_ongoing(0);
+    if (fd_events == 1 && property_writes - writes == 2)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %u events, %u property writes\n", __FUNCTION__,
+        fd_events, property_writes - writes);
+
+    reactor_del_fd(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_reactor_timer(unsigned int period, int runtime_ms, unsigned int expect) {
+    struct timespec start;
+    int fd;
+
+    timer_events = 0;
+    if ((fd = reactor_add_timer(period, on_timer, NULL)) < 0) {
+        printf("%s (%u) failed; returned %d\n", __FUNCTION__, period, fd);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (elapsed_ms(&start) < runtime_ms)
+        reactor_run_once(runtime_ms - elapsed_ms(&start));
+
+    if (timer_events == expect)
+        printf("%s (%u) succeeded\n", __FUNCTION__, period);
+    else printf("%s (%u) failed; returned %u\n", __FUNCTION__, period, timer_events);
+    reactor_del_fd(fd);
+}
+
+/* Runs the monitor loop with its periodic tasks and no event, and
+ * extrapolates the wakeups and the property writes per hour */
+void test_reactor_idle(int runtime_ms) {
+    struct reactor_stats before, after;
+    struct timespec start;
+    unsigned long wakeups, max_wakeups, writes;
+    long long elapsed;
+    int fd;
+
+    if ((fd = reactor_add_timer(CRASHLOG_WD_KICK_PERIOD, on_timer, NULL)) < 0) {
+        printf("%s failed; returned %d\n", __FUNCTION__, fd);
+        return;
+    }
+    collector_set_ongoing(0);
+    reactor_get_stats(&before);
+    writes = property_writes;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((elapsed = elapsed_ms(&start)) < runtime_ms) {
+        collector_set_ongoing(0);
+        reactor_run_once(runtime_ms - elapsed);
+    }
+    elapsed = elapsed_ms(&start);
+    reactor_get_stats(&after);
+    wakeups = after.wakeups - before.wakeups;
+    writes = property_writes - writes;
+    max_wakeups = elapsed / (CRASHLOG_WD_KICK_PERIOD * 1000) + 1;
+
+    printf("%s: %lu wakeups, %lu property writes in %lld ms (%lu wakeups/hour)\n",
+        __FUNCTION__, wakeups, writes, elapsed, 3600UL / CRASHLOG_WD_KICK_PERIOD);
+    if (wakeups <= max_wakeups && !writes)
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %lu wakeups (max %lu), %lu property writes\n", __FUNCTION__,
+        wakeups, max_wakeups, writes);
+    reactor_del_fd(fd);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (reactor_init() < 0) {
+        printf("reactor_init failed\n");
+        return -1;
+    }
+    test_reactor_fd();
+    test_reactor_timer(1, 2500, 2);
+    test_reactor_idle(3000);
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cutils/properties.h>
+
+#include <privconfig.h>
+#include <reaper.h>
+
+#define TEST_DIR    "/tmp/test_reaper"
+#define NB_SUBDIRS  20
+#define NB_FILES    250
+
+/* Properties stubs */
+int property_get(char __attribute__((unused)) *name, char *value, char *def) {
+    if (!value) return -EINVAL;
+    strncpy(value, def ? def : "", PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+int property_set(char __attribute__((unused)) *name, char __attribute__((unused)) *value) {
+    return 0;
+}
+
+/* rmfr stub, the paths shall never be deleted synchronously */
+static int rmfr_calls = 0;
+
+int rmfr(char __attribute__((unused)) *path) {
+    rmfr_calls++;
+    return 0;
+}
+
+int history_delete_first_existent_logcrashpath(const char __attribute__((unused)) *path) {
+    return 1;
+}
+
+static long long now_ms() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* Creates a folder of NB_SUBDIRS directories of NB_FILES files, returns
+ * the number of entries created */
+static unsigned long populate(const char *path) {
+    char name[PATHMAX], data[4096];
+    unsigned long count = 1;
+    int dir, file, fd;
+
+    memset(data, 'x', sizeof(data));
+    mkdir(path, 0770);
+    for (dir = 0 ; dir < NB_SUBDIRS ; dir++) {
+        snprintf(name, sizeof(name), "%s/dir%d", path, dir);
+        mkdir(name, 0770);
+        count++;
+        for (file = 0 ; file < NB_FILES ; file++) {
+            snprintf(name, sizeof(name), "%s/dir%d/file%d", path, dir, file);
+            fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+            if (fd < 0)
+                continue;
+            if (write(fd, data, sizeof(data)) < 0)
+                printf("%s: cannot write %s\n", __FUNCTION__, name);
+            close(fd);
+            count++;
+        }
+    }
+    return count;
+}
+
+/* Waits for the reaper to delete expect entries more than before */
+static int wait_deleted(unsigned long before, unsigned long expect, long long max_ms) {
+    struct reaper_stats stats;
+    long long start = now_ms();
+
+    do {
+        reaper_get_stats(&stats);
+        if (stats.deleted - before >= expect)
+            return 0;
+        usleep(10 * 1000);
+    } while (now_ms() - start < max_ms);
+    return -1;
+}
+
+static int trash_is_empty() {
+    return system("[ -z \"$(ls -A " TEST_DIR "/" TRASH_DIR_NAME ")\" ]") == 0;
+}
+
+/* The folder is gone as soon as reaper_dispose returns, its content is
+ * deleted by the reaper thread */
+void test_reaper_dispose(long long max_ms) {
+    struct reaper_stats stats;
+    unsigned long count;
+    struct stat info;
+    long long start, elapsed;
+    int res;
+
+    count = populate(TEST_DIR "/crashlog0");
+    reaper_get_stats(&stats);
+
+    start = now_ms();
+    res = reaper_dispose(TEST_DIR "/crashlog0");
+    elapsed = now_ms() - start;
+
+    if (res || elapsed > max_ms || stat(TEST_DIR "/crashlog0", &info) == 0) {
+        printf("%s failed; returned %d after %lld ms\n", __FUNCTION__, res, elapsed);
+        return;
+    }
+    if (wait_deleted(stats.deleted, count, 10000) < 0 || !trash_is_empty() || rmfr_calls) {
+        printf("%s failed; %lu entries not deleted by the reaper\n", __FUNCTION__, count);
+        return;
+    }
+    printf("%s succeeded; %lu entries disposed in %lld ms\n", __FUNCTION__, count, elapsed);
+}
+
+/* The leftovers of a previous run are deleted when the trash is kicked */
+void test_reaper_leftovers() {
+    struct reaper_stats stats;
+    unsigned long count;
+
+    mkdir(TEST_DIR "/" TRASH_DIR_NAME, 0770);
+    count = populate(TEST_DIR "/" TRASH_DIR_NAME "/leftover");
+    reaper_get_stats(&stats);
+    reaper_kick(TEST_DIR "/" TRASH_DIR_NAME);
+
+    if (!wait_deleted(stats.deleted, count, 10000) && trash_is_empty())
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; %lu entries not deleted by the reaper\n", __FUNCTION__, count);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (system("rm -rf " TEST_DIR) || mkdir(TEST_DIR, 0770) < 0) {
+        printf("cannot create %s\n", TEST_DIR);
+        return -1;
+    }
+    if (reaper_init() < 0) {
+        printf("reaper_init failed\n");
+        return -1;
+    }
+    test_reaper_leftovers();
+    /* a rename, whatever the size of the folder */
+    test_reaper_dispose(50);
+    system("rm -rf " TEST_DIR);
+    return 0;
+}
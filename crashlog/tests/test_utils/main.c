@@ -0,0 +1,109 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <cutils/properties.h>
+
+#include <utils.h>
+
+#define STUB_SCRIPT "/tmp/test_utils_stub.sh"
+
+/* Properties stubs */
+int property_get(char __attribute__((unused)) *name, char *value, char *def) {
+    if (!value) return -EINVAL;
+    strncpy(value, def ? def : "", PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+int property_set(char __attribute__((unused)) *name, char __attribute__((unused)) *value) {
+    return 0;
+}
+
+/* The stub sleeps for $1 seconds and exits with $2. It prints its
+ * arguments only when $3 is "echo", the output of run_command being the
+ * one of the test. */
+static int create_stub_script() {
+    FILE *fp = fopen(STUB_SCRIPT, "w");
+
+    if (!fp)
+        return -errno;
+    fprintf(fp, "#!/bin/sh\n[ \"$3\" = echo ] && echo \"stub $1 $2\"\nsleep $1\nexit $2\n");
+    fclose(fp);
+    return chmod(STUB_SCRIPT, 0755);
+}
+
+static long long now_ms() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void test_run_command_status(const char *command, int expect) {
+    int res = run_command(command, 5);
+
+    if (res >= 0 && WIFEXITED(res) && WEXITSTATUS(res) == expect)
+        printf("%s (%s) succeeded\n", __FUNCTION__, command);
+    else printf("%s (%s) failed; returned %d\n", __FUNCTION__, command, res);
+}
+
+void test_spawn_command_output() {
+    const char *command[] = {STUB_SCRIPT, "0", "0", "echo", NULL};
+    char out[64];
+    char small[8];
+    int res1, res2;
+
+    res1 = spawn_command(command, 5, out, sizeof(out));
+    res2 = spawn_command(command, 5, small, sizeof(small));
+    if (res1 == 0 && !strcmp(out, "stub 0 0\n") && res2 == 0 && !strcmp(small, "stub 0 "))
+        printf("%s succeeded\n", __FUNCTION__);
+    else printf("%s failed; returned %d (%s) and %d (%s)\n", __FUNCTION__, res1, out, res2, small);
+}
+
+/* The command is killed at the timeout, and reaped */
+void test_run_command_timeout(unsigned int timeout) {
+    long long start = now_ms(), elapsed;
+    int res;
+
+    res = run_command(STUB_SCRIPT " 10 0", timeout);
+    elapsed = now_ms() - start;
+    if (res == -1 && elapsed >= timeout * 1000LL && elapsed < timeout * 1000LL + 500 &&
+            waitpid(-1, NULL, WNOHANG) == -1 && errno == ECHILD)
+        printf("%s (%u) succeeded; returned after %lld ms\n", __FUNCTION__, timeout, elapsed);
+    else printf("%s (%u) failed; returned %d after %lld ms\n", __FUNCTION__, timeout, res, elapsed);
+}
+
+/* The completion is detected without polling delay */
+void test_run_command_latency(int nbruns, long long max_ms) {
+    long long start = now_ms(), average;
+    int idx;
+
+    for (idx = 0 ; idx < nbruns ; idx++)
+        run_command(STUB_SCRIPT " 0.05 0", 5);
+    average = (now_ms() - start) / nbruns;
+    if (average <= max_ms)
+        printf("%s succeeded; %lld ms per command\n", __FUNCTION__, average);
+    else printf("%s failed; %lld ms per command\n", __FUNCTION__, average);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv) {
+
+    if (create_stub_script() < 0) {
+        printf("cannot create %s\n", STUB_SCRIPT);
+        return -1;
+    }
+    test_run_command_status(STUB_SCRIPT " 0 0", 0);
+    test_run_command_status(STUB_SCRIPT " 0 3", 3);
+    test_run_command_status("/nonexistent/command", 127);
+    test_spawn_command_output();
+    test_run_command_timeout(1);
+    /* a 50 ms command used to take 100 ms with the waitpid polling */
+    test_run_command_latency(10, 90);
+    unlink(STUB_SCRIPT);
+    return 0;
+}
@@ -32,34 +32,13 @@
 #include <ctype.h>
 #include <dirent.h>
 
+/* aplog and bplog files are compressed while copied */
 #ifdef FULL_REPORT
-static void compress_aplog_folder(char *folder_path)
-{
-    char cmd[PATHMAX];
-    char spath[PATHMAX];
-    DIR *d;
-    struct dirent* de;
-
-    /* Compress aplog/bplog files */
-    snprintf(cmd, sizeof(cmd), "gzip %s/[ab]plog*", folder_path);
-    run_command(cmd, 45);
-    /* Change owner and group of those aplog files */
-    d = opendir(folder_path);
-    if (d == 0) {
-         return;
-    }
-    else {
-        while ((de = readdir(d)) != 0) {
-           if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
-               continue;
-           snprintf(spath, sizeof(spath)-1,  "%s/%s", folder_path, de->d_name);
-           do_chown(spath, PERM_USER, PERM_GROUP);
-        }
-        closedir(d);
-    }
-}
+#define TRIGGER_COPY_FLAGS  COPY_COMPRESS
+#define TRIGGER_COPY_SUFFIX ".gz"
 #else
-static inline void compress_aplog_folder(char *folder_path __attribute__((__unused__))) {}
+#define TRIGGER_COPY_FLAGS  0
+#define TRIGGER_COPY_SUFFIX ""
 #endif
 
 /**
@@ -78,7 +57,7 @@ static inline void compress_aplog_folder(char *folder_path __attribute__((__unus
 *   mode              -> mode (BZ or APLOG)
  */
 int process_log_event(char *rootdir, char *triggername, int mode) {
-    char *key = NULL;
+    char key[EVENT_ID_SIZE];
     char *dir = NULL;
     char path[PATHMAX];
     char destination[PATHMAX];
@@ -187,22 +166,21 @@ int process_log_event(char *rootdir, char *triggername, int mode) {
             if( !aplogIsPresent ) break;
 
             if( ( newdirperpacket && (logidx == 0) ) || (!newdirperpacket && (packetidx == 0) && (logidx == 0) ) ) {
-                key = generate_event_id(event, type);
+                compute_event_id(key, event, type);
                 dir = generate_crashlog_dir(mode, key);
                 if (!dir) {
                     LOGE("%s: Cannot get a valid new crash directory for %s...\n", __FUNCTION__,
                             (triggername ? triggername : "no trigger file"));
-                    free(key);
                     return -1;
                 }
             }
 
             if (dir != NULL) {
                 /* Set destination file*/
-                snprintf(destination,sizeof(destination),"%s/aplog.%.*d",
+                snprintf(destination,sizeof(destination),"%s/aplog.%.*d" TRIGGER_COPY_SUFFIX,
                         dir, cnt_len, (packetidx*aplogDepth)+logidx);
 
-                do_copy_tail(path, destination, 0);
+                do_copy_file(path, destination, 0, TRIGGER_COPY_FLAGS);
             }
         }
         /* When a new crashlog dir is created per packet, send an event per dir */
@@ -214,10 +192,8 @@ int process_log_event(char *rootdir, char *triggername, int mode) {
             snprintf(path, sizeof(path),"%s/%s",rootdir, triggername);
             do_copy_tail(path, destination, 0);
 
-            compress_aplog_folder(dir);
             raise_event(key, event, type, NULL, dir);
             LOGE("%-8s%-22s%-20s%s %s\n", event, key, get_current_time_long(0), type, dir);
-            free(key);
             free(dir);
             dir = NULL;
             if (rootdir)
@@ -229,12 +205,11 @@ int process_log_event(char *rootdir, char *triggername, int mode) {
     /* In case of bz_trigger with APLOG=0 which means bz type="enhancement" and so no logs needed. */
     if( !newdirperpacket ) {
         if (!dir) {
-            key = generate_event_id(event, type);
+            compute_event_id(key, event, type);
             dir = generate_crashlog_dir(mode, key);
             if (!dir) {
                 LOGE("%s: Cannot get a valid new crash directory for %s...\n", __FUNCTION__,
                         (triggername ? triggername : "no trigger file"));
-                free(key);
                 return -1;
              }
         }
@@ -246,7 +221,7 @@ int process_log_event(char *rootdir, char *triggername, int mode) {
 
             /* In case of bz_trigger with BPLOG=1, copy bplog file(s) */
             if( bplogFlag == 1 ) {
-                do_logs_copy(BPLOG_TYPE, -1, dir, "", MAXFILESIZE);
+                do_logs_copy(BPLOG_TYPE, -1, dir, "", MAXFILESIZE, TRIGGER_COPY_FLAGS);
             }
         }
 
@@ -257,10 +232,8 @@ int process_log_event(char *rootdir, char *triggername, int mode) {
         if (do_screenshot) {
             do_screenshot_copy(path, dir);
         }
-        compress_aplog_folder(dir);
         raise_event(key, event, type, NULL, dir);
         LOGE("%-8s%-22s%-20s%s %s\n", event, key, get_current_time_long(0), type, dir);
-        free(key);
         free(dir);
         restart_profile_srv(2);
     }
@@ -290,7 +263,8 @@ int process_stat_event(struct watch_entry *entry, struct inotify_event *event) {
     char destination[PATHMAX];
     char tmp_data_name[PATHMAX];
     const char *dateshort = get_current_time_short(1);
-    char *key, *p, tmp[32];
+    char key[EVENT_ID_SIZE];
+    char *p, tmp[32];
     char *dir;
 
     snprintf(tmp, sizeof(tmp), "%s", event->name);
@@ -300,13 +274,12 @@ int process_stat_event(struct watch_entry *entry, struct inotify_event *event) {
         strcpy(p, "data");
     }
 
-    key = generate_event_id(STATSEVENT, tmp);
+    compute_event_id(key, STATSEVENT, tmp);
     dir = generate_crashlog_dir(MODE_STATS, key);
     if (!dir) {
         LOGE("%s: Cannot get a valid new crash directory...\n", __FUNCTION__);
         raise_event(key, STATSEVENT, tmp, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", STATSEVENT, key, get_current_time_long(0), tmp);
-        free(key);
         return -1;
     }
 
@@ -341,7 +314,6 @@ int process_stat_event(struct watch_entry *entry, struct inotify_event *event) {
     }
     raise_event(key, STATSEVENT, type, NULL, dir);
     LOGE("%-8s%-22s%-20s%s %s\n", STATSEVENT, key, get_current_time_long(0), type, dir);
-    free(key);
     free(dir);
     return 0;
 }
@@ -74,7 +74,7 @@ static int priv_process_usercrash_event(struct watch_entry *entry, struct inotif
     char path[PATHMAX];
     char destion[PATHMAX];
     char eventname[PATHMAX];
-    char *key;
+    char key[EVENT_ID_SIZE];
     char *dir;
     const char *pb_ext = ".pb";
 
@@ -90,7 +90,7 @@ static int priv_process_usercrash_event(struct watch_entry *entry, struct inotif
     snprintf(path, sizeof(path),"%s/%s", entry->eventpath, event->name);
     snprintf(eventname, sizeof(eventname),"%s%s", entry->eventname,
             priv_filter_crashevent(entry->eventtype, path));
-    key = generate_event_id(CRASHEVENT, eventname);
+    compute_event_id(key, CRASHEVENT, eventname);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir || !file_exists(path)) {
         if (!dir)
@@ -101,7 +101,6 @@ static int priv_process_usercrash_event(struct watch_entry *entry, struct inotif
         }
         raise_event(key, CRASHEVENT, entry->eventname, NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(1), entry->eventname);
-        free(key);
         return -1;
     }
 
@@ -136,7 +135,6 @@ static int priv_process_usercrash_event(struct watch_entry *entry, struct inotif
         /* Event is nor JAVACRASH neither TOMBSTONE : no dumpstate necessary*/
         break;
     }
-    free(key);
     free(dir);
     return 1;
 }
@@ -170,7 +168,7 @@ int process_apcore_event(struct watch_entry *entry, struct inotify_event *event)
     char path[PATHMAX];
     char destion[PATHMAX];
     char eventname[PATHMAX];
-    char *key = NULL;
+    char key[EVENT_ID_SIZE];
     char *dir = NULL;
 
     if (property_get(PROP_COREDUMP, value, "") <= 0 || value[0] != '1') {
@@ -250,7 +248,7 @@ int process_apcore_event(struct watch_entry *entry, struct inotify_event *event)
     snprintf(path, sizeof(path), "%s/%s", entry->eventpath, event->name);
     snprintf(eventname, sizeof(eventname), "%s%s", entry->eventname,
              priv_filter_crashevent(entry->eventtype, path));
-    key = generate_event_id(event_lv, eventname);
+    compute_event_id(key, event_lv, eventname);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir || !file_exists(path)) {
         if (!dir) {
@@ -291,7 +289,6 @@ int process_apcore_event(struct watch_entry *entry, struct inotify_event *event)
     LOGE("%-8s%-22s%-20s%s %s\n", event_lv, key, get_current_time_long(0), entry->eventname, dir);
 
 done:
-    free(key);
     free(dir);
     free(namedup);
     return result;
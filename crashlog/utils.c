@@ -22,7 +22,11 @@
 
 #include <fcntl.h>
 #include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <stdlib.h>
 
@@ -38,58 +42,146 @@ static int64_t current_time_ns() {
     return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
-int run_command_array(const char **command, unsigned int timeout) {
-    pid_t pid;
-    int status;
-    int64_t start = current_time_ns();
-    unsigned int elapsed = timeout;
-    timeout *= 10;
+/* The output is read into out until it is full, the rest is discarded.
+ * Returns 0 at end of file, 1 while the pipe is still open */
+static int read_command_output(int fd, char *out, size_t outlen, size_t *len) {
+    char discard[256];
+    ssize_t nb;
+
+    for (;;) {
+        if (out && *len + 1 < outlen)
+            nb = read(fd, out + *len, outlen - *len - 1);
+        else
+            nb = read(fd, discard, sizeof(discard));
+        if (nb == 0)
+            return 0;
+        if (nb < 0)
+            return (errno == EAGAIN || errno == EINTR) ? 1 : 0;
+        if (out && *len + 1 < outlen) {
+            *len += nb;
+            out[*len] = '\0';
+        }
+    }
+}
 
-    if ((pid = fork()) < 0) {
-        LOGE("%s: Error while forking child\n", __FUNCTION__);
+/**
+ * Spawns a command with vfork semantics, the child sharing the crashlogd
+ * address space until exec instead of copying its page tables, and waits
+ * for its completion on a pidfd. Kernels without pidfd_open fall back to
+ * polling waitpid.
+ */
+int spawn_command(const char **command, unsigned int timeout, char *out, size_t outlen) {
+    struct pollfd fds[2];
+    sigset_t all, prev;
+    pid_t pid, p;
+    int status = -1, pidfd = -1, outfd = -1, pipefd[2] = {-1, -1};
+    int64_t start = current_time_ns(), deadline, remaining;
+    unsigned int nfds, elapsed;
+    size_t len = 0;
+
+    if (!command || !command[0])
         return -1;
-    } else if (!pid) {
+    if (out && outlen) {
+        out[0] = '\0';
+        if (pipe(pipefd) < 0) {
+            LOGE("%s: Cannot create the output pipe - %s\n", __FUNCTION__, strerror(errno));
+            return -1;
+        }
+        fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+        fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+        fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+    }
+
+    /* no signal handler shall run in the child before exec */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &prev);
+    pid = vfork();
+    if (!pid) {
         // child process
         // make sure the child dies when crashlogd dies
         prctl(PR_SET_PDEATHSIG, SIGKILL);
-
         // just ignore SIGPIPE, will go down with parent's
-        struct sigaction sigact;
-        memset(&sigact, 0, sizeof(sigact));
-        sigact.sa_handler = SIG_IGN;
-        sigaction(SIGPIPE, &sigact, NULL);
-
+        signal(SIGPIPE, SIG_IGN);
+        if (pipefd[1] >= 0) {
+            dup2(pipefd[1], STDOUT_FILENO);
+            dup2(pipefd[1], STDERR_FILENO);
+        }
+        pthread_sigmask(SIG_SETMASK, &prev, NULL);
         execvp(command[0], (char **)command);
-        LOGE("%s: Failed to launch (%s): %s\n", __FUNCTION__, command[0], strerror(errno));
-        _exit(-1);
+        _exit(127);
+    }
+    pthread_sigmask(SIG_SETMASK, &prev, NULL);
+
+    if (pipefd[1] >= 0)
+        close(pipefd[1]);
+    outfd = pipefd[0];
+    if (pid < 0) {
+        LOGE("%s: Error while forking child\n", __FUNCTION__);
+        if (outfd >= 0)
+            close(outfd);
+        return -1;
     }
 
-    // parent process
-    while(timeout--) {
-        pid_t p = waitpid(pid, &status, WNOHANG);
+#ifdef __NR_pidfd_open
+    pidfd = syscall(__NR_pidfd_open, pid, 0);
+#endif
 
+    deadline = start + (int64_t)timeout * 1000000000;
+    for (;;) {
+        p = waitpid(pid, &status, WNOHANG);
+        if (p == pid)
+            break;
         if (p == -1) {
             LOGE("%s: Error encountered while waiting for pid: %d (%s)\n",
                  __FUNCTION__, pid, command[0]);
-            return -1;
+            status = -1;
+            goto out;
         }
 
-        if (p == pid)
-            return status;
+        remaining = (deadline - current_time_ns()) / 1000000;
+        if (remaining <= 0) {
+            elapsed = (unsigned int)((current_time_ns() - start) / 100000000);
+            LOGD("%s: Command (%s) timed out: %d seconds (elapsed time: %d.%d seconds)\n",
+                 __FUNCTION__, command[0], timeout, elapsed / 10, elapsed % 10);
+            kill(pid, SIGKILL);
+            // clean child to avoid zombie processes
+            waitpid(pid, NULL, 0);
+            status = -1;
+            goto out;
+        }
 
-        usleep(100000);
+        nfds = 0;
+        if (pidfd >= 0) {
+            fds[nfds].fd = pidfd;
+            fds[nfds++].events = POLLIN;
+        } else if (remaining > 100) {
+            remaining = 100;
+        }
+        if (outfd >= 0) {
+            fds[nfds].fd = outfd;
+            fds[nfds++].events = POLLIN;
+        }
+        if (poll(fds, nfds, remaining) > 0 && outfd >= 0 &&
+                (fds[nfds - 1].revents & (POLLIN | POLLHUP)) &&
+                !read_command_output(outfd, out, outlen, &len)) {
+            close(outfd);
+            outfd = -1;
+        }
     }
 
-    timeout = elapsed;
-    elapsed = (unsigned int)((current_time_ns() - start) / 100000000);
-    LOGD("%s: Command (%s) timed out: %d seconds (elapsed time: %d.%d seconds)\n",
-         __FUNCTION__, command[0], timeout, elapsed / 10, elapsed % 10);
-    kill(pid, SIGKILL);
-
-    // clean child to avoid zombie processes
-    while(waitpid(pid, NULL, WNOHANG) >= 0){};
+    /* collect what the command wrote before exiting */
+    if (outfd >= 0)
+        read_command_output(outfd, out, outlen, &len);
+out:
+    if (outfd >= 0)
+        close(outfd);
+    if (pidfd >= 0)
+        close(pidfd);
+    return status;
+}
 
-    return -1;
+int run_command_array(const char **command, unsigned int timeout) {
+    return spawn_command(command, timeout, NULL, 0);
 }
 
 int run_command(const char *command, unsigned int timeout) {
@@ -181,60 +273,22 @@ int dump_system_information(const char *filepath) {
  *                as in: pm missing or PackageManager service not started, and return -1.
  */
 static int check_package_presence(const char *package) {
-    char buffer[MAXLINESIZE + 1] = {0};
-    char command[PATHMAX];
-    int out_pipe[2];
-    int prev_stdout, prev_stderr;
-    int status, len;
+    char buffer[MAXLINESIZE + 1];
+    const char *command[] = {"pm", "list", "packages", "-f", package, NULL};
+    int status;
 
-    if (!package || package[0] == '\0' || pipe(out_pipe) != 0)
+    if (!package || package[0] == '\0')
         return -1;
 
-    prev_stdout = dup(STDOUT_FILENO);
-    prev_stderr = dup(STDERR_FILENO);
-
-    if ( prev_stdout < 0 || prev_stderr < 0 )
-        goto failed;
-
-    dup2(out_pipe[1], STDOUT_FILENO);
-    dup2(out_pipe[1], STDERR_FILENO);
-    close(out_pipe[1]);
-
-    //need to add O_NONBLOCK, otherwise it will hang if nothing is output on stdout/stderr
-    int fattr = fcntl(out_pipe[0], F_GETFL);
-    if (fattr < 0)
-        goto failed;
-    
-    status = fcntl(out_pipe[0], F_SETFL, fattr | O_NONBLOCK);
-    if (status < 0)
-        goto failed;
-
-    snprintf(command, PATHMAX, "pm list packages -f %s", package);
-    status = run_command(command, 15);
-    fflush(stdout);
-    fflush(stderr);
-
-    len = read(out_pipe[0], buffer, MAXLINESIZE);
-    if (len > 0) buffer[len] = 0;
-    close(out_pipe[0]);
-    dup2(prev_stdout, STDOUT_FILENO);
-    dup2(prev_stderr, STDERR_FILENO);
-    close(prev_stdout);
-    close(prev_stderr);
-
+    status = spawn_command(command, 15, buffer, sizeof(buffer));
     if (status < 0)
         return -1;
     if (strstr(buffer, package))
         return 1;
-    else if (len > 0)
+    else if (buffer[0] != '\0')
         return -1;
 
     return 0;
-
-failed:
-    if (prev_stdout >= 0) close(prev_stdout);
-    if (prev_stderr >= 0) close(prev_stderr);
-    return -1;
 }
 
 int is_crashreport_available() {
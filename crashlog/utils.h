@@ -23,6 +23,24 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include <stddef.h>
+
+/**
+ * Runs a specified command and waits for it to finish for
+ * a given amount of time, optionally capturing its output.
+ *
+ * @param command indicates a null terminated array of parameters,
+ *                first parameter being the command to be run while
+ *                the rest represent the arguments used.
+ * @param timeout value in seconds before stopping the process on
+ *                which the command is running
+ * @param out buffer receiving the null terminated standard output and
+ *            error of the command, truncated to outlen, NULL to let the
+ *            command write to the crashlogd ones
+ * @return -1 on failure, termination status otherwise
+ */
+int spawn_command(const char **command, unsigned int timeout, char *out, size_t outlen);
+
 /**
  * Runs a specified command and waits for it to finish for
  * a given amount of time.
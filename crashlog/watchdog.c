@@ -57,14 +57,14 @@ static void stop_crashlog_watchdog() {
 
 static void process_crashlogwd_event() {
     char destion[PATHMAX];
-    char *key, *dir;
+    char key[EVENT_ID_SIZE];
+    char *dir;
 
-    key = generate_event_id("CRASHLOG_WATCHDOG", NULL);
+    compute_event_id(key, "CRASHLOG_WATCHDOG", NULL);
     dir = generate_crashlog_dir(MODE_CRASH, key);
     if (!dir) {
         raise_event(key, CRASHEVENT, "CRASHLOG_WATCHDOG", NULL, NULL);
         LOGE("%-8s%-22s%-20s%s\n", CRASHEVENT, key, get_current_time_long(0), "CRASHLOG_WATCHDOG");
-        free(key);
         return;
     }
 
@@ -84,7 +84,6 @@ static void process_crashlogwd_event() {
     LOGE("%-8s%-22s%-20s%s %s\n", CRASHEVENT, key, get_current_time_long(0),
             "CRASHLOG_WATCHDOG", dir);
     free(dir);
-    free(key);
 }
 
 static void crashlog_wd_handler(int signal,
@@ -32,8 +32,10 @@ LOCAL_SRC_FILES := \
     LwConfig.cpp \
     logwatch.cpp \
     LwLog.cpp \
+    LogArena.cpp \
     LogItem.cpp \
     LogReader.cpp \
+    PatternFilter.cpp \
     TimeVal.cpp \
     utils.cpp \
     UeventReader.cpp \
@@ -17,93 +17,117 @@
 
 #include "DataFormat.h"
 
-#include <regex.h>
 #include <stddef.h>
-#include <cstdlib>
+#include <cctype>
 #include <vector>
 #include <string>
 #include <map>
 
+#define UNKNOWN_VALUE "-?-"
+
 DataFormat::DataFormat(std::string str, bool repeat) {
   this->source = str;
   this->repeat = repeat;
+  compile();
 }
 
 DataFormat::~DataFormat() {
 }
 
-void DataFormat::setCaptures(std::vector<std::string> cap) {
-  captures = cap;
+void DataFormat::addLiteral(const char *str, size_t len) {
+  if (!program.empty() && program.back().type == OP_LITERAL) {
+    program.back().literal.append(str, len);
+    return;
+  }
+  Op op;
+  op.type = OP_LITERAL;
+  op.literal.assign(str, len);
+  op.key = 0;
+  op.id = 0;
+  program.push_back(op);
 }
 
-void DataFormat::setMap(char key, std::string str) {
-  h_map[key] = str;
-}
+/* Parses the source once: a '%' followed by letters is a map lookup on the
+ * first letter, followed by digits a capture, otherwise it is kept */
+void DataFormat::compile() {
+  const char *str = source.c_str();
 
-void DataFormat::cleanMap() {
-  h_map.clear();
-}
-
-std::string DataFormat::formatMap(std::string str) {
-  regex_t rx;
-  if (regcomp(&rx, "%([a-zA-Z]+)", REG_EXTENDED)) {
-    // just exit
-    return str;
-  }
+  program.clear();
+  while (*str) {
+    const char *start = str;
+    Op op;
 
-  regmatch_t matches[2];
-  while (!regexec(&rx, str.c_str(), 2, matches, REG_EXTENDED)) {
-    char key = str.substr(matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so)
-                .c_str()[0];
+    if (*str != '%' || !isalnum((unsigned char)str[1])) {
+      for (str++; *str && *str != '%'; str++) {}
+      addLiteral(start, str - start);
+      continue;
+    }
 
-    if (!h_map[key].empty()) {
-      str.replace(matches[0].rm_so, matches[0].rm_eo - matches[0].rm_so,
-                  h_map[key]);
+    str++;
+    op.key = 0;
+    op.id = 0;
+    if (isalpha((unsigned char)*str)) {
+      op.type = OP_MAP;
+      op.key = *str;
+      while (isalpha((unsigned char)*str))
+        str++;
     } else {
-      str.replace(matches[0].rm_so, matches[0].rm_eo - matches[0].rm_so,
-                     "-?-");
+      op.type = OP_CAPTURE;
+      for (; isdigit((unsigned char)*str); str++) {
+        /* the ids too big for a capture are unknown anyway */
+        if (op.id < 100000)
+          op.id = op.id * 10 + *str - '0';
+      }
     }
+    program.push_back(op);
   }
-  regfree(&rx);
-  return str;
 }
 
-std::string DataFormat::formatCap(std::string str) {
-    regex_t rx;
-    if (regcomp(&rx, "%([0-9]+)", REG_EXTENDED)) {
-      // just exit
-      return str;
-    }
+void DataFormat::setCaptures(std::vector<std::string> cap) {
+  captures = cap;
+}
 
-    regmatch_t matches[2];
-    while (!regexec(&rx, str.c_str(), 2, matches, REG_EXTENDED)) {
-      int id = atoi(
-          str.substr(matches[1].rm_so, matches[1].rm_eo - matches[1].rm_so)
-              .c_str());
-      if (id >= 0 && (size_t) id < captures.size()) {
-        str.replace(matches[0].rm_so, matches[0].rm_eo - matches[0].rm_so,
-                       captures[id]);
-      } else {
-        str.replace(matches[0].rm_so, matches[0].rm_eo - matches[0].rm_so,
-                       "-?-");
-      }
-    }
-    regfree(&rx);
-    return str;
+void DataFormat::setMap(char key, std::string str) {
+  h_map[key] = str;
+}
+
+void DataFormat::cleanMap() {
+  h_map.clear();
 }
 
 bool DataFormat::isRepeat() const {
   return repeat;
 }
 
-std::string DataFormat::format(std::vector<std::string> cap,
-                               std::map<char, std::string> map) {
+std::string DataFormat::format(const std::vector<std::string> &cap,
+                               const std::map<char, std::string> &map) {
   if (!cap.empty())
     captures = cap;
 
   if (!map.empty())
     h_map = map;
 
-  std::string format = formatMap(source);
-  return formatCap(format);
+  std::string ret;
+  for (auto &op : program) {
+    switch (op.type) {
+      case OP_LITERAL:
+        ret += op.literal;
+        break;
+      case OP_MAP: {
+        auto value = h_map.find(op.key);
+        if (value != h_map.end() && !value->second.empty())
+          ret += value->second;
+        else
+          ret += UNKNOWN_VALUE;
+        break;
+      }
+      case OP_CAPTURE:
+        if (op.id < captures.size())
+          ret += captures[op.id];
+        else
+          ret += UNKNOWN_VALUE;
+        break;
+    }
+  }
+  return ret;
 }
@@ -24,20 +24,34 @@
 #include <map>
 
 class DataFormat {
+  enum OpType {
+    OP_LITERAL,  // text copied as is
+    OP_MAP,      // %<letters>, value of the map for the first letter
+    OP_CAPTURE,  // %<digits>, capture of the pattern
+  };
+
+  struct Op {
+    OpType type;
+    std::string literal;
+    char key;
+    size_t id;
+  };
+
   std::string source;
+  std::vector<Op> program;
   std::map<char, std::string> h_map;
   std::vector<std::string> captures;
   bool repeat;
 
-  std::string formatMap(std::string str);
-  std::string formatCap(std::string str);
+  void compile();
+  void addLiteral(const char *str, size_t len);
  public:
   explicit DataFormat(std::string str, bool repeat = false);
   virtual ~DataFormat();
 
   std::string format(
-      std::vector<std::string> cap, std::map<char, std::string> h_map =
-          std::map<char, std::string>());
+      const std::vector<std::string> &cap,
+      const std::map<char, std::string> &h_map = std::map<char, std::string>());
 
   void setCaptures(std::vector<std::string> cap);
   void setMap(char key, std::string str);
@@ -29,11 +29,11 @@
 #include <string>
 
 #include "LwLog.h"
-#include "DataFormat.h"
 #include "utils.h"
 
 EventAttachment::EventAttachment(std::string s, std::string d, bool exec,
-                                 unsigned int wait) : src(s), dst(d) {
+                                 unsigned int wait)
+    : src(s), dst(d), src_format(s), dst_format(d) {
   if (src.empty()) {
     type = ATT_INVALID;
     return;
@@ -63,10 +63,8 @@ std::string EventAttachment::get(std::string base,
   std::string f_src = this->src;
 
   if (!cap.empty()) {
-    DataFormat df_src(f_src);
-    f_src = df_src.format(cap);
-    DataFormat df_dst(f_dst);
-    f_dst = df_dst.format(cap);
+    f_src = src_format.format(cap);
+    f_dst = dst_format.format(cap);
   }
 
   std::string full_dest = base + "/" + f_dst;
@@ -21,6 +21,8 @@
 #include <string>
 #include <vector>
 
+#include "DataFormat.h"
+
 class EventAttachment {
   enum AttachmentType {
     ATT_INVALID,
@@ -33,6 +35,8 @@ class EventAttachment {
   unsigned int max_wait;
   std::string src;
   std::string dst;
+  DataFormat src_format;
+  DataFormat dst_format;
   bool exec(std::string d, std::string command = "");
 
  public:
@@ -31,8 +31,10 @@ EventRecord::~EventRecord() {
   captures.clear();
 }
 
-void EventRecord::addItem(std::shared_ptr<LogItem> li) {
-  items.push_back(li);
+/* The records live until flushed, their items must not hold the slabs of
+ * the reader arena */
+void EventRecord::addItem(const LogItemPtr &li) {
+  items.push_back(LogItem::detach(li));
 }
 
 const std::vector<std::string>& EventRecord::getCaptures() const {
@@ -43,7 +45,7 @@ void EventRecord::setCaptures(const std::vector<std::string>& captures) {
   this->captures = captures;
 }
 
-const std::vector<std::shared_ptr<LogItem>>& EventRecord::getItems() const {
+const std::vector<LogItemPtr>& EventRecord::getItems() const {
   return items;
 }
 
@@ -20,25 +20,25 @@
 
 #include <cstddef>
 #include <ctime>
-#include <memory>
 #include <string>
 #include <vector>
 
-class LogItem;
+#include "LogItem.h"
+
 class TimeVal;
 
 class EventRecord {
-  std::vector<std::shared_ptr<LogItem>> items;
+  std::vector<LogItemPtr> items;
   std::vector<std::string> captures;  // From the start log item
   bool valid;
  public:
   EventRecord();
   virtual ~EventRecord();
-  void addItem(std::shared_ptr<LogItem> li);
+  void addItem(const LogItemPtr &li);
   size_t itemCount();
   TimeVal getTimestamp() const;
   const std::vector<std::string>& getCaptures() const;
-  const std::vector<std::shared_ptr<LogItem>>& getItems() const;
+  const std::vector<LogItemPtr>& getItems() const;
   void setCaptures(const std::vector<std::string>& captures);
   bool isValid() const;
   void setValid(bool valid);
@@ -18,6 +18,7 @@
 #include "EventWatch.h"
 
 #include <sys/stat.h>
+#include <unistd.h>
 #include <climits>
 #include <cstdio>
 #include <fstream>
@@ -36,6 +37,8 @@
 #endif
 
 #define MAILBOX_MAX_LIMIT 5000
+#define MAILBOX_BATCH 64
+#define MAILBOX_RETRY_DELAY 1000  // us
 #define SUSPEND_RECORDS_MAX_LIMIT 50
 #define DEFAULT_MAX_COUNT 10
 #define DEFAULT_MAX_INTERVAL 60
@@ -56,7 +59,10 @@ EventWatch::EventWatch(const char *name)
       max_records(10),
       max_suspend_records(0),
       flush_timeout(120),
+      mailbox_drops(0),
+      dropping(false),
       accept_data(true),
+      kill_pending(false),
       flush_count(0),
       suspend_records_count(0),
       suspend_until(-1),
@@ -64,7 +70,6 @@ EventWatch::EventWatch(const char *name)
       thread(0),
       kill_reason(UNKNOWN) {
   this->name = name ? name : "Unnamed";
-  sem_init(&items_available, 0, 0);
   sem_init(&started, 0, 0);
   pthread_mutex_init(&mutex, NULL);
 }
@@ -82,7 +87,6 @@ EventWatch::~EventWatch() {
     body_patterns.pop_front();
   }
 
-  sem_destroy(&items_available);
   sem_destroy(&started);
   pthread_mutex_destroy(&mutex);
 }
@@ -163,12 +167,12 @@ void EventWatch::addRecord(std::shared_ptr<EventRecord> record) {
   }
 }
 
-bool EventWatch::process(std::shared_ptr<LogItem> li) {
+bool EventWatch::process(const LogItemPtr &li) {
   bool taken = false;
   bool ret = true;
 
   if (!li->isEof()) {
-    if (start_pattern && start_pattern->check(li->getMsg())) {
+    if (start_pattern && start_pattern->check(*li)) {
       if (record)
         addRecord(record);
       record = std::make_shared<EventRecord>();
@@ -179,14 +183,14 @@ bool EventWatch::process(std::shared_ptr<LogItem> li) {
       }
       taken = true;
     } else if (record) {
-      if (end_pattern && end_pattern->check(li->getMsg())) {
+      if (end_pattern && end_pattern->check(*li)) {
         record->addItem(li);
         addRecord(record);
         record.reset();
         taken = true;
       }
 
-      if (!taken && valid_pattern && valid_pattern->check(li->getMsg())) {
+      if (!taken && valid_pattern && valid_pattern->check(*li)) {
         record->addItem(li);
         record->setCaptures(valid_pattern->getLastMatches());
         record->setValid(true);
@@ -196,7 +200,7 @@ bool EventWatch::process(std::shared_ptr<LogItem> li) {
       if (!taken) {
         if (!body_patterns.empty()) {
           for (auto pat : body_patterns) {
-            if (pat->check(li->getMsg())) {
+            if (pat->check(*li)) {
               record->addItem(li);
               taken = true;
               break;
@@ -257,7 +261,7 @@ void EventWatch::setMaxRecords(size_t maxRecords) {
   max_records = maxRecords;
 }
 
-bool EventWatch::feed(std::shared_ptr<LogItem> li) {
+bool EventWatch::feed(const LogItemPtr &li) {
   if (!li->isEof()
       && (li->getPrio() > max_level || li->getPrio() < min_level))
     return true;
@@ -271,22 +275,19 @@ bool EventWatch::feed(std::shared_ptr<LogItem> li) {
     case READY:
       threadStart();
     case RUNNING:
-      pthread_mutex_lock(&mutex);
-      if (mailbox.size() > mailbox_max) {
-        LwLog::error("Lazy %s, mailbox size > %d", name.c_str(), mailbox_max);
-        kill_reason = LAZY;
-        mailbox.clear();
-        /* Send an eof*/
-        li = std::make_shared<LogItem>();
-        li->setEof(true);
-        accept_data = false;
-        mailbox.push_back(li);
-        sem_post(&items_available);
-      } else if (accept_data) {
-        mailbox.push_back(li);
-        sem_post(&items_available);
+      if (li->isEof()) {
+        /* the end of the stream is never dropped */
+        while (!mailbox.push(li) && accept_data)
+          usleep(MAILBOX_RETRY_DELAY);
+      } else if (mailbox.push(li)) {
+        dropping = false;
+      } else {
+        mailbox_drops++;
+        if (!dropping)
+          LwLog::error("Slow %s, mailbox size > %d, dropping items", name.c_str(),
+                       mailbox_max);
+        dropping = true;
       }
-      pthread_mutex_unlock(&mutex);
   }
   return true;
 }
@@ -467,15 +468,9 @@ void EventWatch::flush(const char* reason) {
       LwLog::info("Max events for %s, mec %d", name.c_str(), max_event_count);
       kill_reason = MAX_EVENTS;
     }
-    std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-    if (!li)
-      LwLog::critical("Cannot allocate log item");
-    li->setEof(true);
-
+    /* the thread stops once the current item is processed */
     accept_data = false;
-    mailbox.clear();
-    mailbox.push_back(li);
-    sem_post(&items_available);
+    kill_pending = true;
   }
 
   pthread_mutex_unlock(&mutex);
@@ -484,6 +479,7 @@ void EventWatch::flush(const char* reason) {
 
 void EventWatch::threadStart() {
   LwLog::info("Starting %s thread", name.c_str());
+  mailbox.setCapacity(mailbox_max);
   pthread_create(&thread, NULL, threadEntry, this);
   sem_wait(&started);
 }
@@ -499,21 +495,22 @@ void EventWatch::threadLoop() {
   sem_post(&started);
   pthread_mutex_unlock(&mutex);
 
-  std::shared_ptr<LogItem> li;
-  while (thread_state == RUNNING) {
-    sem_wait(&items_available);
-    pthread_mutex_lock(&mutex);
-    if (mailbox.empty()) {
-      pthread_mutex_unlock(&mutex);
-      LwLog::error("Wake up with no data %s", name.c_str());
-    } else {
-      li = mailbox.front();
-      mailbox.pop_front();
-      pthread_mutex_unlock(&mutex);
-      if (!process(li))
-        break;
+  LogItemPtr items[MAILBOX_BATCH];
+  bool running = true;
+  while (running) {
+    size_t count = mailbox.pop(items, MAILBOX_BATCH);
+    for (size_t idx = 0; idx < count; idx++) {
+      if (running && (!process(items[idx]) || kill_pending))
+        running = false;
+      items[idx].reset();
     }
   }
+  if (kill_pending) {
+    /* Flush what is left as on an eof, the pending items are discarded */
+    LogItemPtr li = LogItem::create();
+    li->setEof(true);
+    process(li);
+  }
   pthread_mutex_lock(&mutex);
   /*End of life, generate the stats event*/
   if (LwConfig::inst()->getWatcherStats())
@@ -616,12 +613,10 @@ void EventWatch::notifyKill() {
   config += ", esi:" + std::to_string(event_suspend_interval);
   config += ", kl:" + std::to_string(keep_last);
   config += ", mm:" + std::to_string(mailbox_max);
+  config += ", md:" + std::to_string(mailbox_drops);
 
   const char *reason = "Unknown";
   switch (kill_reason) {
-    case LAZY:
-      reason = "Lazy";
-      break;
     case NOISY:
       reason = "Noisy";
       break;
@@ -663,3 +658,7 @@ void EventWatch::setMailboxMax(unsigned int max) {
                  MAILBOX_MAX_LIMIT);
   mailbox_max = max > MAILBOX_MAX_LIMIT ? MAILBOX_MAX_LIMIT : max;
 }
+
+unsigned long EventWatch::getMailboxDrops() const {
+  return mailbox_drops;
+}
@@ -21,6 +21,7 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <stddef.h>
+#include <atomic>
 #include <ctime>
 #include <list>
 #include <memory>
@@ -30,9 +31,10 @@
 #include "DataFormat.h"
 #include "EventAttachment.h"
 #include "ItemPattern.h"
+#include "LogItem.h"
+#include "Mailbox.h"
 #include "TimeVal.h"
 
-class LogItem;
 class EventRecord;
 class TimeVal;
 
@@ -44,7 +46,6 @@ enum TState {
 
 enum KillReason {
   UNKNOWN,
-  LAZY,
   NOISY,
   MAX_EVENTS,
 };
@@ -74,16 +75,18 @@ class EventWatch {
   std::list<std::shared_ptr<EventRecord>> records;
   std::list<std::shared_ptr<EventRecord>> suspend_records;
   std::shared_ptr<EventRecord> record;
-  std::list<std::shared_ptr<LogItem>> mailbox;
+  Mailbox<LogItemPtr> mailbox;
+  std::atomic<unsigned long> mailbox_drops;
+  bool dropping;
 
   std::list<TimeVal> event_log;
 
-  bool accept_data;
+  std::atomic<bool> accept_data;
+  bool kill_pending;
   unsigned int flush_count;
   size_t suspend_records_count;
   TimeVal suspend_until;
 
-  sem_t items_available;
   sem_t started;
   pthread_mutex_t mutex;
 
@@ -99,7 +102,7 @@ class EventWatch {
   std::string getOutputDirName(unsigned int id);
   void flush(const char *reason);
   void notifyKill();
-  bool process(std::shared_ptr<LogItem> li);
+  bool process(const LogItemPtr &li);
   void addRecord(std::shared_ptr<EventRecord> record);
   void logEvent(TimeVal ts);
   bool logContinue();
@@ -116,7 +119,7 @@ class EventWatch {
   void setValidPattern(const char* pattern);
   bool isValid();
   bool isEnabled();
-  bool feed(std::shared_ptr<LogItem> li);
+  bool feed(const LogItemPtr &li);
   void setFlushTimeout(unsigned int flushTimeout);
   void setMaxItems(size_t max);
   void setMaxRecords(size_t maxRecords);
@@ -128,6 +131,7 @@ class EventWatch {
   void setDataFormats(unsigned int id, const char *pattern, bool repeat);
   const std::string& getName() const;
   void setMailboxMax(unsigned int max);
+  unsigned long getMailboxDrops() const;
   void setKeepLast(unsigned int keepLast);
   void setMaxEvents(unsigned int maxEventCount, unsigned int maxEventInterval);
   void setEventSuspendInterval(unsigned int EventSuspendInterval);
@@ -17,13 +17,195 @@
 
 #include "ItemPattern.h"
 
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 #include <vector>
 
+#include "LogItem.h"
+#include "PatternFilter.h"
+
+static bool parseAlternatives(const char **p, bool in_group, std::string *best,
+                              bool *alternatives);
+
+static void keepLongest(std::string *best, std::string *run) {
+  if (run->size() > best->size())
+    *best = *run;
+  run->clear();
+}
+
+/* Skips a bracket expression, p is after the '[' */
+static bool skipBracket(const char **p) {
+  const char *s = *p;
+
+  if (*s == '^')
+    s++;
+  if (*s == ']')
+    s++;
+  for (; *s && *s != ']'; s++) {
+    if (*s == '[' && (s[1] == ':' || s[1] == '=' || s[1] == '.')) {
+      char end = s[1];
+      for (s += 2; *s && !(*s == end && s[1] == ']'); s++) {}
+      if (!*s)
+        return false;
+      s++;
+    }
+  }
+  if (!*s)
+    return false;
+  *p = s + 1;
+  return true;
+}
+
+/* Reads the quantifier following an atom, if any, and its minimum count */
+static bool parseQuantifier(const char **p, bool *quantified, long *min) {
+  const char *s = *p;
+
+  *quantified = true;
+  switch (*s) {
+    case '*':
+    case '?':
+      *min = 0;
+      s++;
+      break;
+    case '+':
+      *min = 1;
+      s++;
+      break;
+    case '{': {
+      char *end;
+      if (!isdigit(s[1]))
+        return false;
+      *min = strtol(s + 1, &end, 10);
+      s = strchr(end, '}');
+      if (!s)
+        return false;
+      s++;
+      break;
+    }
+    default:
+      *quantified = false;
+      *min = 1;
+      return true;
+  }
+  /* stacked quantifiers are left to regexec */
+  if (*s == '*' || *s == '?' || *s == '+' || *s == '{')
+    return false;
+  *p = s;
+  return true;
+}
+
+/* Parses one branch up to '|', ')' or the end. best is set to the longest
+ * literal contained by every string the branch matches */
+static bool parseBranch(const char **p, bool in_group, std::string *best) {
+  std::string run;
+  const char *s = *p;
+
+  while (*s && *s != '|' && *s != ')') {
+    std::string group;
+    bool alternatives = false;
+    bool literal = false;
+    char c = 0;
+
+    switch (*s) {
+      case '(':
+        s++;
+        if (!parseAlternatives(&s, true, &group, &alternatives) || *s != ')')
+          return false;
+        s++;
+        break;
+      case '[':
+        s++;
+        if (!skipBracket(&s))
+          return false;
+        break;
+      case '.':
+      case '^':
+      case '$':
+        s++;
+        break;
+      case '\\':
+        c = s[1];
+        if (!c)
+          return false;
+        /* \w, \<, \b... are classes or anchors, not characters */
+        literal = !isalnum(c) && !strchr("<>`'", c);
+        s += 2;
+        break;
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        return false;
+      default:
+        c = *s++;
+        literal = true;
+        break;
+    }
+
+    bool quantified;
+    long min;
+    if (!parseQuantifier(&s, &quantified, &min))
+      return false;
+
+    if (literal && !quantified) {
+      run += c;
+    } else if (literal && min > 0) {
+      /* "ab+c" contains "ab" and "bc" */
+      run += c;
+      keepLongest(best, &run);
+      run = c;
+    } else {
+      keepLongest(best, &run);
+      if (min > 0 && !alternatives)
+        keepLongest(best, &group);
+    }
+  }
+  keepLongest(best, &run);
+  if (*s == ')' && !in_group)
+    return false;
+  *p = s;
+  return true;
+}
+
+/* Parses the branches up to ')' or the end. A literal is only required when
+ * there is a single branch */
+static bool parseAlternatives(const char **p, bool in_group, std::string *best,
+                              bool *alternatives) {
+  const char *s = *p;
+
+  *alternatives = false;
+  if (!parseBranch(&s, in_group, best))
+    return false;
+  while (*s == '|') {
+    std::string other;
+    s++;
+    if (!parseBranch(&s, in_group, &other))
+      return false;
+    *alternatives = true;
+  }
+  if (*alternatives)
+    best->clear();
+  *p = s;
+  return true;
+}
+
+/* Longest literal every match of the extended regular expression contains,
+ * empty when there is none or when the pattern is not understood */
+static std::string requiredLiteral(const char *pattern) {
+  std::string best;
+  bool alternatives;
+
+  if (!parseAlternatives(&pattern, false, &best, &alternatives) || *pattern)
+    return "";
+  return best;
+}
+
 ItemPattern::ItemPattern(const char *pattern) {
   match_count = 0;
   matches = NULL;
+  literal_id = -1;
 
   this->pattern = pattern;
 
@@ -33,6 +215,9 @@ ItemPattern::ItemPattern(const char *pattern) {
 
   match_count = countCaptures();
   matches = new regmatch_t[match_count];
+
+  literal = requiredLiteral(pattern);
+  literal_id = PatternFilter::inst()->add(literal);
 }
 
 ItemPattern::~ItemPattern() {
@@ -72,6 +257,19 @@ bool ItemPattern::check(const char* str) {
   return (last_error == 0);
 }
 
+/* Skips regexec when the scan of the item did not find the literal */
+bool ItemPattern::check(const LogItem &li) {
+  if (literal_id >= 0 && !li.isCandidate(literal_id)) {
+    last_error = REG_NOMATCH;
+    return false;
+  }
+  return check(li.getMsg());
+}
+
+const std::string& ItemPattern::getLiteral() const {
+  return literal;
+}
+
 std::vector<std::string> ItemPattern::getLastMatches() const {
   std::vector<std::string> ret;
   if (last_error || last_string.empty())
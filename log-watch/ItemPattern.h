@@ -23,6 +23,8 @@
 #include <string>
 #include <vector>
 
+class LogItem;
+
 class ItemPattern {
   std::string pattern;
   regex_t rx;
@@ -30,6 +32,8 @@ class ItemPattern {
   size_t match_count;
   int last_error;
   std::string last_string;
+  std::string literal;
+  int literal_id;
 
   int countCaptures();
 
@@ -42,6 +46,8 @@ class ItemPattern {
   bool isValid();
   std::string getLastError();
   bool check(const char *str);
+  bool check(const LogItem &li);
+  const std::string& getLiteral() const;
   std::vector<std::string> getLastMatches() const;
 };
 
@@ -17,12 +17,13 @@
 
 #include "KmsgReader.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <unistd.h>
-#include <cstdio>
 #include <cstring>
-#include <errno.h>
+#include <utility>
 
 #include "LogItem.h"
 #include "LwLog.h"
@@ -33,116 +34,204 @@
 #define SEC_FROM_USEC(a) ((a)/(USEC_IN_SEC))
 #define EXTRA_USEC(a)    ((a)%(USEC_IN_SEC))
 
-KmsgReader::KmsgReader(bool nonblock) :last_prio(0), last_timestamp(0) {
-  int mode = O_RDONLY;
-  this->nonblock = nonblock;
-  if (nonblock)
-    mode |= O_NONBLOCK;
-  fd = open(FPATH, mode);
+/* Reads the decimal number at s, NULL when there is none */
+static const char *parseNumber(const char *s, const char *end,
+                               uint64_t *value) {
+  uint64_t v = 0;
+
+  if (s == end || *s < '0' || *s > '9')
+    return NULL;
+  for (; s < end && *s >= '0' && *s <= '9'; s++)
+    v = v * 10 + (*s - '0');
+  *value = v;
+  return s;
+}
+
+/* Writes value padded to width, as printf "%<width>" would with pad */
+static char *putNumber(char *out, uint64_t value, int width, char pad) {
+  char digits[20];
+  int count = 0;
+
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  for (; width > count; width--)
+    *out++ = pad;
+  while (count)
+    *out++ = digits[--count];
+  return out;
+}
+
+KmsgReader::KmsgReader(bool nonblock)
+    : KmsgReader(open(FPATH, O_RDONLY), nonblock) {
   if (fd < 0)
     LwLog::error("Cannot open " FPATH " (%d)", fd);
 }
 
-std::shared_ptr<LogItem> KmsgReader::get() {
-  std::shared_ptr<LogItem> ret = std::make_shared<LogItem>();
-  if (!ret)
-    LwLog::critical("Cannot allocate log item");
-  if (fd < 0) {
-    ret->setEof(true);
-    return ret;
+/* Takes over fd, a record per read() as with /dev/kmsg */
+KmsgReader::KmsgReader(int fd, bool nonblock)
+    : fd(fd),
+      last_prio(0),
+      last_timestamp(0),
+      last_seq(0),
+      has_seq(false),
+      dropped(0),
+      nonblock(nonblock),
+      eof(false),
+      next(0) {
+  if (fd >= 0)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  pending.reserve(KMSG_BATCH);
+}
+
+/* The records overwritten before being read leave a gap in the sequence */
+void KmsgReader::checkSeq(uint64_t seq) {
+  if (has_seq && seq > last_seq + 1) {
+    uint64_t lost = seq - last_seq - 1;
+    dropped += lost;
+    LwLog::warn("KmsgReader: %" PRIu64 " records lost", lost);
   }
+  has_seq = true;
+  last_seq = seq;
+}
 
-  int len = read(fd, read_buf, LOG_MAX_LEN);
+/* Makes the item of the record in read_buf. The continuation lines
+ * (" KEY=value") are left out, the records without header get the
+ * priority and time of the previous one */
+LogItemPtr KmsgReader::parse(size_t len) {
+  const char *end = read_buf + len;
+  const char *msg = read_buf;
+  const char *semi = static_cast<const char *>(memchr(read_buf, ';', len));
+
+  if (semi) {
+    uint64_t prio, seq, timestamp;
+    const char *s = parseNumber(read_buf, semi, &prio);
+    if (s && *s == ',')
+      s = parseNumber(s + 1, semi, &seq);
+    else
+      s = NULL;
+    if (s && *s == ',')
+      s = parseNumber(s + 1, semi, &timestamp);
+    else
+      s = NULL;
+    /* the flags and the fields the kernel may add are skipped */
+    if (s && (s == semi || *s == ',')) {
+      last_prio = prio & 7;
+      last_timestamp = timestamp;
+      checkSeq(seq);
+      msg = semi + 1;
+    }
+  }
 
-  if (len == 0) {
-    if (nonblock) {
-      ret->setEof(true);
+  const char *msg_end = static_cast<const char *>(memchr(msg, '\n', end - msg));
+  if (!msg_end)
+    msg_end = end;
+
+  /* "<prio> [sssss.uuuuuu] message" */
+  char *out = msg_buf;
+  *out++ = '<';
+  out = putNumber(out, last_prio, 0, ' ');
+  *out++ = '>';
+  *out++ = ' ';
+  *out++ = '[';
+  out = putNumber(out, SEC_FROM_USEC(last_timestamp), 5, ' ');
+  *out++ = '.';
+  out = putNumber(out, EXTRA_USEC(last_timestamp), 6, '0');
+  *out++ = ']';
+  *out++ = ' ';
+  memcpy(out, msg, msg_end - msg);
+  out += msg_end - msg;
+
+  /* the message is stored with the item, in the arena of the reader */
+  LogItemPtr ret = LogItem::create(&arena, msg_buf, out - msg_buf);
+
+  TimeVal ts(SEC_FROM_USEC(last_timestamp), EXTRA_USEC(last_timestamp));
+  ret->setTimestamp(ts);
+  ret->setPrio(last_prio);
+  return ret;
+}
+
+/* Reads the available records into pending, false when the log is over */
+bool KmsgReader::drain() {
+  pending.clear();
+  next = 0;
+
+  while (pending.size() < KMSG_BATCH) {
+    ssize_t len = read(fd, read_buf, LOG_MAX_LEN);
+
+    if (len > 0) {
+      pending.push_back(parse(len));
+      continue;
+    }
+    if (len == 0) {
       LwLog::info("KmsgReader: EOF");
-    } else {
-      ret->setEmpty(true);
+      return false;
     }
-    return ret;
-  }
 
-  if (len < 0) {
     switch (errno) {
+      case EAGAIN:
+        if (nonblock && pending.empty()) {
+          LwLog::info("KmsgReader: EOF");
+          return false;
+        }
+        return true;
+      case EINTR:
+        break;
       /* Acording to Documentation/ABI/testing/dev-kmsg:
        *
        * In case messages get overwritten in the circular buffer while
        * the device is kept open, the next read() will return -EPIPE,
        * and the seek position be updated to the next available record.
-       * Subsequent reads() will return available records again.*/
+       * Subsequent reads() will return available records again.
+       *
+       * The count of the records lost is known by the next one. */
       case EPIPE:
-        LwLog::warn("KmsgReader: buffer overrun", len, errno);
-        ret->setEmpty(true);
+        LwLog::warn("KmsgReader: buffer overrun");
         break;
       case EINVAL:
-        LwLog::warn("KmsgReader: insufficient buffer size", len, errno);
-        ret->setEmpty(true);
-        break;
+        LwLog::warn("KmsgReader: insufficient buffer size");
+        return true;
       case EFAULT:
-        LwLog::warn("KmsgReader: unable to copy to user memory", len, errno);
-        ret->setEmpty(true);
-        break;
-      case EINTR:
-        LwLog::warn("KmsgReader: interrupted read", len, errno);
-        ret->setEmpty(true);
-        break;
+        LwLog::warn("KmsgReader: unable to copy to user memory");
+        return true;
       default:
-        LwLog::error("KmsgReader: Bad read r: %d, err: %d", len, errno);
-        ret->setEof(true);
-        break;
+        LwLog::error("KmsgReader: Bad read r: %zd, err: %d", len, errno);
+        return false;
     }
-    return ret;
   }
+  return true;
+}
 
-  /* just make sure we are null terminated */
-  if ((size_t)len < LOG_MAX_LEN)
-    read_buf[len] = 0;
-  else
-    read_buf[LOG_MAX_LEN - 1] = 0;
-
-  /* the actual parsing*/
-  unsigned char prio;
-  uint64_t timestamp;
-
-  const char *msg_start = strchr(read_buf, ';');
-  if (msg_start) {
-    msg_start++;
-    if (sscanf(read_buf, "%hhu,%*u,%" PRIu64 ",", &prio, &timestamp) == 2) {
-      last_prio = prio = prio & 7;
-      last_timestamp = timestamp;
-    } else {
-      prio = last_prio;
-      timestamp = last_timestamp;
+LogItemPtr KmsgReader::get() {
+  if (next < pending.size())
+    return std::move(pending[next++]);
+  if (fd < 0 || eof)
+    return statusItem(true);
+
+  if (!nonblock) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, -1) < 0) {
+      if (errno == EINTR)
+        return statusItem(false);
+      LwLog::error("KmsgReader: poll failed (%d)", errno);
+      eof = true;
+      return statusItem(true);
     }
-  } else {
-    prio = last_prio;
-    timestamp = last_timestamp;
   }
 
-  size_t out_len = snprintf(NULL, 0, "<%d> [%5" PRIu64 ".%06" PRIu64 "] %s",
-                            prio, SEC_FROM_USEC(timestamp),
-                            EXTRA_USEC(timestamp),
-                            msg_start ? msg_start : read_buf);
-
-  char *msg = new char[out_len];
-
-  if (msg) {
-    snprintf(msg, out_len, "<%d> [%5" PRIu64 ".%06" PRIu64 "] %s", prio,
-             SEC_FROM_USEC(timestamp), EXTRA_USEC(timestamp),
-             msg_start ? msg_start : read_buf);
-  }
-
-  TimeVal ts(SEC_FROM_USEC(timestamp), EXTRA_USEC(timestamp));
-  ret->setTimestamp(ts);
-  ret->setPrio(prio);
-  ret->setMsg(msg);
+  if (!drain())
+    eof = true;
+  if (next < pending.size())
+    return std::move(pending[next++]);
+  return statusItem(eof);
+}
 
-  return ret;
+unsigned long KmsgReader::getDropped() const {
+  return dropped;
 }
 
 KmsgReader::~KmsgReader() {
-  if (fd > 0)
+  if (fd >= 0)
     close(fd);
 }
@@ -18,7 +18,8 @@
 #define KMSGREADER_H_
 
 #include <stddef.h>
-#include <memory>
+#include <stdint.h>
+#include <vector>
 
 #include "LogReader.h"
 
@@ -28,16 +29,40 @@
  * of 8k so we should go with that as well*/
 #define LOG_MAX_LEN 8192
 
+/* Records read at most per wake up of the reader */
+#define KMSG_BATCH 256
+
+/*
+ * Reads the kernel log records, one per read() of /dev/kmsg:
+ *   prio,seq,timestamp,flags[,...];message\n[ KEY=value\n]...
+ *
+ * The fd is non-blocking: every wake up of poll() drains the available
+ * records into items, handed out by the next calls of get(). Without
+ * blocking (nonblock), the end of the records is the end of the log.
+ */
 class KmsgReader : public LogReader {
   int fd;
   unsigned char last_prio;
   uint64_t last_timestamp;
+  uint64_t last_seq;
+  bool has_seq;
+  unsigned long dropped;
   char read_buf[LOG_MAX_LEN];
+  char msg_buf[LOG_MAX_LEN + 64];  // with the priority and time prefix
   bool nonblock;
+  bool eof;
+  std::vector<LogItemPtr> pending;
+  size_t next;
+
+  bool drain();
+  LogItemPtr parse(size_t len);
+  void checkSeq(uint64_t seq);
 
  public:
   explicit KmsgReader(bool nonblock = false);
-  virtual std::shared_ptr<LogItem> get();
+  KmsgReader(int fd, bool nonblock);
+  virtual LogItemPtr get();
+  unsigned long getDropped() const;
   virtual ~KmsgReader();
 };
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LogArena.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "LwLog.h"
+
+#define LOGARENA_ALIGN 16
+#define ALIGN_UP(a) (((a) + LOGARENA_ALIGN - 1) & ~(size_t)(LOGARENA_ALIGN - 1))
+
+LogArena::LogArena()
+    : current(NULL),
+      free_slabs(NULL),
+      free_count(0),
+      items(0) {
+  memset(&stats, 0, sizeof(stats));
+  pthread_mutex_init(&mutex, NULL);
+}
+
+LogArena::~LogArena() {
+  if (current) {
+    /* drop the reference of the arena, the slab is then unused */
+    if (current->live.fetch_sub(1) != 1)
+      LwLog::critical("Log arena destroyed with %u items alive",
+                      current->live.load());
+    free(current);
+  }
+  /* the other slabs are all back on the free list */
+  pthread_mutex_lock(&mutex);
+  if (current)
+    stats.live_slabs--;
+  if (stats.live_slabs != free_count)
+    LwLog::critical("Log arena destroyed with %lu slabs in use",
+                    stats.live_slabs - free_count);
+  pthread_mutex_unlock(&mutex);
+  while (free_slabs) {
+    Slab *next = free_slabs->next;
+    free(free_slabs);
+    free_slabs = next;
+  }
+  pthread_mutex_destroy(&mutex);
+}
+
+LogArena::Slab *LogArena::newSlab() {
+  Slab *slab;
+
+  pthread_mutex_lock(&mutex);
+  if (free_slabs) {
+    slab = free_slabs;
+    free_slabs = slab->next;
+    free_count--;
+    stats.recycled++;
+  } else {
+    void *mem = malloc(LOGARENA_SLAB_SIZE);
+    slab = mem ? new (mem) Slab : NULL;
+    if (slab) {
+      stats.mallocs++;
+      stats.live_slabs++;
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  if (!slab)
+    return NULL;
+  /* the arena holds a reference while the slab is being filled */
+  slab->live.store(1);
+  slab->arena = this;
+  slab->used = ALIGN_UP(sizeof(Slab));
+  slab->next = NULL;
+  return slab;
+}
+
+void LogArena::recycle(Slab *slab) {
+  pthread_mutex_lock(&mutex);
+  if (free_count < LOGARENA_MAX_FREE) {
+    slab->next = free_slabs;
+    free_slabs = slab;
+    free_count++;
+  } else {
+    free(slab);
+    stats.live_slabs--;
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+/* Reader thread only. Returns a block of size bytes, slab is set to what
+ * release needs */
+void *LogArena::alloc(size_t size, void **slab) {
+  size = ALIGN_UP(size);
+  items.fetch_add(1, std::memory_order_relaxed);
+
+  if (size > (LOGARENA_SLAB_SIZE - ALIGN_UP(sizeof(Slab))) / 4) {
+    pthread_mutex_lock(&mutex);
+    stats.mallocs++;
+    pthread_mutex_unlock(&mutex);
+    *slab = NULL;
+    return malloc(size);
+  }
+
+  if (!current || current->used + size > LOGARENA_SLAB_SIZE) {
+    if (current)
+      release(NULL, current);
+    current = newSlab();
+    if (!current) {
+      *slab = NULL;
+      return NULL;
+    }
+  }
+
+  void *block = reinterpret_cast<char *>(current) + current->used;
+  current->used += size;
+  current->live.fetch_add(1, std::memory_order_relaxed);
+  *slab = current;
+  return block;
+}
+
+/* Any thread */
+void LogArena::release(void *block, void *slab) {
+  if (!slab) {
+    free(block);
+    return;
+  }
+  Slab *s = reinterpret_cast<Slab *>(slab);
+  if (s->live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    s->arena->recycle(s);
+}
+
+void LogArena::getStats(LogArenaStats *out) {
+  pthread_mutex_lock(&mutex);
+  *out = stats;
+  pthread_mutex_unlock(&mutex);
+  out->items = items.load(std::memory_order_relaxed);
+}
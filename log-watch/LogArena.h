@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOGARENA_H_
+#define LOGARENA_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <atomic>
+
+#define LOGARENA_SLAB_SIZE (64 * 1024)
+#define LOGARENA_MAX_FREE 4
+
+struct LogArenaStats {
+  unsigned long items;       // blocks handed out
+  unsigned long mallocs;     // slabs and big blocks allocated
+  unsigned long recycled;    // slabs reused
+  unsigned long live_slabs;  // slabs allocated and not freed
+};
+
+/*
+ * Slab allocator for the log items of a reader.
+ *
+ * The blocks are carved one after the other in the current slab, by the
+ * reader thread only. A slab counts its live blocks: the last release, from
+ * any thread, puts it back on the free list to be filled again. The blocks
+ * too big for a slab are allocated on their own. The blocks must be
+ * released before the arena is destroyed, which aborts otherwise: the slabs
+ * still in use would release into a freed arena.
+ */
+class LogArena {
+  struct Slab {
+    std::atomic<unsigned int> live;
+    LogArena *arena;
+    size_t used;
+    Slab *next;
+  };
+
+  Slab *current;
+  Slab *free_slabs;
+  unsigned int free_count;
+  std::atomic<unsigned long> items;  // read by getStats from any thread
+  LogArenaStats stats;
+  pthread_mutex_t mutex;
+
+  Slab *newSlab();
+  void recycle(Slab *slab);
+
+  LogArena(const LogArena&) { /* do not copy */ }
+  LogArena& operator=(const LogArena&) { return *this;}
+
+ public:
+  LogArena();
+  virtual ~LogArena();
+  void *alloc(size_t size, void **slab);
+  static void release(void *block, void *slab);
+  void getStats(LogArenaStats *out);
+};
+
+#endif  // LOGARENA_H_
@@ -20,12 +20,80 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <new>
 
+#include "LogArena.h"
+#include "LwLog.h"
 #include "TimeVal.h"
 
+LogItem::LogItem()
+    : refs(1),
+      slab(NULL),
+      timestamp(0),
+      prio(0),
+      eof(false),
+      empty(false),
+      has_msg(false),
+      scanned_literals(0) {
+}
+
 LogItem::~LogItem() {
-  if (msg)
-    delete[] msg;
+}
+
+/* Allocates the item and its message in one block, len bytes of msg are
+ * copied and terminated. Without arena, the block is allocated on its own */
+LogItemPtr LogItem::create(LogArena *arena, const char *msg, size_t len) {
+  size_t size = sizeof(LogItem) + (msg ? len + 1 : 1);
+  void *slab = NULL;
+  void *mem;
+
+  mem = arena ? arena->alloc(size, &slab) : malloc(size);
+  if (!mem) {
+    LwLog::critical("Cannot allocate log item");
+    return LogItemPtr();
+  }
+
+  LogItem *li = new (mem) LogItem();
+  li->slab = slab;
+  if (msg) {
+    memcpy(li->msg, msg, len);
+    li->has_msg = true;
+  }
+  li->msg[msg ? len : 0] = 0;
+  return LogItemPtr(li);
+}
+
+LogItemPtr LogItem::create(const char *msg) {
+  return create(NULL, msg, msg ? strlen(msg) : 0);
+}
+
+/* Returns the item itself when allocated on its own, else a copy allocated
+ * on its own. Costs a malloc per item kept, instead of a slab per item */
+LogItemPtr LogItem::detach(const LogItemPtr &li) {
+  if (!li || !li->slab)
+    return li;
+
+  LogItemPtr copy = create(NULL, li->getMsg(), li->has_msg ? strlen(li->msg) : 0);
+  if (!copy)
+    return li;
+  copy->timestamp = li->timestamp;
+  copy->prio = li->prio;
+  copy->eof = li->eof;
+  copy->empty = li->empty;
+  copy->scanned_literals = li->scanned_literals;
+  memcpy(copy->candidates, li->candidates, sizeof(copy->candidates));
+  return copy;
+}
+
+void LogItem::destroy() {
+  void *block_slab = slab;
+
+  this->~LogItem();
+  LogArena::release(this, block_slab);
+}
+
+unsigned int LogItem::getRefs() const {
+  return refs.load();
 }
 
 unsigned char LogItem::getPrio() const {
@@ -40,18 +108,6 @@ bool LogItem::isEof() const {
   return eof;
 }
 
-LogItem::LogItem()
-    : prio(0),
-      timestamp(0),
-      msg(NULL),
-      eof(false),
-      empty(false) {
-}
-
-void LogItem::setMsg(char* msg) {
-  this->msg = msg;
-}
-
 void LogItem::setPrio(unsigned char prio) {
   this->prio = prio;
 }
@@ -64,8 +120,9 @@ void LogItem::setEof(bool forceFlush) {
   eof = forceFlush;
 }
 
+/* NULL for the items without message, such as the eof */
 const char* LogItem::getMsg() const {
-  return msg;
+  return has_msg ? msg : NULL;
 }
 
 bool LogItem::isEmpty() const {
@@ -75,3 +132,17 @@ bool LogItem::isEmpty() const {
 void LogItem::setEmpty(bool empty) {
   this->empty = empty;
 }
+
+void LogItem::resetCandidates(unsigned int literalCount) {
+  scanned_literals = literalCount;
+  memset(candidates, 0, sizeof(candidates));
+}
+
+void LogItem::setCandidate(unsigned int id) {
+  candidates[id / 64] |= 1ULL << (id % 64);
+}
+
+/* The literals added after the scan were not looked for */
+bool LogItem::isCandidate(unsigned int id) const {
+  return id >= scanned_literals || (candidates[id / 64] >> (id % 64)) & 1;
+}
@@ -18,23 +18,60 @@
 #ifndef LOGITEM_H_
 #define LOGITEM_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
 #include <ctime>
 
 #include "TimeVal.h"
 
+#define LOGITEM_MAX_CANDIDATES 256
+
+class LogArena;
+class LogItemPtr;
+
+/*
+ * A log line and its attributes, with the message stored inline. Created
+ * by create(), from the arena of the reader when there is one, and shared
+ * by the watchers through LogItemPtr, which counts the references in the
+ * item itself. The items kept longer than the stream goes by are detached
+ * from the arena, a single item would hold its whole slab otherwise.
+ */
 class LogItem {
-  unsigned char prio;
+  std::atomic<unsigned int> refs;
+  void *slab;  // arena slab, NULL when allocated on its own
   TimeVal timestamp;
-  char *msg;
+  unsigned char prio;
   bool eof;
   bool empty;
+  bool has_msg;
+  // literals of the pattern filter known when scanned, 0 if never scanned
+  unsigned short scanned_literals;
+  uint64_t candidates[LOGITEM_MAX_CANDIDATES / 64];
+  char msg[];
+
+  LogItem();
+  ~LogItem();
+  void destroy();
 
   LogItem(const LogItem&) { /* do not copy */ }
   LogItem& operator=(const LogItem&) { return *this;}
 
  public:
-  LogItem();
-  virtual ~LogItem();
+  static LogItemPtr create(LogArena *arena, const char *msg, size_t len);
+  static LogItemPtr create(const char *msg = NULL);
+  static LogItemPtr detach(const LogItemPtr &li);
+
+  void ref() {
+    refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void unref() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      destroy();
+  }
+
+  unsigned int getRefs() const;
   unsigned char getPrio() const;
   TimeVal getTimestamp() const;
   const char* getMsg() const;
@@ -42,9 +79,66 @@ class LogItem {
   void setEof(bool forceFlush);
   bool isEmpty() const;
   void setEmpty(bool empty);
-  void setMsg(char* msg);
   void setPrio(unsigned char prio);
   void setTimestamp(TimeVal timestamp);
+  void resetCandidates(unsigned int literalCount);
+  void setCandidate(unsigned int id);
+  bool isCandidate(unsigned int id) const;
+};
+
+/* Counted reference to a log item, null by default */
+class LogItemPtr {
+  LogItem *item;
+
+ public:
+  LogItemPtr() : item(NULL) {}
+
+  /* takes over a reference the caller holds */
+  explicit LogItemPtr(LogItem *li) : item(li) {}
+
+  LogItemPtr(const LogItemPtr &p) : item(p.item) {
+    if (item)
+      item->ref();
+  }
+
+  LogItemPtr(LogItemPtr &&p) : item(p.item) {
+    p.item = NULL;
+  }
+
+  ~LogItemPtr() {
+    if (item)
+      item->unref();
+  }
+
+  LogItemPtr& operator=(const LogItemPtr &p) {
+    if (p.item)
+      p.item->ref();
+    if (item)
+      item->unref();
+    item = p.item;
+    return *this;
+  }
+
+  LogItemPtr& operator=(LogItemPtr &&p) {
+    if (this != &p) {
+      if (item)
+        item->unref();
+      item = p.item;
+      p.item = NULL;
+    }
+    return *this;
+  }
+
+  void reset() {
+    if (item)
+      item->unref();
+    item = NULL;
+  }
+
+  LogItem *get() const { return item; }
+  LogItem *operator->() const { return item; }
+  LogItem &operator*() const { return *item; }
+  explicit operator bool() const { return item != NULL; }
 };
 
 #endif  // LOGITEM_H_
@@ -28,12 +28,17 @@
 #endif
 #include "LwLog.h"
 
-std::shared_ptr<LogItem> LogReader::get() {
-  std::shared_ptr<LogItem> ret = std::make_shared<LogItem>();
-  if (!ret)
-    LwLog::critical("Cannot allocate log item");
-  ret->setEof(true);
+LogItemPtr LogReader::get() {
+  return statusItem(true);
+}
 
+/* Item without message telling the end of the log, or that nothing was read */
+LogItemPtr LogReader::statusItem(bool eof) {
+  LogItemPtr ret = LogItem::create(&arena, NULL, 0);
+  if (eof)
+    ret->setEof(true);
+  else
+    ret->setEmpty(true);
   return ret;
 }
 
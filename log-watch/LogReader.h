@@ -18,14 +18,19 @@
 #ifndef LOGREADER_H_
 #define LOGREADER_H_
 
-#include <memory>
 #include <string>
 
+#include "LogArena.h"
 #include "LogItem.h"
 
 class LogReader {
+ protected:
+  LogArena arena;  // of the items read
+
+  LogItemPtr statusItem(bool eof);
+
  public:
-  virtual std::shared_ptr<LogItem> get();
+  virtual LogItemPtr get();
   virtual ~LogReader();
   static LogReader *getReader(std::string type, std::string args);
 };
@@ -111,20 +111,13 @@ LogdReader::LogdReader(std::string args) {
   }
 }
 
-std::shared_ptr<LogItem> LogdReader::get() {
-  std::shared_ptr<LogItem> logItem = std::make_shared<LogItem>();
-
-  if (!logItem) {
-    LwLog::critical("Cannot allocate log item");
-  }
-
+LogItemPtr LogdReader::get() {
   struct log_msg log_msg;
   int ret = android_logger_list_read(logger_list, &log_msg);
 
   if (ret <= 0) {
     LwLog::error("Unexpected read result %d\n", ret);
-    logItem->setEof(true);
-    return logItem;
+    return statusItem(true);
   }
 
   AndroidLogEntry entry;
@@ -139,23 +132,18 @@ std::shared_ptr<LogItem> LogdReader::get() {
   }
   else if (android_log_processLogBuffer(&log_msg.entry_v1, &entry) < 0) {
     LwLog::error("Unable to process log buffer\n");
-    logItem->setEmpty(true);
-    return logItem;
+    return statusItem(false);
   }
 
-  char *outBuffer;
   int len = strlen(entry.tag) + entry.messageLen + 3 * sizeof(char);
-  outBuffer = new char[len];
-  if (outBuffer) {
-    snprintf(outBuffer, len, "%s: %s", entry.tag, entry.message);
-  } else {
-    LwLog::critical("Cannot allocate entry");
-  }
+  char outBuffer[len];
+  snprintf(outBuffer, len, "%s: %s", entry.tag, entry.message);
+
+  LogItemPtr logItem = LogItem::create(&arena, outBuffer, strlen(outBuffer));
 
   TimeVal timestamp(entry.tv_sec, NSEC_TO_USEC(entry.tv_nsec));
   logItem->setTimestamp(timestamp);
   logItem->setPrio(entry.priority);
-  logItem->setMsg(outBuffer);
 
   return logItem;
 }
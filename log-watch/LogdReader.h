@@ -36,7 +36,7 @@ class LogdReader : public LogReader {
 
  public:
   explicit LogdReader(std::string args);
-  virtual std::shared_ptr<LogItem> get();
+  virtual LogItemPtr get();
   virtual ~LogdReader();
 };
 
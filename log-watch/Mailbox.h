@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <errno.h>
+#include <semaphore.h>
+#include <stddef.h>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#define MAILBOX_CACHE_LINE 64
+
+/*
+ * Bounded single producer, single consumer queue.
+ *
+ * The slots are allocated once by setCapacity, before the first push. The
+ * producer only writes tail, the consumer only writes head, so neither push
+ * nor pop takes a lock. The consumer sleeps on a semaphore which is only
+ * posted when it announced it was waiting, that is once per burst rather
+ * than once per item. A full mailbox refuses the item, the producer decides
+ * whether to drop it or to retry.
+ */
+template<typename T>
+class Mailbox {
+  std::vector<T> slots;
+  size_t mask;
+  size_t capacity;
+
+  // producer side, on its own cache line
+  char tail_pad[MAILBOX_CACHE_LINE];
+  std::atomic<size_t> tail;
+
+  // consumer side
+  char head_pad[MAILBOX_CACHE_LINE - sizeof(size_t)];
+  std::atomic<size_t> head;
+  std::atomic<bool> waiting;
+  sem_t wakeup;
+
+  Mailbox(const Mailbox&) { /* do not copy */ }
+  Mailbox& operator=(const Mailbox&) { return *this;}
+
+ public:
+  Mailbox() : mask(0), capacity(0), tail(0), head(0), waiting(false) {
+    sem_init(&wakeup, 0, 0);
+  }
+
+  virtual ~Mailbox() {
+    sem_destroy(&wakeup);
+  }
+
+  /* Only call before the first push */
+  void setCapacity(size_t max) {
+    size_t size = 1;
+
+    while (size < max)
+      size <<= 1;
+    slots.clear();
+    slots.resize(size);
+    mask = size - 1;
+    capacity = max;
+  }
+
+  size_t getCapacity() const {
+    return capacity;
+  }
+
+  /* Producer: returns false when the mailbox is full */
+  bool push(const T &item) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+
+    if (pos - head.load(std::memory_order_acquire) >= capacity)
+      return false;
+    slots[pos & mask] = item;
+    tail.store(pos + 1, std::memory_order_seq_cst);
+    /* pairs with the store of waiting then the load of tail in pop */
+    if (waiting.load(std::memory_order_seq_cst) && waiting.exchange(false))
+      sem_post(&wakeup);
+    return true;
+  }
+
+  /* Consumer: moves up to max items into out, waits while the mailbox is
+   * empty. Returns the number of items moved. */
+  size_t pop(T *out, size_t max) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    size_t count, idx;
+
+    for (;;) {
+      count = tail.load(std::memory_order_acquire) - pos;
+      if (count)
+        break;
+      waiting.store(true, std::memory_order_seq_cst);
+      if (tail.load(std::memory_order_seq_cst) != pos) {
+        /* the producer may have seen the flag: consume its post */
+        if (!waiting.exchange(false))
+          while (sem_wait(&wakeup) && errno == EINTR) {}
+        continue;
+      }
+      while (sem_wait(&wakeup) && errno == EINTR) {}
+    }
+    if (count > max)
+      count = max;
+    for (idx = 0; idx < count; idx++)
+      out[idx] = std::move(slots[(pos + idx) & mask]);
+    head.store(pos + count, std::memory_order_release);
+    return count;
+  }
+};
+
+#endif  // MAILBOX_H_
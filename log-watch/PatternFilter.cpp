@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PatternFilter.h"
+
+#include <cstring>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "LogItem.h"
+#include "LwLog.h"
+
+PatternFilter *PatternFilter::inst_ = NULL;
+
+PatternFilter::PatternFilter()
+    : dirty(false),
+      class_count(1) {
+  memset(classes, 0, sizeof(classes));
+}
+
+PatternFilter::~PatternFilter() {
+}
+
+PatternFilter* PatternFilter::inst() {
+  if (!inst_)
+    inst_ = new PatternFilter();
+  return inst_;
+}
+
+void PatternFilter::release() {
+  if (inst_) {
+    delete inst_;
+    inst_ = NULL;
+  }
+}
+
+/* Returns the id of the literal, -1 when it cannot be filtered */
+int PatternFilter::add(const std::string &literal) {
+  if (literal.empty())
+    return -1;
+  for (size_t id = 0; id < literals.size(); id++) {
+    if (literals[id] == literal)
+      return id;
+  }
+  if (literals.size() >= LOGITEM_MAX_CANDIDATES) {
+    LwLog::warn("Too many pattern literals, %s is not filtered",
+                literal.c_str());
+    return -1;
+  }
+  literals.push_back(literal);
+  dirty = true;
+  return literals.size() - 1;
+}
+
+size_t PatternFilter::getLiteralCount() const {
+  return literals.size();
+}
+
+void PatternFilter::build() {
+  std::vector<int> trie;
+  std::vector<unsigned int> fail;
+  std::queue<unsigned int> todo;
+
+  /* the bytes which are in no literal share the class 0 */
+  memset(classes, 0, sizeof(classes));
+  class_count = 1;
+  for (auto &literal : literals) {
+    for (auto c : literal) {
+      if (!classes[(unsigned char)c])
+        classes[(unsigned char)c] = class_count++;
+    }
+  }
+
+  trie.assign(class_count, -1);
+  outputs.assign(1, std::vector<unsigned short>());
+  for (size_t id = 0; id < literals.size(); id++) {
+    unsigned int state = 0;
+    for (auto c : literals[id]) {
+      size_t edge = state * class_count + classes[(unsigned char)c];
+      if (trie[edge] < 0) {
+        trie[edge] = outputs.size();
+        outputs.push_back(std::vector<unsigned short>());
+        trie.resize(outputs.size() * class_count, -1);
+      }
+      state = trie[edge];
+    }
+    outputs[state].push_back(id);
+  }
+
+  /* breadth first, so the fail state of a state is complete before it */
+  next.assign(outputs.size() * class_count, 0);
+  fail.assign(outputs.size(), 0);
+  todo.push(0);
+  while (!todo.empty()) {
+    unsigned int state = todo.front();
+    todo.pop();
+    for (size_t cls = 0; cls < class_count; cls++) {
+      size_t edge = state * class_count + cls;
+      if (trie[edge] < 0) {
+        next[edge] = state ? next[fail[state] * class_count + cls] : 0;
+        continue;
+      }
+      unsigned int child = trie[edge];
+      fail[child] = state ? next[fail[state] * class_count + cls] : 0;
+      outputs[child].insert(outputs[child].end(), outputs[fail[child]].begin(),
+                            outputs[fail[child]].end());
+      next[edge] = child;
+      todo.push(child);
+    }
+  }
+  dirty = false;
+}
+
+void PatternFilter::scan(LogItem *li) {
+  if (dirty)
+    build();
+  li->resetCandidates(literals.size());
+
+  const char *msg = li->getMsg();
+  if (!msg || literals.empty())
+    return;
+
+  unsigned int state = 0;
+  for (; *msg; msg++) {
+    state = next[state * class_count + classes[(unsigned char)*msg]];
+    for (auto id : outputs[state])
+      li->setCandidate(id);
+  }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PATTERNFILTER_H_
+#define PATTERNFILTER_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class LogItem;
+
+/*
+ * Finds, in one pass over a message, which of the literals required by the
+ * patterns it contains (Aho-Corasick automaton). A pattern whose literal is
+ * missing from a message cannot match it, so its regexec is skipped.
+ *
+ * The literals are added by the patterns when they are compiled; the
+ * automaton is rebuilt by the next scan. Only used from the reader thread.
+ */
+class PatternFilter {
+  static PatternFilter *inst_;
+
+  std::vector<std::string> literals;
+  bool dirty;
+
+  unsigned char classes[256];
+  size_t class_count;
+  std::vector<unsigned int> next;
+  std::vector<std::vector<unsigned short>> outputs;
+
+  void build();
+
+  PatternFilter(const PatternFilter&) { /* do not copy */ }
+  PatternFilter& operator=(const PatternFilter&) { return *this;}
+
+ public:
+  PatternFilter();
+  virtual ~PatternFilter();
+  static PatternFilter *inst();
+  static void release();
+  int add(const std::string &literal);
+  size_t getLiteralCount() const;
+  void scan(LogItem *li);
+};
+
+#endif  // PATTERNFILTER_H_
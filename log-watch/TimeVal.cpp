@@ -28,15 +28,6 @@ TimeVal::TimeVal(long s, long us)
   redist();
 }
 
-TimeVal::~TimeVal() {
-}
-
-TimeVal& TimeVal::operator =(const TimeVal &p) {
-  sec = p.sec;
-  usec = p.usec;
-  return *this;
-}
-
 TimeVal TimeVal::add(long s, long us) {
   sec += s;
   usec += us;
@@ -44,37 +35,37 @@ TimeVal TimeVal::add(long s, long us) {
   return *this;
 }
 
-bool TimeVal::operator <=(const TimeVal& p) {
+bool TimeVal::operator <=(const TimeVal& p) const {
   return (operator <(p)) || (operator ==(p));
 }
 
-bool TimeVal::operator ==(const TimeVal& p) {
+bool TimeVal::operator ==(const TimeVal& p) const {
   return sec == p.sec && usec == p.usec;
 }
 
-bool TimeVal::operator >=(const TimeVal& p) {
+bool TimeVal::operator >=(const TimeVal& p) const {
   return !operator <(p);
 }
 
-bool TimeVal::operator >(const TimeVal& p) {
+bool TimeVal::operator >(const TimeVal& p) const {
   return !((operator <(p)) || (operator ==(p)));
 }
 
-TimeVal TimeVal::operator +(const TimeVal& p) {
+TimeVal TimeVal::operator +(const TimeVal& p) const {
   TimeVal tmp(sec, usec);
   tmp.add(p.sec, p.usec);
   tmp.redist();
   return tmp;
 }
 
-TimeVal TimeVal::operator -(const TimeVal& p) {
+TimeVal TimeVal::operator -(const TimeVal& p) const {
   TimeVal tmp(sec, usec);
   tmp.add(-p.sec, -p.usec);
   tmp.redist();
   return tmp;
 }
 
-bool TimeVal::operator <(const TimeVal& p) {
+bool TimeVal::operator <(const TimeVal& p) const {
   if (sec < p.sec) {
     return true;
   } else if (sec == p.sec) {
@@ -19,20 +19,19 @@
 #define TIMEVAL_H_
 
 
+/* Trivially copyable: stored by value in every log item */
 class TimeVal {
  public:
   explicit TimeVal(long s = 0, long us = 0);
-  virtual ~TimeVal();
-  bool operator < (const TimeVal &p);
-  bool operator <= (const TimeVal &p);
-  bool operator == (const TimeVal &p);
-  bool operator >= (const TimeVal &p);
-  bool operator > (const TimeVal &p);
+  bool operator < (const TimeVal &p) const;
+  bool operator <= (const TimeVal &p) const;
+  bool operator == (const TimeVal &p) const;
+  bool operator >= (const TimeVal &p) const;
+  bool operator > (const TimeVal &p) const;
 
-  TimeVal operator + (const TimeVal &p);
-  TimeVal operator - (const TimeVal &p);
+  TimeVal operator + (const TimeVal &p) const;
+  TimeVal operator - (const TimeVal &p) const;
 
-  TimeVal& operator = (const TimeVal &p);
   TimeVal add(long s, long us = 0);
   static TimeVal current();
  private:
@@ -54,15 +54,9 @@ UeventReader::UeventReader(bool nonblock) {
   }
 }
 
-std::shared_ptr<LogItem> UeventReader::get() {
-  std::shared_ptr<LogItem> ret = std::make_shared<LogItem>();
-
-  if (!ret)
-    LwLog::critical("Cannot allocate log item");
-  if (fd < 0) {
-    ret->setEof(true);
-    return ret;
-  }
+LogItemPtr UeventReader::get() {
+  if (fd < 0)
+    return statusItem(true);
 
   size_t d_len = 4096;
   char buf[4096];
@@ -82,10 +76,8 @@ std::shared_ptr<LogItem> UeventReader::get() {
   int flags = nonblock ? MSG_DONTWAIT : 0;
   int len = recvmsg(fd, &msgh, flags);
 
-  if (len <= 0) {
-    ret->setEof(true);
-    return ret;
-  }
+  if (len <= 0)
+    return statusItem(true);
 
   unsigned char prio = SRC_UNKNOWN;
 
@@ -106,15 +98,11 @@ std::shared_ptr<LogItem> UeventReader::get() {
   /*Keep it null terminated*/
   buf[len-1] = 0;
 
+  LogItemPtr ret = LogItem::create(&arena, buf, len - 1);
+
   /*Set the priority*/
   ret->setPrio(prio);
-
-  char *msg = new char[len];
-  if (msg) {
-    memcpy(msg, buf, len);
-  }
   ret->setTimestamp(TimeVal::current());
-  ret->setMsg(msg);
 
   return ret;
 }
@@ -25,7 +25,7 @@ class UeventReader : public LogReader {
   bool nonblock;
  public:
   explicit UeventReader(bool nonblock = false);
-  virtual std::shared_ptr<LogItem> get();
+  virtual LogItemPtr get();
   virtual ~UeventReader();
 };
 
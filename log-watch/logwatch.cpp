@@ -26,6 +26,7 @@
 #include "LogReader.h"
 #include "LwConfig.h"
 #include "LwLog.h"
+#include "PatternFilter.h"
 
 void usage(const char *app) {
   printf("usage:\n");
@@ -61,9 +62,11 @@ int main(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
-  std::shared_ptr<LogItem> item = reader->get();
+  LogItemPtr item = reader->get();
   do {
     if (!item->isEmpty()) {
+      /* once for all the watchers, their patterns look at the result */
+      PatternFilter::inst()->scan(item.get());
       for (auto &watch : watchers) {
         watch->feed(item);
       }
@@ -76,7 +79,11 @@ int main(int argc, char **argv) {
     watch->waitThreadStop();
   }
 
-  delete reader;
+  /* the watchers hold items of the reader arena */
+  item.reset();
+  watchers.clear();
   LwConfig::release();
+  delete reader;
+  PatternFilter::release();
   return EXIT_SUCCESS;
 }
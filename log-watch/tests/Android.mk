@@ -24,16 +24,24 @@ LOCAL_PROPRIETARY_MODULE := true
 
 LOCAL_SRC_FILES = \
     aosp_tests.cpp \
+    arena.cpp \
     attachments.cpp \
     datafields.cpp \
     eventwatch.cpp \
+    kmsg.cpp \
+    mailbox.cpp \
     patterns.cpp \
     ../LwLog.cpp \
     ../EventAttachment.cpp \
     ../ItemPattern.cpp \
+    ../PatternFilter.cpp \
     ../EventWatch.cpp \
     ../EventRecord.cpp \
+    ../LogArena.cpp \
     ../LogItem.cpp \
+    ../LogReader.cpp \
+    ../KmsgReader.cpp \
+    ../UeventReader.cpp \
     ../LwConfig.cpp \
     ../DataFormat.cpp \
     ../TimeVal.cpp \
@@ -57,16 +65,24 @@ LOCAL_PROPRIETARY_MODULE := true
 
 LOCAL_SRC_FILES = \
     aosp_tests.cpp \
+    arena.cpp \
     attachments.cpp \
     datafields.cpp \
     eventwatch.cpp \
+    kmsg.cpp \
+    mailbox.cpp \
     patterns.cpp \
     ../LwLog.cpp \
     ../EventAttachment.cpp \
     ../ItemPattern.cpp \
+    ../PatternFilter.cpp \
     ../EventWatch.cpp \
     ../EventRecord.cpp \
+    ../LogArena.cpp \
     ../LogItem.cpp \
+    ../LogReader.cpp \
+    ../KmsgReader.cpp \
+    ../UeventReader.cpp \
     ../LwConfig.cpp \
     ../DataFormat.cpp \
     ../TimeVal.cpp \
@@ -73,6 +73,38 @@ TEST(data, replace_incomplete) {
   ASSERT_EQ(0, test_data_replace_incomplete());
 }
 
+TEST(data, directives) {
+  ASSERT_EQ(0, test_data_directives());
+}
+
+TEST(data, timing) {
+  ASSERT_EQ(0, test_data_timing());
+}
+
+TEST(mailbox, order) {
+  ASSERT_EQ(0, test_mailbox_order());
+}
+
+TEST(mailbox, throughput) {
+  ASSERT_EQ(0, test_mailbox_throughput());
+}
+
+TEST(arena, recycle) {
+  ASSERT_EQ(0, test_arena_recycle());
+}
+
+TEST(arena, stress) {
+  ASSERT_EQ(0, test_arena_stress());
+}
+
+TEST(kmsg, records) {
+  ASSERT_EQ(0, test_kmsg_records());
+}
+
+TEST(kmsg, batch) {
+  ASSERT_EQ(0, test_kmsg_batch());
+}
+
 TEST(pattern, invalid) {
   ASSERT_EQ(0, test_pattern_invalid());
 }
@@ -81,6 +113,18 @@ TEST(pattern, valid) {
   ASSERT_EQ(0, test_pattern_valid());
 }
 
+TEST(pattern, literals) {
+  ASSERT_EQ(0, test_pattern_literals());
+}
+
+TEST(pattern, prefilter) {
+  ASSERT_EQ(0, test_pattern_prefilter());
+}
+
+TEST(pattern, benchmark) {
+  ASSERT_EQ(0, test_pattern_benchmark());
+}
+
 TEST(eventwatch, invalid) {
   ASSERT_EQ(0, test_eventwatch_invalid());
 }
@@ -113,8 +157,8 @@ TEST(eventwatch, gen_2) {
   ASSERT_EQ(0, test_eventwatch_gen_2());
 }
 
-TEST(eventwatch, kick_lazy) {
-  ASSERT_EQ(0, test_eventwatch_kick_lazy());
+TEST(eventwatch, mailbox_drop) {
+  ASSERT_EQ(0, test_eventwatch_mailbox_drop());
 }
 
 TEST(eventwatch, suspend_interval) {
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../EventWatch.h"
+#include "../LogArena.h"
+#include "../LogItem.h"
+
+#define ARENA_TEST_RATE 50000       // lines per second
+#define ARENA_TEST_SECONDS 2
+#define ARENA_TEST_BATCH 500        // lines per wake up of the feed
+#define ARENA_TEST_KEPT_SLABS 10    // slabs in use while records are kept
+
+static long long now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+int test_arena_recycle() {
+  LogArena arena;
+  LogArenaStats stats;
+  std::vector<LogItemPtr> items;
+  char msg[] = "<6> [  123.456789] usb 1-1: new high-speed USB device";
+
+  /* several slabs of items, all released: the slabs are filled again */
+  for (int round = 0; round < 4; round++) {
+    for (int i = 0; i < 5000; i++)
+      items.push_back(LogItem::create(&arena, msg, strlen(msg)));
+    if (strcmp(items.back()->getMsg(), msg) || items.back()->getRefs() != 1)
+      return 1;
+    items.clear();
+  }
+  arena.getStats(&stats);
+  if (stats.items != 20000 || stats.recycled == 0)
+    return 1;
+  if (stats.live_slabs > LOGARENA_MAX_FREE + 1)
+    return 1;
+
+  /* the messages too long for a slab are allocated on their own */
+  std::vector<char> big(LOGARENA_SLAB_SIZE, 'x');
+  big.back() = 0;
+  LogItemPtr li = LogItem::create(&arena, big.data(), big.size() - 1);
+  arena.getStats(&stats);
+  if (strlen(li->getMsg()) != big.size() - 1 || stats.live_slabs > LOGARENA_MAX_FREE + 1)
+    return 1;
+
+  /* items without message, as the eof */
+  li = LogItem::create(&arena, NULL, 0);
+  return li->getMsg() == NULL ? 0 : 1;
+}
+
+/* The reader feeding the watchers at a steady rate, as a busy kmsg would.
+ * One of them keeps a record every 3000 lines until the end of the stream,
+ * which must not keep the slabs of the records' items */
+int test_arena_stress() {
+  LogArena arena;
+  LogArenaStats stats;
+  struct rusage usage;
+  char msg[256];
+  unsigned long lines = 0;
+  unsigned long kept_slabs;
+  int ret = 0;
+
+  EventWatch ew1("test_arena_1");
+  ew1.setStartPattern("Kernel panic - not syncing");
+  EventWatch ew2("test_arena_2");
+  ew2.setStartPattern("Out of memory: Kill process ([0-9]+)");
+  EventWatch ew3("test_arena_3");
+  ew3.setStartPattern("size 0-0 line 1500");
+  ew3.setMaxItems(1);
+  ew3.setMaxRecords(ARENA_TEST_RATE * ARENA_TEST_SECONDS);
+  ew3.setFlushTimeout(ARENA_TEST_SECONDS * 1000);
+  if (!ew1.isValid() || !ew2.isValid() || !ew3.isValid())
+    return 1;
+
+  long long start = now_us();
+  long long deadline = start;
+  while (lines < ARENA_TEST_RATE * ARENA_TEST_SECONDS) {
+    for (int i = 0; i < ARENA_TEST_BATCH; i++, lines++) {
+      int len = snprintf(msg, sizeof(msg),
+                         "<6> [%5lu.%06lu] binder: %lu:%lu transaction failed"
+                         " 29189/-22, size 0-0 line %d", lines / 1000,
+                         lines * 7919 % 1000000, lines % 4000, lines % 97,
+                         (int)(lines % 3000));
+      LogItemPtr li = LogItem::create(&arena, msg, len);
+      li->setTimestamp(TimeVal(lines / 1000, lines % 1000));
+      ew1.feed(li);
+      ew2.feed(li);
+      ew3.feed(li);
+    }
+    deadline += 1000000LL * ARENA_TEST_BATCH / ARENA_TEST_RATE;
+    long long wait = deadline - now_us();
+    if (wait > 0)
+      usleep(wait);
+  }
+  long long elapsed = now_us() - start;
+
+  /* the records are all kept until the end of the stream */
+  usleep(100000);
+  arena.getStats(&stats);
+  kept_slabs = stats.live_slabs;
+
+  LogItemPtr li_stop = LogItem::create();
+  li_stop->setEof(true);
+  ew1.feed(li_stop);
+  ew2.feed(li_stop);
+  ew3.feed(li_stop);
+  ew1.waitThreadStop();
+  ew2.waitThreadStop();
+  ew3.waitThreadStop();
+
+  arena.getStats(&stats);
+  getrusage(RUSAGE_SELF, &usage);
+  printf("arena: %lu lines in %lld ms, %.5f allocations per line"
+         " (%lu slabs, %lu recycled, %lu in use with %lu records kept),"
+         " peak RSS %ld KB\n", lines, elapsed / 1000,
+         (double)stats.mallocs / lines, stats.mallocs, stats.recycled,
+         kept_slabs, lines / 3000, usage.ru_maxrss);
+
+  /* a malloc per slab of items at most, and the slabs are reused */
+  if (stats.items != lines || stats.mallocs * 100 > lines)
+    ret = 1;
+  if (stats.live_slabs > LOGARENA_MAX_FREE + 1 || kept_slabs > ARENA_TEST_KEPT_SLABS)
+    ret = 1;
+  if (ew1.getMailboxDrops() || ew2.getMailboxDrops() || ew3.getMailboxDrops())
+    ret = 1;
+  return ret;
+}
@@ -14,6 +14,11 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <regex.h>
+#include <time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -46,3 +51,126 @@ int test_data_replace_incomplete() {
     return 1;
   return 0;
 }
+
+/* The former implementation, substituting with regexec until nothing
+ * matches */
+static std::string referenceFormat(std::string str,
+                                   std::map<char, std::string> h_map,
+                                   std::vector<std::string> captures) {
+  regex_t rx;
+  regmatch_t matches[2];
+
+  if (regcomp(&rx, "%([a-zA-Z]+)", REG_EXTENDED))
+    return str;
+  while (!regexec(&rx, str.c_str(), 2, matches, 0)) {
+    char key = str[matches[1].rm_so];
+    str.replace(matches[0].rm_so, matches[0].rm_eo - matches[0].rm_so,
+                h_map[key].empty() ? "-?-" : h_map[key]);
+  }
+  regfree(&rx);
+
+  if (regcomp(&rx, "%([0-9]+)", REG_EXTENDED))
+    return str;
+  while (!regexec(&rx, str.c_str(), 2, matches, 0)) {
+    int id = atoi(str.substr(matches[1].rm_so,
+                             matches[1].rm_eo - matches[1].rm_so).c_str());
+    str.replace(matches[0].rm_so, matches[0].rm_eo - matches[0].rm_so,
+                (id >= 0 && (size_t)id < captures.size()) ? captures[id]
+                                                          : "-?-");
+  }
+  regfree(&rx);
+  return str;
+}
+
+static const char *data_templates[] = {
+  "",
+  "no directive",
+  "%0",
+  "%1/%2",
+  "%R records, %r, %S suspended",
+  "%rest %Rz",
+  "%12 %3",
+  "100% of %1, %% %-",
+  "%",
+  "trailing %",
+  "%1%2 %r",
+  "%Q unknown",
+};
+
+int test_data_directives() {
+  std::vector<std::string> captures;
+  std::map<char, std::string> map;
+
+  for (int i = 0; i < 13; i++)
+    captures.push_back("c" + std::to_string(i));
+  map['r'] = "1";
+  map['R'] = "4";
+  map['S'] = "2";
+
+  for (auto tmpl : data_templates) {
+    DataFormat df(tmpl);
+    std::string ret = df.format(captures, map);
+    std::string ref = referenceFormat(tmpl, map, captures);
+    if (ret != ref) {
+      printf("format \"%s\": \"%s\", expected \"%s\"\n", tmpl, ret.c_str(),
+             ref.c_str());
+      return 1;
+    }
+  }
+
+  // a value is not parsed again, the former substitution read "%21" here
+  DataFormat values("%2%r");
+  if (values.format(captures, map) != "c21")
+    return 1;
+
+  DataFormat df("%r of %R, %S: %0 %1 %2");
+  df.setMap('r', "0");
+  df.setMap('R', "3");
+  if (df.format(captures) != "0 of 3, -?-: c0 c1 c2")
+    return 1;
+  // the captures and the map are kept for the next calls
+  df.setMap('S', "5");
+  if (df.format(std::vector<std::string>()) != "0 of 3, 5: c0 c1 c2")
+    return 1;
+  df.cleanMap();
+  if (df.format(std::vector<std::string>(1, "x")) != "-?- of -?-, -?-: x -?- -?-")
+    return 1;
+  return 0;
+}
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int test_data_timing() {
+  std::vector<std::string> captures;
+  std::map<char, std::string> map;
+  const char *tmpl = "%1 crashed (%2), record %r of %R, %S suspended";
+  const int loops = 10000;
+  long long start, compiled, reference;
+  size_t len = 0;
+
+  captures.push_back("Kernel panic - not syncing: Fatal exception");
+  captures.push_back("Fatal exception");
+  captures.push_back("in interrupt");
+  map['r'] = "3";
+  map['R'] = "10";
+  map['S'] = "0";
+
+  DataFormat df(tmpl);
+  start = now_ns();
+  for (int i = 0; i < loops; i++)
+    len += df.format(captures, map).size();
+  compiled = now_ns() - start;
+
+  start = now_ns();
+  for (int i = 0; i < loops; i++)
+    len -= referenceFormat(tmpl, map, captures).size();
+  reference = now_ns() - start;
+
+  printf("data format: %lld ns per format, %lld ns with regcomp\n",
+         compiled / loops, reference / loops);
+  return (!len && compiled < reference) ? 0 : 1;
+}
@@ -16,9 +16,9 @@
  */
 
 #include <unistd.h>
+#include <cstdarg>
 #include <cstdio>
 #include <fstream>
-#include <memory>
 #include <string>
 
 #include "../EventWatch.h"
@@ -26,6 +26,16 @@
 #include "../LwConfig.h"
 #include "../utils.h"
 
+static LogItemPtr newItem(const char *fmt, ...) {
+  char msg[100];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, args);
+  va_end(args);
+  return LogItem::create(msg);
+}
+
 int test_eventwatch_invalid() {
   EventWatch ew("test_invalid");
   if (ew.isValid())
@@ -50,14 +60,10 @@ int test_eventwatch_accept_one() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-
-  char *msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  LogItemPtr li = newItem("some text");
   ew.feed(li);
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
 
@@ -103,26 +109,16 @@ int test_eventwatch_flush_eof() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-
-  char *msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  LogItemPtr li = newItem("some text");
   ew.feed(li);
 
-  li = std::make_shared<LogItem>();
-  msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  li = newItem("some text");
   ew.feed(li);
 
-  li = std::make_shared<LogItem>();
-  msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  li = newItem("some text");
   ew.feed(li);
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
 
@@ -157,26 +153,16 @@ int test_eventwatch_history() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-
-  char *msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  LogItemPtr li = newItem("some text");
   ew.feed(li);
 
-  li = std::make_shared<LogItem>();
-  msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  li = newItem("some text");
   ew.feed(li);
 
-  li = std::make_shared<LogItem>();
-  msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  li = newItem("some text");
   ew.feed(li);
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
 
@@ -216,34 +202,24 @@ int test_eventwatch_kick_noisy() {
   if (!ew.isValid())
     return 1;
 
-  std::shared_ptr<LogItem> li;
-  char *msg;
+  LogItemPtr li;
 
-  li = std::make_shared<LogItem>();
-  msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  li = newItem("some text");
   li->setTimestamp(TimeVal(0));
   ew.feed(li);
 
-  li = std::make_shared<LogItem>();
-  msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  li = newItem("some text");
   li->setTimestamp(TimeVal(1));
   ew.feed(li);
 
-  li = std::make_shared<LogItem>();
-  msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  li = newItem("some text");
   li->setTimestamp(TimeVal(1));
   ew.feed(li);
 
   sleep(1);
   // by this time it should be dead
   if (ew.isEnabled()) {
-    std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+    LogItemPtr li_stop = LogItem::create();
     li_stop->setEof(true);
     ew.feed(li_stop);
     ret = 1;
@@ -268,22 +244,18 @@ int test_eventwatch_gen_1() {
   if (!ew.isValid())
     return 1;
 
-  std::shared_ptr<LogItem> li;
-  char *msg;
+  LogItemPtr li;
   int count = 4;
 
   while (count--) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "some text %d", count);
-    li->setMsg(msg);
+    li = newItem("some text %d", count);
     ew.feed(li);
   }
 
   sleep(1);
   // by this time it should be dead
   if (ew.isEnabled()) {
-    std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+    LogItemPtr li_stop = LogItem::create();
     li_stop->setEof(true);
     ew.feed(li_stop);
     ret = 1;
@@ -314,21 +286,17 @@ int test_eventwatch_gen_2() {
   if (!ew.isValid())
     return 1;
 
-  std::shared_ptr<LogItem> li;
-  char *msg;
+  LogItemPtr li;
   int count = 4;
 
   while (count--) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "some text %d", count);
-    li->setMsg(msg);
+    li = newItem("some text %d", count);
     ew.feed(li);
   }
   sleep(1);
   // by this time it should be dead
   if (ew.isEnabled()) {
-    std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+    LogItemPtr li_stop = LogItem::create();
     li_stop->setEof(true);
     ew.feed(li_stop);
     ret = 1;
@@ -348,7 +316,7 @@ int test_eventwatch_gen_2() {
   return ret;
 }
 
-int test_eventwatch_kick_lazy() {
+int test_eventwatch_mailbox_drop() {
   std::string test_ew_name = "test_watch";
   std::string test_ew_path = LwConfig::inst()->getWorkDir() + "/"
       + test_ew_name;
@@ -359,35 +327,27 @@ int test_eventwatch_kick_lazy() {
   ew.setMaxRecords(1);
   ew.setMailboxMax(2);
 
-  EventAttachment attachment("sleep 5", "sleep_res", true, 5000);
+  EventAttachment attachment("sleep 2", "sleep_res", true, 5000);
   ew.addAttachment(attachment);
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-
-  char *msg = new char[100];
-  snprintf(msg, 100, "some text");
-  li->setMsg(msg);
+  LogItemPtr li = newItem("some text");
   ew.feed(li);
 
   int count = 5;
   while (count--) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "some text");
-    li->setMsg(msg);
+    li = newItem("some text");
     ew.feed(li);
   }
 
-  sleep(6);
-  // by this time it should be dead
-  if (ew.isEnabled()) {
-    std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
-    li_stop->setEof(true);
-    ew.feed(li_stop);
+  // the items which do not fit are dropped, the watcher keeps running
+  if (!ew.isEnabled() || !ew.getMailboxDrops())
     ret = 1;
-  }
+
+  LogItemPtr li_stop = LogItem::create();
+  li_stop->setEof(true);
+  ew.feed(li_stop);
   ew.waitThreadStop();
 
   utils::rmRec(test_ew_path, true);
@@ -408,19 +368,15 @@ int test_eventwatch_suspend_interval() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-  char *msg;
+  LogItemPtr li;
 
   for (int i = 0; i < 6; i++) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "some text %d", i);
-    li->setMsg(msg);
+    li = newItem("some text %d", i);
     li->setTimestamp(TimeVal(i));
     ew.feed(li);
   }
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
   ew.waitThreadStop();
@@ -459,19 +415,15 @@ int test_eventwatch_suspend_interval_keep() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-  char *msg;
+  LogItemPtr li;
 
   for (int i = 0; i < 6; i++) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "some text %d", i);
-    li->setMsg(msg);
+    li = newItem("some text %d", i);
     li->setTimestamp(TimeVal(i));
     ew.feed(li);
   }
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
   ew.waitThreadStop();
@@ -516,21 +468,17 @@ int test_eventwatch_vlidation_pass() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-  char *msg;
+  LogItemPtr li;
 
   for (size_t i = 0; i < sizeof(lines) / sizeof(*lines); i++) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "%s", lines[i]);
-    li->setMsg(msg);
+    li = newItem("%s", lines[i]);
     li->setTimestamp(TimeVal(i));
     ew.feed(li);
   }
 
   sleep(1);
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
   ew.waitThreadStop();
@@ -572,21 +520,17 @@ int test_eventwatch_vlidation_pass_twice() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-  char *msg;
+  LogItemPtr li;
 
   for (size_t i = 0; i < sizeof(lines) / sizeof(*lines); i++) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "%s", lines[i]);
-    li->setMsg(msg);
+    li = newItem("%s", lines[i]);
     li->setTimestamp(TimeVal(i));
     ew.feed(li);
   }
 
   sleep(1);
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
   ew.waitThreadStop();
@@ -626,19 +570,15 @@ int test_eventwatch_vlidation_fail() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-  char *msg;
+  LogItemPtr li;
 
   for (size_t i = 0; i < sizeof(lines) / sizeof(*lines); i++) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "%s", lines[i]);
-    li->setMsg(msg);
+    li = newItem("%s", lines[i]);
     li->setTimestamp(TimeVal(i));
     ew.feed(li);
   }
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
   ew.waitThreadStop();
@@ -677,19 +617,15 @@ int test_eventwatch_no_vlidation() {
 
   if (!ew.isValid())
     return 1;
-  std::shared_ptr<LogItem> li = std::make_shared<LogItem>();
-  char *msg;
+  LogItemPtr li;
 
   for (size_t i = 0; i < sizeof(lines) / sizeof(*lines); i++) {
-    li = std::make_shared<LogItem>();
-    msg = new char[100];
-    snprintf(msg, 100, "%s", lines[i]);
-    li->setMsg(msg);
+    li = newItem("%s", lines[i]);
     li->setTimestamp(TimeVal(i));
     ew.feed(li);
   }
 
-  std::shared_ptr<LogItem> li_stop = std::make_shared<LogItem>();
+  LogItemPtr li_stop = LogItem::create();
   li_stop->setEof(true);
   ew.feed(li_stop);
   ew.waitThreadStop();
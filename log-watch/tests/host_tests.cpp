@@ -56,10 +56,32 @@ int main(int argc, char **argv) {
   ASSERT_EQ(0, test_data_replace_complete());
   // Run test_data_replace_incomplete
   ASSERT_EQ(0, test_data_replace_incomplete());
+  // Run test_data_directives
+  ASSERT_EQ(0, test_data_directives());
+  // Run test_data_timing
+  ASSERT_EQ(0, test_data_timing());
+  // Run test_mailbox_order
+  ASSERT_EQ(0, test_mailbox_order());
+  // Run test_mailbox_throughput
+  ASSERT_EQ(0, test_mailbox_throughput());
+  // Run test_arena_recycle
+  ASSERT_EQ(0, test_arena_recycle());
+  // Run test_arena_stress
+  ASSERT_EQ(0, test_arena_stress());
+  // Run test_kmsg_records
+  ASSERT_EQ(0, test_kmsg_records());
+  // Run test_kmsg_batch
+  ASSERT_EQ(0, test_kmsg_batch());
   // Run test_pattern_invalid
   ASSERT_EQ(0, test_pattern_invalid());
   // Run test_pattern_valid
   ASSERT_EQ(0, test_pattern_valid());
+  // Run test_pattern_literals
+  ASSERT_EQ(0, test_pattern_literals());
+  // Run test_pattern_prefilter
+  ASSERT_EQ(0, test_pattern_prefilter());
+  // Run test_pattern_benchmark
+  ASSERT_EQ(0, test_pattern_benchmark());
   // Run test_eventwatch_invalid
   ASSERT_EQ(0, test_eventwatch_invalid());
   // Run test_eventwatch_invalid_bad_start
@@ -76,8 +98,8 @@ int main(int argc, char **argv) {
   ASSERT_EQ(0, test_eventwatch_gen_1());
   // Run test_eventwatch_gen_2
   ASSERT_EQ(0, test_eventwatch_gen_2());
-  // Run test_eventwatch_kick_lazy
-  ASSERT_EQ(0, test_eventwatch_kick_lazy());
+  // Run test_eventwatch_mailbox_drop
+  ASSERT_EQ(0, test_eventwatch_mailbox_drop());
   // Run test_eventwatch_suspend_interval
   ASSERT_EQ(0, test_eventwatch_suspend_interval());
   // Run test_eventwatch_suspend_interval_keep
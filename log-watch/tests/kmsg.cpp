@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+
+#include "../KmsgReader.h"
+#include "../LogItem.h"
+
+#define KMSG_TEST_RECORDS 100000
+
+/* Recorded /dev/kmsg records, as returned by read() */
+static const char *kmsg_records[] = {
+  "6,100,5000000,-;usb 1-1: new high-speed USB device number 2\n"
+  " SUBSYSTEM=usb\n"
+  " DEVICE=c189:1\n",
+  "30,101,5000123,c;init: Service 'bootanim' (pid 311) exited\n",
+  "3,105,12345678901,-,caller=T1;Out of memory: Kill process 42 (app)\n",
+  "line written without header",
+  "4,106,12345679000;binder: 1203:1203 transaction failed 29189/-22\n",
+};
+
+static const char *kmsg_lines[] = {
+  "<6> [    5.000000] usb 1-1: new high-speed USB device number 2",
+  "<6> [    5.000123] init: Service 'bootanim' (pid 311) exited",
+  "<3> [12345.678901] Out of memory: Kill process 42 (app)",
+  "<3> [12345.678901] line written without header",
+  "<4> [12345.679000] binder: 1203:1203 transaction failed 29189/-22",
+};
+
+/* A datagram socket keeps the records apart, as /dev/kmsg does */
+static int fakeKmsg(int fds[2]) {
+  return socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds);
+}
+
+int test_kmsg_records() {
+  int fds[2];
+  size_t count = sizeof(kmsg_records) / sizeof(kmsg_records[0]);
+
+  if (fakeKmsg(fds))
+    return 1;
+  for (size_t i = 0; i < count; i++) {
+    if (write(fds[1], kmsg_records[i], strlen(kmsg_records[i])) < 0)
+      return 1;
+  }
+
+  KmsgReader reader(fds[0], true);
+  for (size_t i = 0; i < count; i++) {
+    LogItemPtr li = reader.get();
+    if (li->isEof() || li->isEmpty() || strcmp(li->getMsg(), kmsg_lines[i]))
+      return 1;
+  }
+  LogItemPtr li = reader.get();
+  close(fds[1]);
+
+  /* the end of the records, after the gap from 101 to 105 */
+  if (!li->isEof() || reader.getDropped() != 3)
+    return 1;
+  return 0;
+}
+
+static void *kmsg_writer(void *arg) {
+  int fd = *reinterpret_cast<int *>(arg);
+  char record[256];
+
+  for (int seq = 0; seq < KMSG_TEST_RECORDS; seq++) {
+    int len = snprintf(record, sizeof(record),
+                       "%d,%d,%d,-;binder: %d:%d transaction failed\n",
+                       3 + seq % 4, seq, seq * 10, seq % 4000, seq % 97);
+    if (write(fd, record, len) < 0)
+      break;
+  }
+  close(fd);
+  return NULL;
+}
+
+/* The records of a flood, waited for with poll() */
+int test_kmsg_batch() {
+  int fds[2];
+  pthread_t thread;
+  struct timespec start, end;
+  int count = 0, empty = 0;
+  int ret = 0;
+
+  if (fakeKmsg(fds))
+    return 1;
+  KmsgReader reader(fds[0], false);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (pthread_create(&thread, NULL, kmsg_writer, &fds[1]))
+    return 1;
+  for (LogItemPtr li = reader.get(); !li->isEof(); li = reader.get()) {
+    if (li->isEmpty()) {
+      empty++;
+      continue;
+    }
+    TimeVal ts(count * 10 / 1000000, count * 10 % 1000000);
+    if (!(li->getTimestamp() == ts))
+      ret = 1;
+    count++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  pthread_join(thread, NULL);
+
+  long long ns = (end.tv_sec - start.tv_sec) * 1000000000LL
+      + end.tv_nsec - start.tv_nsec;
+  printf("kmsg: %d records, %lld ns per record\n", count, ns / count);
+  if (count != KMSG_TEST_RECORDS || empty || reader.getDropped())
+    ret = 1;
+  return ret;
+}
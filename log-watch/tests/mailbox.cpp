@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Intel 2015
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
+#include <cstdio>
+#include <list>
+
+#include "../LogItem.h"
+#include "../Mailbox.h"
+
+#define MAILBOX_TEST_ITEMS 1000000
+#define MAILBOX_TEST_CAPACITY 5000
+#define MAILBOX_TEST_BATCH 64
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *order_consumer(void *arg) {
+  Mailbox<unsigned long> *mb = reinterpret_cast<Mailbox<unsigned long> *>(arg);
+  unsigned long items[MAILBOX_TEST_BATCH];
+  unsigned long expected = 0;
+
+  while (expected < MAILBOX_TEST_ITEMS) {
+    size_t count = mb->pop(items, MAILBOX_TEST_BATCH);
+    for (size_t idx = 0; idx < count; idx++) {
+      if (items[idx] != expected++)
+        return reinterpret_cast<void *>(1);
+    }
+  }
+  return NULL;
+}
+
+int test_mailbox_order() {
+  Mailbox<unsigned long> mb;
+  pthread_t thread;
+  void *res;
+
+  mb.setCapacity(100);
+  if (pthread_create(&thread, NULL, order_consumer, &mb))
+    return 1;
+  for (unsigned long item = 0; item < MAILBOX_TEST_ITEMS; item++) {
+    while (!mb.push(item))
+      sched_yield();
+  }
+  pthread_join(thread, &res);
+  return res ? 1 : 0;
+}
+
+struct ThroughputArg {
+  Mailbox<LogItemPtr> mb;
+  std::list<LogItemPtr> list;
+  pthread_mutex_t mutex;
+  sem_t available;
+};
+
+static void *ring_consumer(void *arg) {
+  ThroughputArg *ta = reinterpret_cast<ThroughputArg *>(arg);
+  LogItemPtr items[MAILBOX_TEST_BATCH];
+  unsigned long received = 0;
+
+  while (received < MAILBOX_TEST_ITEMS) {
+    size_t count = ta->mb.pop(items, MAILBOX_TEST_BATCH);
+    for (size_t idx = 0; idx < count; idx++)
+      items[idx].reset();
+    received += count;
+  }
+  return NULL;
+}
+
+/* The mailbox as it was: a list under a mutex and a post per item */
+static void *list_consumer(void *arg) {
+  ThroughputArg *ta = reinterpret_cast<ThroughputArg *>(arg);
+  LogItemPtr li;
+
+  for (unsigned long received = 0; received < MAILBOX_TEST_ITEMS; received++) {
+    sem_wait(&ta->available);
+    pthread_mutex_lock(&ta->mutex);
+    li = ta->list.front();
+    ta->list.pop_front();
+    pthread_mutex_unlock(&ta->mutex);
+    li.reset();
+  }
+  return NULL;
+}
+
+int test_mailbox_throughput() {
+  LogItemPtr li = LogItem::create();
+  ThroughputArg ta;
+  long long start, ring, list;
+  pthread_t thread;
+
+  ta.mb.setCapacity(MAILBOX_TEST_CAPACITY);
+  pthread_mutex_init(&ta.mutex, NULL);
+  sem_init(&ta.available, 0, 0);
+
+  start = now_ns();
+  if (pthread_create(&thread, NULL, ring_consumer, &ta))
+    return 1;
+  for (unsigned long item = 0; item < MAILBOX_TEST_ITEMS; item++) {
+    while (!ta.mb.push(li))
+      sched_yield();
+  }
+  pthread_join(thread, NULL);
+  ring = now_ns() - start;
+
+  start = now_ns();
+  if (pthread_create(&thread, NULL, list_consumer, &ta))
+    return 1;
+  for (unsigned long item = 0; item < MAILBOX_TEST_ITEMS; item++) {
+    pthread_mutex_lock(&ta.mutex);
+    ta.list.push_back(li);
+    pthread_mutex_unlock(&ta.mutex);
+    sem_post(&ta.available);
+  }
+  pthread_join(thread, NULL);
+  list = now_ns() - start;
+
+  printf("mailbox: %d items, %lld ns per item, %lld ns with a locked list\n",
+         MAILBOX_TEST_ITEMS, ring / MAILBOX_TEST_ITEMS, list / MAILBOX_TEST_ITEMS);
+  sem_destroy(&ta.available);
+  pthread_mutex_destroy(&ta.mutex);
+  /* every item was released by the consumers */
+  return li->getRefs() == 1 ? 0 : 1;
+}
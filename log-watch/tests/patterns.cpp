@@ -15,10 +15,15 @@
  * limitations under the License.
  */
 
+#include <time.h>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include "../ItemPattern.h"
+#include "../LogItem.h"
+#include "../PatternFilter.h"
 
 int test_pattern_invalid() {
   ItemPattern ip("(");
@@ -46,3 +51,153 @@ int test_pattern_valid() {
       return 1;
   return 0;
 }
+
+static const char *kmsg_patterns[] = {
+  "Kernel panic - not syncing: (.+)",
+  "WARNING: CPU: ([0-9]+) PID: ([0-9]+) at (.+)",
+  "BUG: unable to handle kernel (NULL pointer dereference|paging request)",
+  "Out of memory: Kill process ([0-9]+) \\(([^)]+)\\)",
+  "(mmc[0-9]+): Timeout waiting for hardware interrupt",
+  "iwlwifi [0-9a-f:.]+: Microcode SW error detected",
+  "thermal thermal_zone[0-9]+: critical temperature reached \\(([0-9]+) C\\)",
+  "usb [0-9.-]+: device descriptor read/64, error (-?[0-9]+)",
+  "EXT4-fs error \\(device ([^)]+)\\): (.+)",
+  "Watchdog detected (hard|soft) LOCKUP on cpu ([0-9]+)",
+  "^<[0-7]> \\[ *[0-9.]+\\] (init|ueventd): .*",
+  "binder: [0-9]+:[0-9]+ transaction failed ([0-9]+)/(-?[0-9]+)",
+};
+
+static const char *kmsg_lines[] = {
+  "usb 1-1: new high-speed USB device number %d using xhci_hcd",
+  "healthd: battery l=%d v=3987 t=27.0 h=2 st=3 c=-245 fc=3037000 cc=12 chg=",
+  "audit: type=1400 audit(1462.%d:87): avc: denied { read } for pid=%d "
+      "comm=\"surfaceflinger\" name=\"mem\" dev=\"debugfs\" ino=1234 "
+      "scontext=u:r:surfaceflinger:s0 tcontext=u:object_r:debugfs:s0 "
+      "tclass=file permissive=0",
+  "binder: %d:2081 transaction failed 29189/-22, size 0-0 line 2980",
+  "wlan0: disconnect from AP 00:11:22:33:44:%02d for new auth to "
+      "00:11:22:33:44:55",
+  "init: Service 'bootanim' (pid %d) exited with status 0",
+  "EXT4-fs (mmcblk0p%d): mounted filesystem with ordered data mode. Opts: "
+      "(null)",
+  "mmc0: Timeout waiting for hardware interrupt (%d)",
+  "Out of memory: Kill process %d (com.example.app) score 912 or sacrifice "
+      "child",
+  "WARNING: CPU: 1 PID: %d at kernel/sched/core.c:1234 "
+      "__might_sleep+0x7e/0x90()",
+  "lowmemorykiller: Killing 'droid.gallery3d' (%d), adj 1000,",
+  "Watchdog detected soft LOCKUP on cpu %d",
+};
+
+/* Kernel messages as formatted by KmsgReader: mostly noise, every 50th line
+ * is of a kind the patterns look for */
+static std::vector<LogItemPtr> kmsgCorpus(size_t count) {
+  std::vector<LogItemPtr> items;
+  char buf[512];
+  size_t noise = 7, matching = sizeof(kmsg_lines) / sizeof(kmsg_lines[0]);
+
+  for (size_t i = 0; i < count; i++) {
+    const char *fmt = (i % 50) ? kmsg_lines[i % noise]
+        : kmsg_lines[noise + (i / 50) % (matching - noise)];
+    int len = snprintf(buf, sizeof(buf), "<%zu> [%5zu.%06zu] ", 3 + i % 4,
+                       i / 100, (i * 7919) % 1000000);
+    snprintf(buf + len, sizeof(buf) - len, fmt, (int)(i % 997));
+
+    items.push_back(LogItem::create(buf));
+  }
+  return items;
+}
+
+static void checkAll(std::vector<ItemPattern *> &patterns,
+                     std::vector<LogItemPtr> &items,
+                     bool filter, std::vector<std::string> *results) {
+  for (auto &li : items) {
+    if (filter)
+      PatternFilter::inst()->scan(li.get());
+    else
+      li->resetCandidates(0);
+    for (auto pat : patterns) {
+      if (!pat->check(*li))
+        continue;
+      if (results) {
+        for (auto &capture : pat->getLastMatches())
+          results->push_back(capture);
+      }
+    }
+  }
+}
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int test_pattern_literals() {
+  static const char *expected[][2] = {
+    { "Kernel panic - not syncing: (.+)", "Kernel panic - not syncing: " },
+    { "ab+c", "ab" },
+    { "x*abc?de", "ab" },
+    { "(foo|bar) baz", " baz" },
+    { "foo|bar", "" },
+    { "(long literal)+ x", "long literal" },
+    { "(long literal)? x", " x" },
+    { "a\\.b\\wcd", "a.b" },
+    { "[[:alpha:]]]xyz", "]xyz" },
+    { "a{0,2}bc{2}", "bc" },
+    { ".*", "" },
+  };
+
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    ItemPattern ip(expected[i][0]);
+    if (!ip.isValid() || ip.getLiteral() != expected[i][1]) {
+      printf("pattern %s: literal \"%s\", expected \"%s\"\n", expected[i][0],
+             ip.getLiteral().c_str(), expected[i][1]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int test_pattern_prefilter() {
+  std::vector<LogItemPtr> lines = kmsgCorpus(20000);
+  std::vector<std::string> filtered, unfiltered;
+  std::vector<ItemPattern *> patterns;
+  int ret = 0;
+
+  for (auto pattern : kmsg_patterns)
+    patterns.push_back(new ItemPattern(pattern));
+
+  checkAll(patterns, lines, false, &unfiltered);
+  checkAll(patterns, lines, true, &filtered);
+  if (unfiltered.empty() || filtered != unfiltered)
+    ret = 1;
+
+  for (auto pat : patterns)
+    delete pat;
+  return ret;
+}
+
+int test_pattern_benchmark() {
+  std::vector<LogItemPtr> lines = kmsgCorpus(20000);
+  std::vector<ItemPattern *> patterns;
+  long long start, before, after;
+
+  for (auto pattern : kmsg_patterns)
+    patterns.push_back(new ItemPattern(pattern));
+
+  start = now_ns();
+  checkAll(patterns, lines, false, NULL);
+  before = now_ns() - start;
+  start = now_ns();
+  checkAll(patterns, lines, true, NULL);
+  after = now_ns() - start;
+  printf("patterns: %zu lines, %lld lines/s with regexec only, "
+         "%lld lines/s with the literal filter\n", lines.size(),
+         lines.size() * 1000000000LL / (before ? before : 1),
+         lines.size() * 1000000000LL / (after ? after : 1));
+
+  for (auto pat : patterns)
+    delete pat;
+  return after < before ? 0 : 1;
+}
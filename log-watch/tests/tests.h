@@ -32,9 +32,23 @@ int test_attachments_replace_cap();
 
 int test_data_replace_complete();
 int test_data_replace_incomplete();
+int test_data_directives();
+int test_data_timing();
+
+int test_mailbox_order();
+int test_mailbox_throughput();
+
+int test_arena_recycle();
+int test_arena_stress();
+
+int test_kmsg_records();
+int test_kmsg_batch();
 
 int test_pattern_invalid();
 int test_pattern_valid();
+int test_pattern_literals();
+int test_pattern_prefilter();
+int test_pattern_benchmark();
 
 int test_eventwatch_invalid();
 int test_eventwatch_invalid_bad_start();
@@ -44,7 +58,7 @@ int test_eventwatch_history();
 int test_eventwatch_kick_noisy();
 int test_eventwatch_gen_1();
 int test_eventwatch_gen_2();
-int test_eventwatch_kick_lazy();
+int test_eventwatch_mailbox_drop();
 int test_eventwatch_suspend_interval();
 int test_eventwatch_suspend_interval_keep();
 int test_eventwatch_vlidation_pass();
@@ -18,12 +18,18 @@
 #include "utils.h"
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <linux/fs.h>
 #include <stddef.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <cstring>
 #include <string>
+#include <vector>
 
 bool utils::isDir(std::string dir) {
   struct stat buf;
@@ -39,6 +45,79 @@ bool utils::isFile(std::string path) {
   return S_ISREG(buf.st_mode);
 }
 
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+namespace {
+const size_t COPY_BUFFER_SIZE = 128 * 1024;
+
+/* Read/write fallback, pseudo files (procfs, debugfs) report no size */
+bool copyRw(int source, int dest) {
+  std::vector<char> buf(COPY_BUFFER_SIZE);
+  ssize_t size;
+
+  while ((size = read(source, buf.data(), buf.size())) != 0) {
+    if (size < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN;
+    }
+    for (ssize_t done = 0, w; done < size; done += w) {
+      w = write(dest, buf.data() + done, size - done);
+      if (w < 0 && errno == EINTR)
+        w = 0;
+      else if (w <= 0)
+        return false;
+    }
+  }
+  return true;
+}
+
+bool copyUnsupported(int err) {
+  return err == EINVAL || err == EXDEV || err == ENOSYS || err == EOPNOTSUPP ||
+         err == EBADF;
+}
+
+/* Regular file: clone, then in kernel copies looping on short transfers,
+ * each method restarting where the previous one stopped */
+bool copyRegular(int source, int dest, size_t count) {
+  if (!ioctl(dest, FICLONE, source))
+    return true;
+
+  enum { COPY_RANGE, COPY_SENDFILE, COPY_RW } method = COPY_RANGE;
+#ifndef __NR_copy_file_range
+  method = COPY_SENDFILE;
+#endif
+  off_t pos = 0;
+  size_t total = 0;
+  while (total < count) {
+    ssize_t n;
+    if (method == COPY_RW)
+      return lseek(source, pos, SEEK_SET) >= 0 && copyRw(source, dest);
+#ifdef __NR_copy_file_range
+    if (method == COPY_RANGE) {
+      loff_t lpos = pos;
+      n = syscall(__NR_copy_file_range, source, &lpos, dest, nullptr,
+                  count - total, 0);
+      pos = lpos;
+    } else
+#endif
+      n = sendfile(dest, source, &pos, count - total);
+    if (n > 0) {
+      total += n;
+    } else if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    } else if (n < 0 && !copyUnsupported(errno)) {
+      return false;
+    } else {
+      method = static_cast<decltype(method)>(method + 1);
+    }
+  }
+  return true;
+}
+}  // namespace
+
 bool utils::copyFile(std::string s, std::string d) {
   int source = open(s.c_str(), O_RDONLY | O_NONBLOCK, 0);
   if (source < 0)
@@ -50,16 +129,17 @@ bool utils::copyFile(std::string s, std::string d) {
     close(source);
     return false;
   }
-  char buf[4096];
-  ssize_t size;
 
-  while ((size = read(source, buf, 4096)) > 0) {
-    write(dest, buf, size);
-  }
+  struct stat st;
+  bool ret;
+  if (!fstat(source, &st) && S_ISREG(st.st_mode) && st.st_size > 0)
+    ret = copyRegular(source, dest, st.st_size);
+  else
+    ret = copyRw(source, dest);
 
   close(source);
   close(dest);
-  return true;
+  return ret;
 }
 
 bool utils::rmRec(std::string path, bool rem_root) {